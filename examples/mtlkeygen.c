@@ -83,7 +83,7 @@ uint8_t new_key(char *keystr, char *keyfilename, char *ctx_str)
         return 1;
     }
 
-    buffer_len = mtllib_key_to_buffer(mtl_ctx, &buffer);
+    buffer_len = mtllib_key_to_buffer_version(mtl_ctx, &buffer, MTLLIB_KEY_FORMAT_V2);
 
     if ((buffer == NULL) || (buffer_len == 0))
     {
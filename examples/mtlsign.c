@@ -199,7 +199,7 @@ int main(int argc, char **argv)
     keyfile_size = buffer_from_file(keyfilename, &keybuffer);
 
 
-    if(mtllib_key_from_buffer(keybuffer, keyfile_size, &ctx) != MTLLIB_OK) {     
+    if(mtllib_key_from_buffer_threads(keybuffer, keyfile_size, &ctx, 0) != MTLLIB_OK) {     
         LOG_ERROR("Unable to load key\n");
         free(handle_zero);
         return (2);    
@@ -333,7 +333,7 @@ int main(int argc, char **argv)
     // Output updated private key
     if ((keyfilename != NULL) && (key_updated == true))
     {
-        keyfile_size = mtllib_key_to_buffer(ctx, &keybuffer);
+        keyfile_size = mtllib_key_to_buffer_version(ctx, &keybuffer, MTLLIB_KEY_FORMAT_V2);
         if(keyfile_size > 0) {
             FILE* outfile = fopen(keyfilename, "wb");
             if (outfile == NULL) {
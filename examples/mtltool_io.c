@@ -65,6 +65,7 @@ uint8_t write_key_file(char *keyfilename, uint8_t * sk, uint32_t sk_len,
 {
 	uint32_t tree_pages = 0;
 	uint32_t randomizer_pages = 0;
+	uint32_t leaf_count;
 	uint32_t index;
 	uint32_t id_str_length;
 	FILE *keyfile = NULL;
@@ -74,6 +75,14 @@ uint8_t write_key_file(char *keyfilename, uint8_t * sk, uint32_t sk_len,
 	// read and write only for owner of application
 	umask(0133);
 
+	// The tool format holds a 32 bit leaf count, which a full node set
+	// (2^32 leaves) does not fit in
+	if (mtl_ctx->nodes.leaf_count > UINT32_MAX) {
+		LOG_ERROR("Node set is too large for the keyfile");
+		return 1;
+	}
+	leaf_count = (uint32_t)mtl_ctx->nodes.leaf_count;
+
 	if ((keyfile = fopen(keyfilename, "wb")) == NULL) {
 		LOG_ERROR("Unable to open the keyfile");
 		return 1;
@@ -107,17 +116,17 @@ uint8_t write_key_file(char *keyfilename, uint8_t * sk, uint32_t sk_len,
 	// Save the MTL tree data
 	fwrite(&mtl_ctx->sid.id, mtl_ctx->sid.length, 1, keyfile);
 	// Leaf Count
-	fwrite(&mtl_ctx->nodes.leaf_count, 4, 1, keyfile);
+	fwrite(&leaf_count, 4, 1, keyfile);
 	// Hash Size    
 	fwrite(&mtl_ctx->nodes.hash_size, 2, 1, keyfile);
-	for (index = 0; index < MTL_TREE_MAX_PAGES; index++) {
+	for (index = 0; index < mtl_ctx->nodes.tree_page_count; index++) {
 		if (mtl_ctx->nodes.tree_pages[index] != NULL) {
 			tree_pages++;
 		}
 	}
 	// Tree Hash Count
 	fwrite(&tree_pages, 4, 1, keyfile);
-	for (index = 0; index < MTL_TREE_RANDOMIZER_PAGES; index++) {
+	for (index = 0; index < mtl_ctx->nodes.randomizer_page_count; index++) {
 		if (mtl_ctx->nodes.randomizer_pages[index] != NULL) {
 			randomizer_pages++;
 		}
@@ -160,6 +169,7 @@ uint8_t read_key_file(char *keyfilename, uint8_t ** sk, uint32_t * sk_len,
 	uint32_t tree_pages = 0;
 	uint32_t randomizer_pages = 0;
 	uint32_t index = 0;
+	uint8_t *page = NULL;
 	uint32_t length = 0;
 	uint32_t leaf_count = 0;
 	int32_t hash_size = 0;
@@ -368,9 +378,7 @@ uint8_t read_key_file(char *keyfilename, uint8_t ** sk, uint32_t * sk_len,
 	}
 
 	for (index = 0; index < tree_pages; index++) {
-		mtl->nodes.tree_pages[index] =
-		    malloc(mtl->nodes.tree_page_size);
-		if(mtl->nodes.tree_pages[index] == NULL) {
+		if(mtl_node_set_alloc_page(&mtl->nodes, index, 0, &page) != MTL_OK) {
 			free(*keystr);
 			*keystr = NULL;				
 			free(*sk);
@@ -379,7 +387,7 @@ uint8_t read_key_file(char *keyfilename, uint8_t ** sk, uint32_t * sk_len,
 			*pk = NULL;		
 			return 2;			
 		}
-		if(fread(mtl->nodes.tree_pages[index], mtl->nodes.tree_page_size,
+		if(fread(page, mtl->nodes.tree_page_size,
 		      1, keyfile) != 1) {
 			free(*keystr);
 			*keystr = NULL;				
@@ -392,9 +400,7 @@ uint8_t read_key_file(char *keyfilename, uint8_t ** sk, uint32_t * sk_len,
 	}
 
 	for (index = 0; index < randomizer_pages; index++) {
-		mtl->nodes.randomizer_pages[index] =
-		    malloc(mtl->nodes.tree_page_size);
-		if(mtl->nodes.randomizer_pages[index] == NULL) {
+		if(mtl_node_set_alloc_page(&mtl->nodes, index, 1, &page) != MTL_OK) {
 			free(*keystr);
 			*keystr = NULL;				
 			free(*sk);
@@ -403,7 +409,7 @@ uint8_t read_key_file(char *keyfilename, uint8_t ** sk, uint32_t * sk_len,
 			*pk = NULL;		
 			return 2;	
 		}
-		if(fread(mtl->nodes.randomizer_pages[index],
+		if(fread(page,
 		      mtl->nodes.tree_page_size, 1, keyfile) != 1) {
 			free(*keystr);
 			*keystr = NULL;				
@@ -415,6 +421,7 @@ uint8_t read_key_file(char *keyfilename, uint8_t ** sk, uint32_t * sk_len,
 		}
 	}
 
+	mtl_node_set_publish(&mtl->nodes, leaf_count);
 	*mtl_ctx = mtl;
 
 	fclose(keyfile);
@@ -30,7 +30,9 @@
 	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 	POSSIBILITY OF SUCH DAMAGE.
 */
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "mtl.h"
 #include "mtl_node_set.h"
@@ -91,6 +93,11 @@ MTLSTATUS mtl_set_scheme_functions(MTL_CTX * ctx, void *parameters,
 	ctx->hash_msg = hash_msg;
 	ctx->hash_leaf = hash_leaf;
 	ctx->hash_node = hash_node;
+	ctx->hash_leaf_batch = NULL;
+	ctx->hash_node_batch = NULL;
+	ctx->hash_msg_init = NULL;
+	ctx->hash_msg_update = NULL;
+	ctx->hash_msg_final = NULL;
 	ctx->ctx_str = NULL;
 	if(mtl_ctx != NULL) {
 		ctx_str_len = strlen(mtl_ctx);
@@ -110,6 +117,79 @@ MTLSTATUS mtl_set_scheme_functions(MTL_CTX * ctx, void *parameters,
 	return MTL_OK;
 }
 
+/*****************************************************************
+ * Set the optional MTL Scheme batch hashing functions
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param hash_leaf_batch, the scheme specific batch leaf hash function
+ * @param hash_node_batch, the scheme specific batch node hash function
+ * @return MTLSTATUS: MTL_OK if successful
+ */
+MTLSTATUS mtl_set_scheme_batch_functions(MTL_CTX * ctx,
+					 uint8_t(*hash_leaf_batch) (void *params,
+								    SERIESID * sid,
+								    uint32_t * node_ids,
+								    uint8_t ** msg_buffers,
+								    uint32_t msg_length,
+								    uint8_t ** hashes,
+								    uint32_t hash_length,
+								    uint32_t count),
+					 uint8_t(*hash_node_batch) (void *params,
+								    SERIESID * sid,
+								    uint32_t * left_index,
+								    uint32_t * right_index,
+								    uint8_t ** left_hash,
+								    uint8_t ** right_hash,
+								    uint8_t ** hash,
+								    uint32_t hash_length,
+								    uint32_t count))
+{
+	if (ctx == NULL) {
+		return MTL_RESOURCE_FAIL;
+	}
+
+	ctx->hash_leaf_batch = hash_leaf_batch;
+	ctx->hash_node_batch = hash_node_batch;
+	return MTL_OK;
+}
+
+/*****************************************************************
+ * Set the optional MTL Scheme streaming message hash functions
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param hash_msg_init, the scheme specific function starting a message hash
+ * @param hash_msg_update, the scheme specific function adding message data
+ * @param hash_msg_final, the scheme specific function finishing the hash
+ * @return MTLSTATUS, MTL_OK if successful
+ */
+MTLSTATUS mtl_set_scheme_stream_functions(MTL_CTX * ctx,
+					  uint8_t(*hash_msg_init) (void *params,
+								   SERIESID * sid,
+								   uint32_t node_id,
+								   uint8_t * randomizer,
+								   uint32_t randomizer_len,
+								   uint32_t hash_length,
+								   char *ctx_str,
+								   uint8_t ** rmtl,
+								   uint32_t * rmtl_len,
+								   void **state),
+					  uint8_t(*hash_msg_update) (void *state,
+								     uint8_t * msg_buffer,
+								     size_t msg_length),
+					  uint8_t(*hash_msg_final) (void *state,
+								    uint8_t * hash,
+								    uint32_t hash_length))
+{
+	if (ctx == NULL) {
+		return MTL_RESOURCE_FAIL;
+	}
+
+	ctx->hash_msg_init = hash_msg_init;
+	ctx->hash_msg_update = hash_msg_update;
+	ctx->hash_msg_final = hash_msg_final;
+	return MTL_OK;
+}
+
 /************************************************************************
  * The following algorithms are implementations from the draft 
  * draft-harvey-cfrg-mtl-mode-00
@@ -141,6 +221,11 @@ MTLSTATUS mtl_initns(MTL_CTX ** mtl_ctx, SEED *seed, SERIESID * sid, char* ctx_s
 	ctx->hash_msg = NULL;
 	ctx->hash_leaf = NULL;
 	ctx->hash_node = NULL;
+	ctx->hash_leaf_batch = NULL;
+	ctx->hash_node_batch = NULL;
+	ctx->hash_msg_init = NULL;
+	ctx->hash_msg_update = NULL;
+	ctx->hash_msg_final = NULL;
 	ctx->ctx_str = NULL;
 	if(ctx_str != NULL) {
 		ctx_str_len = strlen(ctx_str);
@@ -150,6 +235,27 @@ MTLSTATUS mtl_initns(MTL_CTX ** mtl_ctx, SEED *seed, SERIESID * sid, char* ctx_s
 
 	mtl_node_set_init(&ctx->nodes, seed, sid);
 
+	// Ladder for the empty node set, it grows as leaves are appended
+	ctx->ladder.flags = 0;
+	memcpy(&ctx->ladder.sid, sid, sizeof(SERIESID));
+	ctx->ladder.rung_count = 0;
+	ctx->ladder.rungs = calloc(MTL_LADDER_MAX_RUNGS, sizeof(RUNG));
+	if (ctx->ladder.rungs == NULL) {
+		LOG_ERROR("Unable to allocate ladder");
+		mtl_node_set_free(&ctx->nodes);
+		free(ctx->ctx_str);
+		free(ctx);
+		return MTL_RESOURCE_FAIL;
+	}
+
+	// No leaves are reserved yet
+	pthread_mutex_init(&ctx->pending.lock, NULL);
+	pthread_mutex_init(&ctx->pending.commit_lock, NULL);
+	ctx->pending.first_leaf = 0;
+	ctx->pending.leaves = NULL;
+	ctx->pending.leaf_count = 0;
+	ctx->pending.leaf_capacity = 0;
+
 	*mtl_ctx = ctx;
 
 	return MTL_OK;
@@ -204,6 +310,317 @@ MTLSTATUS mtl_append(MTL_CTX * ctx,
 	return MTL_OK;
 }
 
+/*****************************************************************
+* Compute and store the hash of one internal node from its children
+******************************************************************
+ * @param ctx:  the context for this MTL Node Set
+ * @param left_index: leftmost leaf index of the node
+ * @param mid_index: leftmost leaf index of the right child
+ * @param right_index: rightmost leaf index of the node
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_node_set_hash_parent(MTL_CTX * ctx, uint32_t left_index,
+					  uint32_t mid_index,
+					  uint32_t right_index)
+{
+	const uint8_t *hash_left;
+	const uint8_t *hash_right;
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	MTLSTATUS return_code;
+
+	// Child hashes reference the node set pages directly, which is
+	// safe since the insert below never moves existing pages
+	if ((mtl_node_set_fetch_ref
+	     (&ctx->nodes, left_index, mid_index - 1, &hash_left) != MTL_OK)
+	    ||
+	    (mtl_node_set_fetch_ref
+	     (&ctx->nodes, mid_index, right_index, &hash_right) != MTL_OK)) {
+		LOG_ERROR("Unable to fetch hash when appending data_value");
+		return MTL_ERROR;
+	}
+
+	if (ctx->hash_node != NULL) {
+		if (ctx->hash_node(ctx->sig_params, &ctx->sid,
+				   left_index, right_index,
+				   (uint8_t *) hash_left,
+				   (uint8_t *) hash_right,
+				   &hash[0], ctx->nodes.hash_size) != MTL_OK) {
+			LOG_ERROR("Unable to hash the node");
+			return MTL_ERROR;
+		}
+	} else {
+		LOG_ERROR("Internal node hash function is not defined");
+		return MTL_ERROR;
+	}
+
+	return_code = mtl_node_set_insert(&ctx->nodes, left_index, right_index,
+					  &hash[0]);
+	if (return_code != MTL_OK) {
+		LOG_ERROR_WITH_CODE("mtl_node_set_insert", return_code);
+		return MTL_ERROR;
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Compute the parent hashes of a leaf up to a given tree level
+******************************************************************
+ * @param ctx:  the context for this MTL Node Set
+ * @param leaf_index: leaf node index of the new data value
+ * @param first_level: lowest parent level to compute (1 for the leaf parent)
+ * @param last_level: highest parent level to compute
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_node_set_update_levels(MTL_CTX * ctx, uint32_t leaf_index,
+					    uint32_t first_level,
+					    uint32_t last_level)
+{
+	uint32_t index;
+	uint32_t left_index;
+	uint32_t mid_index;
+
+	// Complete the parent hashes in the tree
+	for (index = first_level; index <= last_level; index++) {
+		left_index = (uint32_t)(leaf_index - ((uint64_t)1 << index) + 1);
+		mid_index = (uint32_t)(leaf_index - ((uint64_t)1 << (index - 1)) + 1);
+
+		if (mtl_node_set_hash_parent(ctx, left_index, mid_index,
+					     leaf_index) != MTL_OK) {
+			return MTL_ERROR;
+		}
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Compute and store the hashes of a group of independent internal nodes
+******************************************************************
+ * @param ctx:  the context for this MTL Node Set
+ * @param left_index: leftmost leaf index of each node
+ * @param mid_index: leftmost leaf index of each right child
+ * @param right_index: rightmost leaf index of each node
+ * @param count: number of nodes (at most MTL_HASH_BATCH_SIZE)
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_node_set_hash_parents(MTL_CTX * ctx,
+					   uint32_t * left_index,
+					   uint32_t * mid_index,
+					   uint32_t * right_index,
+					   uint32_t count)
+{
+	const uint8_t *hash_left[MTL_HASH_BATCH_SIZE];
+	const uint8_t *hash_right[MTL_HASH_BATCH_SIZE];
+	uint8_t hashes[MTL_HASH_BATCH_SIZE][EVP_MAX_MD_SIZE];
+	uint8_t *hash_ptrs[MTL_HASH_BATCH_SIZE];
+	uint32_t index;
+	MTLSTATUS return_code;
+
+	// Without a batch function every node is hashed on its own
+	if (ctx->hash_node_batch == NULL) {
+		for (index = 0; index < count; index++) {
+			if (mtl_node_set_hash_parent(ctx, left_index[index],
+						     mid_index[index],
+						     right_index[index]) != MTL_OK) {
+				return MTL_ERROR;
+			}
+		}
+		return MTL_OK;
+	}
+
+	for (index = 0; index < count; index++) {
+		if ((mtl_node_set_fetch_ref
+		     (&ctx->nodes, left_index[index], mid_index[index] - 1,
+		      &hash_left[index]) != MTL_OK)
+		    ||
+		    (mtl_node_set_fetch_ref
+		     (&ctx->nodes, mid_index[index], right_index[index],
+		      &hash_right[index]) != MTL_OK)) {
+			LOG_ERROR("Unable to fetch hash when appending data_value");
+			return MTL_ERROR;
+		}
+		hash_ptrs[index] = hashes[index];
+	}
+
+	if (ctx->hash_node_batch(ctx->sig_params, &ctx->sid, left_index,
+				 right_index, (uint8_t **) hash_left,
+				 (uint8_t **) hash_right, hash_ptrs,
+				 ctx->nodes.hash_size, count) != MTL_OK) {
+		LOG_ERROR("Unable to hash the node");
+		return MTL_ERROR;
+	}
+
+	for (index = 0; index < count; index++) {
+		return_code = mtl_node_set_insert(&ctx->nodes, left_index[index],
+						  right_index[index],
+						  hashes[index]);
+		if (return_code != MTL_OK) {
+			LOG_ERROR_WITH_CODE("mtl_node_set_insert", return_code);
+			return MTL_ERROR;
+		}
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Compute every internal node whose rightmost leaf is in a range
+******************************************************************
+ * @param ctx:  the context for this MTL Node Set
+ * @param first_leaf: first leaf index of the range
+ * @param last_leaf: last leaf index of the range
+ * @param first_level: lowest tree level to compute (1 for leaf parents)
+ * @param last_level: highest tree level to compute
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_node_set_hash_levels(MTL_CTX * ctx, uint32_t first_leaf,
+					  uint32_t last_leaf,
+					  uint32_t first_level,
+					  uint32_t last_level)
+{
+	uint32_t left_index[MTL_HASH_BATCH_SIZE];
+	uint32_t mid_index[MTL_HASH_BATCH_SIZE];
+	uint32_t right_index[MTL_HASH_BATCH_SIZE];
+	uint32_t count;
+	uint32_t level;
+	uint64_t span;
+	uint64_t right;
+
+	// Fill each level left to right, the nodes of one level only
+	// depend on the level below so they are hashed as a group
+	for (level = first_level; (level <= last_level) && (level <= 32);
+	     level++) {
+		span = (uint64_t)1 << level;
+		right = ((first_leaf / span) + 1) * span - 1;
+		if (right > last_leaf) {
+			break;
+		}
+		count = 0;
+		for (; right <= last_leaf; right += span) {
+			left_index[count] = (uint32_t)(right - span + 1);
+			mid_index[count] = (uint32_t)(right - (span / 2) + 1);
+			right_index[count] = (uint32_t)right;
+			count++;
+			if ((count == MTL_HASH_BATCH_SIZE) ||
+			    (right + span > last_leaf)) {
+				if (mtl_node_set_hash_parents(ctx, left_index,
+							      mid_index,
+							      right_index,
+							      count) != MTL_OK) {
+					return MTL_ERROR;
+				}
+				count = 0;
+			}
+		}
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Number of leaves covered by a ladder
+******************************************************************
+ * @param ladder: ladder to check
+ * @return leaf count covered by the ladder rungs
+ */
+static uint64_t mtl_ladder_leaf_count(const LADDER * ladder)
+{
+	if (ladder->rung_count == 0) {
+		return 0;
+	}
+	return (uint64_t)ladder->rungs[ladder->rung_count - 1].right_index + 1;
+}
+
+/*****************************************************************
+* Fill a ladder with the rungs for a leaf count from the node set
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param ladder: ladder with room for MTL_LADDER_MAX_RUNGS rungs
+ * @param leaf_count: number of leaves the ladder covers
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_ladder_fill(MTL_CTX * ctx, LADDER * ladder,
+				 uint64_t leaf_count)
+{
+	uint32_t left_index = 0;
+	uint32_t right_index = 0;
+	int64_t i;
+	RUNG *rung;
+	const uint8_t *hash_ptr;
+
+	ladder->rung_count = 0;
+	for (i = mtl_msb(leaf_count); i >= 0; i--) {
+		if (leaf_count & ((uint64_t)1 << i)) {
+			right_index = (uint32_t)(left_index + ((uint64_t)1 << i) - 1);
+
+			rung = &ladder->rungs[ladder->rung_count];
+			rung->left_index = left_index;
+			rung->right_index = right_index;
+			rung->hash_length = ctx->nodes.hash_size;
+			if (mtl_node_set_fetch_ref(&ctx->nodes, left_index,
+						   right_index, &hash_ptr) != MTL_OK) {
+				LOG_ERROR("Unable to fetch ladder rung hash");
+				ladder->rung_count = 0;
+				return MTL_ERROR;
+			}
+			memcpy(rung->hash, hash_ptr, ctx->nodes.hash_size);
+			ladder->rung_count++;
+			left_index = right_index + 1;
+		}
+	}
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Rebuild the context ladder from the node set
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_ladder_refresh(MTL_CTX * ctx)
+{
+	return mtl_ladder_fill(ctx, &ctx->ladder,
+			       mtl_node_set_published(&ctx->nodes));
+}
+
+/*****************************************************************
+* Update the context ladder after the parents of a leaf were hashed
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param leaf_index: index of the leaf node that was appended
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_ladder_append(MTL_CTX * ctx, uint32_t leaf_index)
+{
+	uint32_t levels = mtl_lsb((uint64_t)leaf_index + 1);
+	const uint8_t *hash_ptr;
+	RUNG *rung;
+
+	// Anything but the next leaf in order leaves the ladder to be
+	// rebuilt from the node set the next time it is used
+	if ((mtl_ladder_leaf_count(&ctx->ladder) != leaf_index) ||
+	    (ctx->nodes.published_count != (uint64_t)leaf_index + 1) ||
+	    (ctx->ladder.rung_count < levels)) {
+		ctx->ladder.rung_count = 0;
+		return MTL_OK;
+	}
+
+	// The trailing rungs and the new leaf merge into a single rung
+	ctx->ladder.rung_count -= levels;
+	rung = &ctx->ladder.rungs[ctx->ladder.rung_count];
+	rung->left_index = (uint32_t)(leaf_index + 1 - ((uint64_t)1 << levels));
+	rung->right_index = leaf_index;
+	rung->hash_length = ctx->nodes.hash_size;
+	if (mtl_node_set_fetch_ref(&ctx->nodes, rung->left_index,
+				   rung->right_index, &hash_ptr) != MTL_OK) {
+		LOG_ERROR("Unable to fetch ladder rung hash");
+		ctx->ladder.rung_count = 0;
+		return MTL_ERROR;
+	}
+	memcpy(rung->hash, hash_ptr, ctx->nodes.hash_size);
+	ctx->ladder.rung_count++;
+
+	return MTL_OK;
+}
+
 /*****************************************************************
 * MTL Node Set Update Parent Hashes
 ******************************************************************
@@ -213,63 +630,327 @@ MTLSTATUS mtl_append(MTL_CTX * ctx,
  */
 MTLSTATUS mtl_node_set_update_parents(MTL_CTX * ctx, uint32_t leaf_index)
 {
+	if (ctx == NULL) {
+		LOG_ERROR_WITH_CODE("mtl_node_set_insert", MTL_ERROR);
+		return MTL_ERROR;
+	}
+
+	if (mtl_node_set_update_levels(ctx, leaf_index, 1,
+				       mtl_lsb((uint64_t)leaf_index + 1)) != MTL_OK) {
+		return MTL_ERROR;
+	}
+
+	// Every node the leaf completes is written, so readers may use it
+	mtl_node_set_publish(&ctx->nodes, (uint64_t)leaf_index + 1);
+	return mtl_ladder_append(ctx, leaf_index);
+}
+
+/*****************************************************************
+* MTL Node Set Update Parent Hashes of a run of appended leaves
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param first_leaf: index of the first leaf of the run
+ * @param last_leaf: index of the last leaf of the run
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_node_set_update_parents_range(MTL_CTX * ctx,
+					    uint32_t first_leaf,
+					    uint32_t last_leaf)
+{
+	if ((ctx == NULL) || (last_leaf < first_leaf)) {
+		LOG_ERROR_WITH_CODE("mtl_node_set_update_parents_range",
+				    MTL_ERROR);
+		return MTL_ERROR;
+	}
+
+	// A single leaf also extends the context ladder in place
+	if (first_leaf == last_leaf) {
+		return mtl_node_set_update_parents(ctx, first_leaf);
+	}
+
+	// Fill each level with the nodes completed by the run, so every
+	// internal node is hashed exactly once
+	if (mtl_node_set_hash_levels(ctx, first_leaf, last_leaf, 1, 32) !=
+	    MTL_OK) {
+		return MTL_ERROR;
+	}
+
+	mtl_node_set_publish(&ctx->nodes, (uint64_t)last_leaf + 1);
+	return MTL_OK;
+}
+
+/** Work item for a thread rebuilding a set of complete subtrees */
+typedef struct MTL_REBUILD_TASK {
+	MTL_CTX *ctx;
+	uint32_t first_subtree;
+	uint32_t subtree_stride;
+	uint32_t subtree_count;
+	uint32_t subtree_levels;
+	MTLSTATUS result;
+} MTL_REBUILD_TASK;
+
+/*****************************************************************
+* Rebuild the internal nodes of the subtrees assigned to a thread
+******************************************************************
+ * @param arg: pointer to the MTL_REBUILD_TASK for this thread
+ * @return NULL
+ */
+static void *mtl_node_set_rebuild_worker(void *arg)
+{
+	MTL_REBUILD_TASK *task = (MTL_REBUILD_TASK *) arg;
+	uint32_t subtree_size = (uint32_t)1 << task->subtree_levels;
+	uint32_t subtree;
+
+	task->result = MTL_OK;
+	for (subtree = task->first_subtree; subtree < task->subtree_count;
+	     subtree += task->subtree_stride) {
+		// Stay inside this subtree, the merge adds higher levels
+		if (mtl_node_set_hash_levels(task->ctx, subtree * subtree_size,
+					     ((subtree + 1) * subtree_size) - 1,
+					     1, task->subtree_levels) != MTL_OK) {
+			task->result = MTL_ERROR;
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+/*****************************************************************
+* Rebuild all internal nodes from the leaves already in the node set
+******************************************************************
+ * @param ctx:  the context for this MTL Node Set
+ * @param threads: number of worker threads (0 for one per online CPU)
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_node_set_rebuild(MTL_CTX * ctx, uint32_t threads)
+{
+	MTL_REBUILD_TASK *tasks = NULL;
+	pthread_t *thread_ids = NULL;
+	uint64_t leaf_count;
+	uint32_t subtree_levels = 0;
+	uint32_t subtree_count;
+	uint32_t started = 0;
 	uint32_t index;
-	uint8_t *hash_left;
-	uint8_t *hash_right;
-	uint8_t hash[EVP_MAX_MD_SIZE];
-	uint32_t left_index;
-	uint32_t mid_index;	
-	MTLSTATUS return_code;	
+	uint64_t page_count;
+	uint8_t *page;
+	MTLSTATUS result = MTL_OK;
 
 	if (ctx == NULL) {
-		LOG_ERROR_WITH_CODE("mtl_node_set_insert", MTL_ERROR);
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	leaf_count = ctx->nodes.leaf_count;
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? (uint32_t) cpus : 1;
+	}
+
+	// Pick the largest subtrees that still give each thread several
+	// to work on, otherwise the rebuild is not worth splitting up
+	while ((subtree_levels < 31) &&
+	       ((leaf_count >> (subtree_levels + 1)) >= threads * 4)) {
+		subtree_levels++;
+	}
+	subtree_count = (uint32_t)(leaf_count >> subtree_levels);
+	if ((threads < 2) || (subtree_levels == 0) || (subtree_count < threads)) {
+		if (leaf_count == 0) {
+			return MTL_OK;
+		}
+		if (mtl_node_set_hash_levels(ctx, 0, (uint32_t)(leaf_count - 1),
+					     1, 32) != MTL_OK) {
+			return MTL_ERROR;
+		}
+		mtl_node_set_publish(&ctx->nodes, leaf_count);
+		return mtl_ladder_refresh(ctx);
+	}
+
+	// Allocate every tree page up front so the workers never
+	// change the page directory while other threads read it
+	page_count = mtl_node_set_page_count(&ctx->nodes, leaf_count);
+	for (index = 0; index < page_count; index++) {
+		if (mtl_node_set_alloc_page(&ctx->nodes, index, 0, &page) != MTL_OK) {
+			return MTL_RESOURCE_FAIL;
+		}
+	}
+
+	tasks = calloc(threads, sizeof(MTL_REBUILD_TASK));
+	thread_ids = calloc(threads, sizeof(pthread_t));
+	if ((tasks == NULL) || (thread_ids == NULL)) {
+		LOG_ERROR("Unable to allocate buffer");
+		free(tasks);
+		free(thread_ids);
+		return MTL_RESOURCE_FAIL;
+	}
+
+	for (index = 0; index < threads; index++) {
+		tasks[index].ctx = ctx;
+		tasks[index].first_subtree = index;
+		tasks[index].subtree_stride = threads;
+		tasks[index].subtree_count = subtree_count;
+		tasks[index].subtree_levels = subtree_levels;
+		if (pthread_create(&thread_ids[index], NULL,
+				   mtl_node_set_rebuild_worker,
+				   &tasks[index]) != 0) {
+			LOG_ERROR("Unable to start rebuild thread");
+			result = MTL_RESOURCE_FAIL;
+			break;
+		}
+		started++;
+	}
+	for (index = 0; index < started; index++) {
+		pthread_join(thread_ids[index], NULL);
+		if (tasks[index].result != MTL_OK) {
+			result = MTL_ERROR;
+		}
+	}
+	free(tasks);
+	free(thread_ids);
+	if (result != MTL_OK) {
+		return result;
+	}
+
+	// Merge the subtree roots into the levels above them
+	if (mtl_node_set_hash_levels(ctx, 0,
+				     (uint32_t)(((uint64_t)subtree_count <<
+						 subtree_levels) - 1),
+				     subtree_levels + 1, 32) != MTL_OK) {
 		return MTL_ERROR;
 	}
 
-	// Complete the parent hashes in the tree
-	for (index = 1; index <= mtl_lsb(leaf_index + 1); index++) {
-		left_index = leaf_index - (1 << index) + 1;
-		mid_index = leaf_index - (1 << (index - 1)) + 1;
-
-		if ((mtl_node_set_fetch
-		     (&ctx->nodes, left_index, mid_index - 1, &hash_left) == MTL_OK)
-		    &&
-		    (mtl_node_set_fetch
-		     (&ctx->nodes, mid_index, leaf_index, &hash_right) == MTL_OK)) {
-			if (ctx->hash_node != NULL) {
-				if (ctx->hash_node(ctx->sig_params, &ctx->sid,
-						   left_index, leaf_index,
-						   hash_left, hash_right,
-						   &hash[0],
+	// Leaves after the last complete subtree
+	if ((((uint64_t)subtree_count << subtree_levels) < leaf_count) &&
+	    (mtl_node_set_hash_levels(ctx, subtree_count << subtree_levels,
+				      (uint32_t)(leaf_count - 1), 1, 32) != MTL_OK)) {
+		return MTL_ERROR;
+	}
+
+	mtl_node_set_publish(&ctx->nodes, leaf_count);
+	return mtl_ladder_refresh(ctx);
+}
+
+/*****************************************************************
+* MTL Node Set Append of a batch of data values
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param data_values: array of data_value byte arrays
+ * @param data_value_lens: length of each data_value byte array
+ * @param count: number of data values to append
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_append_batch(MTL_CTX * ctx, uint8_t ** data_values,
+			   uint16_t * data_value_lens, uint32_t count)
+{
+	uint8_t hashes[MTL_HASH_BATCH_SIZE][EVP_MAX_MD_SIZE];
+	uint8_t *hash_ptrs[MTL_HASH_BATCH_SIZE];
+	uint32_t node_ids[MTL_HASH_BATCH_SIZE];
+	uint32_t first_leaf;
+	uint32_t last_leaf;
+	uint32_t index;
+	uint32_t base;
+	uint32_t group;
+	uint8_t use_batch;
+
+	if ((ctx == NULL) || (data_values == NULL) || (data_value_lens == NULL)
+	    || (count == 0)) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	if (ctx->hash_leaf == NULL) {
+		LOG_ERROR("Leaf hash function is not defined");
+		return MTL_ERROR;
+	}
+	// The batch goes right after the last leaf, which is only known
+	// while no leaves are reserved (see mtl_reserve)
+	if (ctx->nodes.leaf_count != mtl_node_set_published(&ctx->nodes)) {
+		LOG_ERROR("Leaves are reserved but not committed");
+		return MTL_ERROR;
+	}
+	if (ctx->nodes.leaf_count + count - 1 > MTL_NODE_SET_MAX_LEAF) {
+		LOG_ERROR("Batch exceeds the node set size");
+		return MTL_BAD_PARAM;
+	}
+	first_leaf = (uint32_t)ctx->nodes.leaf_count;
+	last_leaf = first_leaf + count - 1;
+
+	// The scheme batch function takes leaves of one length
+	use_batch = (ctx->hash_leaf_batch != NULL);
+	for (index = 0; index < count; index++) {
+		if ((data_values[index] == NULL) || (data_value_lens[index] == 0)) {
+			LOG_ERROR("NULL Input Pointers");
+			return MTL_NULL_PTR;
+		}
+		if (data_value_lens[index] != data_value_lens[0]) {
+			use_batch = 0;
+		}
+	}
+
+	// Compute and store every leaf hash first
+	for (base = 0; base < count; base += group) {
+		group = count - base;
+		if (group > MTL_HASH_BATCH_SIZE) {
+			group = MTL_HASH_BATCH_SIZE;
+		}
+		for (index = 0; index < group; index++) {
+			node_ids[index] = first_leaf + base + index;
+			hash_ptrs[index] = hashes[index];
+		}
+		if (use_batch) {
+			if (ctx->hash_leaf_batch(ctx->sig_params, &ctx->sid,
+						 node_ids, &data_values[base],
+						 data_value_lens[0], hash_ptrs,
+						 ctx->nodes.hash_size,
+						 group) != MTL_OK) {
+				LOG_ERROR("Unable to hash leaf node");
+				return MTL_ERROR;
+			}
+		} else {
+			for (index = 0; index < group; index++) {
+				if (ctx->hash_leaf(ctx->sig_params, &ctx->sid,
+						   node_ids[index],
+						   data_values[base + index],
+						   data_value_lens[base + index],
+						   hashes[index],
 						   ctx->nodes.hash_size) != MTL_OK) {
-					free(hash_left);
-					free(hash_right);
-					LOG_ERROR("Unable to hash the node");
+					LOG_ERROR("Unable to hash leaf node");
 					return MTL_ERROR;
 				}
-			} else {
-				LOG_ERROR
-				    ("Internal node hash function is not defined");
-				return MTL_ERROR;
 			}
-			return_code = mtl_node_set_insert(&ctx->nodes, left_index, leaf_index,
-					    &hash[0]);
-			if(return_code != MTL_OK) {
-				LOG_ERROR_WITH_CODE("mtl_node_set_insert", return_code);
+		}
+		for (index = 0; index < group; index++) {
+			if (mtl_node_set_insert(&ctx->nodes, node_ids[index],
+						node_ids[index],
+						hashes[index]) != MTL_OK) {
+				LOG_ERROR("Unable to add message to node set");
 				return MTL_ERROR;
 			}
-			free(hash_left);
-			free(hash_right);
-		} else {
-			LOG_ERROR
-			    ("Unable to fetch hash when appending data_value");
-				return MTL_ERROR;
 		}
 	}
+
+	if (mtl_node_set_update_parents_range(ctx, first_leaf, last_leaf) !=
+	    MTL_OK) {
+		LOG_ERROR("Unable to add message to node set");
+		return MTL_ERROR;
+	}
 	return MTL_OK;
 }
 
 
+/*****************************************************************
+* Get the leaf count of the newest snapshot of the node set
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set 
+ * @return leaf count every node of which is written (0 on error)
+ */
+uint64_t mtl_snapshot(MTL_CTX * ctx)
+{
+	if (ctx == NULL) {
+		LOG_ERROR("NULL Input Pointers");
+		return 0;
+	}
+	return mtl_node_set_published(&ctx->nodes);
+}
+
 /*****************************************************************
 * Algorithm 5: Computing an Authentication Path for a Data Value.
 * mtl_authpath from draft-harvey-cfrg-mtl-mode-00 Section 8.5
@@ -280,41 +961,57 @@ MTLSTATUS mtl_node_set_update_parents(MTL_CTX * ctx, uint32_t leaf_index)
  *                    associated rung, NULL on error
  */
 AUTHPATH *mtl_authpath(MTL_CTX * ctx, uint32_t leaf_index)
+{
+	return mtl_authpath_at(ctx, leaf_index, mtl_snapshot(ctx));
+}
+
+/*****************************************************************
+* Compute an authentication path to a rung of a snapshot's ladder
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set 
+ * @param leaf_index: leaf node index of the data value to authenticate
+ * @param snapshot: leaf count from mtl_snapshot
+ * @return auth_path: authentication path from the leaf node to the
+ *                    associated rung, NULL on error
+ */
+AUTHPATH *mtl_authpath_at(MTL_CTX * ctx, uint32_t leaf_index,
+			  uint64_t snapshot)
 {
 	int64_t index = 0;
 	uint32_t left = 0;
 	uint32_t right = 0;
 	uint32_t pathl = 0;
 	uint32_t pathr = 0;
-	uint8_t *hash;
-	AUTHPATH *auth_path = calloc(1, sizeof(AUTHPATH));
+	const uint8_t *hash;
+	AUTHPATH *auth_path;
 
+	if (ctx == NULL) {
+		LOG_ERROR("NULL Input Pointers");
+		return NULL;
+	}
+	auth_path = calloc(1, sizeof(AUTHPATH));
 	if(auth_path == NULL) {
 		LOG_ERROR("Unable to allocate auth_path");
 		return NULL;
 	}
 
-	// Check that the leaf is part of this node set
-	if (leaf_index >= ctx->nodes.leaf_count) {
+	// Check that the leaf is part of this snapshot of the node set
+	if ((leaf_index >= snapshot) ||
+	    (snapshot > mtl_node_set_published(&ctx->nodes))) {
 		free(auth_path);
 		LOG_ERROR("Invalid Auth Path Index");
 		return NULL;	// Leaf is outside of node set
 	}
-	// Find the rung index pair covering the leaf index
-	for (index = (int64_t) mtl_msb(ctx->nodes.leaf_count) + 1; index >= 0;
-	     index--) {
-		if (ctx->nodes.leaf_count & (1 << index)) {
-			right = left + (1 << index) - 1;
-			if (leaf_index <= right)
-				break;
-			left = right + 1;
-		}
-	}
+	// Find the rung index pair covering the leaf index, the rung is
+	// at the highest bit where the leaf index and leaf count differ
+	index = mtl_msb(leaf_index ^ snapshot);
+	left = (uint32_t)(snapshot & ~(((uint64_t) 2 << index) - 1));
+	right = (uint32_t)(left + ((uint64_t) 1 << index) - 1);
 
 	// Concatenate the sibling nodes from the leaf to the rung
 	auth_path->leaf_index = leaf_index;
 	memcpy(&auth_path->sid, &ctx->sid, sizeof(SERIESID));
-	auth_path->sibling_hash_count = mtl_bit_width(right - left);
+	auth_path->sibling_hash_count = mtl_bit_width((uint64_t)right - left);
 	auth_path->sibling_hash =
 	    malloc((size_t)auth_path->sibling_hash_count * 
 		       (size_t)ctx->nodes.hash_size);
@@ -322,16 +1019,21 @@ AUTHPATH *mtl_authpath(MTL_CTX * ctx, uint32_t leaf_index)
 	auth_path->rung_right = right;
 
 	// Find the path from the leaf to the sub-tree root
-	for (index = 0; index < mtl_bit_width(right - left); index++) {
-		if (leaf_index & (1 << index)) {
-			pathl =
-			    (~((1 << index) - 1) & leaf_index) - (1 << index);
+	for (index = 0; index < auth_path->sibling_hash_count; index++) {
+		if (leaf_index & ((uint32_t)1 << index)) {
+			pathl = (~(((uint32_t)1 << index) - 1) & leaf_index) -
+			    ((uint32_t)1 << index);
 		} else {
-			pathl =
-			    (~((1 << index) - 1) & leaf_index) + (1 << index);
+			pathl = (~(((uint32_t)1 << index) - 1) & leaf_index) +
+			    ((uint32_t)1 << index);
+		}
+		pathr = pathl + ((uint32_t)1 << index) - 1;
+		if (mtl_node_set_fetch_ref(&ctx->nodes, pathl, pathr, &hash)
+		    != MTL_OK) {
+			LOG_ERROR("Unable to fetch auth path sibling hash");
+			mtl_authpath_free(auth_path);
+			return NULL;
 		}
-		pathr = pathl + (1 << index) - 1;
-		mtl_node_set_fetch(&ctx->nodes, pathl, pathr, &hash);
 		if (index < auth_path->sibling_hash_count) {
 			memcpy(auth_path->sibling_hash +
 			       (index * ctx->nodes.hash_size), hash,
@@ -339,8 +1041,6 @@ AUTHPATH *mtl_authpath(MTL_CTX * ctx, uint32_t leaf_index)
 		} else {
 			LOG_ERROR("Auth Path extends past hash count\n");
 		}
-
-		free(hash);
 	}
 
 	return auth_path;
@@ -355,41 +1055,72 @@ AUTHPATH *mtl_authpath(MTL_CTX * ctx, uint32_t leaf_index)
  */
 LADDER *mtl_ladder(MTL_CTX * ctx)
 {
-	uint32_t left_index = 0;
-	uint32_t right_index = 0;
-	int64_t i;
-	RUNG *rung;
-	LADDER *ladder = malloc(sizeof(LADDER));
-	uint8_t *hash_ptr;
-	uint16_t node_index = 0;
+	return mtl_ladder_at(ctx, mtl_snapshot(ctx));
+}
+
+/*****************************************************************
+ * Compute the Merkle tree ladder of a snapshot of the node set
+ ****************************************************************** 
+ * @param ctx,  the context for this MTL Node Set 
+ * @param snapshot: leaf count from mtl_snapshot
+ * @return ladder, Merkle tree ladder for the snapshot, NULL on error
+ */
+LADDER *mtl_ladder_at(MTL_CTX * ctx, uint64_t snapshot)
+{
+	LADDER *ladder;
 
+	if (ctx == NULL) {
+		LOG_ERROR("NULL Input Pointers");
+		return NULL;
+	}
+	if (snapshot > mtl_node_set_published(&ctx->nodes)) {
+		LOG_ERROR("Snapshot is newer than the node set");
+		return NULL;
+	}
+
+	// Built from the node set rather than copied from the context
+	// ladder, which only the appending thread may touch
+	ladder = malloc(sizeof(LADDER));
+	if (ladder == NULL) {
+		LOG_ERROR("Unable to allocate ladder");
+		return NULL;
+	}
 	ladder->flags = 0;
 	memcpy(&ladder->sid, &ctx->sid, sizeof(SERIESID));
-	ladder->rung_count = mtl_bit_width(ctx->nodes.leaf_count);
-	ladder->rungs = malloc(sizeof(RUNG) * ladder->rung_count);
+	ladder->rungs = calloc(MTL_LADDER_MAX_RUNGS, sizeof(RUNG));
+	if ((ladder->rungs == NULL) ||
+	    (mtl_ladder_fill(ctx, ladder, snapshot) != MTL_OK)) {
+		mtl_ladder_free(ladder);
+		return NULL;
+	}
 
-	// Concatenate the rungs in the node set
-	for (i = mtl_msb(ctx->nodes.leaf_count); i >= 0; i--) {
-		if (ctx->nodes.leaf_count & (1 << i)) {
-			right_index = left_index + (1 << i) - 1;
+	return ladder;
+}
 
-			rung =
-			    (RUNG *) ((uint8_t *) ladder->rungs +
-				      (sizeof(RUNG) * node_index));
-			node_index++;
+/*****************************************************************
+ * Get the ladder for the current node set without copying it
+ ****************************************************************** 
+ * @param ctx,  the context for this MTL Node Set 
+ * @return ladder owned by the context, NULL on error
+ */
+const LADDER *mtl_ladder_ref(MTL_CTX * ctx)
+{
+	if (ctx == NULL) {
+		LOG_ERROR("NULL Input Pointers");
+		return NULL;
+	}
 
-			rung->left_index = left_index;
-			rung->right_index = right_index;
-			rung->hash_length = ctx->nodes.hash_size;
-			mtl_node_set_fetch(&ctx->nodes, left_index, right_index,
-					   &hash_ptr);
-			memcpy(rung->hash, hash_ptr, ctx->nodes.hash_size);
-			free(hash_ptr);
-			left_index = right_index + 1;
+	// Appends keep the ladder current, anything else that changed
+	// the leaf count has it rebuilt here
+	if (mtl_ladder_leaf_count(&ctx->ladder) !=
+	    mtl_node_set_published(&ctx->nodes)) {
+		if (mtl_ladder_refresh(ctx) != MTL_OK) {
+			return NULL;
 		}
 	}
+	memcpy(&ctx->ladder.sid, &ctx->sid, sizeof(SERIESID));
 
-	return ladder;
+	return &ctx->ladder;
 }
 
 /*****************************************************************
@@ -413,7 +1144,7 @@ RUNG *mtl_rung(AUTHPATH * auth_path, LADDER * ladder)
 	// Minimum degree is updated after first rung is found
 	uint32_t min_degree = -1;
 	uint32_t degree;
-	uint32_t bin_power;
+	uint64_t bin_power;
 
 	if ((auth_path == NULL) || (ladder == NULL)) {
 		LOG_ERROR("NULL Input Pointers");
@@ -430,9 +1161,13 @@ RUNG *mtl_rung(AUTHPATH * auth_path, LADDER * ladder)
 	sibling_hash_count = auth_path->sibling_hash_count;
 
 	// Check that authentication path is a binary rung strategy path
-	bin_power = (1 << sibling_hash_count) - 1;
-	left_index = leaf_index & ~bin_power;
-	right_index = left_index + bin_power;
+	if (sibling_hash_count > 32) {
+		LOG_ERROR("Bad Index Not Covered");
+		return NULL;
+	}
+	bin_power = ((uint64_t)1 << sibling_hash_count) - 1;
+	left_index = (uint32_t)(leaf_index & ~bin_power);
+	right_index = (uint32_t)(left_index + bin_power);
 	if ((auth_path->rung_left != left_index) ||
 	    (auth_path->rung_right != right_index)) {
 		LOG_ERROR("Bad Index Not Covered");
@@ -447,11 +1182,11 @@ RUNG *mtl_rung(AUTHPATH * auth_path, LADDER * ladder)
 		left_index = rung->left_index;
 		right_index = rung->right_index;
 		if ((left_index <= leaf_index) && (right_index >= leaf_index)) {
-			degree = mtl_lsb(right_index - left_index + 1);
+			degree = mtl_lsb((uint64_t)right_index - left_index + 1);
 			if (((degree <= mtl_lsb(left_index)) ||
 			     (mtl_lsb(left_index) == 0)) &&
-			    (right_index - left_index + 1 ==
-			     (uint32_t) (1 << degree))
+			    ((uint64_t)right_index - left_index + 1 ==
+			     ((uint64_t)1 << degree))
 			    && (degree <= sibling_hash_count)) {
 				if ((assoc_rung == NULL)
 				    || (degree < min_degree)) {
@@ -525,9 +1260,9 @@ MTLSTATUS mtl_verify(MTL_CTX * ctx, uint8_t * data_value,
 	// Recompute internal node hash values and compare to associated
 	//     rung hash value if index pairs match
 	for (i = 1; i < sibling_hash_count + 1; i++) {
-		left_index = leaf_index & ~((1 << i) - 1);
-		right_index = left_index + (1 << i) - 1;
-		mid_index = left_index + (1 << (i - 1));
+		left_index = (uint32_t)(leaf_index & ~(((uint64_t)1 << i) - 1));
+		right_index = (uint32_t)(left_index + ((uint64_t)1 << i) - 1);
+		mid_index = (uint32_t)(left_index + ((uint64_t)1 << (i - 1)));
 
 		sibling_hash =
 		    auth_path->sibling_hash +
@@ -591,7 +1326,16 @@ MTLSTATUS mtl_verify(MTL_CTX * ctx, uint8_t * data_value,
  */
 MTLSTATUS mtl_free(MTL_CTX * ctx)
 {
+	uint64_t index;
+
+	for (index = 0; index < ctx->pending.leaf_count; index++) {
+		free(ctx->pending.leaves[index].rmtl);
+	}
+	free(ctx->pending.leaves);
+	pthread_mutex_destroy(&ctx->pending.lock);
+	pthread_mutex_destroy(&ctx->pending.commit_lock);
 	mtl_node_set_free(&ctx->nodes);
+	free(ctx->ladder.rungs);
 	free(ctx->ctx_str);
 	free(ctx);
 	ctx = NULL;
@@ -42,6 +42,7 @@
 
 #include <math.h>
 #include <openssl/evp.h>
+#include <pthread.h>
 #include <stdint.h>
 
 #include "mtl_error.h"
@@ -49,6 +50,15 @@
 
 /** The default MTL Series Identifier Size (specified to 8 bytes whey using a random SEED) */ 
 #define MTL_SID_SIZE 8
+/** Most rungs a ladder can have (one per bit of a 32 bit leaf count) */
+#define MTL_LADDER_MAX_RUNGS 32
+/** Largest group of independent nodes handed to a scheme batch function */
+#define MTL_HASH_BATCH_SIZE 16
+
+/** Reserved leaf states (see mtl_reserve) */
+#define MTL_LEAF_RESERVED 0
+#define MTL_LEAF_COMPLETE 1
+#define MTL_LEAF_FAILED 2
 
 // Data Structures
 /**
@@ -109,6 +119,36 @@ typedef struct LADDER {
 	RUNG *rungs;
 } LADDER;
 
+/**
+ * \brief MTL reserved leaf waiting to be committed
+ */
+typedef struct MTL_PENDING_LEAF {
+	/** MTL_LEAF_RESERVED, MTL_LEAF_COMPLETE or MTL_LEAF_FAILED */
+	uint8_t state;
+	/** Leaf hash (complete leaves only) */
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	/** Randomizer value (complete leaves only) */
+	uint8_t *rmtl;
+} MTL_PENDING_LEAF;
+
+/**
+ * \brief MTL reserved leaves that are not committed yet
+ */
+typedef struct MTL_PENDING {
+	/** Lock for the pending leaves, held only to update them */
+	pthread_mutex_t lock;
+	/** Lock held while leaves are committed, so commits are in order */
+	pthread_mutex_t commit_lock;
+	/** Leaf index of the first pending leaf (the next to commit) */
+	uint64_t first_leaf;
+	/** Pending leaves from first_leaf on, one per reserved leaf */
+	MTL_PENDING_LEAF *leaves;
+	/** Number of entries in the pending leaf array */
+	uint64_t leaf_count;
+	/** Number of entries allocated for the pending leaf array */
+	uint64_t leaf_capacity;
+} MTL_PENDING;
+
 /**
  * \brief MTL Context
  */
@@ -138,10 +178,53 @@ typedef struct MTL_CTX {
 			      uint32_t right_index, uint8_t * left_hash,
 			      uint8_t * right_hash, uint8_t * hash,
 			      uint32_t hash_length);
+	/** Optional scheme function hashing a batch of equal length leaves */
+	 uint8_t(*hash_leaf_batch) (void *params, SERIESID * sid,
+				    uint32_t * node_ids, uint8_t ** msg_buffers,
+				    uint32_t msg_length, uint8_t ** hashes,
+				    uint32_t hash_length, uint32_t count);
+	/** Optional scheme function hashing a batch of internal nodes */
+	 uint8_t(*hash_node_batch) (void *params, SERIESID * sid,
+				    uint32_t * left_index, uint32_t * right_index,
+				    uint8_t ** left_hash, uint8_t ** right_hash,
+				    uint8_t ** hash, uint32_t hash_length,
+				    uint32_t count);
+	/** Optional scheme function starting a message hash fed in pieces */
+	 uint8_t(*hash_msg_init) (void *params, SERIESID * sid,
+				  uint32_t node_id, uint8_t * randomizer,
+				  uint32_t randomizer_len, uint32_t hash_length,
+				  char *ctx, uint8_t ** rmtl,
+				  uint32_t * rmtl_len, void **state);
+	/** Optional scheme function adding a piece of the message to the hash */
+	 uint8_t(*hash_msg_update) (void *state, uint8_t * msg_buffer,
+				    size_t msg_length);
+	/** Optional scheme function finishing (or with a NULL hash discarding) the message hash */
+	 uint8_t(*hash_msg_final) (void *state, uint8_t * hash,
+				   uint32_t hash_length);
 	/** MTL node set structure */
 	MTLNODES nodes;
+	/** Ladder for the current leaf count, kept up to date on append */
+	LADDER ladder;
+	/** Reserved leaves waiting to be committed in index order */
+	MTL_PENDING pending;
 } MTL_CTX;
 
+/**
+ * \brief MTL message hash that is fed in pieces
+ */
+typedef struct MTL_MSG_STREAM {
+	/** Context for the MTL Node Set the message belongs to */
+	MTL_CTX *ctx;
+	/** Leaf index the message is hashed for */
+	uint32_t leaf_index;
+	/** Flag set when the message is appended to the node set when finished */
+	uint8_t append;
+	/** Generated randomness bytes for the hash (appending only) */
+	uint8_t *rmtl;
+	/** Scheme specific message hash state */
+	void *state;
+} MTL_MSG_STREAM;
+
 // Abstract Function Prototypes
 /**
  * Set the MTL Scheme Functions
@@ -185,9 +268,70 @@ MTLSTATUS mtl_set_scheme_functions(MTL_CTX * ctx, void *parameters,
 							uint32_t hash_length),
 				   char* mtl_ctx);
 
+/**
+ * Set the optional MTL Scheme batch hashing functions
+ *   Tree code hands independent nodes to these when they are set and
+ *   loops over the single node functions when they are NULL.
+ *   mtl_set_scheme_functions clears them, so set them afterwards.
+ * @param ctx  the context for this MTL Node Set
+ * @param hash_leaf_batch the scheme specific batch leaf hash function
+ * @param hash_node_batch the scheme specific batch node hash function
+ * @return MTLSTATUS MTL_OK if successful
+ */
+MTLSTATUS mtl_set_scheme_batch_functions(MTL_CTX * ctx,
+					 uint8_t(*hash_leaf_batch) (void *params,
+								    SERIESID * sid,
+								    uint32_t * node_ids,
+								    uint8_t ** msg_buffers,
+								    uint32_t msg_length,
+								    uint8_t ** hashes,
+								    uint32_t hash_length,
+								    uint32_t count),
+					 uint8_t(*hash_node_batch) (void *params,
+								    SERIESID * sid,
+								    uint32_t * left_index,
+								    uint32_t * right_index,
+								    uint8_t ** left_hash,
+								    uint8_t ** right_hash,
+								    uint8_t ** hash,
+								    uint32_t hash_length,
+								    uint32_t count));
+
+/**
+ * Set the optional MTL Scheme streaming message hash functions
+ *   These let a message be hashed in pieces so it never has to be
+ *   held in memory at once, see mtl_hash_and_append_init.
+ *   mtl_set_scheme_functions clears them, so set them afterwards.
+ * @param ctx  the context for this MTL Node Set
+ * @param hash_msg_init the scheme specific function starting a message hash
+ * @param hash_msg_update the scheme specific function adding message data
+ * @param hash_msg_final the scheme specific function finishing the hash
+ * @return MTLSTATUS MTL_OK if successful
+ */
+MTLSTATUS mtl_set_scheme_stream_functions(MTL_CTX * ctx,
+					  uint8_t(*hash_msg_init) (void *params,
+								   SERIESID * sid,
+								   uint32_t node_id,
+								   uint8_t * randomizer,
+								   uint32_t randomizer_len,
+								   uint32_t hash_length,
+								   char *ctx_str,
+								   uint8_t ** rmtl,
+								   uint32_t * rmtl_len,
+								   void **state),
+					  uint8_t(*hash_msg_update) (void *state,
+								     uint8_t * msg_buffer,
+								     size_t msg_length),
+					  uint8_t(*hash_msg_final) (void *state,
+								    uint8_t * hash,
+								    uint32_t hash_length));
+
 /**
  * Generate the message hash with randomization and then append to
  * the MTL node set as a leaf node. 
+ *   The leaf is reserved, hashed and committed (see mtl_reserve). It is
+ *   in the node set on return unless another thread holds an earlier
+ *   reservation, in which case the commit of that one adds it.
  * @param ctx:         the context for this MTL Node Set
  * @param message:     byte array of message data
  * @param message_len: byte length of the message data
@@ -195,7 +339,86 @@ MTLSTATUS mtl_set_scheme_functions(MTL_CTX * ctx, void *parameters,
  * @return MTL_OK on success
  */							
 MTLSTATUS mtl_hash_and_append(MTL_CTX * ctx, uint8_t * message,
-			     uint16_t message_len, uint32_t * node_id);
+			     uint32_t message_len, uint32_t * node_id);
+
+/**
+ * Reserve the next leaf index of the node set
+ *   Any number of threads may reserve leaves, hash their messages with
+ *   mtl_hash_reserved and release the ones they give up on in any
+ *   order. mtl_commit then adds them to the node set in index order.
+ *   The message batch appends reserve their leaves the same way.
+ *   mtl_append_batch fails while reservations are open, and mtl_append
+ *   takes an explicit leaf index so it must not be mixed with them.
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_index: return value reserved leaf index
+ * @return MTL_OK on success, MTL_BAD_PARAM if the node set is full or
+ *         MTL_RESOURCE_FAIL if there is no memory to track the leaf
+ */
+MTLSTATUS mtl_reserve(MTL_CTX * ctx, uint32_t * leaf_index);
+
+/**
+ * Generate the message hash and leaf hash for a reserved leaf
+ *   The leaf is marked failed if hashing does not succeed.
+ * @param ctx:         the context for this MTL Node Set
+ * @param leaf_index:  leaf index from mtl_reserve
+ * @param message:     byte array of message data
+ * @param message_len: byte length of the message data
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_reserved(MTL_CTX * ctx, uint32_t leaf_index,
+			    uint8_t * message, uint32_t message_len);
+
+/**
+ * Give up a reserved leaf that will not be hashed
+ *   The newest reservation is handed back, any other is committed as a
+ *   filler leaf (the leaf hash of an all zero data value).
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_index: leaf index from mtl_reserve
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_release(MTL_CTX * ctx, uint32_t leaf_index);
+
+/**
+ * Commit the hashed and failed reserved leaves that follow the node set
+ *   Leaves are inserted in index order and stop at the first leaf that
+ *   is still being hashed. Failed leaves are filled with the leaf hash
+ *   of an all zero data value and an all zero randomizer.
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_count: optional return value committed leaf count
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_commit(MTL_CTX * ctx, uint64_t * leaf_count);
+
+/**
+ * Generate the message hashes with randomization for a batch of
+ * messages and append them to the MTL node set as leaf nodes.
+ * @param ctx         the context for this MTL Node Set
+ * @param messages    array of message byte arrays
+ * @param message_lens byte length of each message
+ * @param count       number of messages
+ * @param node_ids    return value array with the leaf index of each message
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_batch(MTL_CTX * ctx, uint8_t ** messages,
+				    uint32_t * message_lens, uint32_t count,
+				    uint32_t * node_ids);
+
+/**
+ * Generate the message hashes for a batch of messages on worker threads
+ * and append them to the MTL node set as leaf nodes in message order.
+ *   The batch reserves consecutive leaves (see mtl_reserve), so it is
+ *   committed after any leaf reserved before it.
+ * @param ctx         the context for this MTL Node Set
+ * @param messages    array of message byte arrays
+ * @param message_lens byte length of each message
+ * @param count       number of messages
+ * @param node_ids    return value array with the leaf index of each message
+ * @param threads     number of worker threads (0 for one per online CPU)
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_threads(MTL_CTX * ctx, uint8_t ** messages,
+				      uint32_t * message_lens, uint32_t count,
+				      uint32_t * node_ids, uint32_t threads);
 
 /**
  * Setup the MTL randomizer value
@@ -223,6 +446,20 @@ MTLSTATUS mtl_randomizer_free(RANDOMIZER * mtl_random);
 MTLSTATUS mtl_randomizer_and_authpath(MTL_CTX * ctx, uint32_t leaf_index,
 				    RANDOMIZER ** randomizer, AUTHPATH ** auth);
 
+/**
+ * Get the MTL Auth path to the ladder of a snapshot and the randomizer value
+ * @param ctx,  the context for this MTL Node Set
+ * @param leaf_index: index of the leaf node that is being appended
+ * @param snapshot:   leaf count from mtl_snapshot
+ * @param randomizer: pointer to randomizer buffer 
+ * @param auth:       pointer to authpath buffer
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_randomizer_and_authpath_at(MTL_CTX * ctx, uint32_t leaf_index,
+				       uint64_t snapshot,
+				       RANDOMIZER ** randomizer,
+				       AUTHPATH ** auth);
+
 /**
  * Generate the message hash with randomization and then verify
  * the hash with the authenticaiton path
@@ -235,9 +472,72 @@ MTLSTATUS mtl_randomizer_and_authpath(MTL_CTX * ctx, uint32_t leaf_index,
  * @return MTL_OK on success
  */
 MTLSTATUS mtl_hash_and_verify(MTL_CTX * ctx, uint8_t * message,
-			    uint16_t message_len, RANDOMIZER * randomizer,
+			    uint32_t message_len, RANDOMIZER * randomizer,
 			    AUTHPATH * auth_path, RUNG * assoc_rung);
 
+/**
+ * Start a message hash for a message that will be appended to the
+ * MTL node set, when the message is supplied in pieces.
+ *   The next leaf index is reserved for the message, so no other
+ *   message may be appended until the stream is finished or freed.
+ * @param ctx:    the context for this MTL Node Set
+ * @param stream: return value message stream
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_init(MTL_CTX * ctx, MTL_MSG_STREAM ** stream);
+
+/**
+ * Finish the message hash and append it to the MTL node set as a
+ * leaf node.  The stream is freed whether or not this succeeds.
+ * @param stream:  message stream from mtl_hash_and_append_init
+ * @param node_id: return value index of the leaf node that was appended
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_final(MTL_MSG_STREAM * stream,
+				    uint32_t * node_id);
+
+/**
+ * Start a message hash for a message that will be verified, when
+ * the message is supplied in pieces.
+ * @param ctx:        the context for this MTL Node Set
+ * @param randomizer: randomizer value for this leaf node
+ * @param leaf_index: leaf index from the authentication path
+ * @param stream:     return value message stream
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_verify_init(MTL_CTX * ctx, RANDOMIZER * randomizer,
+				   uint32_t leaf_index,
+				   MTL_MSG_STREAM ** stream);
+
+/**
+ * Add the next piece of the message to a message stream
+ * @param stream:      message stream to add to
+ * @param message:     byte array of message data
+ * @param message_len: byte length of the message data
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_stream_update(MTL_MSG_STREAM * stream, uint8_t * message,
+				 size_t message_len);
+
+/**
+ * Finish a verification message stream with the message data value
+ * that is checked with mtl_verify.  The stream is freed whether or
+ * not this succeeds.
+ * @param stream:     message stream from mtl_hash_and_verify_init
+ * @param data_value: return value message hash (EVP_MAX_MD_SIZE bytes)
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_verify_final(MTL_MSG_STREAM * stream,
+				    uint8_t * data_value);
+
+/**
+ * Free a message stream that will not be finished.  The leaf index
+ * reserved by mtl_hash_and_append_init is released.
+ * @param stream: message stream to free
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_stream_free(MTL_MSG_STREAM * stream);
+
 /**
  * Create buffer for ladder including address separation scheme
  * @param ctx:  the context for this MTL Node Set
@@ -248,7 +548,7 @@ MTLSTATUS mtl_hash_and_verify(MTL_CTX * ctx, uint8_t * message,
  * @param oid_len: length of the oid in bytes
  * @return buffer size
  */				
-uint32_t mtl_get_scheme_separated_buffer(MTL_CTX * ctx, LADDER * ladder,
+uint32_t mtl_get_scheme_separated_buffer(MTL_CTX * ctx, const LADDER * ladder,
 					 uint32_t hash_size, uint8_t ** buffer, uint8_t* oid,
 					 size_t oid_len);
 
@@ -276,6 +576,21 @@ MTLSTATUS mtl_initns(MTL_CTX ** mtl_ctx, SEED *seed, SERIESID * sid, char* ctx_s
 MTLSTATUS mtl_append(MTL_CTX * ctx, uint8_t * data_value,
 		   uint16_t data_value_len, uint32_t leaf_index);
 
+/**
+ * MTL Node Set Append of a batch of data values.
+ * The data values are appended as the leaves following the current
+ * leaf count. All leaf hashes are computed first and then each tree
+ * level is filled left to right, so each internal node is hashed once.
+ * Fails with MTL_ERROR while leaves are reserved (see mtl_reserve).
+ * @param ctx  the context for this MTL Node Set
+ * @param data_values array of data_value byte arrays
+ * @param data_value_lens length of each data_value byte array
+ * @param count number of data values to append
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_append_batch(MTL_CTX * ctx, uint8_t ** data_values,
+			   uint16_t * data_value_lens, uint32_t count);
+
 /*****************************************************************
 * MTL Node Set Update Parent Hashes
 ******************************************************************
@@ -285,6 +600,41 @@ MTLSTATUS mtl_append(MTL_CTX * ctx, uint8_t * data_value,
  */
 MTLSTATUS mtl_node_set_update_parents(MTL_CTX * ctx, uint32_t leaf_index);
 
+/*****************************************************************
+* MTL Node Set Update Parent Hashes of a run of appended leaves
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param first_leaf: index of the first leaf of the run
+ * @param last_leaf: index of the last leaf of the run
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_node_set_update_parents_range(MTL_CTX * ctx,
+					    uint32_t first_leaf,
+					    uint32_t last_leaf);
+
+/**
+ * Rebuild all internal nodes from the leaves already in the node set.
+ * Complete power of two subtrees are hashed on worker threads and the
+ * levels above them are merged afterwards.
+ * @param ctx the context for this MTL Node Set
+ * @param threads number of worker threads (0 for one per online CPU)
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_node_set_rebuild(MTL_CTX * ctx, uint32_t threads);
+
+/**
+ * Get a snapshot of the node set for threads reading it.
+ * The snapshot is the count of leaves whose nodes are all written. It
+ * stays valid while leaves are appended, so an authentication path and
+ * a ladder built from the same snapshot always match. One thread may
+ * append while any number of threads call mtl_snapshot, mtl_authpath,
+ * mtl_authpath_at, mtl_ladder, mtl_ladder_at,
+ * mtl_randomizer_and_authpath and mtl_randomizer_and_authpath_at.
+ * @param ctx  the context for this MTL Node Set 
+ * @return leaf count of the newest snapshot (0 on error)
+ */
+uint64_t mtl_snapshot(MTL_CTX * ctx);
+
 /**
  * Algorithm 5: Computing an Authentication Path for a Data Value.
  * mtl_authpath from draft-harvey-cfrg-mtl-mode-00 Section 8.5
@@ -294,6 +644,16 @@ MTLSTATUS mtl_node_set_update_parents(MTL_CTX * ctx, uint32_t leaf_index);
  */		   
 AUTHPATH *mtl_authpath(MTL_CTX * ctx, uint32_t leaf_index);
 
+/**
+ * Compute an authentication path to a rung of the ladder of a snapshot
+ * @param ctx  the context for this MTL Node Set 
+ * @param leaf_index leaf node index of the data value to authenticate
+ * @param snapshot leaf count from mtl_snapshot
+ * @return auth_path authentication path from the leaf node to the associated rung, or NULL on error 
+ */
+AUTHPATH *mtl_authpath_at(MTL_CTX * ctx, uint32_t leaf_index,
+			  uint64_t snapshot);
+
 /**
  * Algorithm 6: Computing a Merkle Tree Ladder for a Node Set.
  * mtl_ladder from draft-harvey-cfrg-mtl-mode-00 Section 8.6
@@ -302,6 +662,25 @@ AUTHPATH *mtl_authpath(MTL_CTX * ctx, uint32_t leaf_index);
  */
 LADDER *mtl_ladder(MTL_CTX * ctx);
 
+/**
+ * Compute the Merkle tree ladder of a snapshot of the node set
+ * @param ctx  the context for this MTL Node Set 
+ * @param snapshot leaf count from mtl_snapshot
+ * @return ladder Merkle tree ladder for the snapshot, or NULL on error
+ */
+LADDER *mtl_ladder_at(MTL_CTX * ctx, uint64_t snapshot);
+
+/**
+ * Get the ladder for the current node set without copying it.
+ * The ladder is maintained as leaves are appended and is owned by the
+ * context, it must not be modified or freed and is only valid until
+ * the node set changes. Only use it while no other thread appends;
+ * readers that run alongside appends use mtl_ladder_at instead.
+ * @param ctx  the context for this MTL Node Set 
+ * @return ladder for this node set, or NULL on error
+ */
+const LADDER *mtl_ladder_ref(MTL_CTX * ctx);
+
 /**
  * Algorithm 7: Selecting a Ladder Rung.
  * mtl_rung from draft-harvey-cfrg-mtl-mode-00 Section 8.7
@@ -392,7 +771,7 @@ uint32_t mtl_ladder_from_buffer(char *buffer, size_t buffer_size,
  * @param buffer     Pointer to where the buffer is created
  * @return size of the ladder buffer in bytes
  */
-uint32_t mtl_ladder_to_buffer(LADDER * ladder, uint32_t hash_size,
+uint32_t mtl_ladder_to_buffer(const LADDER * ladder, uint32_t hash_size,
 			      uint8_t ** buffer);
 
 #endif				// ___MTL_IMPL_H__
@@ -30,7 +30,9 @@
 	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 	POSSIBILITY OF SUCH DAMAGE.
 */
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "mtl.h"
 #include "mtl_node_set.h"
@@ -38,6 +40,9 @@
 
 #include <openssl/rand.h>
 
+// Most finished leaves mtl_commit inserts before hashing their parents
+#define MTL_COMMIT_RUN_SIZE (4 * MTL_HASH_BATCH_SIZE)
+
 /************************************************************************
  * The following algorithms are abstractions that use the constructs 
  * that are defined in draft-harvey-cfrg-mtl-mode-00 to simplify use.
@@ -104,66 +109,422 @@ MTLSTATUS mtl_randomizer_free(RANDOMIZER * mtl_random)
 }
 
 /*****************************************************************
-* Generate the message hash with randomization and then append to
-* the MTL node set as a leaf node. 
+* Drop the pending leaves that were committed some other way
+******************************************************************
+ * The caller holds ctx->pending.lock
+ * @param ctx: the context for this MTL Node Set
+ * @return none
+ */
+static void mtl_pending_sync(MTL_CTX * ctx)
+{
+	MTL_PENDING *pending = &ctx->pending;
+	uint64_t published = mtl_node_set_published(&ctx->nodes);
+	uint64_t drop;
+	uint64_t index;
+
+	// Committed leaves leave the array once they are published, and
+	// mtl_append publishes without going through it at all
+	if (pending->first_leaf >= published) {
+		return;
+	}
+	drop = published - pending->first_leaf;
+	if (drop > pending->leaf_count) {
+		drop = pending->leaf_count;
+	}
+	for (index = 0; index < drop; index++) {
+		free(pending->leaves[index].rmtl);
+	}
+	memmove(pending->leaves, pending->leaves + drop,
+		(pending->leaf_count - drop) * sizeof(MTL_PENDING_LEAF));
+	pending->leaf_count -= drop;
+	pending->first_leaf = published;
+}
+
+/*****************************************************************
+* Find the pending entry of a reserved leaf
+******************************************************************
+ * The caller holds ctx->pending.lock
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_index: reserved leaf index
+ * @return pointer to the entry, NULL if the leaf is not pending
+ */
+static MTL_PENDING_LEAF *mtl_pending_leaf(MTL_CTX * ctx, uint32_t leaf_index)
+{
+	MTL_PENDING *pending = &ctx->pending;
+
+	mtl_pending_sync(ctx);
+	if ((leaf_index < pending->first_leaf) ||
+	    (leaf_index - pending->first_leaf >= pending->leaf_count)) {
+		return NULL;
+	}
+	return &pending->leaves[leaf_index - pending->first_leaf];
+}
+
+/*****************************************************************
+* Record the outcome of hashing a reserved leaf
+******************************************************************
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_index: reserved leaf index
+ * @param state:      MTL_LEAF_COMPLETE or MTL_LEAF_FAILED
+ * @param hash:       leaf hash (complete leaves only)
+ * @param rmtl:       randomizer, owned by the entry on success
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_pending_finish(MTL_CTX * ctx, uint32_t leaf_index,
+				    uint8_t state, uint8_t * hash,
+				    uint8_t * rmtl)
+{
+	MTL_PENDING_LEAF *leaf;
+
+	pthread_mutex_lock(&ctx->pending.lock);
+	leaf = mtl_pending_leaf(ctx, leaf_index);
+	if ((leaf == NULL) || (leaf->state != MTL_LEAF_RESERVED)) {
+		pthread_mutex_unlock(&ctx->pending.lock);
+		LOG_ERROR("Leaf is not reserved");
+		return MTL_BAD_PARAM;
+	}
+	leaf->state = state;
+	if (state == MTL_LEAF_COMPLETE) {
+		memcpy(leaf->hash, hash, ctx->nodes.hash_size);
+		leaf->rmtl = rmtl;
+	}
+	pthread_mutex_unlock(&ctx->pending.lock);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Reserve a run of consecutive leaf indexes of the node set
+******************************************************************
+ * @param ctx:        the context for this MTL Node Set
+ * @param count:      number of leaves to reserve (at least one)
+ * @param first_leaf: return value first reserved leaf index
+ * @return MTL_OK on success, MTL_BAD_PARAM if the node set is full
+ */
+static MTLSTATUS mtl_reserve_leaves(MTL_CTX * ctx, uint32_t count,
+				    uint32_t * first_leaf)
+{
+	MTL_PENDING *pending = &ctx->pending;
+	MTL_PENDING_LEAF *leaves;
+	uint64_t leaf_count;
+	uint64_t needed;
+	uint64_t capacity;
+
+	pthread_mutex_lock(&pending->lock);
+	mtl_pending_sync(ctx);
+	leaf_count = __atomic_load_n(&ctx->nodes.leaf_count, __ATOMIC_RELAXED);
+	if (leaf_count + count - 1 > MTL_NODE_SET_MAX_LEAF) {
+		pthread_mutex_unlock(&pending->lock);
+		LOG_ERROR("Node set is full");
+		return MTL_BAD_PARAM;
+	}
+
+	// Every reserved leaf gets its entry now, so finishing or giving
+	// up a leaf later never needs memory
+	needed = leaf_count + count - pending->first_leaf;
+	if (needed > pending->leaf_capacity) {
+		capacity = 2 * pending->leaf_capacity;
+		if (capacity < needed) {
+			capacity = needed;
+		}
+		leaves = realloc(pending->leaves,
+				 capacity * sizeof(MTL_PENDING_LEAF));
+		if (leaves == NULL) {
+			pthread_mutex_unlock(&pending->lock);
+			LOG_ERROR("Unable to allocate buffer");
+			return MTL_RESOURCE_FAIL;
+		}
+		pending->leaves = leaves;
+		pending->leaf_capacity = capacity;
+	}
+	memset(pending->leaves + pending->leaf_count, 0,
+	       (needed - pending->leaf_count) * sizeof(MTL_PENDING_LEAF));
+	pending->leaf_count = needed;
+
+	// mtl_append from draft-harvey-cfrg-mtl-mode-00 Section 8.4
+	// The leaf index is part of the message ADRS, so it is claimed
+	// before the message is hashed
+	__atomic_store_n(&ctx->nodes.leaf_count, leaf_count + count,
+			 __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&pending->lock);
+
+	*first_leaf = (uint32_t)leaf_count;
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Reserve the next leaf index of the node set
+******************************************************************
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_index: return value reserved leaf index
+ * @return MTL_OK on success, MTL_BAD_PARAM if the node set is full
+ */
+MTLSTATUS mtl_reserve(MTL_CTX * ctx, uint32_t * leaf_index)
+{
+	if ((ctx == NULL) || (leaf_index == NULL)) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	return mtl_reserve_leaves(ctx, 1, leaf_index);
+}
+
+/*****************************************************************
+* Generate the message hash and leaf hash for a reserved leaf
 ******************************************************************
  * @param ctx:         the context for this MTL Node Set
+ * @param leaf_index:  leaf index from mtl_reserve
  * @param message:     byte array of message data
  * @param message_len: byte length of the message data
- * @param node_id:     return value index of the leaf node that was appended
  * @return MTL_OK on success
  */
-MTLSTATUS mtl_hash_and_append(MTL_CTX * ctx, uint8_t * message,
-			     uint16_t message_len, uint32_t * node_id)
+MTLSTATUS mtl_hash_reserved(MTL_CTX * ctx, uint32_t leaf_index,
+			    uint8_t * message, uint32_t message_len)
 {
-	uint32_t leaf_index = 0;
+	uint8_t msg_hash[EVP_MAX_MD_SIZE];
 	uint8_t hash[EVP_MAX_MD_SIZE];
 	RANDOMIZER *mtl_random;
-	uint8_t* rmtl_ptr = NULL;
+	uint8_t *rmtl_ptr = NULL;
 	uint32_t rmtl_len = 0;
-	MTLSTATUS return_code;
+	MTLSTATUS return_code = MTL_ERROR;
 
-	if ((ctx == NULL) || (message == NULL) || message_len == 0 || node_id == NULL) {
+	if (ctx == NULL) {
 		LOG_ERROR("NULL Input Pointers");
 		return MTL_NULL_PTR;
 	}
-	// Generate the randomizer in a buffer
-	if (mtl_generate_randomizer(ctx, &mtl_random) != MTL_OK) {
-		LOG_ERROR("Unable to get node randomizer");
-		return MTL_ERROR;
+	if ((message == NULL) || (message_len == 0)) {
+		LOG_ERROR("NULL Input Pointers");
+		mtl_pending_finish(ctx, leaf_index, MTL_LEAF_FAILED, NULL, NULL);
+		return MTL_NULL_PTR;
 	}
-	// mtl_append from draft-harvey-cfrg-mtl-mode-00 Section 8.4
-	leaf_index = ctx->nodes.leaf_count;
-	ctx->nodes.leaf_count++;
 
-	// Hash the message
-	if (ctx->hash_msg != NULL) {
+	if ((ctx->hash_msg == NULL) || (ctx->hash_leaf == NULL)) {
+		LOG_ERROR("Message hash function is not defined");
+	} else if (mtl_generate_randomizer(ctx, &mtl_random) != MTL_OK) {
+		LOG_ERROR("Unable to get node randomizer");
+	} else {
+		// Hash the message and then the leaf node, neither touches
+		// the node set so reserved leaves are hashed in any order
 		if (ctx->hash_msg(ctx->sig_params, &ctx->sid, leaf_index,
 				  mtl_random->value, mtl_random->length,
-				  message, message_len, &hash[0],
+				  message, message_len, &msg_hash[0],
 				  ctx->nodes.hash_size, ctx->ctx_str,
 				  &rmtl_ptr, &rmtl_len) != MTL_OK) {
 			LOG_ERROR("Unable to hash leaf node");
-			mtl_randomizer_free(mtl_random);
-			return MTL_ERROR;
+		} else if (rmtl_ptr == NULL) {
+			LOG_ERROR("Message hash did not return a randomizer");
+		} else if (ctx->hash_leaf(ctx->sig_params, &ctx->sid,
+					  leaf_index, &msg_hash[0],
+					  ctx->nodes.hash_size, &hash[0],
+					  ctx->nodes.hash_size) != MTL_OK) {
+			LOG_ERROR("Unable to hash leaf node");
+		} else {
+			return_code = MTL_OK;
 		}
+		mtl_randomizer_free(mtl_random);
+	}
+
+	if (return_code != MTL_OK) {
+		free(rmtl_ptr);
+		mtl_pending_finish(ctx, leaf_index, MTL_LEAF_FAILED, NULL, NULL);
+		return return_code;
+	}
+	if (mtl_pending_finish(ctx, leaf_index, MTL_LEAF_COMPLETE, &hash[0],
+			       rmtl_ptr) != MTL_OK) {
+		free(rmtl_ptr);
+		return MTL_BAD_PARAM;
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Give up a reserved leaf that will not be hashed
+******************************************************************
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_index: leaf index from mtl_reserve
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_release(MTL_CTX * ctx, uint32_t leaf_index)
+{
+	MTL_PENDING *pending;
+	MTL_PENDING_LEAF *leaf;
+	uint64_t count;
+
+	if (ctx == NULL) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	pending = &ctx->pending;
+
+	pthread_mutex_lock(&pending->lock);
+	leaf = mtl_pending_leaf(ctx, leaf_index);
+	if ((leaf == NULL) || (leaf->state != MTL_LEAF_RESERVED)) {
+		pthread_mutex_unlock(&pending->lock);
+		LOG_ERROR("Leaf is not reserved");
+		return MTL_BAD_PARAM;
+	}
+
+	// Hand the leaf index back if nothing was reserved since,
+	// otherwise it becomes a filler leaf when it is committed
+	count = (uint64_t)leaf_index + 1;
+	if (__atomic_compare_exchange_n(&ctx->nodes.leaf_count, &count,
+					leaf_index, 0, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED)) {
+		pending->leaf_count = leaf_index - pending->first_leaf;
 	} else {
-		LOG_ERROR("Message hash function is not defined");
-		return MTL_ERROR;
+		leaf->state = MTL_LEAF_FAILED;
 	}
+	pthread_mutex_unlock(&pending->lock);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Insert a finished reserved leaf into the node set
+******************************************************************
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_index: index of the leaf
+ * @param leaf:       copy of the pending entry of the leaf
+ * @return MTL_OK on success
+ */
+static MTLSTATUS mtl_commit_leaf(MTL_CTX * ctx, uint32_t leaf_index,
+				 MTL_PENDING_LEAF * leaf)
+{
+	uint8_t filler[EVP_MAX_MD_SIZE];
+	uint8_t *rmtl = leaf->rmtl;
 
-	return_code = mtl_node_set_insert_randomizer(&ctx->nodes, leaf_index,
-				       rmtl_ptr);
-	if(return_code != MTL_OK){
-		LOG_ERROR_WITH_CODE("mtl_node_set_insert_randomizer",return_code);
+	// A leaf that failed keeps its index, so the tree is filled
+	// with a value no message hashes to
+	if (leaf->state == MTL_LEAF_FAILED) {
+		memset(filler, 0, sizeof(filler));
+		rmtl = &filler[0];
+		if ((ctx->hash_leaf == NULL) ||
+		    (ctx->hash_leaf(ctx->sig_params, &ctx->sid, leaf_index,
+				    &filler[0], ctx->nodes.hash_size,
+				    leaf->hash, ctx->nodes.hash_size) != MTL_OK)) {
+			LOG_ERROR("Unable to hash leaf node");
+			return MTL_ERROR;
+		}
+	}
+	if (mtl_node_set_insert_randomizer(&ctx->nodes, leaf_index, rmtl)
+	    != MTL_OK) {
+		LOG_ERROR("Unable to add randomizer to node set");
+		return MTL_ERROR;
+	}
+	if (mtl_node_set_insert(&ctx->nodes, leaf_index, leaf_index,
+				leaf->hash) != MTL_OK) {
+		LOG_ERROR("Unable to add message to node set");
 		return MTL_ERROR;
 	}
+	return MTL_OK;
+}
 
-	free(rmtl_ptr);
-	mtl_randomizer_free(mtl_random);
+/*****************************************************************
+* Commit the hashed and failed reserved leaves that follow the
+* node set, in index order.
+******************************************************************
+ * @param ctx:        the context for this MTL Node Set
+ * @param leaf_count: optional return value committed leaf count
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_commit(MTL_CTX * ctx, uint64_t * leaf_count)
+{
+	MTL_PENDING *pending;
+	MTL_PENDING_LEAF leaves[MTL_COMMIT_RUN_SIZE];
+	uint64_t first_leaf;
+	uint32_t run;
+	uint32_t index;
+	MTLSTATUS return_code = MTL_OK;
+
+	if (ctx == NULL) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	pending = &ctx->pending;
+
+	// Only one thread commits at a time so leaves go in in order,
+	// the others keep hashing and completing leaves meanwhile
+	pthread_mutex_lock(&pending->commit_lock);
+	while (return_code == MTL_OK) {
+		// Copy the run of finished leaves at the front. They stay
+		// pending until they are published, so a leaf that fails to
+		// go in is retried by the next commit instead of lost
+		pthread_mutex_lock(&pending->lock);
+		mtl_pending_sync(ctx);
+		first_leaf = pending->first_leaf;
+		for (run = 0; (run < MTL_COMMIT_RUN_SIZE) &&
+		     (run < pending->leaf_count) &&
+		     (pending->leaves[run].state != MTL_LEAF_RESERVED); run++) {
+			leaves[run] = pending->leaves[run];
+		}
+		pthread_mutex_unlock(&pending->lock);
+		if (run == 0) {
+			break;
+		}
+
+		for (index = 0; (return_code == MTL_OK) && (index < run);
+		     index++) {
+			return_code = mtl_commit_leaf(ctx,
+						      (uint32_t)(first_leaf + index),
+						      &leaves[index]);
+		}
+
+		// Publishing the run drops it from the pending leaves
+		if ((return_code == MTL_OK) &&
+		    (mtl_node_set_update_parents_range(ctx, (uint32_t)first_leaf,
+						       (uint32_t)(first_leaf +
+								  run - 1))
+		     != MTL_OK)) {
+			LOG_ERROR("Unable to add message to node set");
+			return_code = MTL_ERROR;
+		}
+	}
+	if (return_code == MTL_OK) {
+		pthread_mutex_lock(&pending->lock);
+		mtl_pending_sync(ctx);
+		pthread_mutex_unlock(&pending->lock);
+	}
+	pthread_mutex_unlock(&pending->commit_lock);
+
+	if (leaf_count != NULL) {
+		*leaf_count = mtl_node_set_published(&ctx->nodes);
+	}
+	return return_code;
+}
+
+/*****************************************************************
+* Generate the message hash with randomization and then append to
+* the MTL node set as a leaf node. 
+******************************************************************
+ * @param ctx:         the context for this MTL Node Set
+ * @param message:     byte array of message data
+ * @param message_len: byte length of the message data
+ * @param node_id:     return value index of the leaf node that was appended
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append(MTL_CTX * ctx, uint8_t * message,
+			     uint32_t message_len, uint32_t * node_id)
+{
+	uint32_t leaf_index = 0;
+	MTLSTATUS return_code;
+
+	if ((ctx == NULL) || (message == NULL) || message_len == 0 || node_id == NULL) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	if ((ctx->hash_msg == NULL) || (ctx->hash_leaf == NULL)) {
+		LOG_ERROR("Message hash function is not defined");
+		return MTL_ERROR;
+	}
+	return_code = mtl_reserve(ctx, &leaf_index);
+	if (return_code != MTL_OK) {
+		return return_code;
+	}
 
-	// Insert the leaf in the MTL node set
-	if (mtl_append(ctx, &hash[0], ctx->nodes.hash_size, leaf_index) != MTL_OK) {
+	// A leaf that fails to hash is still committed (as a filler leaf)
+	// so the leaves reserved after it are not held up
+	if (mtl_hash_reserved(ctx, leaf_index, message, message_len) != MTL_OK) {
+		mtl_commit(ctx, NULL);
+		return MTL_ERROR;
+	}
+	if (mtl_commit(ctx, NULL) != MTL_OK) {
 		LOG_ERROR("Append Message Error");
 		return MTL_ERROR;
 	}
@@ -171,6 +532,252 @@ MTLSTATUS mtl_hash_and_append(MTL_CTX * ctx, uint8_t * message,
 	return MTL_OK;
 }
 
+/** Work item for a thread hashing a share of a message batch */
+typedef struct MTL_HASH_TASK {
+	MTL_CTX *ctx;
+	uint8_t **messages;
+	uint32_t *message_lens;
+	uint32_t first_leaf;
+	uint32_t first_message;
+	uint32_t message_stride;
+	uint32_t count;
+	MTLSTATUS result;
+} MTL_HASH_TASK;
+
+/*****************************************************************
+* Hash the messages assigned to a thread and complete their
+* reserved leaves
+******************************************************************
+ * @param arg: pointer to the MTL_HASH_TASK for this thread
+ * @return NULL
+ */
+static void *mtl_hash_batch_worker(void *arg)
+{
+	MTL_HASH_TASK *task = (MTL_HASH_TASK *) arg;
+	MTL_CTX *ctx = task->ctx;
+	uint8_t msg_hashes[MTL_HASH_BATCH_SIZE][EVP_MAX_MD_SIZE];
+	uint8_t leaf_hashes[MTL_HASH_BATCH_SIZE][EVP_MAX_MD_SIZE];
+	uint8_t *msg_ptrs[MTL_HASH_BATCH_SIZE];
+	uint8_t *leaf_ptrs[MTL_HASH_BATCH_SIZE];
+	uint8_t *rmtl_ptrs[MTL_HASH_BATCH_SIZE];
+	uint8_t hashed[MTL_HASH_BATCH_SIZE];
+	uint32_t node_ids[MTL_HASH_BATCH_SIZE];
+	RANDOMIZER *mtl_random;
+	uint32_t rmtl_len;
+	uint32_t message;
+	uint32_t group;
+	uint32_t index;
+
+	task->result = MTL_OK;
+	message = task->first_message;
+	while (message < task->count) {
+		// Randomize and hash the next group of messages
+		for (group = 0; (group < MTL_HASH_BATCH_SIZE) &&
+		     (message < task->count);
+		     group++, message += task->message_stride) {
+			node_ids[group] = task->first_leaf + message;
+			msg_ptrs[group] = msg_hashes[group];
+			leaf_ptrs[group] = leaf_hashes[group];
+			rmtl_ptrs[group] = NULL;
+			hashed[group] = 0;
+			memset(msg_hashes[group], 0, EVP_MAX_MD_SIZE);
+			if (mtl_generate_randomizer(ctx, &mtl_random) != MTL_OK) {
+				LOG_ERROR("Unable to get node randomizer");
+				continue;
+			}
+			rmtl_len = 0;
+			if ((ctx->hash_msg(ctx->sig_params, &ctx->sid,
+					   node_ids[group], mtl_random->value,
+					   mtl_random->length,
+					   task->messages[message],
+					   task->message_lens[message],
+					   msg_hashes[group], ctx->nodes.hash_size,
+					   ctx->ctx_str, &rmtl_ptrs[group],
+					   &rmtl_len) == MTL_OK) &&
+			    (rmtl_ptrs[group] != NULL)) {
+				hashed[group] = 1;
+			} else {
+				LOG_ERROR("Unable to hash leaf node");
+			}
+			mtl_randomizer_free(mtl_random);
+		}
+
+		// The message hashes are all one length, so the scheme can
+		// hash the whole group of leaves at once
+		if (ctx->hash_leaf_batch != NULL) {
+			if (ctx->hash_leaf_batch(ctx->sig_params, &ctx->sid,
+						 node_ids, msg_ptrs,
+						 ctx->nodes.hash_size, leaf_ptrs,
+						 ctx->nodes.hash_size,
+						 group) != MTL_OK) {
+				LOG_ERROR("Unable to hash leaf node");
+				memset(hashed, 0, sizeof(hashed));
+			}
+		} else {
+			for (index = 0; index < group; index++) {
+				if ((hashed[index]) &&
+				    (ctx->hash_leaf(ctx->sig_params, &ctx->sid,
+						    node_ids[index],
+						    msg_ptrs[index],
+						    ctx->nodes.hash_size,
+						    leaf_ptrs[index],
+						    ctx->nodes.hash_size) != MTL_OK)) {
+					LOG_ERROR("Unable to hash leaf node");
+					hashed[index] = 0;
+				}
+			}
+		}
+
+		// Hand the leaves over to be committed in index order
+		for (index = 0; index < group; index++) {
+			if (!hashed[index]) {
+				free(rmtl_ptrs[index]);
+				mtl_pending_finish(ctx, node_ids[index],
+						   MTL_LEAF_FAILED, NULL, NULL);
+				task->result = MTL_ERROR;
+			} else if (mtl_pending_finish(ctx, node_ids[index],
+						      MTL_LEAF_COMPLETE,
+						      leaf_hashes[index],
+						      rmtl_ptrs[index]) != MTL_OK) {
+				free(rmtl_ptrs[index]);
+				task->result = MTL_ERROR;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*****************************************************************
+* Generate the message hashes with randomization for a batch of
+* messages and then append them to the MTL node set as leaf nodes.
+******************************************************************
+ * @param ctx:          the context for this MTL Node Set
+ * @param messages:     array of message byte arrays
+ * @param message_lens: byte length of each message
+ * @param count:        number of messages
+ * @param node_ids:     return value array of the appended leaf indexes
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_batch(MTL_CTX * ctx, uint8_t ** messages,
+				    uint32_t * message_lens, uint32_t count,
+				    uint32_t * node_ids)
+{
+	return mtl_hash_and_append_threads(ctx, messages, message_lens, count,
+					   node_ids, 1);
+}
+
+/*****************************************************************
+* Generate the message hashes for a batch of messages on worker
+* threads and then append them to the MTL node set in index order.
+******************************************************************
+ * @param ctx:          the context for this MTL Node Set
+ * @param messages:     array of message byte arrays
+ * @param message_lens: byte length of each message
+ * @param count:        number of messages
+ * @param node_ids:     return value array of the appended leaf indexes
+ * @param threads:      number of worker threads (0 for one per online CPU)
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_threads(MTL_CTX * ctx, uint8_t ** messages,
+				      uint32_t * message_lens, uint32_t count,
+				      uint32_t * node_ids, uint32_t threads)
+{
+	uint32_t first_leaf;
+	uint32_t index;
+	uint32_t started = 0;
+	MTL_HASH_TASK *tasks = NULL;
+	pthread_t *thread_ids = NULL;
+	MTLSTATUS return_code = MTL_OK;
+
+	if ((ctx == NULL) || (messages == NULL) || (message_lens == NULL) ||
+	    (count == 0) || (node_ids == NULL)) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	if ((ctx->hash_msg == NULL) || (ctx->hash_leaf == NULL)) {
+		LOG_ERROR("Message hash function is not defined");
+		return MTL_ERROR;
+	}
+	for (index = 0; index < count; index++) {
+		if ((messages[index] == NULL) || (message_lens[index] == 0)) {
+			LOG_ERROR("NULL Input Pointers");
+			return MTL_NULL_PTR;
+		}
+	}
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? (uint32_t) cpus : 1;
+	}
+	if (threads > count) {
+		threads = count;
+	}
+
+	tasks = calloc(threads, sizeof(MTL_HASH_TASK));
+	thread_ids = calloc(threads, sizeof(pthread_t));
+	if ((tasks == NULL) || (thread_ids == NULL)) {
+		LOG_ERROR("Unable to allocate buffer");
+		free(tasks);
+		free(thread_ids);
+		return MTL_RESOURCE_FAIL;
+	}
+
+	// Reserve the whole batch at once so its leaves are consecutive,
+	// open streams and other appends keep the leaves they reserved
+	return_code = mtl_reserve_leaves(ctx, count, &first_leaf);
+	if (return_code != MTL_OK) {
+		LOG_ERROR("Unable to reserve the batch leaves");
+		free(tasks);
+		free(thread_ids);
+		return return_code;
+	}
+	for (index = 0; index < threads; index++) {
+		tasks[index].ctx = ctx;
+		tasks[index].messages = messages;
+		tasks[index].message_lens = message_lens;
+		tasks[index].first_leaf = first_leaf;
+		tasks[index].first_message = index;
+		tasks[index].message_stride = threads;
+		tasks[index].count = count;
+	}
+
+	// Every reserved leaf must be finished, so the share of a thread
+	// that could not be started is hashed here instead
+	for (index = 1; index < threads; index++) {
+		if (pthread_create(&thread_ids[index], NULL,
+				   mtl_hash_batch_worker, &tasks[index]) != 0) {
+			LOG_ERROR("Unable to start hash thread");
+			break;
+		}
+		started++;
+	}
+	for (index = started + 1; index < threads; index++) {
+		mtl_hash_batch_worker(&tasks[index]);
+	}
+	mtl_hash_batch_worker(&tasks[0]);
+	for (index = 1; index <= started; index++) {
+		pthread_join(thread_ids[index], NULL);
+	}
+	for (index = 0; index < threads; index++) {
+		if (tasks[index].result != MTL_OK) {
+			return_code = MTL_ERROR;
+		}
+	}
+
+	// Leaves held up by an earlier reservation are committed with it
+	if (mtl_commit(ctx, NULL) != MTL_OK) {
+		LOG_ERROR("Append Message Error");
+		return_code = MTL_ERROR;
+	}
+	for (index = 0; (return_code == MTL_OK) && (index < count); index++) {
+		node_ids[index] = first_leaf + index;
+	}
+
+	free(tasks);
+	free(thread_ids);
+	return return_code;
+}
+
 /*****************************************************************
 * Get the MTL Auth path and randomizer value
 ******************************************************************
@@ -182,6 +789,30 @@ MTLSTATUS mtl_hash_and_append(MTL_CTX * ctx, uint8_t * message,
  */
 MTLSTATUS mtl_randomizer_and_authpath(MTL_CTX * ctx, uint32_t leaf_index,
 				    RANDOMIZER ** randomizer, AUTHPATH ** auth)
+{
+	if (ctx == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	return mtl_randomizer_and_authpath_at(ctx, leaf_index,
+					      mtl_snapshot(ctx), randomizer,
+					      auth);
+}
+
+/*****************************************************************
+* Get the MTL Auth path to a snapshot's ladder and randomizer value
+******************************************************************
+ * @param ctx,  the context for this MTL Node Set
+ * @param leaf_index: index of the leaf node that is being appended
+ * @param snapshot:   leaf count from mtl_snapshot
+ * @param randomizer: pointer to randomizer buffer 
+ * @param auth:       pointer to authpath buffer
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_randomizer_and_authpath_at(MTL_CTX * ctx, uint32_t leaf_index,
+				       uint64_t snapshot,
+				       RANDOMIZER ** randomizer,
+				       AUTHPATH ** auth)
 {
 	RANDOMIZER *mtl_random = NULL;
 
@@ -190,21 +821,35 @@ MTLSTATUS mtl_randomizer_and_authpath(MTL_CTX * ctx, uint32_t leaf_index,
 		return MTL_NULL_PTR;
 	}
 
+	// Only leaves of a published snapshot are complete, a reserved
+	// leaf may not have its randomizer or parent nodes yet
+	if ((leaf_index >= snapshot) ||
+	    (snapshot > mtl_snapshot(ctx))) {
+		LOG_ERROR("Invalid Auth Path Index");
+		return MTL_ERROR;
+	}
+
 	mtl_random = malloc(sizeof(RANDOMIZER));
+	if (mtl_random == NULL) {
+		LOG_ERROR("Unable to allocate randomizer");
+		return MTL_RESOURCE_FAIL;
+	}
 	mtl_random->length = ctx->nodes.hash_size;
 
 	if (mtl_node_set_get_randomizer
 	    (&ctx->nodes, leaf_index, &mtl_random->value) != 0) {
 		LOG_ERROR("Randomizer Failure");
+		free(mtl_random);
 		return MTL_ERROR;
 	}
 
-	*randomizer = mtl_random;
-	*auth = mtl_authpath(ctx, leaf_index);
-	if(auth == NULL) {
+	*auth = mtl_authpath_at(ctx, leaf_index, snapshot);
+	if (*auth == NULL) {
 		LOG_ERROR("Failed generating authpath");
+		mtl_randomizer_free(mtl_random);
 		return MTL_ERROR;
 	}
+	*randomizer = mtl_random;
 
 	return MTL_OK;
 }
@@ -222,7 +867,7 @@ MTLSTATUS mtl_randomizer_and_authpath(MTL_CTX * ctx, uint32_t leaf_index,
  * @return 0 on success, int on failure
  */
 MTLSTATUS mtl_hash_and_verify(MTL_CTX * ctx, uint8_t * message,
-			    uint16_t message_len, RANDOMIZER * randomizer,
+			    uint32_t message_len, RANDOMIZER * randomizer,
 			    AUTHPATH * auth_path, RUNG * assoc_rung)
 {
 	uint32_t leaf_index = 0;
@@ -263,6 +908,279 @@ MTLSTATUS mtl_hash_and_verify(MTL_CTX * ctx, uint8_t * message,
 			  assoc_rung);
 }
 
+/*****************************************************************
+* Free a message stream that will not be finished
+******************************************************************
+ * @param stream: message stream to free
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_stream_free(MTL_MSG_STREAM * stream)
+{
+	MTL_CTX *ctx;
+
+	if (stream == NULL) {
+		return MTL_OK;
+	}
+	ctx = stream->ctx;
+
+	// A NULL hash tells the scheme to discard its state
+	if (stream->state != NULL) {
+		ctx->hash_msg_final(stream->state, NULL, 0);
+	}
+	// Give up the reserved leaf, it is handed back if it is the newest
+	if (stream->append) {
+		mtl_release(ctx, stream->leaf_index);
+	}
+	free(stream->rmtl);
+	free(stream);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Start a message hash for a message that will be appended to the
+* MTL node set, when the message is supplied in pieces.
+******************************************************************
+ * @param ctx:    the context for this MTL Node Set
+ * @param stream: return value message stream
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_init(MTL_CTX * ctx, MTL_MSG_STREAM ** stream)
+{
+	MTL_MSG_STREAM *msg_stream;
+	RANDOMIZER *mtl_random;
+	uint32_t rmtl_len = 0;
+	MTLSTATUS return_code;
+
+	if ((ctx == NULL) || (stream == NULL)) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	*stream = NULL;
+
+	if ((ctx->hash_msg_init == NULL) || (ctx->hash_msg_update == NULL)
+	    || (ctx->hash_msg_final == NULL)) {
+		LOG_ERROR("Message stream hash functions are not defined");
+		return MTL_ERROR;
+	}
+
+
+	msg_stream = calloc(1, sizeof(MTL_MSG_STREAM));
+	if (msg_stream == NULL) {
+		LOG_ERROR("Unable to allocate message stream");
+		return MTL_RESOURCE_FAIL;
+	}
+	// Generate the randomizer in a buffer
+	if (mtl_generate_randomizer(ctx, &mtl_random) != MTL_OK) {
+		LOG_ERROR("Unable to get node randomizer");
+		free(msg_stream);
+		return MTL_ERROR;
+	}
+
+	// The leaf index is part of the message ADRS, so it is reserved
+	// before any of the message is hashed
+	msg_stream->ctx = ctx;
+	return_code = mtl_reserve(ctx, &msg_stream->leaf_index);
+	if (return_code != MTL_OK) {
+		mtl_randomizer_free(mtl_random);
+		free(msg_stream);
+		return return_code;
+	}
+	msg_stream->append = 1;
+	if (ctx->hash_msg_init(ctx->sig_params, &ctx->sid,
+			       msg_stream->leaf_index, mtl_random->value,
+			       mtl_random->length, ctx->nodes.hash_size,
+			       ctx->ctx_str, &msg_stream->rmtl, &rmtl_len,
+			       &msg_stream->state) != MTL_OK) {
+		LOG_ERROR("Unable to start message hash");
+		mtl_randomizer_free(mtl_random);
+		mtl_hash_stream_free(msg_stream);
+		return MTL_ERROR;
+	}
+	mtl_randomizer_free(mtl_random);
+
+	*stream = msg_stream;
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Start a message hash for a message that will be verified, when
+* the message is supplied in pieces.
+******************************************************************
+ * @param ctx:        the context for this MTL Node Set
+ * @param randomizer: randomizer value for this leaf node
+ * @param leaf_index: leaf index from the authentication path
+ * @param stream:     return value message stream
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_verify_init(MTL_CTX * ctx, RANDOMIZER * randomizer,
+				   uint32_t leaf_index,
+				   MTL_MSG_STREAM ** stream)
+{
+	MTL_MSG_STREAM *msg_stream;
+	uint8_t rmtl[EVP_MAX_MD_SIZE];
+	uint8_t *rmtl_ptr = &rmtl[0];
+	uint32_t rmtl_len = 0;
+
+	if ((ctx == NULL) || (randomizer == NULL) || (stream == NULL)) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+	*stream = NULL;
+
+	if ((ctx->hash_msg_init == NULL) || (ctx->hash_msg_update == NULL)
+	    || (ctx->hash_msg_final == NULL)) {
+		LOG_ERROR("Message stream hash functions are not defined");
+		return MTL_ERROR;
+	}
+	if ((randomizer->length == 0) || (randomizer->length > EVP_MAX_MD_SIZE)) {
+		LOG_ERROR("Invalid randomizer");
+		return MTL_BAD_PARAM;
+	}
+
+	msg_stream = calloc(1, sizeof(MTL_MSG_STREAM));
+	if (msg_stream == NULL) {
+		LOG_ERROR("Unable to allocate message stream");
+		return MTL_RESOURCE_FAIL;
+	}
+
+	rmtl_len = randomizer->length;
+	memcpy(rmtl_ptr, randomizer->value, randomizer->length);
+
+	// mtl_authpath from draft-harvey-cfrg-mtl-mode-00 Section 8.8
+	// Randomize the message digest
+	msg_stream->ctx = ctx;
+	msg_stream->leaf_index = leaf_index;
+	if (ctx->hash_msg_init(ctx->sig_params, &ctx->sid, leaf_index,
+			       randomizer->value, randomizer->length,
+			       ctx->nodes.hash_size, ctx->ctx_str, &rmtl_ptr,
+			       &rmtl_len, &msg_stream->state) != MTL_OK) {
+		LOG_ERROR("Unable to start message hash");
+		free(msg_stream);
+		return MTL_ERROR;
+	}
+
+	*stream = msg_stream;
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Add the next piece of the message to a message stream
+******************************************************************
+ * @param stream:      message stream to add to
+ * @param message:     byte array of message data
+ * @param message_len: byte length of the message data
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_stream_update(MTL_MSG_STREAM * stream, uint8_t * message,
+				 size_t message_len)
+{
+	if ((stream == NULL) || (stream->state == NULL)
+	    || ((message == NULL) && (message_len > 0))) {
+		LOG_ERROR("NULL Input Pointers");
+		return MTL_NULL_PTR;
+	}
+
+	if (message_len == 0) {
+		return MTL_OK;
+	}
+	if (stream->ctx->hash_msg_update(stream->state, message, message_len)
+	    != MTL_OK) {
+		LOG_ERROR("Unable to hash message data");
+		return MTL_ERROR;
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Finish the message hash and append it to the MTL node set as a
+* leaf node.
+******************************************************************
+ * @param stream:  message stream from mtl_hash_and_append_init
+ * @param node_id: return value index of the leaf node that was appended
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_append_final(MTL_MSG_STREAM * stream,
+				    uint32_t * node_id)
+{
+	MTL_CTX *ctx;
+	uint32_t leaf_index;
+	uint8_t msg_hash[EVP_MAX_MD_SIZE];
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	MTLSTATUS return_code;
+
+	if ((stream == NULL) || (node_id == NULL) || (!stream->append)) {
+		LOG_ERROR("NULL Input Pointers");
+		mtl_hash_stream_free(stream);
+		return MTL_NULL_PTR;
+	}
+	ctx = stream->ctx;
+	leaf_index = stream->leaf_index;
+
+	// Other leaves may have been reserved while the stream was open,
+	// they are committed in index order around this one
+	return_code = ctx->hash_msg_final(stream->state, &msg_hash[0],
+					  ctx->nodes.hash_size);
+	stream->state = NULL;
+	if ((return_code == MTL_OK) && (ctx->hash_leaf != NULL) &&
+	    (ctx->hash_leaf(ctx->sig_params, &ctx->sid, leaf_index,
+			    &msg_hash[0], ctx->nodes.hash_size, &hash[0],
+			    ctx->nodes.hash_size) == MTL_OK)) {
+		return_code = mtl_pending_finish(ctx, leaf_index,
+						 MTL_LEAF_COMPLETE, &hash[0],
+						 stream->rmtl);
+		if (return_code == MTL_OK) {
+			stream->rmtl = NULL;
+		}
+	} else {
+		LOG_ERROR("Unable to hash leaf node");
+		mtl_pending_finish(ctx, leaf_index, MTL_LEAF_FAILED, NULL, NULL);
+		return_code = MTL_ERROR;
+	}
+	// The leaf index stays used from here on, like mtl_hash_and_append
+	stream->append = 0;
+	mtl_hash_stream_free(stream);
+
+	if (mtl_commit(ctx, NULL) != MTL_OK) {
+		LOG_ERROR("Append Message Error");
+		return MTL_ERROR;
+	}
+	if (return_code != MTL_OK) {
+		return MTL_ERROR;
+	}
+	*node_id = leaf_index;
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Finish a verification message stream with the message data value
+******************************************************************
+ * @param stream:     message stream from mtl_hash_and_verify_init
+ * @param data_value: return value message hash (EVP_MAX_MD_SIZE bytes)
+ * @return MTL_OK on success
+ */
+MTLSTATUS mtl_hash_and_verify_final(MTL_MSG_STREAM * stream,
+				    uint8_t * data_value)
+{
+	MTLSTATUS return_code;
+
+	if ((stream == NULL) || (data_value == NULL) || (stream->append)
+	    || (stream->state == NULL)) {
+		LOG_ERROR("NULL Input Pointers");
+		mtl_hash_stream_free(stream);
+		return MTL_NULL_PTR;
+	}
+
+	return_code = stream->ctx->hash_msg_final(stream->state, data_value,
+						  stream->ctx->nodes.hash_size);
+	stream->state = NULL;
+	mtl_hash_stream_free(stream);
+	if (return_code != MTL_OK) {
+		LOG_ERROR("Unable to hash message");
+		return MTL_ERROR;
+	}
+	return MTL_OK;
+}
+
 /*****************************************************************
 * Create buffer for ladder including address separation scheme
 ******************************************************************
@@ -274,7 +1192,7 @@ MTLSTATUS mtl_hash_and_verify(MTL_CTX * ctx, uint8_t * message,
  * @param oid_len: length of the oid in bytes
  * @return buffer size
  */
-uint32_t mtl_get_scheme_separated_buffer(MTL_CTX * ctx, LADDER * ladder,
+uint32_t mtl_get_scheme_separated_buffer(MTL_CTX * ctx, const LADDER * ladder,
 					 uint32_t hash_size, uint8_t ** buffer, uint8_t* oid,
 					 size_t oid_len)
 {
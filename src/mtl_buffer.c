@@ -288,7 +288,7 @@ uint32_t mtl_ladder_from_buffer(char *buffer, size_t buffer_size,
  * @param buffer:     Pointer to where the buffer is created
  * @return size of the ladder buffer in bytes
  */
-uint32_t mtl_ladder_to_buffer(LADDER * ladder, uint32_t hash_size,
+uint32_t mtl_ladder_to_buffer(const LADDER * ladder, uint32_t hash_size,
 			      uint8_t ** buffer)
 {
 	uint32_t sig_size;
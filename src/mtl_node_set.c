@@ -46,7 +46,6 @@
  */
 void mtl_node_set_init(MTLNODES * nodes, SEED *seed, SERIESID * sid)
 {
-	uint16_t index;
 	// Reserved for future needs
 	sid = sid;
 
@@ -56,16 +55,348 @@ void mtl_node_set_init(MTLNODES * nodes, SEED *seed, SERIESID * sid)
 	}
 
 	nodes->leaf_count = 0;
+	nodes->published_count = 0;
 	nodes->hash_size = seed->length;
-	nodes->tree_page_size = MTL_TREE_PAGE_SIZE;
-	// Initalize the tree pages
-	for (index = 0; index < MTL_TREE_MAX_PAGES; index++) {
-		nodes->tree_pages[index] = NULL;
+	// Page directories are allocated on demand as nodes are inserted
+	nodes->tree_pages = NULL;
+	nodes->tree_page_count = 0;
+	nodes->randomizer_pages = NULL;
+	nodes->randomizer_page_count = 0;
+	nodes->retired_directories = NULL;
+	nodes->retired_count = 0;
+	nodes->tree_page_size = 0;
+	nodes->max_pages = 0;
+	nodes->layout = MTL_NODE_SET_LAYOUT_LINEAR;
+	nodes->tile_height = 0;
+	nodes->slot_size = nodes->hash_size;
+	mtl_node_set_set_geometry(nodes, 0, 0);
+}
+
+/*****************************************************************
+*  MTL node set function to select the page geometry of a MTLNS
+******************************************************************
+ * @param nodes: Pointer to MTL node context to configure
+ * @param page_size: Page size in bytes (0 for MTL_TREE_PAGE_SIZE)
+ * @param max_pages: Maximum number of pages (0 for MTL_TREE_MAX_PAGES)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_set_geometry(MTLNODES * nodes, uint32_t page_size,
+				    uint32_t max_pages)
+{
+	if (nodes == NULL) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_NULL_PTR;
+	}
+	if ((nodes->leaf_count != 0) || (nodes->tree_page_count != 0) ||
+	    (nodes->randomizer_page_count != 0)) {
+		LOG_ERROR("Geometry can only be set on an empty node set");
+		return MTL_ERROR;
+	}
+	if (page_size == 0) {
+		page_size = MTL_TREE_PAGE_SIZE;
+	}
+	if (max_pages == 0) {
+		max_pages = MTL_TREE_MAX_PAGES;
+	}
+	if ((nodes->hash_size == 0) || (page_size < nodes->hash_size)) {
+		LOG_ERROR("Page size is smaller than a node hash");
+		return MTL_BAD_PARAM;
+	}
+
+	// Blocked layout pages must hold at least one whole tile
+	if ((nodes->layout == MTL_NODE_SET_LAYOUT_BLOCKED) &&
+	    (page_size - (page_size % nodes->hash_size) <
+	     ((uint64_t)nodes->slot_size << nodes->tile_height))) {
+		LOG_ERROR("Page size is smaller than a node set tile");
+		return MTL_BAD_PARAM;
+	}
+
+	// Pages hold a whole number of hashes so none straddle a page end
+	nodes->tree_page_size = page_size - (page_size % nodes->hash_size);
+	nodes->max_pages = max_pages;
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  MTL node set function to select the tree page layout of a MTLNS
+******************************************************************
+ * @param nodes: Pointer to MTL node context to configure
+ * @param layout: MTL_NODE_SET_LAYOUT_LINEAR or MTL_NODE_SET_LAYOUT_BLOCKED
+ * @param tile_height: Levels per tile for the blocked layout
+ *                     (0 for the largest tile within MTL_NODE_SET_TILE_SIZE)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_set_layout(MTLNODES * nodes, uint8_t layout,
+				  uint8_t tile_height)
+{
+	uint16_t slot_size;
+
+	if (nodes == NULL) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_NULL_PTR;
+	}
+	if ((nodes->leaf_count != 0) || (nodes->tree_page_count != 0) ||
+	    (nodes->randomizer_page_count != 0)) {
+		LOG_ERROR("Layout can only be set on an empty node set");
+		return MTL_ERROR;
+	}
+	if (nodes->hash_size == 0) {
+		LOG_ERROR("Node set has no hash size");
+		return MTL_BAD_PARAM;
+	}
+
+	if (layout == MTL_NODE_SET_LAYOUT_LINEAR) {
+		nodes->layout = layout;
+		nodes->tile_height = 0;
+		nodes->slot_size = nodes->hash_size;
+		return MTL_OK;
+	}
+	if (layout != MTL_NODE_SET_LAYOUT_BLOCKED) {
+		LOG_ERROR("Unknown node set layout");
+		return MTL_BAD_PARAM;
+	}
+
+	// Power of two slots never straddle a cache line
+	slot_size = 1;
+	while (slot_size < nodes->hash_size) {
+		slot_size <<= 1;
+	}
+	if (tile_height == 0) {
+		tile_height = 1;
+		while (((uint32_t) slot_size << (tile_height + 1)) <=
+		       MTL_NODE_SET_TILE_SIZE) {
+			tile_height++;
+		}
+	}
+	if (tile_height > MTL_NODE_SET_MAX_TILE_HEIGHT) {
+		LOG_ERROR("Tile height out of range");
+		return MTL_BAD_PARAM;
 	}
-	// Initalize the randomizer pages
-	for (index = 0; index < MTL_TREE_RANDOMIZER_PAGES; index++) {
-		nodes->randomizer_pages[index] = NULL;
+	if (((uint64_t)slot_size << tile_height) > nodes->tree_page_size) {
+		LOG_ERROR("Page size is smaller than a node set tile");
+		return MTL_BAD_PARAM;
 	}
+
+	nodes->layout = layout;
+	nodes->tile_height = tile_height;
+	nodes->slot_size = slot_size;
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  Keep a replaced page directory until the MTLNS is freed
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param directory: page directory that is being replaced
+ * @return MTL_OK if successful
+ */
+static MTLSTATUS mtl_node_set_retire(MTLNODES * nodes, uint8_t ** directory)
+{
+	uint8_t ***retired;
+
+	if (directory == NULL) {
+		return MTL_OK;
+	}
+	retired = realloc(nodes->retired_directories,
+			  (nodes->retired_count + 1) * sizeof(uint8_t **));
+	if (retired == NULL) {
+		LOG_ERROR("Unable to allocate memory");
+		return MTL_RESOURCE_FAIL;
+	}
+	retired[nodes->retired_count] = directory;
+	nodes->retired_directories = retired;
+	nodes->retired_count++;
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  Get (allocating if needed) a tree or randomizer page of a MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param page: index of the page to get
+ * @param randomizer: 0 for a tree page, 1 for a randomizer page
+ * @param page_ptr: pointer to fill with the page address
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_alloc_page(MTLNODES * nodes, uint32_t page,
+				  uint8_t randomizer, uint8_t ** page_ptr)
+{
+	uint8_t ***pages;
+	uint32_t *page_count;
+	uint8_t **directory;
+	uint8_t *buffer = NULL;
+	uint64_t count;
+	size_t alignment;
+
+	if ((nodes == NULL) || (page_ptr == NULL)) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_NULL_PTR;
+	}
+	if (page >= nodes->max_pages) {
+		LOG_ERROR("Tree entry out of range");
+		return MTL_BAD_PARAM;
+	}
+
+	if (randomizer) {
+		pages = &nodes->randomizer_pages;
+		page_count = &nodes->randomizer_page_count;
+	} else {
+		pages = &nodes->tree_pages;
+		page_count = &nodes->tree_page_count;
+	}
+
+	// Grow the page directory geometrically up to the configured limit,
+	// the old one is retired since readers may still be walking it.
+	// The count is doubled in 64 bits so it cannot wrap past 2^31 pages
+	if (page >= *page_count) {
+		count = (*page_count > 0) ? *page_count : 1;
+		while (count <= page) {
+			count *= 2;
+		}
+		if (count > nodes->max_pages) {
+			count = nodes->max_pages;
+		}
+		if (count > SIZE_MAX / sizeof(uint8_t *)) {
+			LOG_ERROR("Unable to allocate memory");
+			return MTL_RESOURCE_FAIL;
+		}
+		// Zeroed by calloc, so the unused tail of a large
+		// directory is not touched until its pages are added
+		directory = calloc((size_t)count, sizeof(uint8_t *));
+		if (directory == NULL) {
+			LOG_ERROR("Unable to allocate memory");
+			return MTL_RESOURCE_FAIL;
+		}
+		if (*page_count > 0) {
+			memcpy(directory, *pages, *page_count * sizeof(uint8_t *));
+		}
+		if (mtl_node_set_retire(nodes, *pages) != MTL_OK) {
+			free(directory);
+			return MTL_RESOURCE_FAIL;
+		}
+		// Readers load the count first, so they never index past
+		// the end of the directory they load after it
+		__atomic_store_n(pages, directory, __ATOMIC_RELEASE);
+		__atomic_store_n(page_count, (uint32_t)count, __ATOMIC_RELEASE);
+	}
+
+	if ((*pages)[page] != NULL) {
+		*page_ptr = (*pages)[page];
+		return MTL_OK;
+	}
+
+	// Add a new page, zeroed before readers can find it
+	if (nodes->layout == MTL_NODE_SET_LAYOUT_BLOCKED) {
+		// Align blocked pages so tiles start on a cache line
+		// (and on a memory page when they are that large)
+		alignment = (size_t)nodes->slot_size << nodes->tile_height;
+		if (alignment < MTL_NODE_SET_CACHE_LINE) {
+			alignment = MTL_NODE_SET_CACHE_LINE;
+		}
+		if (alignment > MTL_NODE_SET_TILE_SIZE) {
+			alignment = MTL_NODE_SET_TILE_SIZE;
+		}
+		if (posix_memalign((void **)&buffer, alignment,
+				   nodes->tree_page_size) != 0) {
+			LOG_ERROR("Unable to allocate memory");
+			return MTL_RESOURCE_FAIL;
+		}
+		memset(buffer, 0, nodes->tree_page_size);
+	} else {
+		buffer = calloc(1, nodes->tree_page_size);
+		if (buffer == NULL) {
+			LOG_ERROR("Unable to allocate memory");
+			return MTL_RESOURCE_FAIL;
+		}
+	}
+	__atomic_store_n(&(*pages)[page], buffer, __ATOMIC_RELEASE);
+
+	*page_ptr = buffer;
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  Find an allocated tree or randomizer page of a MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param page: index of the page to find
+ * @param randomizer: 0 for a tree page, 1 for a randomizer page
+ * @return page address, NULL if the page is not allocated
+ */
+static const uint8_t *mtl_node_set_find_page(MTLNODES * nodes, uint32_t page,
+					     uint8_t randomizer)
+{
+	uint8_t **directory;
+	uint32_t count;
+
+	// Load the count before the directory (see mtl_node_set_alloc_page)
+	if (randomizer) {
+		count = __atomic_load_n(&nodes->randomizer_page_count,
+					__ATOMIC_ACQUIRE);
+		directory = __atomic_load_n(&nodes->randomizer_pages,
+					    __ATOMIC_ACQUIRE);
+	} else {
+		count = __atomic_load_n(&nodes->tree_page_count,
+					__ATOMIC_ACQUIRE);
+		directory = __atomic_load_n(&nodes->tree_pages,
+					    __ATOMIC_ACQUIRE);
+	}
+	if (page >= count) {
+		return NULL;
+	}
+	return __atomic_load_n(&directory[page], __ATOMIC_ACQUIRE);
+}
+
+/*****************************************************************
+*  Set the leaf count of a MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param leaf_count: new leaf count
+ * @return none
+ */
+void mtl_node_set_set_leaf_count(MTLNODES * nodes, uint64_t leaf_count)
+{
+	if (nodes == NULL) {
+		LOG_ERROR("Null parameters provided");
+		return;
+	}
+	__atomic_store_n(&nodes->leaf_count, leaf_count, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************
+*  Publish a leaf count to threads reading the MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param leaf_count: number of leaves whose nodes are all written
+ * @return none
+ */
+void mtl_node_set_publish(MTLNODES * nodes, uint64_t leaf_count)
+{
+	if (nodes == NULL) {
+		LOG_ERROR("Null parameters provided");
+		return;
+	}
+	// Release so the node writes are visible before the new count
+	if (leaf_count > nodes->published_count) {
+		__atomic_store_n(&nodes->published_count, leaf_count,
+				 __ATOMIC_RELEASE);
+	}
+}
+
+/*****************************************************************
+*  Get the leaf count published to threads reading the MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @return published leaf count (0 on error)
+ */
+uint64_t mtl_node_set_published(MTLNODES * nodes)
+{
+	if (nodes == NULL) {
+		LOG_ERROR("Null parameters provided");
+		return 0;
+	}
+	return __atomic_load_n(&nodes->published_count, __ATOMIC_ACQUIRE);
 }
 
 /*****************************************************************
@@ -76,30 +407,136 @@ void mtl_node_set_init(MTLNODES * nodes, SEED *seed, SERIESID * sid)
  */
 void mtl_node_set_free(MTLNODES * nodes)
 {
-	uint16_t index;
+	uint32_t index;
 
 	if (nodes == NULL) {
 		return;
 	}
 	// Free the tree pages
-	for (index = 0; index < MTL_TREE_MAX_PAGES; index++) {
-		if (nodes->tree_pages[index] != NULL) {
-			free(nodes->tree_pages[index]);
-			nodes->tree_pages[index] = NULL;
-		}
+	for (index = 0; index < nodes->tree_page_count; index++) {
+		free(nodes->tree_pages[index]);
 	}
+	free(nodes->tree_pages);
+	nodes->tree_pages = NULL;
+	nodes->tree_page_count = 0;
 
 	// Free the randomizer pages
-	for (index = 0; index < MTL_TREE_RANDOMIZER_PAGES; index++) {
-		if (nodes->randomizer_pages[index] != NULL) {
-			free(nodes->randomizer_pages[index]);
-			nodes->randomizer_pages[index] = NULL;
-		}
+	for (index = 0; index < nodes->randomizer_page_count; index++) {
+		free(nodes->randomizer_pages[index]);
+	}
+	free(nodes->randomizer_pages);
+	nodes->randomizer_pages = NULL;
+	nodes->randomizer_page_count = 0;
+
+	// Free the page directories replaced while the set grew
+	for (index = 0; index < nodes->retired_count; index++) {
+		free(nodes->retired_directories[index]);
 	}
+	free(nodes->retired_directories);
+	nodes->retired_directories = NULL;
+	nodes->retired_count = 0;
 
 	nodes->leaf_count = 0;
+	nodes->published_count = 0;
 	nodes->hash_size = 0;
 	nodes->tree_page_size = 0;
+	nodes->max_pages = 0;
+	nodes->layout = MTL_NODE_SET_LAYOUT_LINEAR;
+	nodes->tile_height = 0;
+	nodes->slot_size = 0;
+}
+
+/*****************************************************************
+*  Number of blocked layout tiles of one band for a leaf count
+******************************************************************
+ * @param tile_height: levels per tile
+ * @param band: band of tiles (band b holds levels b*k to b*k+k-1)
+ * @param leaf_count: number of leaves inserted
+ * @return number of tiles of the band holding at least one node
+ */
+static uint64_t mtl_node_set_band_tiles(uint32_t tile_height, uint32_t band,
+					uint64_t leaf_count)
+{
+	uint64_t nodes;
+
+	// Complete nodes on the lowest level of the band
+	nodes = leaf_count >> (band * tile_height);
+	if (nodes == 0) {
+		return 0;
+	}
+	return ((nodes - 1) >> (tile_height - 1)) + 1;
+}
+
+/*****************************************************************
+*  Locate the page and offset holding a node of the MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param left: left index of the node
+ * @param right: right index of the node
+ * @param page: pointer to fill with the tree page index
+ * @param offset: pointer to fill with the byte offset in the page
+ * @return MTL_OK if successful, MTL_BAD_PARAM if not a valid node
+ */
+static MTLSTATUS mtl_node_set_locate(MTLNODES * nodes, uint32_t left,
+				     uint32_t right, uint32_t * page,
+				     uint64_t * offset)
+{
+	uint64_t index;
+	uint32_t tile_height;
+	uint32_t height;
+	uint32_t band;
+	uint32_t other;
+	uint32_t depth;
+	uint32_t position;
+	uint32_t tile_position;
+	uint64_t created;
+	uint64_t tile = 0;
+	uint64_t tile_size;
+	uint64_t tiles_per_page;
+
+	if (mtl_node_set_int_node_id(left, right, &index) != MTL_OK) {
+		return MTL_BAD_PARAM;
+	}
+	if (nodes->layout != MTL_NODE_SET_LAYOUT_BLOCKED) {
+		if (index * nodes->hash_size / nodes->tree_page_size >=
+		    nodes->max_pages) {
+			return MTL_BAD_PARAM;
+		}
+		*page = (index * nodes->hash_size) / nodes->tree_page_size;
+		*offset = (index * nodes->hash_size) % nodes->tree_page_size;
+		return MTL_OK;
+	}
+
+	// Band b tiles are complete subtrees of tile_height levels whose
+	// lowest level is b * tile_height, stored as a 1-based heap
+	tile_height = nodes->tile_height;
+	height = mtl_msb((uint64_t)right - left + 1);
+	band = height / tile_height;
+	depth = tile_height - 1 - (height - band * tile_height);
+	position = left >> height;
+	tile_position = position >> depth;
+
+	// Tiles are numbered in the order their first node is inserted,
+	// lower bands first, so the tiles in use are always a dense prefix
+	created = (((uint64_t)tile_position << (tile_height - 1)) + 1)
+	    << (band * tile_height);
+	for (other = 0; other * tile_height <= 32; other++) {
+		tile += mtl_node_set_band_tiles(tile_height, other,
+						(other <= band) ? created :
+						created - 1);
+	}
+	tile--;
+
+	tile_size = (uint64_t)nodes->slot_size << tile_height;
+	tiles_per_page = nodes->tree_page_size / tile_size;
+	if (tile / tiles_per_page >= nodes->max_pages) {
+		return MTL_BAD_PARAM;
+	}
+	*page = tile / tiles_per_page;
+	*offset = ((tile % tiles_per_page) * tile_size) +
+	    ((((uint64_t)1 << depth) + position -
+	      ((uint64_t)tile_position << depth)) * nodes->slot_size);
+	return MTL_OK;
 }
 
 /*****************************************************************
@@ -114,42 +551,36 @@ void mtl_node_set_free(MTLNODES * nodes)
 MTLSTATUS mtl_node_set_insert(MTLNODES * nodes, uint32_t left, uint32_t right,
 			    uint8_t * hash)
 {
-	uint32_t index;
-	uint16_t page;
+	uint32_t page;
 	uint64_t offset;
+	uint8_t *buffer;
+	MTLSTATUS result;
 
 	if ((nodes == NULL) || (hash == NULL)) {
 		LOG_ERROR("Null parameters provided");
 		return MTL_BAD_PARAM;
 	}
 
-	if (mtl_node_set_int_node_id(left, right, &index) != MTL_OK)
+	if (mtl_node_set_locate(nodes, left, right, &page, &offset) != MTL_OK)
 	{
 		LOG_ERROR("Attempted to insert invalid node");
 		return MTL_BAD_PARAM;
 	}
-	page = (index * nodes->hash_size) / nodes->tree_page_size;
-	offset = (index * nodes->hash_size) % nodes->tree_page_size;
 
-	if (page >= MTL_TREE_MAX_PAGES) {
-		LOG_ERROR("Tree entry out of range");
-		return MTL_BAD_PARAM;
-	}
-	// Add a new tree page if memory is not already allocated
-	if (nodes->tree_pages[page] == NULL) {
-		nodes->tree_pages[page] = calloc(1, nodes->tree_page_size);
-		if (nodes->tree_pages[page] == NULL) {
-			LOG_ERROR("Unable to allocate memory");
-			return MTL_RESOURCE_FAIL;
-		}
+	result = mtl_node_set_alloc_page(nodes, page, 0, &buffer);
+	if (result != MTL_OK) {
+		return result;
 	}
 
-	uint8_t *buffer = nodes->tree_pages[page] + offset;
-	memcpy(buffer, hash, nodes->hash_size);
+	memcpy(buffer + offset, hash, nodes->hash_size);
 
 	// Update leaf count
 	// We assume all nodes lower than current leaf are added atomically
-	nodes-> leaf_count = right+1 > nodes->leaf_count ? right+1 : nodes->leaf_count;
+	// (only written when it grows so parallel rebuilds never store to it)
+	if ((uint64_t)right + 1 >
+	    __atomic_load_n(&nodes->leaf_count, __ATOMIC_RELAXED)) {
+		mtl_node_set_set_leaf_count(nodes, (uint64_t)right + 1);
+	}
 
 	return MTL_OK;
 }
@@ -165,9 +596,11 @@ MTLSTATUS mtl_node_set_insert(MTLNODES * nodes, uint32_t left, uint32_t right,
 MTLSTATUS mtl_node_set_insert_randomizer(MTLNODES * nodes,
 				       uint32_t leaf_index, uint8_t * rand)
 {
-	uint16_t page;
+	uint32_t page;
 	uint64_t offset;
-	uint32_t index;
+	uint64_t index;
+	uint8_t *buffer;
+	MTLSTATUS result;
 
 	if ((nodes == NULL) || (rand == NULL)) {
 		LOG_ERROR("Null parameters provided");
@@ -179,91 +612,124 @@ MTLSTATUS mtl_node_set_insert_randomizer(MTLNODES * nodes,
 		return MTL_BAD_PARAM;
 	}
 
-	page = (leaf_index * nodes->hash_size) / nodes->tree_page_size;
-	offset = (leaf_index * nodes->hash_size) % nodes->tree_page_size;
-
-	if (page >= MTL_TREE_RANDOMIZER_PAGES) {
-		LOG_ERROR("Tree entry out of range");
+	if ((uint64_t)leaf_index * nodes->hash_size / nodes->tree_page_size >=
+	    nodes->max_pages) {
+		LOG_ERROR("Randomizer entry out of range");
 		return MTL_BAD_PARAM;
 	}
+	page = ((uint64_t)leaf_index * nodes->hash_size) / nodes->tree_page_size;
+	offset = ((uint64_t)leaf_index * nodes->hash_size) % nodes->tree_page_size;
 
-	if (nodes->randomizer_pages[page] == NULL) {
-		nodes->randomizer_pages[page] =
-		    calloc(1, nodes->tree_page_size);
-		if (nodes->randomizer_pages[page] == NULL) {
-			LOG_ERROR("Unable to allocate memory");
-			return MTL_RESOURCE_FAIL;
-		}
+	result = mtl_node_set_alloc_page(nodes, page, 1, &buffer);
+	if (result != MTL_OK) {
+		return result;
 	}
 
-	uint8_t *buffer = nodes->randomizer_pages[page] + offset;
-	memcpy(buffer, rand, nodes->hash_size);
+	memcpy(buffer + offset, rand, nodes->hash_size);
 
 	return MTL_OK;
 }
 
 /*****************************************************************
-*  Fetch the node hash for a given index from the MTLNS
+*  Fetch a reference to the node hash for a given index from the MTLNS
 ******************************************************************
  * @param nodes: Pointer to the MTLNS structure
  * @param left: left index of the node to fetch
  * @param right: right index of the node to fetch
- * @param hash: pointer to fill with the hash value (caller must free)
+ * @param hash: pointer to fill with the address of the hash value
+ *              inside the node set (caller must not free, only valid
+ *              until the next insert or free of the node set)
  * @return MTL_OK if successful
  */
-MTLSTATUS mtl_node_set_fetch(MTLNODES * nodes, uint32_t left, uint32_t right,
-			   uint8_t ** hash)
+MTLSTATUS mtl_node_set_fetch_ref(MTLNODES * nodes, uint32_t left,
+			       uint32_t right, const uint8_t ** hash)
 {
 	if ((nodes == NULL) || (hash == NULL)) {
 		LOG_ERROR("Null parameters provided");
 		return MTL_BAD_PARAM;
 	}
 
-	uint32_t index;
-	if (mtl_node_set_int_node_id(left, right, &index) != MTL_OK)
+	uint32_t page;
+	uint64_t offset;
+	const uint8_t *buffer;
+	if (mtl_node_set_locate(nodes, left, right, &page, &offset) != MTL_OK)
 	{
 		LOG_ERROR("Attempted to fetch invalid node");
 		return MTL_BAD_PARAM;
 	}
-	if (right+1 > nodes->leaf_count)
+	if ((uint64_t)right + 1 >
+	    __atomic_load_n(&nodes->leaf_count, __ATOMIC_RELAXED))
 	{
 		LOG_ERROR("Attempted to fetch node before insert");
 		return MTL_ERROR;
 	}
-	uint16_t page = (index * nodes->hash_size) / nodes->tree_page_size;
-	uint64_t offset = (index * nodes->hash_size) % nodes->tree_page_size;
 
 	// Check that the page exists
-	if ((page >= MTL_TREE_MAX_PAGES) || (nodes->tree_pages[page] == NULL)) {
+	buffer = mtl_node_set_find_page(nodes, page, 0);
+	if (buffer == NULL) {
 		*hash = NULL;
 		LOG_ERROR("Null parameters provided");
 		return MTL_BAD_PARAM;
 	}
 
+	*hash = buffer + offset;
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  Fetch the node hash for a given index from the MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param left: left index of the node to fetch
+ * @param right: right index of the node to fetch
+ * @param hash: pointer to fill with the hash value (caller must free)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_fetch(MTLNODES * nodes, uint32_t left, uint32_t right,
+			   uint8_t ** hash)
+{
+	const uint8_t *buffer = NULL;
+	MTLSTATUS result;
+
+	if ((nodes == NULL) || (hash == NULL)) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_BAD_PARAM;
+	}
+
+	result = mtl_node_set_fetch_ref(nodes, left, right, &buffer);
+	if (result != MTL_OK) {
+		if (result == MTL_BAD_PARAM) {
+			*hash = NULL;
+		}
+		return result;
+	}
+
 	*hash = malloc(nodes->hash_size);
 	if (*hash == NULL) {
 		LOG_ERROR("Unable to allocate memory");
 		return MTL_RESOURCE_FAIL;
 	}
-	uint8_t *buffer = nodes->tree_pages[page] + offset;
 	memcpy(*hash, buffer, nodes->hash_size);
 	return MTL_OK;
 }
 
 /*****************************************************************
-*  Fetch the randomizer for a given index from the MTLNS
+*  Fetch a reference to the randomizer for a given index from the MTLNS
 ******************************************************************
  * @param nodes: Pointer to the MTLNS structure
  * @param leaf: leaf index of the randomizer to fetch
- * @param rand: pointer to fill with the hash value (caller must free)
+ * @param rand: pointer to fill with the address of the randomizer
+ *              inside the node set (caller must not free, only valid
+ *              until the next insert or free of the node set)
  * @return MTL_OK if successful
  */
-MTLSTATUS mtl_node_set_get_randomizer(MTLNODES * nodes, uint32_t leaf,
-				    uint8_t ** rand)
+MTLSTATUS mtl_node_set_get_randomizer_ref(MTLNODES * nodes, uint32_t leaf,
+					const uint8_t ** rand)
 {
-	uint16_t page;
+	uint32_t page;
 	uint64_t offset;
-	uint32_t index;
+	uint64_t index;
+	const uint8_t *buffer;
 
 	if ((nodes == NULL) || (rand == NULL)) {
 		LOG_ERROR("Null parameters provided");
@@ -275,33 +741,318 @@ MTLSTATUS mtl_node_set_get_randomizer(MTLNODES * nodes, uint32_t leaf,
 		return MTL_BAD_PARAM;
 	}
 	// We assume leaves and their randomizers are set at the same time
-	if (leaf+1 > nodes->leaf_count)
+	if ((uint64_t)leaf + 1 >
+	    __atomic_load_n(&nodes->leaf_count, __ATOMIC_RELAXED))
 	{
 		LOG_ERROR("Attempted to fetch randomizer before insert");
 		return MTL_ERROR;
 	}
 
 	*rand = NULL;
-	page = (leaf * nodes->hash_size) / nodes->tree_page_size;
-	offset = (leaf * nodes->hash_size) % nodes->tree_page_size;
+	page = ((uint64_t)leaf * nodes->hash_size) / nodes->tree_page_size;
+	offset = ((uint64_t)leaf * nodes->hash_size) % nodes->tree_page_size;
 
 	// Check that the page exists
-	if ((page >= MTL_TREE_RANDOMIZER_PAGES)
-	    || (nodes->randomizer_pages[page] == NULL)) {
+	buffer = mtl_node_set_find_page(nodes, page, 1);
+	if (buffer == NULL) {
 		LOG_ERROR("Invalid id provided");
 		return MTL_ERROR;
 	}
 
+	*rand = buffer + offset;
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  Fetch the randomizer for a given index from the MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param leaf: leaf index of the randomizer to fetch
+ * @param rand: pointer to fill with the hash value (caller must free)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_get_randomizer(MTLNODES * nodes, uint32_t leaf,
+				    uint8_t ** rand)
+{
+	const uint8_t *buffer = NULL;
+	MTLSTATUS result;
+
+	if ((nodes == NULL) || (rand == NULL)) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_BAD_PARAM;
+	}
+
+	result = mtl_node_set_get_randomizer_ref(nodes, leaf, &buffer);
+	if (result != MTL_OK) {
+		if (result == MTL_ERROR) {
+			*rand = NULL;
+		}
+		return result;
+	}
+
 	*rand = malloc(nodes->hash_size);
 	if (*rand == NULL) {
 		LOG_ERROR_WITH_CODE("mtl_node_set_get_randomizer",MTL_NULL_PTR);
+		return MTL_RESOURCE_FAIL;
 	}
-	uint8_t *buffer = nodes->randomizer_pages[page] + offset;
 	memcpy(*rand, buffer, nodes->hash_size);
 
 	return MTL_OK;
 }
 
+/*****************************************************************
+*  Number of nodes held in the MTLNS for a leaf count
+******************************************************************
+ * @param leaf_count: number of leaves in the node set
+ * @return number of nodes stored in the linear node array
+ */
+uint64_t mtl_node_set_node_count(uint64_t leaf_count)
+{
+	return (2 * leaf_count) - mtl_bit_width(leaf_count);
+}
+
+/*****************************************************************
+*  Number of tree pages needed to hold every node for a leaf count
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param leaf_count: number of leaves in the node set
+ * @return number of tree pages
+ */
+uint64_t mtl_node_set_page_count(MTLNODES * nodes, uint64_t leaf_count)
+{
+	uint64_t tile_size;
+	uint64_t tiles_per_page;
+	uint64_t tiles = 0;
+	uint32_t band;
+
+	if ((nodes == NULL) || (nodes->tree_page_size == 0)) {
+		return 0;
+	}
+	if (nodes->layout != MTL_NODE_SET_LAYOUT_BLOCKED) {
+		return ((mtl_node_set_node_count(leaf_count) * nodes->hash_size)
+			+ nodes->tree_page_size - 1) / nodes->tree_page_size;
+	}
+
+	tile_size = (uint64_t)nodes->slot_size << nodes->tile_height;
+	tiles_per_page = nodes->tree_page_size / tile_size;
+	for (band = 0; band * nodes->tile_height <= 32; band++) {
+		tiles += mtl_node_set_band_tiles(nodes->tile_height, band,
+						 leaf_count);
+	}
+	return (tiles + tiles_per_page - 1) / tiles_per_page;
+}
+
+/*****************************************************************
+*  Copy every node between a linear buffer and a blocked MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param buffer: linear post-order buffer to copy to or from
+ * @param leaf_count: number of leaves represented by the buffer
+ * @param import: 1 to copy the buffer into the node set, 0 to copy out
+ * @return MTL_OK if successful
+ */
+static MTLSTATUS mtl_node_set_copy_nodes(MTLNODES * nodes, uint8_t * buffer,
+					 uint64_t leaf_count, uint8_t import)
+{
+	uint8_t *node = buffer;
+	const uint8_t *hash;
+	uint64_t right;
+	uint32_t height;
+	uint32_t left;
+	MTLSTATUS result;
+
+	// Post-order visits each leaf then every subtree it completes
+	for (right = 0; right < leaf_count; right++) {
+		for (height = 0; height <= mtl_lsb(right + 1); height++) {
+			left = (uint32_t)(right + 1 - ((uint64_t)1 << height));
+			if (import) {
+				result = mtl_node_set_insert(nodes, left, right,
+							     node);
+			} else {
+				result = mtl_node_set_fetch_ref(nodes, left,
+								right, &hash);
+				if (result == MTL_OK) {
+					memcpy(node, hash, nodes->hash_size);
+				}
+			}
+			if (result != MTL_OK) {
+				return result;
+			}
+			node += nodes->hash_size;
+		}
+	}
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  Copy a linear byte range between a buffer and the MTLNS pages
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param randomizer: 0 for the tree pages, 1 for the randomizer pages
+ * @param buffer: linear buffer to copy to or from
+ * @param length: number of bytes to copy
+ * @param import: 1 to copy the buffer into the pages, 0 to copy out
+ * @return MTL_OK if successful
+ */
+static MTLSTATUS mtl_node_set_copy_pages(MTLNODES * nodes, uint8_t randomizer,
+					 uint8_t * buffer, uint64_t length,
+					 uint8_t import)
+{
+	uint8_t **pages;
+	uint32_t page_count;
+	uint8_t *page_ptr;
+	uint32_t page = 0;
+	uint64_t offset = 0;
+	uint64_t chunk;
+	MTLSTATUS result;
+
+	if (randomizer) {
+		pages = nodes->randomizer_pages;
+		page_count = nodes->randomizer_page_count;
+	} else {
+		pages = nodes->tree_pages;
+		page_count = nodes->tree_page_count;
+	}
+
+	while (offset < length) {
+		chunk = length - offset;
+		if (chunk > nodes->tree_page_size) {
+			chunk = nodes->tree_page_size;
+		}
+
+		if (import) {
+			result = mtl_node_set_alloc_page(nodes, page, randomizer,
+							 &page_ptr);
+			if (result != MTL_OK) {
+				return result;
+			}
+			memcpy(page_ptr, buffer + offset, chunk);
+		} else {
+			if ((page >= page_count) || (pages[page] == NULL)) {
+				LOG_ERROR("Missing node set page");
+				return MTL_ERROR;
+			}
+			memcpy(buffer + offset, pages[page], chunk);
+		}
+
+		offset += chunk;
+		page++;
+	}
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+*  Copy the nodes (and optionally randomizers) of the first
+*  leaves out of a MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param leaf_count: number of leaves to copy (at most nodes->leaf_count)
+ * @param tree: buffer for mtl_node_set_node_count(leaf_count) hashes
+ * @param randomizers: buffer for leaf_count randomizers (NULL for none)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_export_leaves(MTLNODES * nodes, uint64_t leaf_count,
+				     uint8_t * tree, uint8_t * randomizers)
+{
+	MTLSTATUS result;
+
+	if ((nodes == NULL) || (tree == NULL)) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_NULL_PTR;
+	}
+	if (leaf_count > nodes->leaf_count) {
+		LOG_ERROR("Leaf count is past the end of the node set");
+		return MTL_BAD_PARAM;
+	}
+
+	if (nodes->layout == MTL_NODE_SET_LAYOUT_BLOCKED) {
+		result = mtl_node_set_copy_nodes(nodes, tree, leaf_count, 0);
+	} else {
+		result = mtl_node_set_copy_pages(nodes, 0, tree,
+						 mtl_node_set_node_count(leaf_count)
+						 * nodes->hash_size, 0);
+	}
+	if ((result == MTL_OK) && (randomizers != NULL)) {
+		result = mtl_node_set_copy_pages(nodes, 1, randomizers,
+						 leaf_count * nodes->hash_size,
+						 0);
+	}
+
+	return result;
+}
+
+/*****************************************************************
+*  Copy all nodes (and optionally randomizers) out of a MTLNS
+******************************************************************
+ * @param nodes: Pointer to the MTLNS structure
+ * @param tree: buffer for mtl_node_set_node_count(leaf_count) hashes
+ * @param randomizers: buffer for leaf_count randomizers (NULL for none)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_export(MTLNODES * nodes, uint8_t * tree,
+			      uint8_t * randomizers)
+{
+	if (nodes == NULL) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_NULL_PTR;
+	}
+	return mtl_node_set_export_leaves(nodes, nodes->leaf_count, tree,
+					  randomizers);
+}
+
+/*****************************************************************
+*  Bulk load all nodes (and optionally randomizers) into a MTLNS
+******************************************************************
+ * @param nodes: Pointer to the (empty) MTLNS structure
+ * @param leaf_count: number of leaves represented by the tree buffer
+ * @param tree: buffer of mtl_node_set_node_count(leaf_count) hashes
+ * @param randomizers: buffer of leaf_count randomizers (NULL for none)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_import(MTLNODES * nodes, uint64_t leaf_count,
+			      const uint8_t * tree,
+			      const uint8_t * randomizers)
+{
+	MTLSTATUS result;
+
+	if ((nodes == NULL) || (tree == NULL)) {
+		LOG_ERROR("Null parameters provided");
+		return MTL_NULL_PTR;
+	}
+	if ((nodes->leaf_count != 0) || (nodes->tree_page_count != 0) ||
+	    (nodes->randomizer_page_count != 0)) {
+		LOG_ERROR("Nodes can only be imported into an empty node set");
+		return MTL_ERROR;
+	}
+	if (leaf_count > (uint64_t)MTL_NODE_SET_MAX_LEAF + 1) {
+		LOG_ERROR("Leaf count out of range");
+		return MTL_BAD_PARAM;
+	}
+
+	if (nodes->layout == MTL_NODE_SET_LAYOUT_BLOCKED) {
+		result = mtl_node_set_copy_nodes(nodes, (uint8_t *) tree,
+						 leaf_count, 1);
+	} else {
+		result = mtl_node_set_copy_pages(nodes, 0, (uint8_t *) tree,
+						 mtl_node_set_node_count(leaf_count) *
+						 nodes->hash_size, 1);
+	}
+	if ((result == MTL_OK) && (randomizers != NULL)) {
+		result = mtl_node_set_copy_pages(nodes, 1, (uint8_t *) randomizers,
+						 (uint64_t)leaf_count *
+						 nodes->hash_size, 1);
+	}
+	if (result != MTL_OK) {
+		return result;
+	}
+
+	mtl_node_set_set_leaf_count(nodes, leaf_count);
+	mtl_node_set_publish(nodes, leaf_count);
+	return MTL_OK;
+}
+
 /*****************************************************************
 *  Determine if two leaves bound a complete subtree
 ******************************************************************
@@ -318,11 +1069,7 @@ MTLSTATUS mtl_node_is_valid_subtree(uint32_t left, uint32_t right)
 	{
 		return MTL_BAD_PARAM;
 	}
-	// Both indices must be valid leaf indices
-	if ( right > MTL_NODE_SET_MAX_LEAF || left > MTL_NODE_SET_MAX_LEAF )
-	{
-		return MTL_BAD_PARAM;
-	}
+	// Every 32 bit index is a valid leaf index (MTL_NODE_SET_MAX_LEAF)
 	// Subtree is defined by a common prefix
 	prefix_bitmask = 0xffffffff;
 	for (i = 0; i < 32; i++)
@@ -332,7 +1079,7 @@ MTLSTATUS mtl_node_is_valid_subtree(uint32_t left, uint32_t right)
 			break;
 		}
 		// remove bits on the right until the prefixes match
-		prefix_bitmask -= (1 << i);
+		prefix_bitmask -= ((uint32_t)1 << i);
 	}
 	// Leftmost node of subtree is all 0 after prefix; rightmost is all 1
 	postfix_bitmask = ~prefix_bitmask;
@@ -355,7 +1102,7 @@ MTLSTATUS mtl_node_is_valid_subtree(uint32_t left, uint32_t right)
  * @return MTL_OK if successful, and *return_index set
  * 			MTL_ERROR if <left,right> is not a valid node
  */
-MTLSTATUS mtl_node_set_int_node_id(uint32_t left, uint32_t right, uint32_t * return_index)
+MTLSTATUS mtl_node_set_int_node_id(uint32_t left, uint32_t right, uint64_t * return_index)
 {
 	if ( return_index == NULL ) 
 	{
@@ -369,8 +1116,10 @@ MTLSTATUS mtl_node_set_int_node_id(uint32_t left, uint32_t right, uint32_t * ret
 		return MTL_BAD_PARAM;
 	}
 	else {
-		*return_index =  2 * (right + 1) - mtl_bit_width(right + 1) 
-			- mtl_lsb(right + 1) + mtl_msb(right - left + 1) - 1;
+		*return_index =  2 * ((uint64_t)right + 1)
+			- mtl_bit_width((uint64_t)right + 1)
+			- mtl_lsb((uint64_t)right + 1)
+			+ mtl_msb((uint64_t)right - left + 1) - 1;
 	}
 	return MTL_OK;
 }
@@ -381,9 +1130,9 @@ MTLSTATUS mtl_node_set_int_node_id(uint32_t left, uint32_t right, uint32_t * ret
  * @param number: number to evaluate
  * @return number of 1's in the number
  */
-uint32_t mtl_bit_width(uint32_t number)
+uint32_t mtl_bit_width(uint64_t number)
 {
-	return __builtin_popcountl(number);
+	return __builtin_popcountll(number);
 }
 
 /*****************************************************************
@@ -392,9 +1141,9 @@ uint32_t mtl_bit_width(uint32_t number)
  * @param number: number to evaluate
  * @return index of the least significant bit
  */
-uint32_t mtl_lsb(uint32_t number)
+uint32_t mtl_lsb(uint64_t number)
 {
-	return __builtin_ffsl(number) - 1;
+	return __builtin_ffsll(number) - 1;
 }
 
 /*****************************************************************
@@ -403,9 +1152,9 @@ uint32_t mtl_lsb(uint32_t number)
  * @param number: number to evaluate
  * @return index of the most significant bit
  */
-uint32_t mtl_msb(uint32_t number)
+uint32_t mtl_msb(uint64_t number)
 {
 	if (number == 0)
 		return 0;
-	return (sizeof(uint32_t) * 8) - __builtin_clz(number) - 1;
+	return (sizeof(uint64_t) * 8) - __builtin_clzll(number) - 1;
 }
@@ -46,29 +46,45 @@
 #include "mtl_error.h"
 
 // Definition of constants used in this application
-/** Maximum tree pages allowed to be allocated 
- * \todo Make this configurable for each key set rather than library wide for future use.
+/** Default maximum tree pages allowed to be allocated for a node set
+ *  (see mtl_node_set_set_geometry to select a different value per key)
 */
 #define MTL_TREE_MAX_PAGES 8192
-/** Maximum tree pages size in bytes 
- * \todo Make this configurable for each key set rather than library wide for future use.
+/** Default tree page size in bytes for a node set
+ *  (see mtl_node_set_set_geometry to select a different value per key)
 */
 #define MTL_TREE_PAGE_SIZE 1048576L
-/** Maximum randomizer pages allowed to be allocated
- * \todo Make this configurable for each key set rather than library wide for future use.
+/** Default maximum randomizer pages allowed to be allocated for a node set
+ *  (randomizer pages always use the same limit as the tree pages)
 */
-#define MTL_TREE_RANDOMIZER_PAGES 8192
+#define MTL_TREE_RANDOMIZER_PAGES MTL_TREE_MAX_PAGES
 
 
 /** Maximum leaf index supported by a single set
- * 
+ *  (every 32 bit leaf index, the range of the signature leaf index)
  */
-#define MTL_NODE_SET_MAX_LEAF (uint32_t)0x7fffffff
+#define MTL_NODE_SET_MAX_LEAF (uint32_t)0xffffffff
 
 /** Maximum index supported by an node set
- * 
+ *  (node indices are 64 bit since a full set holds 2^33 - 1 nodes)
  */
-#define MTL_NODE_SET_MAX_INDEX (2*MTL_NODE_SET_MAX_LEAF)
+#define MTL_NODE_SET_MAX_INDEX (2*(uint64_t)MTL_NODE_SET_MAX_LEAF)
+
+/** Node set page layout: nodes stored in post-order (default) */
+#define MTL_NODE_SET_LAYOUT_LINEAR 0
+/** Node set page layout: nodes stored in height-k subtree tiles with
+ *  cache line sized slots so a path from a leaf to the root touches
+ *  one tile per k levels (see mtl_node_set_set_layout)
+ */
+#define MTL_NODE_SET_LAYOUT_BLOCKED 1
+/** Cache line size that blocked layout node slots are aligned to */
+#define MTL_NODE_SET_CACHE_LINE 64
+/** Target size in bytes of a blocked layout tile when no tile height
+ *  is given (one memory page)
+ */
+#define MTL_NODE_SET_TILE_SIZE 4096
+/** Largest tile height supported by the blocked layout */
+#define MTL_NODE_SET_MAX_TILE_HEIGHT 16
 
 // Data structures
 /**
@@ -93,21 +109,48 @@ typedef struct SEED {
 
 /**
  * \brief MTL Node Set Context Structure
+ *  One thread may insert while other threads fetch nodes and randomizers
+ *  of leaves below published_count. Pages are never moved or freed until
+ *  the node set is freed, and replaced page directories are retired
+ *  rather than freed, so a reader never sees memory being released.
  */
 typedef struct MTLNODES {
 	/** Current count of leaf nodes covered by this node set 
 	 * 	We assume leaves are added in order, and any operation 
 	 * 	which inserts a node also inserts any lower-index nodes
+	 * 	(64 bit so a full set of 2^32 leaves can be counted)
 	 */		
-	uint32_t leaf_count;
+	uint64_t leaf_count;
+	/** Leaf count published to concurrent readers, every node and
+	 *  randomizer of these leaves is written (see mtl_node_set_publish)
+	 */
+	uint64_t published_count;
 	/** Size (in bytes) of the hash that is used in the MTL tree */		
 	uint16_t hash_size;
-	/** Tree page byte buffer allocation pointer */		
-	uint8_t *tree_pages[MTL_TREE_MAX_PAGES];
+	/** Tree page directory (grown as pages are needed) */		
+	uint8_t **tree_pages;
+	/** Number of entries in the tree page directory */		
+	uint32_t tree_page_count;
 	/** Page size in bytes */		
 	uint32_t tree_page_size;
-	/** Randomizer page byte buffer allocation pointer */		
-	uint8_t *randomizer_pages[MTL_TREE_RANDOMIZER_PAGES];
+	/** Maximum number of pages the tree and randomizer directories may hold */		
+	uint32_t max_pages;
+	/** Randomizer page directory (grown as pages are needed) */		
+	uint8_t **randomizer_pages;
+	/** Number of entries in the randomizer page directory */		
+	uint32_t randomizer_page_count;
+	/** Page directories replaced by larger ones (freed with the set) */
+	uint8_t ***retired_directories;
+	/** Number of retired page directories */
+	uint32_t retired_count;
+	/** Tree page layout (MTL_NODE_SET_LAYOUT_LINEAR or _BLOCKED) */
+	uint8_t layout;
+	/** Levels held by each tile of the blocked layout */
+	uint8_t tile_height;
+	/** Bytes between node slots (the hash size for the linear layout,
+	 *  the hash size rounded up to a power of two for the blocked one)
+	 */
+	uint16_t slot_size;
 } MTLNODES;
 
 // Prototypes
@@ -121,6 +164,70 @@ typedef struct MTLNODES {
 
 void mtl_node_set_init(MTLNODES * nodes, SEED *seed, SERIESID * sid);
 
+/**
+ *  MTL node set function to select the page geometry of a MTLNS structure
+ *  This must be called before any node is inserted into the node set.
+ * @param nodes Pointer to MTL node context to configure
+ * @param page_size Page size in bytes (0 for MTL_TREE_PAGE_SIZE),
+ *                  rounded down to a multiple of the hash size
+ * @param max_pages Maximum number of pages (0 for MTL_TREE_MAX_PAGES)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_set_geometry(MTLNODES * nodes, uint32_t page_size,
+				    uint32_t max_pages);
+
+/**
+ *  MTL node set function to select the tree page layout of a MTLNS
+ *  This must be called before any node is inserted into the node set.
+ *  The layout only changes where nodes live in memory; export and
+ *  import always use the linear post-order node array.
+ * @param nodes Pointer to MTL node context to configure
+ * @param layout MTL_NODE_SET_LAYOUT_LINEAR or MTL_NODE_SET_LAYOUT_BLOCKED
+ * @param tile_height Levels per tile for the blocked layout (0 selects
+ *                    the largest tile that fits MTL_NODE_SET_TILE_SIZE)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_set_layout(MTLNODES * nodes, uint8_t layout,
+				  uint8_t tile_height);
+/**
+ *  Get (allocating if needed) a tree or randomizer page of a MTLNS
+ * @param nodes Pointer to the MTLNS structure
+ * @param page index of the page to get
+ * @param randomizer 0 for a tree page, 1 for a randomizer page
+ * @param page_ptr pointer to fill with the page address (owned by the MTLNS)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_alloc_page(MTLNODES * nodes, uint32_t page,
+				  uint8_t randomizer, uint8_t ** page_ptr);
+
+/**
+ *  Set the leaf count of a MTLNS, e.g. to reserve the next leaf index
+ *  Only the thread writing the node set may call this.
+ * @param nodes Pointer to the MTLNS structure
+ * @param leaf_count new leaf count
+ * @return none
+ */
+void mtl_node_set_set_leaf_count(MTLNODES * nodes, uint64_t leaf_count);
+
+/**
+ *  Publish a leaf count to threads reading the MTLNS
+ *  Every node covering the leaves below leaf_count must already be
+ *  written. The published count never goes backwards, and a reader that
+ *  sees it also sees those nodes. Only the writing thread may call this.
+ * @param nodes Pointer to the MTLNS structure
+ * @param leaf_count number of complete leaves
+ * @return none
+ */
+void mtl_node_set_publish(MTLNODES * nodes, uint64_t leaf_count);
+
+/**
+ *  Get the leaf count last published by mtl_node_set_publish
+ *  Safe to call from any thread while another thread writes the MTLNS.
+ * @param nodes Pointer to the MTLNS structure
+ * @return published leaf count
+ */
+uint64_t mtl_node_set_published(MTLNODES * nodes);
+
 /**
  *  MTL node set function to free a MTLNS structure
  * @param nodes Pointer to MTL node context to free
@@ -160,6 +267,20 @@ MTLSTATUS mtl_node_set_insert_randomizer(MTLNODES * nodes,
 MTLSTATUS mtl_node_set_fetch(MTLNODES * node_set, uint32_t left, uint32_t right,
 			   uint8_t ** hash);
 
+/**
+ *  Fetch a reference to the node hash for a given index from the MTLNS
+ *  The returned pointer references the node set page memory, so the
+ *  caller must not free it and it is only valid until the node set is
+ *  freed. Nodes of published leaves may be fetched from any thread.
+ * @param nodes Pointer to the MTLNS structure
+ * @param left left index of the node to fetch
+ * @param right right index of the node to fetch
+ * @param hash pointer to fill with the address of the hash value
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_fetch_ref(MTLNODES * nodes, uint32_t left,
+			       uint32_t right, const uint8_t ** hash);
+
 /**
  *  Fetch the randomizer for a given index from the MTLNS
  * @param nodes Pointer to the MTLNS structure
@@ -170,6 +291,68 @@ MTLSTATUS mtl_node_set_fetch(MTLNODES * node_set, uint32_t left, uint32_t right,
 MTLSTATUS mtl_node_set_get_randomizer(MTLNODES * nodes, uint32_t leaf,
 				    uint8_t ** rand);
 
+/**
+ *  Fetch a reference to the randomizer for a given index from the MTLNS
+ *  The returned pointer references the node set page memory, so the
+ *  caller must not free it and it is only valid until the node set is
+ *  freed. Randomizers of published leaves may be fetched from any thread.
+ * @param nodes Pointer to the MTLNS structure
+ * @param leaf leaf index of the randomizer to fetch
+ * @param rand pointer to fill with the address of the randomizer value
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_get_randomizer_ref(MTLNODES * nodes, uint32_t leaf,
+					const uint8_t ** rand);
+
+/**
+ *  Number of nodes (leaves and internal nodes) held for a leaf count
+ * @param leaf_count number of leaves in the node set
+ * @return number of nodes stored in the linear node array
+ */
+uint64_t mtl_node_set_node_count(uint64_t leaf_count);
+/**
+ *  Number of tree pages needed to hold every node for a leaf count
+ * @param nodes Pointer to the MTLNS structure (for its geometry and layout)
+ * @param leaf_count number of leaves in the node set
+ * @return number of tree pages
+ */
+uint64_t mtl_node_set_page_count(MTLNODES * nodes, uint64_t leaf_count);
+
+/**
+ *  Copy the nodes (and optionally randomizers) of the first leaves
+ *  out of a MTLNS
+ * @param nodes Pointer to the MTLNS structure
+ * @param leaf_count number of leaves to copy (at most nodes->leaf_count)
+ * @param tree buffer for mtl_node_set_node_count(leaf_count) hashes
+ * @param randomizers buffer for leaf_count randomizers (NULL for none)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_export_leaves(MTLNODES * nodes, uint64_t leaf_count,
+				     uint8_t * tree, uint8_t * randomizers);
+
+/**
+ *  Copy all nodes (and optionally randomizers) out of a MTLNS
+ * @param nodes Pointer to the MTLNS structure
+ * @param tree buffer for mtl_node_set_node_count(leaf_count) hashes
+ * @param randomizers buffer for leaf_count randomizers (NULL for none)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_export(MTLNODES * nodes, uint8_t * tree,
+			      uint8_t * randomizers);
+
+/**
+ *  Bulk load all nodes (and optionally randomizers) into an empty MTLNS
+ *  without recomputing any internal node
+ * @param nodes Pointer to the MTLNS structure
+ * @param leaf_count number of leaves represented by the tree buffer
+ * @param tree buffer of mtl_node_set_node_count(leaf_count) hashes
+ * @param randomizers buffer of leaf_count randomizers (NULL for none)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS mtl_node_set_import(MTLNODES * nodes, uint64_t leaf_count,
+			      const uint8_t * tree,
+			      const uint8_t * randomizers);
+
 /**
  *  MTLNS mapping function from left/right to linear page array
  * @param left: left index of the node to insert
@@ -178,27 +361,27 @@ MTLSTATUS mtl_node_set_get_randomizer(MTLNODES * nodes, uint32_t leaf,
  * @return MTL_OK if successful, and *return_index set
  * 			MTL_ERROR if <left,right> is not a valid node
  */
-MTLSTATUS mtl_node_set_int_node_id(uint32_t left, uint32_t right, uint32_t * return_index);
+MTLSTATUS mtl_node_set_int_node_id(uint32_t left, uint32_t right, uint64_t * return_index);
 
 /**
  *  MTL implementation of bit_width
  * @param number number to evaluate
  * @return number of 1's in the number
  */
-uint32_t mtl_bit_width(uint32_t number);
+uint32_t mtl_bit_width(uint64_t number);
 
 /**
  *  MTL implementation of lsb
  * @param number number to evaluate
  * @return index of the least significant bit
  */
-uint32_t mtl_lsb(uint32_t number);
+uint32_t mtl_lsb(uint64_t number);
 
 /**
  *  MTL implementation of msb
  * @param number number to evaluate
  * @return index of the most significant bit
  */
-uint32_t mtl_msb(uint32_t number);
+uint32_t mtl_msb(uint64_t number);
 
 #endif
@@ -32,7 +32,6 @@
 */
 #include <arpa/inet.h>
 #include <math.h>
-#include <openssl/hmac.h>
 #include <string.h>
 
 #include "mtl_error.h"
@@ -41,6 +40,32 @@
 #include "mtl_spx.h"
 
 #define BUFFER_APPEND(ptr, offset, data, datalen)  {memcpy(ptr + offset, data, datalen); offset += datalen;}
+/** Largest data value hashed without a heap buffer (two child hashes) */
+#define SPX_MASK_STACK_LEN (EVP_MAX_MD_SIZE * 2)
+// Nodes prepared on the stack per call into the batched hash backends
+#define SPX_BATCH_LANES 8
+
+/**
+ * \brief Running H_msg_mtl state for a message hashed in pieces
+ */
+typedef struct SPX_MSG_STATE {
+	/** SPHINCS+ parameters the message is hashed under */
+	SPX_PARAMS *params;
+	/** Type of algorithm used (#defined values) */
+	uint8_t algorithm;
+	/** Length of the message hash */
+	uint32_t hash_len;
+	/** R_mtl value leading the message hash */
+	uint8_t rmtl[EVP_MAX_MD_SIZE];
+	/** Length of the R_mtl value */
+	uint32_t rmtl_len;
+	/** SHA2 digest of R || PK.seed || PK.root || sep || ADRS || M so far */
+	SHA2_STATE digest;
+	/** Provider digest of the same input (SHAKE, or SHA2 in provider mode) */
+	EVP_MD_CTX *evp;
+	/** Set when evp was allocated for this state */
+	uint8_t evp_owned;
+} SPX_MSG_STATE;
 
 /*****************************************************************
 * MTL Node Set generate message PRF SHA2 values
@@ -62,11 +87,6 @@ MTLSTATUS spx_mtl_node_set_prf_msg_sha2(uint8_t * skprf, uint32_t skprf_len,
 				      uint8_t * message, uint32_t message_len,
 				      uint8_t * rmtl, uint32_t hash_len)
 {
-	uint32_t rmtl_len = 0;
-	const EVP_MD *h_func = NULL;
-	uint8_t *buffer = NULL;
-	uint32_t buffer_offset = 0;
-
 	if ((skprf == NULL) || (skprf_len == 0) ||
 	    (optrand == NULL) || (optrand_len == 0) ||
 	    (message == NULL) || (message_len == 0) || (rmtl == NULL) || 
@@ -76,27 +96,9 @@ MTLSTATUS spx_mtl_node_set_prf_msg_sha2(uint8_t * skprf, uint32_t skprf_len,
 	}
 	// SHA2 PRF_msg from draft-harvey-cfrg-mtl-mode-00 Section 10.2.2
 	// PRF_msg(SK.prf, OptRand, M) = HMAC-SHA-X(SK.prf, OptRand || M)
-	buffer = calloc(1, optrand_len + message_len);
-	if (buffer == NULL) {
-		LOG_ERROR_WITH_CODE("spx_mtl_node_set_prf_msg_sha2",MTL_RESOURCE_FAIL);
-	}
-	BUFFER_APPEND(buffer, buffer_offset, optrand, optrand_len);
-	BUFFER_APPEND(buffer, buffer_offset, message, message_len);
-
-	if (hash_len <= 16) {
-		h_func = EVP_sha256();
-	} else {
-		h_func = EVP_sha512();
-	}
+	hmac_sha2(rmtl, skprf, skprf_len, optrand, optrand_len, message,
+		  message_len, hash_len);
 
-	if (HMAC(h_func, skprf, skprf_len, buffer, optrand_len + message_len,
-		 rmtl, &rmtl_len) == NULL) {
-		LOG_ERROR("HMAC Failure");
-		free(buffer);
-		return MTL_ERROR;
-	}
-
-	free(buffer);
 	return MTL_OK;
 }
 
@@ -120,10 +122,6 @@ MTLSTATUS spx_mtl_node_set_prf_msg_shake(uint8_t * skprf, uint32_t skprf_len,
 				       uint8_t * message, uint32_t message_len,
 				       uint8_t * rmtl, uint32_t hash_len)
 {
-	uint8_t *buffer;
-	uint32_t buffer_len;
-	uint32_t buffer_offset = 0;
-
 	if ((skprf == NULL) || (skprf_len == 0) ||
 	    (optrand == NULL) || (optrand_len == 0) ||
 	    (message == NULL) || (message_len == 0) || (rmtl == 0) ||
@@ -133,21 +131,15 @@ MTLSTATUS spx_mtl_node_set_prf_msg_shake(uint8_t * skprf, uint32_t skprf_len,
 	}
 	// SHA2 PRF_msg from draft-harvey-cfrg-mtl-mode-00 Section 10.1.2
 	// PRF_msg(SK.prf, OptRand, M) = SHAKE256(SK.prf || OptRand || M, 8n)
-	buffer_len = skprf_len + optrand_len + message_len;
-	buffer = calloc(1, buffer_len);
-	if (buffer == NULL) {
-		LOG_ERROR("Failed to allocate msg buffer");
-		return MTL_RESOURCE_FAIL;
+	// M can be long, so it goes through OpenSSL rather than the
+	// native sponge that is tuned for short tree hashes
+	if (spx_md_digest(SPX_MD_SHAKE256, rmtl, hash_len, skprf, skprf_len,
+			  optrand, optrand_len, message, message_len) != MTL_OK) {
+		LOG_ERROR("Unable to compute digest");
+		return MTL_ERROR;
 	}
-	BUFFER_APPEND(buffer, buffer_offset, skprf, skprf_len);
-	BUFFER_APPEND(buffer, buffer_offset, optrand, optrand_len);
-	BUFFER_APPEND(buffer, buffer_offset, message, message_len);
-
-	shake256(rmtl, buffer, buffer_len, hash_len);
-	free(buffer);
 
 	return MTL_OK;
-
 }
 
 /*****************************************************************
@@ -239,44 +231,344 @@ MTLSTATUS spx_sha2(uint8_t * seed, uint32_t seed_len,
 		 uint8_t * data, uint32_t data_len,
 		 uint8_t * hash, uint32_t hash_len)
 {
-	uint8_t *padded_seed = NULL;
-	uint32_t padded_seed_len = 0;
-	uint8_t *buffer = NULL;
-	size_t buffer_len = 0;
-	uint32_t buffer_offset = 0;
-	uint32_t block_len = SHA2_512_BLOCK_SIZE;
-
+	SHA2_SEED_STATE seed_state;
 
 	memset(&hash[0], 0, hash_len);
 
 	// BlockPad(PK.seed)
-	if (hash_len <= 16) {
-		block_len = SHA2_256_BLOCK_SIZE;
+	if (sha2_seed_state_init(&seed_state, seed, seed_len, hash_len) !=
+	    MTL_OK) {
+		LOG_ERROR("Invalid seed length");
+		return MTL_BAD_PARAM;
 	}
-	padded_seed_len = block_pad(seed, seed_len, block_len, &padded_seed);
 
-	// Create the buffer that gets hashed   
-	buffer_len = padded_seed_len + adrs_len + data_len;
-	buffer = malloc(buffer_len);
-	if(buffer == NULL) {
-		LOG_ERROR("failed allocating buffer");
-		return MTL_RESOURCE_FAIL;
+	// Hash functionfrom draft-harvey-cfrg-mtl-mode-00 Section 10.2
+	sha2_seeded(&hash[0], &seed_state, adrs, adrs_len, data, data_len);
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Perform the SHA2 hashing for a batch of tree nodes of the same shape
+******************************************************************
+ * @param seed:     SPHINCS+ public key seed 
+ * @param seed_len: Length of the SPHNICS+ public key
+ * @param adrs:     Compressed ADRS structure for each hash
+ * @param adrs_len: Length of each ADRS structure
+ * @param data:     Data value for each hash
+ * @param data_len: Length of each data value
+ * @param hash:     Output buffer for each hash (full digest length)
+ * @param hash_len: Length of the scheme hash
+ * @param count:    Number of hashes in the batch
+ * @return 0 if successful
+ */
+MTLSTATUS spx_sha2_batch(uint8_t * seed, uint32_t seed_len,
+			 uint8_t ** adrs, uint32_t adrs_len,
+			 uint8_t ** data, uint32_t data_len,
+			 uint8_t ** hash, uint32_t hash_len, uint32_t count)
+{
+	SHA2_SEED_STATE seed_state;
+	uint32_t index;
+
+	if ((adrs == NULL) || (data == NULL) || (hash == NULL)) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	for (index = 0; index < count; index++) {
+		memset(hash[index], 0, hash_len);
 	}
 
-	BUFFER_APPEND(buffer, buffer_offset, padded_seed, padded_seed_len);
-	BUFFER_APPEND(buffer, buffer_offset, adrs, adrs_len);
-	BUFFER_APPEND(buffer, buffer_offset, data, data_len);
-	free(padded_seed);
+	// BlockPad(PK.seed)
+	if (sha2_seed_state_init(&seed_state, seed, seed_len, hash_len) !=
+	    MTL_OK) {
+		LOG_ERROR("Invalid seed length");
+		return MTL_BAD_PARAM;
+	}
 
-	// Hash functionfrom draft-harvey-cfrg-mtl-mode-00 Section 10.2
-	if (hash_len <= 16) {
-		sha256(&hash[0], buffer, buffer_len);
+	sha2_seeded_batch(hash, &seed_state, adrs, adrs_len, data, data_len,
+			  count);
+	return MTL_OK;
+}
 
-	} else {
-		sha512(&hash[0], buffer, buffer_len);
+/*****************************************************************
+* Precompute the SHA2 BlockPad(PK.seed) state for the parameters
+******************************************************************
+ * @param params:   SPHINCS+ parameters with pk_seed set
+ * @param hash_len: Length of the scheme hash (selects SHA-256/512)
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_sha2(SPX_PARAMS * params, uint32_t hash_len)
+{
+	if (params == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+
+	params->node_funcs = NULL;
+	if (sha2_seed_state_init(&params->sha2_seed, params->pk_seed.seed,
+				 params->pk_seed.length, hash_len) != MTL_OK) {
+		LOG_ERROR("Invalid seed length");
+		return MTL_BAD_PARAM;
+	}
+
+	// SK.prf is only present when signing, without it PRF_msg is unused
+	params->prf_hmac.ready = 0;
+	if ((params->prf.length > 0)
+	    && (params->prf.length <= SHA2_512_BLOCK_SIZE)) {
+		hmac_sha2_state_init(&params->prf_hmac, params->prf.data,
+				     params->prf.length, hash_len);
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Precompute the message separator for the MTL context string
+******************************************************************
+ * @param params: SPHINCS+ parameters
+ * @param ctx:    MTL context string the message hashes will be given
+ *                (NULL for none)
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_msg_sep(SPX_PARAMS * params, char *ctx)
+{
+	size_t ctx_len = 0;
+
+	if (params == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+
+	params->msg_sep.ready = 0;
+	if (ctx != NULL) {
+		ctx_len = strlen(ctx);
+	}
+	if (ctx_len > UINT8_MAX) {
+		LOG_ERROR("Context string must be no longer than 255 bytes");
+		return MTL_BAD_PARAM;
+	}
+
+	// MTL Message Separator from draft-harvey-cfrg-mtl-mode-03 section 4.1
+	// octet(MTL_MSG_SEP) || octet(OLEN(ctx)) || ctx
+	params->msg_sep.data[0] = MTL_MSG_SEP;
+	params->msg_sep.data[1] = (uint8_t)ctx_len;
+	if (ctx_len > 0) {
+		memcpy(params->msg_sep.data + 2, ctx, ctx_len);
+	}
+	params->msg_sep.length = 2 + ctx_len;
+	params->msg_sep.ready = SPX_STATE_READY;
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Prebuild the MTL ADRS structures for a series ID
+******************************************************************
+ * @param params: SPHINCS+ parameters
+ * @param sid:    Series ID the node set hashes will be given
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_adrs(SPX_PARAMS * params, SERIESID * sid)
+{
+	uint8_t type;
+
+	if ((params == NULL) || (sid == NULL)) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+
+	params->node_funcs = NULL;
+	params->adrs.ready = 0;
+	if (sid->length > EVP_MAX_MD_SIZE) {
+		LOG_ERROR("Invalid series ID length");
+		return MTL_BAD_PARAM;
+	}
+
+	// Everything but the left and right index words is fixed for a
+	// series, so build each type once with both indexes zero
+	for (type = SPX_ADRS_MTL_MSG; type <= SPX_ADRS_MTL_TREE; type++) {
+		mtlns_adrs_compressed(params->adrs.compressed[type -
+							      SPX_ADRS_MTL_MSG],
+				      type, sid, 0, 0);
+		mtlns_adrs_full(params->adrs.full[type - SPX_ADRS_MTL_MSG],
+				type, sid, 0, 0);
+	}
+	params->adrs.sid.length = sid->length;
+	memcpy(params->adrs.sid.id, sid->id, sid->length);
+	params->adrs.ready = SPX_STATE_READY;
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Build an MTL ADRS structure, from the parameter templates if they
+* were built for this series ID
+******************************************************************
+ * @param spx_prop:  SPHINCS+ parameters
+ * @param adrs:      Bytes array to hold the ADRS structure
+ * @param type:      ADRS type (SPX_ADRS_MTL_MSG/DATA/TREE)
+ * @param sid:       Series ID generated for the MTL node set
+ * @param left:      MTL tree address left value
+ * @param right:     MTL tree address right value
+ * @param algorithm: Type of algorithm used (#defined values)
+ * @return length of the ADRS structure
+ */
+static uint8_t spx_adrs_params(SPX_PARAMS * spx_prop, uint8_t * adrs,
+			       uint8_t type, SERIESID * sid, uint32_t left,
+			       uint32_t right, uint8_t algorithm)
+{
+	SPX_ADRS_TEMPLATES *templates = &spx_prop->adrs;
+
+	if ((templates->ready != SPX_STATE_READY) ||
+	    (type < SPX_ADRS_MTL_MSG) || (type > SPX_ADRS_MTL_TREE) ||
+	    (sid->length != templates->sid.length) ||
+	    (memcmp(sid->id, templates->sid.id, sid->length) != 0)) {
+		if (algorithm == SPX_MTL_SHA2) {
+			return mtlns_adrs_compressed(adrs, type, sid, left,
+						     right);
+		}
+		return mtlns_adrs_full(adrs, type, sid, left, right);
+	}
+
+	// Only the two index words differ from the template
+	if (algorithm == SPX_MTL_SHA2) {
+		memcpy(adrs, templates->compressed[type - SPX_ADRS_MTL_MSG],
+		       ADRS_ADDR_SIZE_C);
+		uint32_to_bytes(&adrs[ADRS_ADDR_2_C], left);
+		uint32_to_bytes(&adrs[ADRS_ADDR_3_C], right);
+		return ADRS_ADDR_SIZE_C;
+	}
+	memcpy(adrs, templates->full[type - SPX_ADRS_MTL_MSG], ADRS_ADDR_SIZE);
+	uint32_to_bytes(&adrs[ADRS_ADDR_2], left);
+	uint32_to_bytes(&adrs[ADRS_ADDR_3], right);
+	return ADRS_ADDR_SIZE;
+}
+
+/*****************************************************************
+* SHA2 PRF_msg using the parameter HMAC key pads when they match
+******************************************************************
+ * @param spx_prop:    SPHINCS+ parameters
+ * @param optrand:     msg rand buffer data pointer
+ * @param optrand_len: msg rand buffer data length
+ * @param message:     message buffer data pointer
+ * @param message_len: message buffer data length
+ * @param rmtl:        output of the prf function (full digest length)
+ * @param hash_len:    length of the hash for the scheme
+ * @return 0 on success, integer on failure
+ */
+static MTLSTATUS spx_prf_msg_sha2_params(SPX_PARAMS * spx_prop,
+					 uint8_t * optrand,
+					 uint32_t optrand_len,
+					 uint8_t * message,
+					 uint32_t message_len,
+					 uint8_t * rmtl, uint32_t hash_len)
+{
+	HMAC_SHA2_STATE *prf_state = &spx_prop->prf_hmac;
+
+	// Parameters built by hand may not have the key pads, or have
+	// stale ones, so fall back to keying the HMAC for this message
+	if ((prf_state->ready != SPX_STATE_READY)
+	    || (prf_state->inner.hash_len != hash_len)
+	    || (prf_state->key_len != spx_prop->prf.length)
+	    || (memcmp(prf_state->key, spx_prop->prf.data,
+		       prf_state->key_len) != 0)
+	    || (optrand == NULL) || (optrand_len == 0)
+	    || (message == NULL) || (message_len == 0)) {
+		return spx_mtl_node_set_prf_msg_sha2(spx_prop->prf.data,
+						     spx_prop->prf.length,
+						     optrand, optrand_len,
+						     message, message_len,
+						     rmtl, hash_len);
+	}
+
+	// PRF_msg(SK.prf, OptRand, M) = HMAC-SHA-X(SK.prf, OptRand || M)
+	hmac_sha2_keyed(rmtl, prf_state, optrand, optrand_len, message,
+			message_len);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Perform the SHA2 tree hashing with the parameter seed state
+******************************************************************
+ * @param spx_prop: SPHINCS+ parameters
+ * @param addrs:    Compressed ADRS tree address structure
+ * @param adrs_len: Lenght of the ADRS tree address structure
+ * @param data:     Data value to hash 
+ * @param data_len: Length of the data value
+ * @param hash:     Pointer to byte array where hash is stored
+ * @param hash_len: Length of byte array
+ * @return 0 if successful
+ */
+static MTLSTATUS spx_sha2_params(SPX_PARAMS * spx_prop,
+				 uint8_t * adrs, uint32_t adrs_len,
+				 uint8_t * data, uint32_t data_len,
+				 uint8_t * hash, uint32_t hash_len)
+{
+	SHA2_SEED_STATE *seed_state = &spx_prop->sha2_seed;
+
+	// Only trust the cached state if it still matches the seed and
+	// the SHA-2 variant selected by this hash length
+	if ((seed_state->ready != SPX_STATE_READY) ||
+	    (seed_state->seed_len != spx_prop->pk_seed.length) ||
+	    ((seed_state->digest.hash_len <= 16) != (hash_len <= 16)) ||
+	    (memcmp(seed_state->seed, spx_prop->pk_seed.seed,
+		    seed_state->seed_len) != 0)) {
+		return spx_sha2(spx_prop->pk_seed.seed,
+				spx_prop->pk_seed.length, adrs, adrs_len,
+				data, data_len, hash, hash_len);
+	}
+
+	memset(&hash[0], 0, hash_len);
+	sha2_seeded(&hash[0], seed_state, adrs, adrs_len, data, data_len);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Perform a batch of SHA2 tree hashes with the parameter seed state
+******************************************************************
+ * @param spx_prop: SPHINCS+ parameters
+ * @param adrs:     Compressed ADRS tree address structures
+ * @param adrs_len: Lenght of each ADRS tree address structure
+ * @param data:     Data values to hash 
+ * @param data_len: Length of each data value
+ * @param hash:     Pointers to byte arrays where the hashes are stored
+ * @param hash_len: Length of each hash byte array
+ * @param count:    Number of hashes (at most SPX_BATCH_LANES)
+ * @return 0 if successful
+ */
+static MTLSTATUS spx_sha2_params_batch(SPX_PARAMS * spx_prop,
+				       uint8_t ** adrs, uint32_t adrs_len,
+				       uint8_t ** data, uint32_t data_len,
+				       uint8_t ** hash, uint32_t hash_len,
+				       uint32_t count)
+{
+	SHA2_SEED_STATE *seed_state = &spx_prop->sha2_seed;
+	uint8_t digests[SPX_BATCH_LANES][EVP_MAX_MD_SIZE];
+	uint8_t *digest_ptrs[SPX_BATCH_LANES];
+	uint32_t index;
+
+	// Same cache checks as spx_sha2_params
+	if ((seed_state->ready != SPX_STATE_READY) ||
+	    (seed_state->seed_len != spx_prop->pk_seed.length) ||
+	    ((seed_state->digest.hash_len <= 16) != (hash_len <= 16)) ||
+	    (memcmp(seed_state->seed, spx_prop->pk_seed.seed,
+		    seed_state->seed_len) != 0)) {
+		for (index = 0; index < count; index++) {
+			spx_sha2_params(spx_prop, adrs[index], adrs_len,
+					data[index], data_len, hash[index],
+					hash_len);
+		}
+		return MTL_OK;
 	}
 
-	free(buffer);
+	// Full digests land on the stack, callers only get hash_len bytes
+	for (index = 0; index < count; index++) {
+		digest_ptrs[index] = digests[index];
+	}
+	sha2_seeded_batch(digest_ptrs, seed_state, adrs, adrs_len, data,
+			  data_len, count);
+	for (index = 0; index < count; index++) {
+		memcpy(hash[index], digests[index], hash_len);
+	}
 	return MTL_OK;
 }
 
@@ -298,73 +590,176 @@ MTLSTATUS spx_shake(uint8_t * seed, uint32_t seed_len,
 		  uint8_t * data, uint32_t data_len,
 		  uint8_t * hash, uint32_t hash_len)
 {
-	uint8_t *buffer;
-	size_t buffer_len = 0;
-	uint32_t buffer_offset = 0;
+	SHAKE256_STATE sponge;
 
-	// Create the buffer that gets hashed   
-	buffer_len = seed_len + adrs_len + data_len;
-	buffer = malloc(buffer_len);
-	if(buffer == NULL) {
-		LOG_ERROR("failed allocating buffer");
-		return MTL_RESOURCE_FAIL;
+	if (spx_md_provider_only()) {
+		if (spx_md_digest(SPX_MD_SHAKE256, hash, hash_len, seed,
+				  seed_len, adrs, adrs_len, data,
+				  data_len) != MTL_OK) {
+			return MTL_ERROR;
+		}
+		return MTL_OK;
+	}
+	shake256_init(&sponge);
+	shake256_absorb(&sponge, seed, seed_len);
+	shake256_absorb(&sponge, adrs, adrs_len);
+	shake256_absorb(&sponge, data, data_len);
+	shake256_squeeze(&hash[0], &sponge, hash_len);
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Precompute the SHAKE PK.seed sponge state for the parameters
+******************************************************************
+ * @param params: SPHINCS+ parameters with pk_seed set
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_shake(SPX_PARAMS * params)
+{
+	if (params == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
 	}
 
-	BUFFER_APPEND(buffer, buffer_offset, seed, seed_len);
-	BUFFER_APPEND(buffer, buffer_offset, adrs, adrs_len);
-	BUFFER_APPEND(buffer, buffer_offset, data, data_len);
+	params->node_funcs = NULL;
+	if (shake_seed_state_init(&params->shake_seed, params->pk_seed.seed,
+				  params->pk_seed.length) != MTL_OK) {
+		LOG_ERROR("Invalid seed length");
+		return MTL_BAD_PARAM;
+	}
+	return MTL_OK;
+}
 
-	shake256(&hash[0], buffer, buffer_len, hash_len);
+/*****************************************************************
+* Perform the SHAKE tree hashing with the parameter seed state
+******************************************************************
+ * @param spx_prop: SPHINCS+ parameters
+ * @param addrs:    Full ADRS tree address structure
+ * @param adrs_len: Lenght of the ADRS tree address structure
+ * @param data:     Data value to hash 
+ * @param data_len: Length of the data value
+ * @param hash:     Pointer to byte array where hash is stored
+ * @param hash_len: Length of byte array
+ * @return 0 if successful
+ */
+static MTLSTATUS spx_shake_params(SPX_PARAMS * spx_prop,
+				  uint8_t * adrs, uint32_t adrs_len,
+				  uint8_t * data, uint32_t data_len,
+				  uint8_t * hash, uint32_t hash_len)
+{
+	SHAKE_SEED_STATE *seed_state = &spx_prop->shake_seed;
+
+	// Only trust the cached sponge if it still matches the seed
+	if ((seed_state->ready != SPX_STATE_READY) ||
+	    (seed_state->seed_len != spx_prop->pk_seed.length) ||
+	    (memcmp(seed_state->seed, spx_prop->pk_seed.seed,
+		    seed_state->seed_len) != 0)) {
+		return spx_shake(spx_prop->pk_seed.seed,
+				 spx_prop->pk_seed.length, adrs, adrs_len,
+				 data, data_len, hash, hash_len);
+	}
 
-	free(buffer);
+	shake_seeded(&hash[0], seed_state, adrs, adrs_len, data, data_len,
+		     hash_len);
 	return MTL_OK;
 }
 
 /*****************************************************************
-* Hash the message set with the rand
+* Perform a batch of SHAKE tree hashes with the parameter seed state
+******************************************************************
+ * @param spx_prop: SPHINCS+ parameters
+ * @param adrs:     Full ADRS tree address structures
+ * @param adrs_len: Lenght of each ADRS tree address structure
+ * @param data:     Data values to hash 
+ * @param data_len: Length of each data value
+ * @param hash:     Pointers to byte arrays where the hashes are stored
+ * @param hash_len: Length of each hash byte array
+ * @param count:    Number of hashes in the batch
+ * @return 0 if successful
+ */
+static MTLSTATUS spx_shake_params_batch(SPX_PARAMS * spx_prop,
+					uint8_t ** adrs, uint32_t adrs_len,
+					uint8_t ** data, uint32_t data_len,
+					uint8_t ** hash, uint32_t hash_len,
+					uint32_t count)
+{
+	SHAKE_SEED_STATE *seed_state = &spx_prop->shake_seed;
+	uint32_t index;
+
+	// Only trust the cached sponge if it still matches the seed
+	if ((seed_state->ready != SPX_STATE_READY) ||
+	    (seed_state->seed_len != spx_prop->pk_seed.length) ||
+	    (memcmp(seed_state->seed, spx_prop->pk_seed.seed,
+		    seed_state->seed_len) != 0)) {
+		for (index = 0; index < count; index++) {
+			spx_shake(spx_prop->pk_seed.seed,
+				  spx_prop->pk_seed.length, adrs[index],
+				  adrs_len, data[index], data_len,
+				  hash[index], hash_len);
+		}
+		return MTL_OK;
+	}
+
+	shake_seeded_batch(hash, seed_state, adrs, adrs_len, data, data_len,
+			   hash_len, count);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Release the resources held by a started message state
+******************************************************************
+ * @param state: Started message state
+ * @return none
+ */
+static void spx_hash_message_release(SPX_MSG_STATE * state)
+{
+	// A lent context is left to be initialized again by its next user
+	if (state->evp_owned) {
+		EVP_MD_CTX_free(state->evp);
+	}
+	state->evp = NULL;
+	state->evp_owned = 0;
+}
+
+/*****************************************************************
+* Start the message hash, absorbing everything ahead of M
 ******************************************************************
+ * @param state:      Message state to start
  * @param params:     SPHINCS+ public key seed & key
  * @param sid:        Series identifier for this MTL node set
  * @param node_id:    Node identifier for this message
  * @param rand:       PRF based rand for this message
  * @param rand_len:   Length of the rand byte array
- * @param msg_buffer: Byte array of the message that will be added
- * @param msg_len:    Length of the msg_buffer array
- * @param hash:       Pointer to byte array where hash is stored
- * @param hash_len:   Length of hash byte array
+ * @param hash_len:   Length of the message hash
  * @param ctx:        MTL signature context string
- * @param rmtl       Generated randomness bytes for the hash
- * @param rmtl_len   Length of the randomness bytes 
- * @param algorithm:  Type of algorithm used (#defined values) 
- * @return 0 if successful
+ * @param rmtl:       Generated randomness bytes for the hash
+ * @param rmtl_len:   Length of the randomness bytes
+ * @param algorithm:  Type of algorithm used (#defined values)
+ * @param digest_ctx: Digest context to lend the state, NULL to allocate one
+ * @return MTL_OK if successful
  */
-MTLSTATUS spx_mtl_node_set_hash_message(void *params,
-				      SERIESID * sid,
-				      uint32_t node_id,
-				      uint8_t * rand,
-				      uint32_t rand_len,
-				      uint8_t * msg_buffer, uint32_t msg_len,
-				      uint8_t * hash, uint32_t hash_len,
-				      char * ctx, uint8_t ** rmtl,
-					  uint32_t * rmtl_len, uint8_t algorithm)
+static MTLSTATUS spx_hash_message_start(SPX_MSG_STATE * state, void *params,
+					SERIESID * sid, uint32_t node_id,
+					uint8_t * rand, uint32_t rand_len,
+					uint32_t hash_len, char *ctx,
+					uint8_t ** rmtl, uint32_t * rmtl_len,
+					uint8_t algorithm,
+					EVP_MD_CTX * digest_ctx)
 {
 	SPX_PARAMS *spx_prop = params;
-	unsigned int tmp_hash_len = 0;
-	uint8_t *buffer = NULL;
-	uint32_t buffer_len = 0;
-	uint32_t buffer_offset = 0;
 	uint32_t address_len = ADRS_ADDR_SIZE;
 	uint8_t address[32] = { 0 };
-	uint8_t *data_buffer;
+	uint8_t data_buffer[2 + UINT8_MAX + ADRS_ADDR_SIZE];
 	uint32_t sep_len;
 	uint32_t dbuff_len_no_msg = 0;
-	uint32_t dbuff_len_w_msg = 0;
-	uint8_t ctx_len = 0;
+	size_t ctx_len = 0;
 	uint8_t* rmtl_buff;
+	uint8_t md = SPX_MD_COUNT;
 
 	if ((params == NULL) || (rand == NULL) || (rand_len == 0)
-	    || (msg_buffer == NULL) || (msg_len == 0) || (hash == NULL)
-	    || (hash_len == 0)) {
+	    || (hash_len == 0) || (hash_len > EVP_MAX_MD_SIZE)
+	    || (rmtl == NULL) || (rmtl_len == NULL)) {
 		LOG_ERROR("Null parameters");
 		return MTL_NULL_PTR;
 	}
@@ -376,41 +771,44 @@ MTLSTATUS spx_mtl_node_set_hash_message(void *params,
 	// Later section 10.X does not call this out because it is assumed
 	// to be included in the message buffer at that point.
 	// Construct that included buffer now.
+	// The message ADRS uses the full layout for both hash families
 	address_len =
-	    mtlns_adrs_full((uint8_t *) & address, SPX_ADRS_MTL_MSG, sid,
-			    0, node_id);
+	    spx_adrs_params(spx_prop, (uint8_t *) & address, SPX_ADRS_MTL_MSG,
+			    sid, 0, node_id, SPX_MTL_SHAKE);
 
+	// MTL Message Separator from draft-harvey-cfrg-mtl-mode-03 section 4.1
+	// octet(MTL_MSG_SEP) || octet(OLEN(ctx)) || ctx || value
+	// Buffer is the sep || ADRS, M is added to each hash separately
 	if(ctx != NULL) {
 		ctx_len = strlen(ctx);
 	}
-
-	// MTL Message Separator from draft-harvey-cfrg-mtl-mode-03 section 4.1
-	// octet(MTL_MSG_SEP) || octet(OLEN(ctx)) || ctx || value
-	// Buffer is the sep || ADRS || M
-	sep_len = 2 + ctx_len;
-	dbuff_len_no_msg = sep_len + address_len;
-	dbuff_len_w_msg = dbuff_len_no_msg + msg_len;
-
-	data_buffer = malloc(dbuff_len_w_msg);
-	if(data_buffer == NULL) {
-		LOG_ERROR("failed allocating data buffer");
-		return MTL_RESOURCE_FAIL;
+	if (ctx_len > UINT8_MAX) {
+		LOG_ERROR("Context string must be no longer than 255 bytes");
+		return MTL_BAD_PARAM;
 	}
-	data_buffer[0] = MTL_MSG_SEP;
-	data_buffer[1] = ctx_len;
-	if(ctx_len > 0) {
-		memcpy(data_buffer + 2, ctx, ctx_len);
+	// The prebuilt separator is only used if it holds this context
+	sep_len = 2 + ctx_len;
+	if ((spx_prop->msg_sep.ready == SPX_STATE_READY)
+	    && (spx_prop->msg_sep.length == sep_len)
+	    && ((ctx_len == 0)
+		|| (memcmp(spx_prop->msg_sep.data + 2, ctx, ctx_len) == 0))) {
+		memcpy(data_buffer, spx_prop->msg_sep.data, sep_len);
+	} else {
+		data_buffer[0] = MTL_MSG_SEP;
+		data_buffer[1] = (uint8_t)ctx_len;
+		if(ctx_len > 0) {
+			memcpy(data_buffer + 2, ctx, ctx_len);
+		}
 	}
+	dbuff_len_no_msg = sep_len + address_len;
 	memcpy(data_buffer + sep_len, address, address_len);
-	memcpy(data_buffer + sep_len + address_len, msg_buffer, msg_len);   
 
 	if(*rmtl_len == 0) {
 		*rmtl_len = hash_len;
 		rmtl_buff = calloc(1, EVP_MAX_MD_SIZE);
 		switch (algorithm) {
 			case SPX_MTL_SHA2:
-				if (spx_mtl_node_set_prf_msg_sha2(spx_prop->prf.data,
-								spx_prop->prf.length, rand,
+				if (spx_prf_msg_sha2_params(spx_prop, rand,
 								rand_len, data_buffer,
 								dbuff_len_no_msg,
 								rmtl_buff, hash_len) != 0) {
@@ -435,66 +833,377 @@ MTLSTATUS spx_mtl_node_set_hash_message(void *params,
 	} else {		
 		rmtl_buff = *rmtl;
 	}
+	if ((rmtl_buff == NULL) || (*rmtl_len > EVP_MAX_MD_SIZE)) {
+		LOG_ERROR("Invalid message randomness");
+		return MTL_BAD_PARAM;
+	}
+
+	state->params = spx_prop;
+	state->algorithm = algorithm;
+	state->hash_len = hash_len;
+	state->rmtl_len = *rmtl_len;
+	memcpy(state->rmtl, rmtl_buff, *rmtl_len);
+	state->evp = NULL;
+	state->evp_owned = 0;
 
 	// Signer operations from draft-harvey-cfrg-mtl-mode-00 Section 5.1 
 	// data_value = H_msg_mtl(R_mtl, PK.seed, PK.root, ADRS || M)
-	memset(hash, 0, EVP_MAX_MD_SIZE);
-	buffer_len =
-	    *rmtl_len + spx_prop->pk_seed.length + spx_prop->pk_root.length +
-	    dbuff_len_w_msg;
-	buffer = malloc(buffer_len + EVP_MAX_MD_SIZE);
-	buffer_offset = 0;
-
-	BUFFER_APPEND(buffer, buffer_offset, rmtl_buff, *rmtl_len);
-	BUFFER_APPEND(buffer, buffer_offset,
-		      spx_prop->pk_seed.seed, spx_prop->pk_seed.length);
-	BUFFER_APPEND(buffer, buffer_offset,
-		      spx_prop->pk_root.key, spx_prop->pk_root.length);
-	BUFFER_APPEND(buffer, buffer_offset, data_buffer,
-	          dbuff_len_w_msg);
-
+	// The message is streamed after the sep || ADRS prefix
 	switch (algorithm) {
 	case SPX_MTL_SHA2:
 		// H_msg_mtl from draft-harvey-cfrg-mtl-mode-00 Section 10.2.1 
 		// hash = SHA-X(R || PK.seed || PK.root || M)
-		// H_msg_mtl = MGF1-SHA-X(R || PK.seed || hash, n)
-		if (hash_len <= 16) {
-			sha256(&hash[0], buffer, buffer_len);
-			tmp_hash_len = 32;
-		} else {
-			sha512(&hash[0], buffer, buffer_len);
-			tmp_hash_len = 64;
+		if (spx_md_provider_only()) {
+			md = SPX_MD_SHA512;
+			if (hash_len <= 16) {
+				md = SPX_MD_SHA256;
+			}
+			break;
 		}
-
-		buffer_len = *rmtl_len + spx_prop->pk_seed.length + tmp_hash_len;
-		buffer_offset = *rmtl_len + spx_prop->pk_seed.length;
-		BUFFER_APPEND(buffer, buffer_offset, &hash[0], tmp_hash_len);
-
-		memset(hash, 0, EVP_MAX_MD_SIZE);
-		// MGF1-SHA-X(R || PK.seed || hash, n)
-		if (hash_len <= 16) {
-			mgf1_256(&hash[0], hash_len, buffer, buffer_len);
-		} else {
-			mgf1_512(&hash[0], hash_len, buffer, buffer_len);
-		}
-		free(buffer);
+		sha2_init(&state->digest, hash_len);
+		sha2_update(&state->digest, rmtl_buff, *rmtl_len);
+		sha2_update(&state->digest, spx_prop->pk_seed.seed,
+			    spx_prop->pk_seed.length);
+		sha2_update(&state->digest, spx_prop->pk_root.key,
+			    spx_prop->pk_root.length);
+		sha2_update(&state->digest, data_buffer, dbuff_len_no_msg);
 		break;
 	case SPX_MTL_SHAKE:
 		// H_msg_mtl from draft-harvey-cfrg-mtl-mode-00 Section 10.1.1 
 		// H_msg_mtl = SHAKE256(R || PK.seed || PK.root || M, 8n)
-		shake256(&hash[0], buffer, buffer_len, hash_len);
-		free(buffer);
+		// R_mtl leads the input so nothing can be absorbed ahead of
+		// time, but the pieces are streamed instead of concatenated.
+		// M can be long, so it goes through OpenSSL rather than the
+		// native sponge that is tuned for short tree hashes
+		md = SPX_MD_SHAKE256;
 		break;
 	default:
 		LOG_ERROR("Invalid hashing algorithm");
 		return MTL_BAD_PARAM;
 		break;
 	}
+	if (md == SPX_MD_COUNT) {
+		return MTL_OK;
+	}
+
+	// A lent context saves an allocation per one-shot message, a
+	// streamed message owns its context until it is finished
+	state->evp = digest_ctx;
+	if (state->evp == NULL) {
+		state->evp = EVP_MD_CTX_new();
+		state->evp_owned = 1;
+	}
+	if ((state->evp == NULL) || (spx_md(md) == NULL) ||
+	    (EVP_DigestInit_ex2(state->evp, spx_md(md), NULL) != 1) ||
+	    (EVP_DigestUpdate(state->evp, rmtl_buff, *rmtl_len) != 1) ||
+	    (EVP_DigestUpdate(state->evp, spx_prop->pk_seed.seed,
+			      spx_prop->pk_seed.length) != 1) ||
+	    (EVP_DigestUpdate(state->evp, spx_prop->pk_root.key,
+			      spx_prop->pk_root.length) != 1) ||
+	    (EVP_DigestUpdate(state->evp, data_buffer,
+			      dbuff_len_no_msg) != 1)) {
+		LOG_ERROR("Unable to start message digest");
+		spx_hash_message_release(state);
+		return MTL_ERROR;
+	}
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Absorb the next piece of M into the message hash
+******************************************************************
+ * @param state:      Started message state
+ * @param msg_buffer: Byte array of the next piece of the message
+ * @param msg_len:    Length of the msg_buffer array
+ * @return MTL_OK if successful
+ */
+static MTLSTATUS spx_hash_message_absorb(SPX_MSG_STATE * state,
+					 uint8_t * msg_buffer, size_t msg_len)
+{
+	if (state->evp == NULL) {
+		sha2_update(&state->digest, msg_buffer, msg_len);
+	} else if (EVP_DigestUpdate(state->evp, msg_buffer, msg_len) != 1) {
+		LOG_ERROR("Unable to add message to digest");
+		return MTL_ERROR;
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Finish the message hash
+******************************************************************
+ * @param state: Started message state (consumed by the call)
+ * @param hash:  Pointer to byte array where hash is stored
+ * @return MTL_OK if successful
+ */
+static MTLSTATUS spx_hash_message_finish(SPX_MSG_STATE * state,
+					 uint8_t * hash)
+{
+	SPX_PARAMS *spx_prop = state->params;
+	uint8_t mgf_buffer[EVP_MAX_MD_SIZE * 3];
+	uint32_t buffer_offset = 0;
+	uint32_t buffer_len = 0;
+	unsigned int digest_len = 0;
+
+	if (state->algorithm == SPX_MTL_SHA2) {
+		// H_msg_mtl = MGF1-SHA-X(R || PK.seed || hash, n)
+		BUFFER_APPEND(mgf_buffer, buffer_offset, state->rmtl,
+			      state->rmtl_len);
+		BUFFER_APPEND(mgf_buffer, buffer_offset,
+			      spx_prop->pk_seed.seed, spx_prop->pk_seed.length);
+		if (state->evp == NULL) {
+			digest_len = sha2_final(mgf_buffer + buffer_offset,
+						&state->digest);
+		} else if (EVP_DigestFinal_ex(state->evp,
+					      mgf_buffer + buffer_offset,
+					      &digest_len) != 1) {
+			LOG_ERROR("Unable to compute digest");
+			return MTL_ERROR;
+		}
+		buffer_len = buffer_offset + digest_len;
+
+		if (state->hash_len <= 16) {
+			mgf1_256(&hash[0], state->hash_len, mgf_buffer,
+				 buffer_len);
+		} else {
+			mgf1_512(&hash[0], state->hash_len, mgf_buffer,
+				 buffer_len);
+		}
+	} else if (EVP_DigestFinalXOF(state->evp, &hash[0],
+				      state->hash_len) != 1) {
+		LOG_ERROR("Unable to compute digest");
+		return MTL_ERROR;
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Hash the message set with the rand
+******************************************************************
+ * @param params:     SPHINCS+ public key seed & key
+ * @param sid:        Series identifier for this MTL node set
+ * @param node_id:    Node identifier for this message
+ * @param rand:       PRF based rand for this message
+ * @param rand_len:   Length of the rand byte array
+ * @param msg_buffer: Byte array of the message that will be added
+ * @param msg_len:    Length of the msg_buffer array
+ * @param hash:       Pointer to byte array where hash is stored
+ * @param hash_len:   Length of hash byte array
+ * @param ctx:        MTL signature context string
+ * @param rmtl       Generated randomness bytes for the hash
+ * @param rmtl_len   Length of the randomness bytes 
+ * @param algorithm:  Type of algorithm used (#defined values) 
+ * @return 0 if successful
+ */
+MTLSTATUS spx_mtl_node_set_hash_message(void *params,
+				      SERIESID * sid,
+				      uint32_t node_id,
+				      uint8_t * rand,
+				      uint32_t rand_len,
+				      uint8_t * msg_buffer, uint32_t msg_len,
+				      uint8_t * hash, uint32_t hash_len,
+				      char * ctx, uint8_t ** rmtl,
+					  uint32_t * rmtl_len, uint8_t algorithm)
+{
+	SPX_MSG_STATE state;
+	MTLSTATUS status;
+
+	if ((params == NULL) || (rand == NULL) || (rand_len == 0)
+	    || (msg_buffer == NULL) || (msg_len == 0) || (hash == NULL)
+	    || (hash_len == 0)) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+
+	status = spx_hash_message_start(&state, params, sid, node_id, rand,
+					rand_len, hash_len, ctx, rmtl,
+					rmtl_len, algorithm,
+					spx_md_msg_ctx());
+	if (status != MTL_OK) {
+		return status;
+	}
+
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	status = spx_hash_message_absorb(&state, msg_buffer, msg_len);
+	if (status == MTL_OK) {
+		status = spx_hash_message_finish(&state, hash);
+	}
+	spx_hash_message_release(&state);
+
+	return status;
+}
+
+/*****************************************************************
+* Start hashing a message that is supplied in pieces
+******************************************************************
+ * @param params:     SPHINCS+ public key seed & key
+ * @param sid:        Series identifier for this MTL node set
+ * @param node_id:    Node identifier for this message
+ * @param rand:       PRF based rand for this message
+ * @param rand_len:   Length of the rand byte array
+ * @param hash_len:   Length of the message hash
+ * @param ctx:        MTL signature context string
+ * @param rmtl:       Generated randomness bytes for the hash
+ * @param rmtl_len:   Length of the randomness bytes
+ * @param state:      Output pointer to the allocated message state
+ * @param algorithm:  Type of algorithm used (#defined values)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS spx_mtl_node_set_hash_message_init(void *params, SERIESID * sid,
+					     uint32_t node_id, uint8_t * rand,
+					     uint32_t rand_len,
+					     uint32_t hash_len, char *ctx,
+					     uint8_t ** rmtl,
+					     uint32_t * rmtl_len,
+					     void **state, uint8_t algorithm)
+{
+	SPX_MSG_STATE *msg_state;
+	MTLSTATUS status;
+
+	if (state == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	*state = NULL;
+
+	msg_state = malloc(sizeof(SPX_MSG_STATE));
+	if (msg_state == NULL) {
+		LOG_ERROR("Unable to allocate message state");
+		return MTL_RESOURCE_FAIL;
+	}
+
+	status = spx_hash_message_start(msg_state, params, sid, node_id, rand,
+					rand_len, hash_len, ctx, rmtl,
+					rmtl_len, algorithm, NULL);
+	if (status != MTL_OK) {
+		free(msg_state);
+		return status;
+	}
+
+	*state = msg_state;
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Start hashing a message in pieces using SHA2 algorithms
+******************************************************************
+ * @param params:     SPHINCS+ public key seed & key
+ * @param sid:        Series identifier for this MTL node set
+ * @param node_id:    Node identifier for this message
+ * @param rand:       PRF based rand for this message
+ * @param rand_len:   Length of the rand byte array
+ * @param hash_len:   Length of the message hash
+ * @param ctx:        MTL signature context string
+ * @param rmtl:       Generated randomness bytes for the hash
+ * @param rmtl_len:   Length of the randomness bytes
+ * @param state:      Output pointer to the allocated message state
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_init_sha2(void *params, SERIESID * sid,
+						uint32_t node_id,
+						uint8_t * rand,
+						uint32_t rand_len,
+						uint32_t hash_len, char *ctx,
+						uint8_t ** rmtl,
+						uint32_t * rmtl_len,
+						void **state)
+{
+	return spx_mtl_node_set_hash_message_init(params, sid, node_id, rand,
+						  rand_len, hash_len, ctx,
+						  rmtl, rmtl_len, state,
+						  SPX_MTL_SHA2);
+}
+
+/*****************************************************************
+* Start hashing a message in pieces using SHAKE algorithms
+******************************************************************
+ * @param params:     SPHINCS+ public key seed & key
+ * @param sid:        Series identifier for this MTL node set
+ * @param node_id:    Node identifier for this message
+ * @param rand:       PRF based rand for this message
+ * @param rand_len:   Length of the rand byte array
+ * @param hash_len:   Length of the message hash
+ * @param ctx:        MTL signature context string
+ * @param rmtl:       Generated randomness bytes for the hash
+ * @param rmtl_len:   Length of the randomness bytes
+ * @param state:      Output pointer to the allocated message state
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_init_shake(void *params,
+						 SERIESID * sid,
+						 uint32_t node_id,
+						 uint8_t * rand,
+						 uint32_t rand_len,
+						 uint32_t hash_len, char *ctx,
+						 uint8_t ** rmtl,
+						 uint32_t * rmtl_len,
+						 void **state)
+{
+	return spx_mtl_node_set_hash_message_init(params, sid, node_id, rand,
+						  rand_len, hash_len, ctx,
+						  rmtl, rmtl_len, state,
+						  SPX_MTL_SHAKE);
+}
+
+/*****************************************************************
+* Add the next piece of a message to a message hash
+******************************************************************
+ * @param state:      Message state from spx_mtl_node_set_hash_message_init
+ * @param msg_buffer: Byte array of the next piece of the message
+ * @param msg_len:    Length of the msg_buffer array
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_update(void *state,
+					     uint8_t * msg_buffer,
+					     size_t msg_len)
+{
+	if ((state == NULL) || ((msg_buffer == NULL) && (msg_len > 0))) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
 
-	free(data_buffer);
+	if (msg_len > 0) {
+		return spx_hash_message_absorb(state, msg_buffer, msg_len);
+	}
 	return MTL_OK;
 }
 
+/*****************************************************************
+* Finish a message hash and free the message state
+******************************************************************
+ * @param state:    Message state from spx_mtl_node_set_hash_message_init
+ * @param hash:     Pointer to byte array where hash is stored
+ *                  (EVP_MAX_MD_SIZE), or NULL to discard the state
+ * @param hash_len: Length of the message hash
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_final(void *state, uint8_t * hash,
+					    uint32_t hash_len)
+{
+	SPX_MSG_STATE *msg_state = state;
+	MTLSTATUS status = MTL_OK;
+
+	if (msg_state == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+
+	if (hash != NULL) {
+		if (hash_len != msg_state->hash_len) {
+			LOG_ERROR("Message hash length mismatch");
+			status = MTL_BAD_PARAM;
+		} else {
+			memset(hash, 0, EVP_MAX_MD_SIZE);
+			status = spx_hash_message_finish(msg_state, hash);
+		}
+	}
+
+	spx_hash_message_release(msg_state);
+	free(msg_state);
+	return status;
+}
+
 /*****************************************************************
 * Hash the message set with the rand using SHA2 algorithms
 ******************************************************************
@@ -557,6 +1266,62 @@ uint8_t spx_mtl_node_set_hash_message_shake(void *params,
 					     rmtl, rmtl_len, SPX_MTL_SHAKE);
 }
 
+/*****************************************************************
+* Apply the robust mode bitmask to a data value
+******************************************************************
+ * @param spx_prop:  SPHINCS+ parameters
+ * @param adrs:      ADRS structure for the hash
+ * @param data:      Data value to mask
+ * @param data_len:  Length of the data value
+ * @param masked:    Output buffer for the masked value (data_len bytes)
+ * @param hash_len:  Length of the scheme hash
+ * @param algorithm: Type of algorithm used (#defined values) 
+ * @return 0 if successful
+ */
+static MTLSTATUS spx_robust_mask(SPX_PARAMS * spx_prop, uint8_t * adrs,
+				 uint8_t * data, uint32_t data_len,
+				 uint8_t * masked, uint32_t hash_len,
+				 uint8_t algorithm)
+{
+	uint8_t mask_buffer[EVP_MAX_MD_SIZE + ADRS_ADDR_SIZE_C];
+	uint32_t mask_buffer_len = 0;
+	uint32_t index;
+
+	mask_buffer_len = spx_prop->pk_seed.length + ADRS_ADDR_SIZE_C;
+	memset(mask_buffer, 0, mask_buffer_len);
+	memcpy(mask_buffer, spx_prop->pk_seed.seed, spx_prop->pk_seed.length);
+	memcpy(mask_buffer, adrs, ADRS_ADDR_SIZE_C);
+
+	// The mask is generated directly into the output and then xored
+	switch (algorithm) {
+	case SPX_MTL_SHA2:
+		// F from draft-harvey-cfrg-mtl-mode-00 Section 10.2.3          
+		// M_1* = M_1 xor MGF1_X(PK.seed, ADRS, 8n)
+		// length is already in bytes so is already 8n                  
+		if (hash_len <= 16) {
+			mgf1_256(masked, data_len, mask_buffer, mask_buffer_len);
+		} else {
+			mgf1_512(masked, data_len, mask_buffer, mask_buffer_len);
+		}
+		break;
+	case SPX_MTL_SHAKE:
+		// F from draft-harvey-cfrg-mtl-mode-00 Section 10.1.3          
+		// M_1* = M_1 xor SHAKE256(PK.seed, ADRS, 8n)
+		// length is already in bytes so is already 8n
+		shake256(masked, mask_buffer, mask_buffer_len, data_len);
+		break;
+	default:
+		LOG_ERROR("Invalid hashing algorithm");
+		return MTL_BAD_PARAM;
+		break;
+	}
+
+	for (index = 0; index < data_len; index++) {
+		masked[index] ^= data[index];
+	}
+	return MTL_OK;
+}
+
 /*****************************************************************
 * Algorithm 1: Hashing a Data Value to Produce a Leaf Node.
 ******************************************************************
@@ -581,11 +1346,9 @@ MTLSTATUS spx_mtl_node_set_hash_leaf(void *params,
 	uint8_t ADRS[32] = { 0 };
 	SPX_PARAMS *spx_prop = params;
 	uint8_t result;
-	uint8_t *bitmask = NULL;
-	uint8_t *mask_buffer = NULL;
-	uint32_t mask_buffer_len = 0;
-	uint8_t *tmp_buffer = NULL;
-	uint32_t index = 0;
+	uint8_t masked_stack[SPX_MASK_STACK_LEN];
+	uint8_t *masked = NULL;
+	uint8_t *data = msg_buffer;
 
 	if ((msg_buffer == NULL) || (hash == NULL) || (hash_len == 0)) {
 		LOG_ERROR("Null parameters");
@@ -594,16 +1357,12 @@ MTLSTATUS spx_mtl_node_set_hash_leaf(void *params,
 
 	switch (algorithm) {
 	case SPX_MTL_SHA2:
-		// Create address structure (Compressed)
-		ADRSLen =
-		    mtlns_adrs_compressed((uint8_t *) & ADRS, SPX_ADRS_MTL_DATA,
-					  sid, 0, node_id);
-		break;
 	case SPX_MTL_SHAKE:
-		// Create address structure (Full)
+		// Create address structure (Compressed for SHA2, else Full)
 		ADRSLen =
-		    mtlns_adrs_full((uint8_t *) & ADRS, SPX_ADRS_MTL_DATA, sid,
-				    0, node_id);
+		    spx_adrs_params(spx_prop, (uint8_t *) & ADRS,
+				    SPX_ADRS_MTL_DATA, sid, 0, node_id,
+				    algorithm);
 		break;
 	default:
 		LOG_ERROR("Invalid hashing algorithm");
@@ -614,55 +1373,25 @@ MTLSTATUS spx_mtl_node_set_hash_leaf(void *params,
 	// H_msg_mtl from draft-harvey-cfrg-mtl-mode-00 Section 8.2.1
 	// spx.F(seed, dataADRS.bytes(), data_value)
 
-	tmp_buffer = calloc(1, msg_len);
-	if (tmp_buffer == NULL) {
-		LOG_ERROR("Unable to allocate tmp_buffer");
-		return MTL_RESOURCE_FAIL;
-	}
 	// If robust variation hash address for mask and xor with data
 	if (spx_prop->robust) {
-		bitmask = calloc(1, msg_len);
-		mask_buffer_len = spx_prop->pk_seed.length + ADRS_ADDR_SIZE_C;
-		mask_buffer = calloc(1, mask_buffer_len);
-		memcpy(mask_buffer, spx_prop->pk_seed.seed,
-		       spx_prop->pk_seed.length);
-		memcpy(mask_buffer, ADRS, ADRS_ADDR_SIZE_C);
-
-		switch (algorithm) {
-		case SPX_MTL_SHA2:
-			// F from draft-harvey-cfrg-mtl-mode-00 Section 10.2.3          
-			// M_1* = M_1 xor MGF1_X(PK.seed, ADRS, 8n)
-			// length is already in bytes so is already 8n                  
-			if (hash_len <= 16) {
-				mgf1_256(bitmask, msg_len, mask_buffer,
-					 mask_buffer_len);
-			} else {
-				mgf1_512(bitmask, msg_len, mask_buffer,
-					 mask_buffer_len);
+		// Data values are hashes, so only oversized input needs the heap
+		masked = masked_stack;
+		if (msg_len > SPX_MASK_STACK_LEN) {
+			masked = malloc(msg_len);
+			if (masked == NULL) {
+				LOG_ERROR("Unable to allocate mask buffer");
+				return MTL_RESOURCE_FAIL;
 			}
-			break;
-		case SPX_MTL_SHAKE:
-			// F from draft-harvey-cfrg-mtl-mode-00 Section 10.1.3          
-			// M_1* = M_1 xor SHAKE256(PK.seed, ADRS, 8n)
-			// length is already in bytes so is already 8n
-			shake256(bitmask, mask_buffer, mask_buffer_len,
-				 msg_len);
-			break;
-		default:
-			LOG_ERROR("Invalid hashing algorithm");
-			return MTL_BAD_PARAM;
-			break;
 		}
-
-		// Apply the bit mask by XOR with the data
-		for (index = 0; index < msg_len; index++) {
-			tmp_buffer[index] = msg_buffer[index] ^ bitmask[index];
+		if (spx_robust_mask(spx_prop, &ADRS[0], msg_buffer, msg_len,
+				    masked, hash_len, algorithm) != MTL_OK) {
+			if (masked != masked_stack) {
+				free(masked);
+			}
+			return MTL_BAD_PARAM;
 		}
-
-		free(bitmask);
-		free(mask_buffer);
-	} else {
-		memcpy(tmp_buffer, msg_buffer, msg_len);
+		data = masked;
 	}
 
 	// Hash the buffer for the leaf node
@@ -671,17 +1400,15 @@ MTLSTATUS spx_mtl_node_set_hash_leaf(void *params,
 		// F from draft-harvey-cfrg-mtl-mode-00 Section 10.2.3 
 		// SHA2-256(BlockPad(PK.seed) || ADRS^c || M_1)
 		result =
-		    spx_sha2(spx_prop->pk_seed.seed, spx_prop->pk_seed.length,
-			     &ADRS[0], ADRSLen, tmp_buffer, msg_len, &hash[0],
-			     hash_len);
+		    spx_sha2_params(spx_prop, &ADRS[0], ADRSLen, data,
+				    msg_len, &hash[0], hash_len);
 		break;
 	case SPX_MTL_SHAKE:
 		// F from draft-harvey-cfrg-mtl-mode-00 Section 10.1.3 
 		// SHAKE256(PK.seed||ADRS||M_1, n)
 		result =
-		    spx_shake(spx_prop->pk_seed.seed, spx_prop->pk_seed.length,
-			      &ADRS[0], ADRSLen, tmp_buffer, msg_len, &hash[0],
-			      hash_len);
+		    spx_shake_params(spx_prop, &ADRS[0], ADRSLen, data,
+				     msg_len, &hash[0], hash_len);
 		break;
 	default:
 		LOG_ERROR("Invalid hashing algorithm");
@@ -689,7 +1416,9 @@ MTLSTATUS spx_mtl_node_set_hash_leaf(void *params,
 		break;
 	}
 
-	free(tmp_buffer);
+	if ((masked != NULL) && (masked != masked_stack)) {
+		free(masked);
+	}
 	return result;
 }
 
@@ -741,6 +1470,150 @@ uint8_t spx_mtl_node_set_hash_leaf_shake(void *params,
 					  SPX_MTL_SHAKE);
 }
 
+/*****************************************************************
+* Algorithm 1: Hashing a Batch of Data Values to Leaf Nodes.
+******************************************************************
+ * @param params:      SPHINCS+ public key seed & key
+ * @param sid:         Series ID generated for the MTL node set
+ * @param node_ids:    Message leaf indexes
+ * @param msg_buffers: Byte arrays of the messages that will be added
+ * @param msg_len:     Length of each msg_buffers array
+ * @param hashes:      Pointers to byte arrays where hashes are stored
+ * @param hash_len:    Length of each hash byte array
+ * @param count:       Number of leaves in the batch
+ * @param algorithm:   Type of algorithm used (#defined values) 
+ * @return 0 if successful 
+ */
+MTLSTATUS spx_mtl_node_set_hash_leaf_batch(void *params,
+					   SERIESID * sid,
+					   uint32_t * node_ids,
+					   uint8_t ** msg_buffers,
+					   uint32_t msg_len,
+					   uint8_t ** hashes,
+					   uint32_t hash_len,
+					   uint32_t count, uint8_t algorithm)
+{
+	uint8_t ADRS[SPX_BATCH_LANES][32];
+	uint8_t *adrs_ptrs[SPX_BATCH_LANES];
+	uint32_t ADRSLen = 0;
+	SPX_PARAMS *spx_prop = params;
+	uint32_t group;
+	uint32_t base;
+	uint32_t index;
+
+	if ((params == NULL) || (node_ids == NULL) || (msg_buffers == NULL) ||
+	    (hashes == NULL) || (hash_len == 0)) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	if ((algorithm != SPX_MTL_SHA2) && (algorithm != SPX_MTL_SHAKE)) {
+		LOG_ERROR("Invalid hashing algorithm");
+		return MTL_BAD_PARAM;
+	}
+
+	// Robust masks are seeded per node, so they take the single path
+	if (spx_prop->robust) {
+		for (index = 0; index < count; index++) {
+			if (spx_mtl_node_set_hash_leaf(params, sid,
+						       node_ids[index],
+						       msg_buffers[index],
+						       msg_len, hashes[index],
+						       hash_len,
+						       algorithm) != MTL_OK) {
+				return MTL_BAD_PARAM;
+			}
+		}
+		return MTL_OK;
+	}
+
+	for (base = 0; base < count; base += group) {
+		group = count - base;
+		if (group > SPX_BATCH_LANES) {
+			group = SPX_BATCH_LANES;
+		}
+		for (index = 0; index < group; index++) {
+			if ((msg_buffers[base + index] == NULL) ||
+			    (hashes[base + index] == NULL)) {
+				LOG_ERROR("Null parameters");
+				return MTL_NULL_PTR;
+			}
+			memset(ADRS[index], 0, sizeof(ADRS[index]));
+			ADRSLen =
+			    spx_adrs_params(spx_prop, ADRS[index],
+					    SPX_ADRS_MTL_DATA, sid, 0,
+					    node_ids[base + index], algorithm);
+			adrs_ptrs[index] = ADRS[index];
+		}
+
+		if (algorithm == SPX_MTL_SHA2) {
+			// SHA2-256(BlockPad(PK.seed) || ADRS^c || M_1) per leaf
+			spx_sha2_params_batch(spx_prop, adrs_ptrs, ADRSLen,
+					      &msg_buffers[base], msg_len,
+					      &hashes[base], hash_len, group);
+		} else {
+			// SHAKE256(PK.seed||ADRS||M_1, n) per leaf
+			spx_shake_params_batch(spx_prop, adrs_ptrs, ADRSLen,
+					       &msg_buffers[base], msg_len,
+					       &hashes[base], hash_len, group);
+		}
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Algorithm 1: SHA2 Hashing a Batch of Data Values to Leaf Nodes.
+******************************************************************
+ * @param params:      SPHINCS+ public key seed & key
+ * @param sid:         Series ID generated for the MTL node set
+ * @param node_ids:    Message leaf indexes
+ * @param msg_buffers: Byte arrays of the messages that will be added
+ * @param msg_len:     Length of each msg_buffers array
+ * @param hashes:      Pointers to byte arrays where hashes are stored
+ * @param hash_len:    Length of each hash byte array
+ * @param count:       Number of leaves in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_leaf_sha2_batch(void *params,
+					      SERIESID * sid,
+					      uint32_t * node_ids,
+					      uint8_t ** msg_buffers,
+					      uint32_t msg_len,
+					      uint8_t ** hashes,
+					      uint32_t hash_len,
+					      uint32_t count)
+{
+	return spx_mtl_node_set_hash_leaf_batch(params, sid, node_ids,
+						msg_buffers, msg_len, hashes,
+						hash_len, count, SPX_MTL_SHA2);
+}
+
+/*****************************************************************
+* Algorithm 1: SHAKE Hashing a Batch of Data Values to Leaf Nodes.
+******************************************************************
+ * @param params:      SPHINCS+ public key seed & key
+ * @param sid:         Series ID generated for the MTL node set
+ * @param node_ids:    Message leaf indexes
+ * @param msg_buffers: Byte arrays of the messages that will be added
+ * @param msg_len:     Length of each msg_buffers array
+ * @param hashes:      Pointers to byte arrays where hashes are stored
+ * @param hash_len:    Length of each hash byte array
+ * @param count:       Number of leaves in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_leaf_shake_batch(void *params,
+					       SERIESID * sid,
+					       uint32_t * node_ids,
+					       uint8_t ** msg_buffers,
+					       uint32_t msg_len,
+					       uint8_t ** hashes,
+					       uint32_t hash_len,
+					       uint32_t count)
+{
+	return spx_mtl_node_set_hash_leaf_batch(params, sid, node_ids,
+						msg_buffers, msg_len, hashes,
+						hash_len, count, SPX_MTL_SHAKE);
+}
+
 /*****************************************************************
 * Algorithm 2: Hashing Two Child Nodes to Produce an Internal Node.
 ******************************************************************
@@ -765,33 +1638,30 @@ MTLSTATUS spx_mtl_node_set_hash_int(void *params,
 {
 	uint32_t ADRSLen = ADRS_ADDR_SIZE_C;
 	uint8_t ADRS[32] = { 0 };
-	uint8_t *buffer;
+	uint8_t buffer[SPX_MASK_STACK_LEN];
+	uint8_t masked[SPX_MASK_STACK_LEN];
+	uint8_t *data = buffer;
 	SPX_PARAMS *spx_prop = params;
-	uint8_t result;
+	uint8_t result = MTL_BAD_PARAM;
 	uint32_t buffer_len = hash_len * 2;
-	uint8_t *tmp_buffer = NULL;
-	uint8_t *bitmask = NULL;
-	uint8_t *mask_buffer = NULL;
-	uint32_t mask_buffer_len = 0;
-	uint32_t index;
 
 	if (hash == NULL) {
 		LOG_ERROR("Null parameters");
 		return MTL_NULL_PTR;
 	}
+	if (buffer_len > SPX_MASK_STACK_LEN) {
+		LOG_ERROR("Invalid hash length");
+		return MTL_BAD_PARAM;
+	}
 	// spx.H(seed, mtlnsADRS.bytes(), (left_hash, right_hash))
 	switch (algorithm) {
 	case SPX_MTL_SHA2:
-		// Create address structure (Compressed)
-		ADRSLen =
-		    mtlns_adrs_compressed((uint8_t *) & ADRS, SPX_ADRS_MTL_TREE,
-					  sid, node_left, node_right);
-		break;
 	case SPX_MTL_SHAKE:
-		// Create address structure (Full)
+		// Create address structure (Compressed for SHA2, else Full)
 		ADRSLen =
-		    mtlns_adrs_full((uint8_t *) & ADRS, SPX_ADRS_MTL_TREE, sid,
-				    node_left, node_right);
+		    spx_adrs_params(spx_prop, (uint8_t *) & ADRS,
+				    SPX_ADRS_MTL_TREE, sid, node_left,
+				    node_right, algorithm);
 		break;
 	default:
 		LOG_ERROR("Invalid hashing algorithm");
@@ -799,81 +1669,36 @@ MTLSTATUS spx_mtl_node_set_hash_int(void *params,
 	}
 
 	// Concatenate the left and right hashes
-	buffer = malloc(buffer_len);
-	if (buffer == NULL) {
-		LOG_ERROR("Unable to allocate buffer");
-		return MTL_RESOURCE_FAIL;
-	}
 	memcpy(buffer, hash_left, hash_len);
 	memcpy(buffer + hash_len, hash_right, hash_len);
 
 	// If robust variation hash address for mask and xor with data
+	// from draft-harvey-cfrg-mtl-mode-00 Section 10.1.3 and 10.2.3
+	// (M_1 || M_2)* = (M_1 || M_2)* xor MGF1_X/SHAKE256(PK.seed, ADRS, 16n)
 	if (spx_prop->robust) {
-		tmp_buffer = calloc(1, buffer_len);
-		bitmask = calloc(1, buffer_len);
-		mask_buffer_len = spx_prop->pk_seed.length + ADRS_ADDR_SIZE_C;
-		mask_buffer = calloc(1, mask_buffer_len);
-		memcpy(mask_buffer, spx_prop->pk_seed.seed,
-		       spx_prop->pk_seed.length);
-		memcpy(mask_buffer, ADRS, ADRS_ADDR_SIZE_C);
-
-		switch (algorithm) {
-		case SPX_MTL_SHA2:
-			// from draft-harvey-cfrg-mtl-mode-00 Section 10.2.3
-			// (M_1 || M_2)* = (M_1 || M_2)* xor MFG1_X(PK.seed, ADRS, 16n) 
-			// length is already in bytes so is already 8n  
-			if (hash_len <= 16) {
-				mgf1_256(bitmask, buffer_len, mask_buffer,
-					 mask_buffer_len);
-			} else {
-				mgf1_512(bitmask, buffer_len, mask_buffer,
-					 mask_buffer_len);
-			}
-			break;
-		case SPX_MTL_SHAKE:
-			// from draft-harvey-cfrg-mtl-mode-00 Section 10.1.3 
-			// (M_1 || M_2)* = (M_1 || M_2)* xor SHAKE256(PK.seed, ADRS, 16n)                       
-			// length is already in bytes so is already 8n
-			shake256(bitmask, mask_buffer, mask_buffer_len,
-				 buffer_len);
-			break;
-		default:
-			LOG_ERROR("Invalid hashing algorithm");
-			break;
-		}
-
-		// XOR the bitmask with the buffer
-		for (index = 0; index < buffer_len; index++) {
-			tmp_buffer[index] = buffer[index] ^ bitmask[index];
-		}
-
-		memcpy(buffer, tmp_buffer, buffer_len);
-		free(bitmask);
-		free(tmp_buffer);
-		free(mask_buffer);
+		spx_robust_mask(spx_prop, &ADRS[0], buffer, buffer_len, masked,
+				hash_len, algorithm);
+		data = masked;
 	}
 
 	switch (algorithm) {
 	case SPX_MTL_SHA2:
 		// H from draft-harvey-cfrg-mtl-mode-00 Section 10.2.3 
 		// SHA-X(BlockPad(PK.seed) || ADRS^c || (M_1 ||M_2)*)   
-		result = spx_sha2(spx_prop->pk_seed.seed,
-				  spx_prop->pk_seed.length, &ADRS[0], ADRSLen,
-				  buffer, buffer_len, &hash[0], hash_len);
+		result = spx_sha2_params(spx_prop, &ADRS[0], ADRSLen,
+					 data, buffer_len, &hash[0], hash_len);
 		break;
 	case SPX_MTL_SHAKE:
 		// H from draft-harvey-cfrg-mtl-mode-00 Section 10.1.3 
 		// SHAKE256(PK.seed || ADRS || (M_1 ||M_2)*, 8n)
-		result = spx_shake(spx_prop->pk_seed.seed,
-				   spx_prop->pk_seed.length, &ADRS[0], ADRSLen,
-				   buffer, buffer_len, &hash[0], hash_len);
+		result = spx_shake_params(spx_prop, &ADRS[0], ADRSLen,
+					  data, buffer_len, &hash[0], hash_len);
 		break;
 	default:
 		LOG_ERROR("Invalid hashing algorithm");
 		break;
 	}
 
-	free(buffer);
 	return result;
 }
 
@@ -928,3 +1753,667 @@ uint8_t spx_mtl_node_set_hash_int_shake(void *params,
 					 hash_left, hash_right, hash, hash_len,
 					 SPX_MTL_SHAKE);
 }
+
+/*****************************************************************
+* Algorithm 2: Hashing a Batch of Child Pairs to Internal Nodes.
+******************************************************************
+ * @param params:      SPHINCS+ public key seed & key
+ * @param sid:         Series ID generated for the MTL node set
+ * @param node_left:   Node Ids for the left child nodes
+ * @param node_right:  Node Ids for the right child nodes
+ * @param hash_left:   Pointers to byte arrays for left child hashes
+ * @param hash_right:  Pointers to byte arrays for right child hashes
+ * @param hash:        Pointers where the resulting hashes are placed
+ * @param hash_len:    Length of each hash byte array
+ * @param count:       Number of internal nodes in the batch
+ * @param algorithm:   Type of algorithm used (#defined values) 
+ * @return 0 if successful 
+ */
+MTLSTATUS spx_mtl_node_set_hash_int_batch(void *params,
+					  SERIESID * sid,
+					  uint32_t * node_left,
+					  uint32_t * node_right,
+					  uint8_t ** hash_left,
+					  uint8_t ** hash_right,
+					  uint8_t ** hash,
+					  uint32_t hash_len,
+					  uint32_t count, uint8_t algorithm)
+{
+	uint8_t ADRS[SPX_BATCH_LANES][32];
+	uint8_t buffer[SPX_BATCH_LANES][SPX_MASK_STACK_LEN];
+	uint8_t *adrs_ptrs[SPX_BATCH_LANES];
+	uint8_t *data_ptrs[SPX_BATCH_LANES];
+	uint32_t ADRSLen = 0;
+	SPX_PARAMS *spx_prop = params;
+	uint32_t buffer_len = hash_len * 2;
+	uint32_t group;
+	uint32_t base;
+	uint32_t index;
+
+	if ((params == NULL) || (node_left == NULL) || (node_right == NULL) ||
+	    (hash_left == NULL) || (hash_right == NULL) || (hash == NULL)) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	if ((hash_len == 0) || (buffer_len > SPX_MASK_STACK_LEN)) {
+		LOG_ERROR("Invalid hash length");
+		return MTL_BAD_PARAM;
+	}
+	if ((algorithm != SPX_MTL_SHA2) && (algorithm != SPX_MTL_SHAKE)) {
+		LOG_ERROR("Invalid hashing algorithm");
+		return MTL_BAD_PARAM;
+	}
+
+	// Robust masks are seeded per node, so they take the single path
+	if (spx_prop->robust) {
+		for (index = 0; index < count; index++) {
+			if (spx_mtl_node_set_hash_int(params, sid,
+						      node_left[index],
+						      node_right[index],
+						      hash_left[index],
+						      hash_right[index],
+						      hash[index], hash_len,
+						      algorithm) != MTL_OK) {
+				return MTL_BAD_PARAM;
+			}
+		}
+		return MTL_OK;
+	}
+
+	for (base = 0; base < count; base += group) {
+		group = count - base;
+		if (group > SPX_BATCH_LANES) {
+			group = SPX_BATCH_LANES;
+		}
+		for (index = 0; index < group; index++) {
+			if (hash[base + index] == NULL) {
+				LOG_ERROR("Null parameters");
+				return MTL_NULL_PTR;
+			}
+			memset(ADRS[index], 0, sizeof(ADRS[index]));
+			ADRSLen =
+			    spx_adrs_params(spx_prop, ADRS[index],
+					    SPX_ADRS_MTL_TREE, sid,
+					    node_left[base + index],
+					    node_right[base + index], algorithm);
+			adrs_ptrs[index] = ADRS[index];
+
+			// Concatenate the left and right hashes
+			memcpy(buffer[index], hash_left[base + index], hash_len);
+			memcpy(buffer[index] + hash_len,
+			       hash_right[base + index], hash_len);
+			data_ptrs[index] = buffer[index];
+		}
+
+		if (algorithm == SPX_MTL_SHA2) {
+			// SHA-X(BlockPad(PK.seed) || ADRS^c || (M_1 ||M_2)) per node
+			spx_sha2_params_batch(spx_prop, adrs_ptrs, ADRSLen,
+					      data_ptrs, buffer_len,
+					      &hash[base], hash_len, group);
+		} else {
+			// SHAKE256(PK.seed || ADRS || (M_1 ||M_2), 8n) per node
+			spx_shake_params_batch(spx_prop, adrs_ptrs, ADRSLen,
+					       data_ptrs, buffer_len,
+					       &hash[base], hash_len, group);
+		}
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Algorithm 2: SHA2 Hashing a Batch of Child Pairs to Internal Nodes.
+******************************************************************
+ * @param params:      SPHINCS+ public key seed & key
+ * @param sid:         Series ID generated for the MTL node set
+ * @param node_left:   Node Ids for the left child nodes
+ * @param node_right:  Node Ids for the right child nodes
+ * @param hash_left:   Pointers to byte arrays for left child hashes
+ * @param hash_right:  Pointers to byte arrays for right child hashes
+ * @param hash:        Pointers where the resulting hashes are placed
+ * @param hash_len:    Length of each hash byte array
+ * @param count:       Number of internal nodes in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_int_sha2_batch(void *params,
+					     SERIESID * sid,
+					     uint32_t * node_left,
+					     uint32_t * node_right,
+					     uint8_t ** hash_left,
+					     uint8_t ** hash_right,
+					     uint8_t ** hash,
+					     uint32_t hash_len,
+					     uint32_t count)
+{
+	return spx_mtl_node_set_hash_int_batch(params, sid, node_left,
+					       node_right, hash_left,
+					       hash_right, hash, hash_len,
+					       count, SPX_MTL_SHA2);
+}
+
+/*****************************************************************
+* Algorithm 2: SHAKE Hashing a Batch of Child Pairs to Internal Nodes.
+******************************************************************
+ * @param params:      SPHINCS+ public key seed & key
+ * @param sid:         Series ID generated for the MTL node set
+ * @param node_left:   Node Ids for the left child nodes
+ * @param node_right:  Node Ids for the right child nodes
+ * @param hash_left:   Pointers to byte arrays for left child hashes
+ * @param hash_right:  Pointers to byte arrays for right child hashes
+ * @param hash:        Pointers where the resulting hashes are placed
+ * @param hash_len:    Length of each hash byte array
+ * @param count:       Number of internal nodes in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_int_shake_batch(void *params,
+					      SERIESID * sid,
+					      uint32_t * node_left,
+					      uint32_t * node_right,
+					      uint8_t ** hash_left,
+					      uint8_t ** hash_right,
+					      uint8_t ** hash,
+					      uint32_t hash_len,
+					      uint32_t count)
+{
+	return spx_mtl_node_set_hash_int_batch(params, sid, node_left,
+					       node_right, hash_left,
+					       hash_right, hash, hash_len,
+					       count, SPX_MTL_SHAKE);
+}
+
+
+/*****************************************************************
+* Parameter set specific node hashing
+******************************************************************
+ * The generic node hashes above branch on the algorithm, the hash
+ * length and the robust flag for every hash.  The kernels below are
+ * generated once per (hash family, n) pair from sig_algos so those
+ * are compile time constants, and the ADRS build, the child copies
+ * and the digest truncation are fixed size.  Whether the parameters
+ * suit a kernel is checked once by spx_params_init_node_funcs, and
+ * anything else is passed to the generic functions.
+ */
+#if defined(__GNUC__)
+#define SPX_KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define SPX_KERNEL_INLINE static inline
+#endif
+
+/** Hash family and length pairs that get their own kernels */
+#define SPX_NODE_KERNELS(X) \
+	X(sha2, SPX_MTL_SHA2, 16) \
+	X(sha2, SPX_MTL_SHA2, 24) \
+	X(sha2, SPX_MTL_SHA2, 32) \
+	X(shake, SPX_MTL_SHAKE, 16) \
+	X(shake, SPX_MTL_SHAKE, 24) \
+	X(shake, SPX_MTL_SHAKE, 32)
+
+/*****************************************************************
+* Check the parameters were selected for a kernel
+******************************************************************
+ * @param spx_prop:  SPHINCS+ parameters
+ * @param algorithm: Type of algorithm used (#defined values)
+ * @param n:         Length of the scheme hash
+ * @return 1 if the kernel can run, 0 to use the generic function
+ */
+SPX_KERNEL_INLINE uint8_t spx_kernel_ready(SPX_PARAMS * spx_prop,
+					   const uint8_t algorithm,
+					   const uint32_t n)
+{
+	return ((spx_prop->node_funcs != NULL) &&
+		(spx_prop->node_funcs->algorithm == algorithm) &&
+		(spx_prop->node_funcs->hash_len == n));
+}
+
+/*****************************************************************
+* Build the ADRS structure from the parameter template
+******************************************************************
+ * @param adrs:      Bytes array to hold the ADRS structure
+ * @param spx_prop:  SPHINCS+ parameters
+ * @param type:      ADRS type
+ * @param left:      MTL tree address left value
+ * @param right:     MTL tree address right value
+ * @param algorithm: Type of algorithm used (#defined values)
+ * @return None
+ */
+SPX_KERNEL_INLINE void spx_kernel_adrs(uint8_t * adrs,
+				       SPX_PARAMS * spx_prop,
+				       const uint8_t type,
+				       uint32_t left, uint32_t right,
+				       const uint8_t algorithm)
+{
+	if (algorithm == SPX_MTL_SHA2) {
+		// Compressed: layer || SID || type || pad || left || right
+		memcpy(adrs, spx_prop->adrs.compressed[type - SPX_ADRS_MTL_MSG],
+		       ADRS_ADDR_SIZE_C);
+		uint32_to_bytes(&adrs[ADRS_ADDR_2_C], left);
+		uint32_to_bytes(&adrs[ADRS_ADDR_3_C], right);
+	} else {
+		// Full: the SID is right aligned in the 12 byte tree address
+		memcpy(adrs, spx_prop->adrs.full[type - SPX_ADRS_MTL_MSG],
+		       ADRS_ADDR_SIZE);
+		uint32_to_bytes(&adrs[ADRS_ADDR_2], left);
+		uint32_to_bytes(&adrs[ADRS_ADDR_3], right);
+	}
+}
+
+/*****************************************************************
+* Hash one node input of fixed shape with the parameter seed state
+******************************************************************
+ * @param spx_prop:  SPHINCS+ parameters
+ * @param adrs:      ADRS structure from spx_kernel_adrs
+ * @param data:      Data value to hash (data_len bytes)
+ * @param data_len:  Length of the data value
+ * @param hash:      Output hash (n bytes)
+ * @param algorithm: Type of algorithm used (#defined values)
+ * @param n:         Length of the scheme hash
+ * @return None
+ */
+SPX_KERNEL_INLINE void spx_kernel_hash(SPX_PARAMS * spx_prop, uint8_t * adrs,
+				       uint8_t * data, const uint32_t data_len,
+				       uint8_t * hash, const uint8_t algorithm,
+				       const uint32_t n)
+{
+	uint8_t digest[EVP_MAX_MD_SIZE];
+
+	if (algorithm == SPX_MTL_SHA2) {
+		// SHA-X(BlockPad(PK.seed) || ADRS^c || M) truncated to n
+		sha2_seeded(digest, &spx_prop->sha2_seed, adrs,
+			    ADRS_ADDR_SIZE_C, data, data_len);
+		memcpy(hash, digest, n);
+	} else {
+		// SHAKE256(PK.seed || ADRS || M, 8n)
+		shake_seeded(hash, &spx_prop->shake_seed, adrs, ADRS_ADDR_SIZE,
+			     data, data_len, n);
+	}
+}
+
+/*****************************************************************
+* Hash a group of node inputs of fixed shape with the seed state
+******************************************************************
+ * @param spx_prop:  SPHINCS+ parameters
+ * @param adrs:      ADRS structures from spx_kernel_adrs
+ * @param data:      Data values to hash (data_len bytes each)
+ * @param data_len:  Length of each data value
+ * @param hash:      Output hashes (n bytes each)
+ * @param count:     Number of hashes (at most SPX_BATCH_LANES)
+ * @param algorithm: Type of algorithm used (#defined values)
+ * @param n:         Length of the scheme hash
+ * @return None
+ */
+SPX_KERNEL_INLINE void spx_kernel_hash_group(SPX_PARAMS * spx_prop,
+					     uint8_t ** adrs, uint8_t ** data,
+					     const uint32_t data_len,
+					     uint8_t ** hash, uint32_t count,
+					     const uint8_t algorithm,
+					     const uint32_t n)
+{
+	uint8_t digests[SPX_BATCH_LANES][EVP_MAX_MD_SIZE];
+	uint8_t *digest_ptrs[SPX_BATCH_LANES];
+	uint32_t index;
+
+	if (algorithm == SPX_MTL_SHA2) {
+		// Full digests land on the stack, callers only get n bytes
+		for (index = 0; index < count; index++) {
+			digest_ptrs[index] = digests[index];
+		}
+		sha2_seeded_batch(digest_ptrs, &spx_prop->sha2_seed, adrs,
+				  ADRS_ADDR_SIZE_C, data, data_len, count);
+		for (index = 0; index < count; index++) {
+			memcpy(hash[index], digests[index], n);
+		}
+	} else {
+		shake_seeded_batch(hash, &spx_prop->shake_seed, adrs,
+				   ADRS_ADDR_SIZE, data, data_len, n, count);
+	}
+}
+
+/*****************************************************************
+* Algorithm 1: Leaf node hash for a fixed hash family and length
+******************************************************************
+ * @param params:     SPHINCS+ public key seed & key
+ * @param sid:        Series ID generated for the MTL node set
+ * @param node_id:    Message leaf index
+ * @param msg_buffer: Data value for the leaf
+ * @param msg_len:    Length of the data value
+ * @param hash:       Pointer to byte array where hash is stored
+ * @param hash_len:   Length of hash byte array
+ * @param algorithm:  Type of algorithm used (#defined values)
+ * @param n:          Length of the scheme hash
+ * @return 0 if successful
+ */
+SPX_KERNEL_INLINE MTLSTATUS spx_kernel_leaf(void *params, SERIESID * sid,
+					    uint32_t node_id,
+					    uint8_t * msg_buffer,
+					    uint32_t msg_len, uint8_t * hash,
+					    uint32_t hash_len,
+					    const uint8_t algorithm,
+					    const uint32_t n)
+{
+	uint8_t adrs[ADRS_ADDR_SIZE];
+
+	if (params == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	if ((msg_buffer == NULL) || (hash == NULL) || (msg_len != n) ||
+	    (hash_len != n) || (!spx_kernel_ready(params, algorithm, n))) {
+		return spx_mtl_node_set_hash_leaf(params, sid, node_id,
+						  msg_buffer, msg_len, hash,
+						  hash_len, algorithm);
+	}
+
+	spx_kernel_adrs(adrs, params, SPX_ADRS_MTL_DATA, 0, node_id,
+			algorithm);
+	spx_kernel_hash(params, adrs, msg_buffer, n, hash, algorithm, n);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Algorithm 2: Internal node hash for a fixed hash family and length
+******************************************************************
+ * @param params:     SPHINCS+ public key seed & key
+ * @param sid:        Series ID generated for the MTL node set
+ * @param node_left:  Node Id for the left child node
+ * @param node_right: Node Id for the right child node
+ * @param hash_left:  Pointer to byte array for left child hash
+ * @param hash_right: Pointer to byte array for right child hash
+ * @param hash:       Pointer where the resulting hash is placed
+ * @param hash_len:   Length of hash byte array
+ * @param algorithm:  Type of algorithm used (#defined values)
+ * @param n:          Length of the scheme hash
+ * @return 0 if successful
+ */
+SPX_KERNEL_INLINE MTLSTATUS spx_kernel_int(void *params, SERIESID * sid,
+					   uint32_t node_left,
+					   uint32_t node_right,
+					   uint8_t * hash_left,
+					   uint8_t * hash_right,
+					   uint8_t * hash, uint32_t hash_len,
+					   const uint8_t algorithm,
+					   const uint32_t n)
+{
+	uint8_t adrs[ADRS_ADDR_SIZE];
+	uint8_t buffer[SPX_MASK_STACK_LEN];
+
+	if (params == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	if ((hash_left == NULL) || (hash_right == NULL) || (hash == NULL) ||
+	    (hash_len != n) || (!spx_kernel_ready(params, algorithm, n))) {
+		return spx_mtl_node_set_hash_int(params, sid, node_left,
+						 node_right, hash_left,
+						 hash_right, hash, hash_len,
+						 algorithm);
+	}
+
+	spx_kernel_adrs(adrs, params, SPX_ADRS_MTL_TREE, node_left,
+			node_right, algorithm);
+	memcpy(buffer, hash_left, n);
+	memcpy(buffer + n, hash_right, n);
+	spx_kernel_hash(params, adrs, buffer, 2 * n, hash, algorithm, n);
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Algorithm 1: Batch leaf node hash for a fixed family and length
+******************************************************************
+ * @param params:      SPHINCS+ public key seed & key
+ * @param sid:         Series ID generated for the MTL node set
+ * @param node_ids:    Message leaf indexes
+ * @param msg_buffers: Data values for the leaves
+ * @param msg_len:     Length of each data value
+ * @param hashes:      Pointers to byte arrays where hashes are stored
+ * @param hash_len:    Length of each hash byte array
+ * @param count:       Number of leaves in the batch
+ * @param algorithm:   Type of algorithm used (#defined values)
+ * @param n:           Length of the scheme hash
+ * @return 0 if successful
+ */
+SPX_KERNEL_INLINE MTLSTATUS spx_kernel_leaf_batch(void *params,
+						  SERIESID * sid,
+						  uint32_t * node_ids,
+						  uint8_t ** msg_buffers,
+						  uint32_t msg_len,
+						  uint8_t ** hashes,
+						  uint32_t hash_len,
+						  uint32_t count,
+						  const uint8_t algorithm,
+						  const uint32_t n)
+{
+	uint8_t adrs[SPX_BATCH_LANES][ADRS_ADDR_SIZE];
+	uint8_t *adrs_ptrs[SPX_BATCH_LANES];
+	uint32_t group;
+	uint32_t base;
+	uint32_t index;
+
+	if (params == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	if ((node_ids == NULL) || (msg_buffers == NULL) || (hashes == NULL) ||
+	    (msg_len != n) || (hash_len != n) ||
+	    (!spx_kernel_ready(params, algorithm, n))) {
+		return spx_mtl_node_set_hash_leaf_batch(params, sid, node_ids,
+							msg_buffers, msg_len,
+							hashes, hash_len,
+							count, algorithm);
+	}
+	for (base = 0; base < count; base += group) {
+		group = count - base;
+		if (group > SPX_BATCH_LANES) {
+			group = SPX_BATCH_LANES;
+		}
+		for (index = 0; index < group; index++) {
+			if ((msg_buffers[base + index] == NULL) ||
+			    (hashes[base + index] == NULL)) {
+				LOG_ERROR("Null parameters");
+				return MTL_NULL_PTR;
+			}
+			spx_kernel_adrs(adrs[index], params, SPX_ADRS_MTL_DATA,
+					0, node_ids[base + index], algorithm);
+			adrs_ptrs[index] = adrs[index];
+		}
+		spx_kernel_hash_group(params, adrs_ptrs, &msg_buffers[base], n,
+				      &hashes[base], group, algorithm, n);
+	}
+	return MTL_OK;
+}
+
+/*****************************************************************
+* Algorithm 2: Batch internal node hash for a fixed family and length
+******************************************************************
+ * @param params:     SPHINCS+ public key seed & key
+ * @param sid:        Series ID generated for the MTL node set
+ * @param node_left:  Node Ids for the left child nodes
+ * @param node_right: Node Ids for the right child nodes
+ * @param hash_left:  Pointers to byte arrays for left child hashes
+ * @param hash_right: Pointers to byte arrays for right child hashes
+ * @param hash:       Pointers where the resulting hashes are placed
+ * @param hash_len:   Length of each hash byte array
+ * @param count:      Number of internal nodes in the batch
+ * @param algorithm:  Type of algorithm used (#defined values)
+ * @param n:          Length of the scheme hash
+ * @return 0 if successful
+ */
+SPX_KERNEL_INLINE MTLSTATUS spx_kernel_int_batch(void *params,
+						 SERIESID * sid,
+						 uint32_t * node_left,
+						 uint32_t * node_right,
+						 uint8_t ** hash_left,
+						 uint8_t ** hash_right,
+						 uint8_t ** hash,
+						 uint32_t hash_len,
+						 uint32_t count,
+						 const uint8_t algorithm,
+						 const uint32_t n)
+{
+	uint8_t adrs[SPX_BATCH_LANES][ADRS_ADDR_SIZE];
+	uint8_t buffer[SPX_BATCH_LANES][SPX_MASK_STACK_LEN];
+	uint8_t *adrs_ptrs[SPX_BATCH_LANES];
+	uint8_t *data_ptrs[SPX_BATCH_LANES];
+	uint32_t group;
+	uint32_t base;
+	uint32_t index;
+
+	if (params == NULL) {
+		LOG_ERROR("Null parameters");
+		return MTL_NULL_PTR;
+	}
+	if ((node_left == NULL) || (node_right == NULL) ||
+	    (hash_left == NULL) || (hash_right == NULL) || (hash == NULL) ||
+	    (hash_len != n) || (!spx_kernel_ready(params, algorithm, n))) {
+		return spx_mtl_node_set_hash_int_batch(params, sid, node_left,
+						       node_right, hash_left,
+						       hash_right, hash,
+						       hash_len, count,
+						       algorithm);
+	}
+	for (base = 0; base < count; base += group) {
+		group = count - base;
+		if (group > SPX_BATCH_LANES) {
+			group = SPX_BATCH_LANES;
+		}
+		for (index = 0; index < group; index++) {
+			if ((hash_left[base + index] == NULL) ||
+			    (hash_right[base + index] == NULL) ||
+			    (hash[base + index] == NULL)) {
+				LOG_ERROR("Null parameters");
+				return MTL_NULL_PTR;
+			}
+			spx_kernel_adrs(adrs[index], params, SPX_ADRS_MTL_TREE,
+					node_left[base + index],
+					node_right[base + index], algorithm);
+			adrs_ptrs[index] = adrs[index];
+
+			// Concatenate the left and right hashes
+			memcpy(buffer[index], hash_left[base + index], n);
+			memcpy(buffer[index] + n, hash_right[base + index], n);
+			data_ptrs[index] = buffer[index];
+		}
+		spx_kernel_hash_group(params, adrs_ptrs, data_ptrs, 2 * n,
+				      &hash[base], group, algorithm, n);
+	}
+	return MTL_OK;
+}
+
+/** Emit the four node set entry points for one (family, n) pair */
+#define SPX_NODE_KERNEL_DEFINE(family, algorithm, n) \
+static uint8_t spx_hash_leaf_##family##_##n(void *params, SERIESID * sid, \
+	uint32_t node_id, uint8_t * msg_buffer, uint32_t msg_len, \
+	uint8_t * hash, uint32_t hash_len) \
+{ \
+	return spx_kernel_leaf(params, sid, node_id, msg_buffer, msg_len, \
+			       hash, hash_len, algorithm, n); \
+} \
+static uint8_t spx_hash_int_##family##_##n(void *params, SERIESID * sid, \
+	uint32_t node_left, uint32_t node_right, uint8_t * hash_left, \
+	uint8_t * hash_right, uint8_t * hash, uint32_t hash_len) \
+{ \
+	return spx_kernel_int(params, sid, node_left, node_right, hash_left, \
+			      hash_right, hash, hash_len, algorithm, n); \
+} \
+static uint8_t spx_hash_leaf_##family##_##n##_batch(void *params, \
+	SERIESID * sid, uint32_t * node_ids, uint8_t ** msg_buffers, \
+	uint32_t msg_len, uint8_t ** hashes, uint32_t hash_len, \
+	uint32_t count) \
+{ \
+	return spx_kernel_leaf_batch(params, sid, node_ids, msg_buffers, \
+				     msg_len, hashes, hash_len, count, \
+				     algorithm, n); \
+} \
+static uint8_t spx_hash_int_##family##_##n##_batch(void *params, \
+	SERIESID * sid, uint32_t * node_left, uint32_t * node_right, \
+	uint8_t ** hash_left, uint8_t ** hash_right, uint8_t ** hash, \
+	uint32_t hash_len, uint32_t count) \
+{ \
+	return spx_kernel_int_batch(params, sid, node_left, node_right, \
+				    hash_left, hash_right, hash, hash_len, \
+				    count, algorithm, n); \
+}
+
+SPX_NODE_KERNELS(SPX_NODE_KERNEL_DEFINE)
+
+/** Table entry for one (family, n) pair */
+#define SPX_NODE_KERNEL_ENTRY(family, algorithm, n) \
+	{ algorithm, n, spx_hash_leaf_##family##_##n, \
+	  spx_hash_int_##family##_##n, spx_hash_leaf_##family##_##n##_batch, \
+	  spx_hash_int_##family##_##n##_batch },
+
+static const SPX_NODE_FUNCS spx_node_kernels[] = {
+	SPX_NODE_KERNELS(SPX_NODE_KERNEL_ENTRY)
+};
+
+/*****************************************************************
+* Find the node hash functions specialized for a parameter set
+******************************************************************
+ * @param algorithm: Type of algorithm used (#defined values)
+ * @param hash_len:  Length of the scheme hash
+ * @return function table, or NULL if there is no specialization
+ */
+const SPX_NODE_FUNCS *spx_node_funcs(uint8_t algorithm, uint32_t hash_len)
+{
+	uint32_t index;
+
+	for (index = 0;
+	     index < sizeof(spx_node_kernels) / sizeof(spx_node_kernels[0]);
+	     index++) {
+		if ((spx_node_kernels[index].algorithm == algorithm) &&
+		    (spx_node_kernels[index].hash_len == hash_len)) {
+			return &spx_node_kernels[index];
+		}
+	}
+	return NULL;
+}
+
+/*****************************************************************
+* Select the node hash kernels the parameters can serve
+******************************************************************
+ * @param params:    SPHINCS+ parameters with the seed state and the
+ *                   ADRS templates built
+ * @param algorithm: Type of algorithm used (#defined values)
+ * @param hash_len:  Length of the scheme hash
+ * @return function table, or NULL to use the generic functions
+ */
+const SPX_NODE_FUNCS *spx_params_init_node_funcs(SPX_PARAMS * params,
+						 uint8_t algorithm,
+						 uint32_t hash_len)
+{
+	const SPX_NODE_FUNCS *funcs = NULL;
+	uint8_t ready = 0;
+
+	if (params == NULL) {
+		return NULL;
+	}
+	params->node_funcs = NULL;
+
+	funcs = spx_node_funcs(algorithm, hash_len);
+	if ((funcs == NULL) || (params->robust) ||
+	    (params->pk_seed.length != hash_len) ||
+	    (params->adrs.ready != SPX_STATE_READY) ||
+	    (params->adrs.sid.length != ADRS_TREE_ADDR_C_LEN)) {
+		return NULL;
+	}
+
+	// The kernels hash from the precomputed seed state without
+	// checking it, so it has to be for this seed and length
+	if (algorithm == SPX_MTL_SHA2) {
+		ready = ((params->sha2_seed.ready == SPX_STATE_READY)
+			 && (params->sha2_seed.seed_len == hash_len)
+			 && ((params->sha2_seed.digest.hash_len <= 16) ==
+			     (hash_len <= 16))
+			 && (memcmp(params->sha2_seed.seed,
+				    params->pk_seed.seed, hash_len) == 0));
+	} else {
+		ready = ((params->shake_seed.ready == SPX_STATE_READY)
+			 && (params->shake_seed.seed_len == hash_len)
+			 && (memcmp(params->shake_seed.seed,
+				    params->pk_seed.seed, hash_len) == 0));
+	}
+	if (!ready) {
+		return NULL;
+	}
+
+	params->node_funcs = funcs;
+	return funcs;
+}
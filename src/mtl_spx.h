@@ -45,6 +45,7 @@
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include "mtl_node_set.h"
+#include "spx_state.h"
 #include <math.h>
 
 // Definitions
@@ -55,6 +56,8 @@
 #define SPX_ADRS_MTL_DATA 17
 /** SPHINCS+ MTL Address - Type for Trees */
 #define SPX_ADRS_MTL_TREE 18
+/** SPHINCS+ MTL Address - Number of MTL types (MSG, DATA and TREE) */
+#define SPX_ADRS_MTL_TYPES 3
 
 /** MTL message separator */
 #define MTL_MSG_SEP 128
@@ -154,6 +157,32 @@ typedef struct SPK_PRF {
 	uint16_t length;
 } SPK_PRF;
 
+/**
+ * \brief Serialized MTL message separator for a context string
+ */
+typedef struct SPX_MSG_SEP {
+	/** Set to SPX_STATE_READY once the separator is built */
+	uint32_t ready;
+	/** octet(MTL_MSG_SEP) || octet(OLEN(ctx)) || ctx */
+	uint8_t data[2 + UINT8_MAX];
+	/** Separator length */
+	uint32_t length;
+} SPX_MSG_SEP;
+
+/**
+ * \brief MTL ADRS structures prebuilt for one series ID
+ */
+typedef struct SPX_ADRS_TEMPLATES {
+	/** Set to SPX_STATE_READY once the templates are built */
+	uint32_t ready;
+	/** Series ID the templates were built for */
+	SERIESID sid;
+	/** Compressed ADRS for the MSG, DATA and TREE types, indexes zero */
+	uint8_t compressed[SPX_ADRS_MTL_TYPES][ADRS_ADDR_SIZE_C];
+	/** Full ADRS for the MSG, DATA and TREE types, indexes zero */
+	uint8_t full[SPX_ADRS_MTL_TYPES][ADRS_ADDR_SIZE];
+} SPX_ADRS_TEMPLATES;
+
 /**
  * \brief Wrapper for the SPHINCS+ parameters used in MTL Mode
  */
@@ -166,8 +195,50 @@ typedef struct SPX_PARAMS {
 	SPK_PRF prf;
 	/** Flag indicating if SPHINCS+ srobust mode should be used */
 	uint8_t robust;
+	/** SHA2 state after absorbing BlockPad(PK.seed), see spx_params_init_sha2 */
+	SHA2_SEED_STATE sha2_seed;
+	/** SHAKE sponge after absorbing PK.seed, see spx_params_init_shake */
+	SHAKE_SEED_STATE shake_seed;
+	/** HMAC key pads for SK.prf, see spx_params_init_sha2 */
+	HMAC_SHA2_STATE prf_hmac;
+	/** Message separator, see spx_params_init_msg_sep */
+	SPX_MSG_SEP msg_sep;
+	/** ADRS templates for the series ID, see spx_params_init_adrs */
+	SPX_ADRS_TEMPLATES adrs;
+	/** Node hash kernels selected, see spx_params_init_node_funcs */
+	const struct SPX_NODE_FUNCS *node_funcs;
 } SPX_PARAMS;
 
+/**
+ * \brief Node hash functions specialized for one hash family and length
+ */
+typedef struct SPX_NODE_FUNCS {
+	/** Type of algorithm used (#defined values) */
+	uint8_t algorithm;
+	/** Length of the scheme hash */
+	uint32_t hash_len;
+	/** Leaf node hash, same contract as spx_mtl_node_set_hash_leaf_sha2 */
+	uint8_t(*hash_leaf) (void *params, SERIESID * sid, uint32_t node_id,
+			     uint8_t * msg_buffer, uint32_t msg_len,
+			     uint8_t * hash, uint32_t hash_len);
+	/** Internal node hash, same contract as spx_mtl_node_set_hash_int_sha2 */
+	uint8_t(*hash_node) (void *params, SERIESID * sid, uint32_t node_left,
+			     uint32_t node_right, uint8_t * hash_left,
+			     uint8_t * hash_right, uint8_t * hash,
+			     uint32_t hash_len);
+	/** Batch leaf node hash */
+	uint8_t(*hash_leaf_batch) (void *params, SERIESID * sid,
+				   uint32_t * node_ids, uint8_t ** msg_buffers,
+				   uint32_t msg_len, uint8_t ** hashes,
+				   uint32_t hash_len, uint32_t count);
+	/** Batch internal node hash */
+	uint8_t(*hash_node_batch) (void *params, SERIESID * sid,
+				   uint32_t * node_left, uint32_t * node_right,
+				   uint8_t ** hash_left, uint8_t ** hash_right,
+				   uint8_t ** hash, uint32_t hash_len,
+				   uint32_t count);
+} SPX_NODE_FUNCS;
+
 // Function Prototypes
 /**
  * MTL Node Set generate message with PRF SHA2 values
@@ -302,6 +373,100 @@ MTLSTATUS spx_mtl_node_set_hash_message(void *parameters,
 				      char * ctx, uint8_t ** rmtl,
 					  uint32_t * rmtl_len, uint8_t algorithm);
 
+/**
+ * Start hashing a message that is supplied in pieces
+ *   The message hash matches spx_mtl_node_set_hash_message over the
+ *   concatenation of the pieces, without holding the message in memory.
+ * @param params     SPHINCS+ public key seed & key
+ * @param sid        Series identifier for this MTL node set
+ * @param node_id    Node identifier for this message
+ * @param rand       PRF based rand for this message
+ * @param rand_len   Length of the rand byte array
+ * @param hash_len   Length of the message hash
+ * @param ctx        MTL signature context string
+ * @param rmtl       Generated randomness bytes for the hash
+ * @param rmtl_len   Length of the randomness bytes
+ * @param state      Output pointer to the allocated message state
+ * @param algorithm  Type of algorithm used (#defined values)
+ * @return MTL_OK if successful
+ */
+MTLSTATUS spx_mtl_node_set_hash_message_init(void *params, SERIESID * sid,
+					     uint32_t node_id, uint8_t * rand,
+					     uint32_t rand_len,
+					     uint32_t hash_len, char *ctx,
+					     uint8_t ** rmtl,
+					     uint32_t * rmtl_len,
+					     void **state, uint8_t algorithm);
+
+/**
+ * Start hashing a message in pieces using SHA2 algorithms
+ * @param params     SPHINCS+ public key seed & key
+ * @param sid        Series identifier for this MTL node set
+ * @param node_id    Node identifier for this message
+ * @param rand       PRF based rand for this message
+ * @param rand_len   Length of the rand byte array
+ * @param hash_len   Length of the message hash
+ * @param ctx        MTL signature context string
+ * @param rmtl       Generated randomness bytes for the hash
+ * @param rmtl_len   Length of the randomness bytes
+ * @param state      Output pointer to the allocated message state
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_init_sha2(void *params, SERIESID * sid,
+						uint32_t node_id,
+						uint8_t * rand,
+						uint32_t rand_len,
+						uint32_t hash_len, char *ctx,
+						uint8_t ** rmtl,
+						uint32_t * rmtl_len,
+						void **state);
+
+/**
+ * Start hashing a message in pieces using SHAKE algorithms
+ * @param params     SPHINCS+ public key seed & key
+ * @param sid        Series identifier for this MTL node set
+ * @param node_id    Node identifier for this message
+ * @param rand       PRF based rand for this message
+ * @param rand_len   Length of the rand byte array
+ * @param hash_len   Length of the message hash
+ * @param ctx        MTL signature context string
+ * @param rmtl       Generated randomness bytes for the hash
+ * @param rmtl_len   Length of the randomness bytes
+ * @param state      Output pointer to the allocated message state
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_init_shake(void *params,
+						 SERIESID * sid,
+						 uint32_t node_id,
+						 uint8_t * rand,
+						 uint32_t rand_len,
+						 uint32_t hash_len, char *ctx,
+						 uint8_t ** rmtl,
+						 uint32_t * rmtl_len,
+						 void **state);
+
+/**
+ * Add the next piece of a message to a message hash
+ * @param state      Message state from spx_mtl_node_set_hash_message_init
+ * @param msg_buffer Byte array of the next piece of the message
+ * @param msg_len    Length of the msg_buffer array
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_update(void *state,
+					     uint8_t * msg_buffer,
+					     size_t msg_len);
+
+/**
+ * Finish a message hash and free the message state
+ * @param state    Message state from spx_mtl_node_set_hash_message_init
+ * @param hash     Pointer to byte array where hash is stored (EVP_MAX_MD_SIZE),
+ *                 or NULL to discard the message state
+ * @param hash_len Length of the message hash
+ * @return 0 if successful
+ */
+uint8_t spx_mtl_node_set_hash_message_final(void *state, uint8_t * hash,
+					    uint32_t hash_len);
+
 /**
  * Algorithm 2: Hashing Two Child Nodes to Produce an Internal Node.
  * @param params     SPHINCS+ public key seed & key
@@ -323,6 +488,31 @@ MTLSTATUS spx_mtl_node_set_hash_int(void *parameters,
 				  uint8_t * hash_right, uint8_t * hash,
 				  uint32_t hash_len, uint8_t algorithm);
 
+/**
+ * Algorithm 2: Hashing a Batch of Child Pairs to Internal Nodes.
+ *   Uses the multi-buffer hash backends when they are available.
+ * @param params     SPHINCS+ public key seed & key
+ * @param sid        Series ID generated for the MTL node set
+ * @param node_left  Node Ids for the left child nodes
+ * @param node_right Node Ids for the right child nodes
+ * @param hash_left  Pointers to byte arrays for left child hashes
+ * @param hash_right Pointers to byte arrays for right child hashes
+ * @param hash       Pointers where the resulting hashes are placed
+ * @param hash_len   Length of each hash byte array
+ * @param count      Number of internal nodes in the batch
+ * @param algorithm  Type of algorithm used (#defined values) 
+ * @return 0 if successful 
+ */
+MTLSTATUS spx_mtl_node_set_hash_int_batch(void *params,
+					  SERIESID * sid,
+					  uint32_t * node_left,
+					  uint32_t * node_right,
+					  uint8_t ** hash_left,
+					  uint8_t ** hash_right,
+					  uint8_t ** hash,
+					  uint32_t hash_len,
+					  uint32_t count, uint8_t algorithm);
+
 /**
  * Algorithm 1: Hashing a Data Value to Produce a Leaf Node.
  * @param params     SPHINCS+ public key seed & key
@@ -340,6 +530,29 @@ MTLSTATUS spx_mtl_node_set_hash_leaf(void *parameters, SERIESID * sid,
 				   uint32_t msg_buffer_len, uint8_t * hash,
 				   uint32_t hash_len, uint8_t algorithm);
 
+/**
+ * Algorithm 1: Hashing a Batch of Data Values to Leaf Nodes.
+ *   Uses the multi-buffer hash backends when they are available.
+ * @param params      SPHINCS+ public key seed & key
+ * @param sid         Series ID generated for the MTL node set
+ * @param node_ids    Message leaf indexes
+ * @param msg_buffers Byte arrays of the messages that will be added
+ * @param msg_len     Length of each msg_buffers array
+ * @param hashes      Pointers to byte arrays where hashes are stored
+ * @param hash_len    Length of each hash byte array
+ * @param count       Number of leaves in the batch
+ * @param algorithm   Type of algorithm used (#defined values) 
+ * @return 0 if successful 
+ */
+MTLSTATUS spx_mtl_node_set_hash_leaf_batch(void *params,
+					   SERIESID * sid,
+					   uint32_t * node_ids,
+					   uint8_t ** msg_buffers,
+					   uint32_t msg_len,
+					   uint8_t ** hashes,
+					   uint32_t hash_len,
+					   uint32_t count, uint8_t algorithm);
+
 /**
  * Algorithm 1: SHA2 Hashing a Data Value to Produce a Leaf Node.
  * @param params     SPHINCS+ public key seed & key
@@ -358,6 +571,28 @@ uint8_t spx_mtl_node_set_hash_leaf_sha2(void *parameter,
 					uint32_t msg_buffer_len, uint8_t * hash,
 					uint32_t hash_len);
 
+/**
+ * Algorithm 1: SHA2 Hashing a Batch of Data Values to Leaf Nodes.
+ *   Uses the multi-buffer SHA2 backend when it is available.
+ * @param params      SPHINCS+ public key seed & key
+ * @param sid         Series ID generated for the MTL node set
+ * @param node_ids    Message leaf indexes
+ * @param msg_buffers Byte arrays of the messages that will be added
+ * @param msg_len     Length of each msg_buffers array
+ * @param hashes      Pointers to byte arrays where hashes are stored
+ * @param hash_len    Length of each hash byte array
+ * @param count       Number of leaves in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_leaf_sha2_batch(void *params,
+					      SERIESID * sid,
+					      uint32_t * node_ids,
+					      uint8_t ** msg_buffers,
+					      uint32_t msg_len,
+					      uint8_t ** hashes,
+					      uint32_t hash_len,
+					      uint32_t count);
+
 /**
  * Algorithm 1: SHAKE Hashing a Data Value to Produce a Leaf Node.
  * @param params     SPHINCS+ public key seed & key
@@ -374,6 +609,28 @@ uint8_t spx_mtl_node_set_hash_leaf_shake(void *parameters, SERIESID * sid,
 					 uint32_t msg_buffer_len,
 					 uint8_t * hash, uint32_t hash_len);
 
+/**
+ * Algorithm 1: SHAKE Hashing a Batch of Data Values to Leaf Nodes.
+ *   Uses the 4-way SHAKE256 backend when it is available.
+ * @param params      SPHINCS+ public key seed & key
+ * @param sid         Series ID generated for the MTL node set
+ * @param node_ids    Message leaf indexes
+ * @param msg_buffers Byte arrays of the messages that will be added
+ * @param msg_len     Length of each msg_buffers array
+ * @param hashes      Pointers to byte arrays where hashes are stored
+ * @param hash_len    Length of each hash byte array
+ * @param count       Number of leaves in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_leaf_shake_batch(void *params,
+					       SERIESID * sid,
+					       uint32_t * node_ids,
+					       uint8_t ** msg_buffers,
+					       uint32_t msg_len,
+					       uint8_t ** hashes,
+					       uint32_t hash_len,
+					       uint32_t count);
+
 /**
  * Algorithm 2: SHA2 Hashing Child Nodes to Produce an Internal Node.
  * @param params     SPHINCS+ public key seed & key
@@ -394,6 +651,30 @@ uint8_t spx_mtl_node_set_hash_int_sha2(void *parameters,
 				       uint8_t * hash_right, uint8_t * hash,
 				       uint32_t hash_len);
 
+/**
+ * Algorithm 2: SHA2 Hashing a Batch of Child Pairs to Internal Nodes.
+ *   Uses the multi-buffer SHA2 backend when it is available.
+ * @param params     SPHINCS+ public key seed & key
+ * @param sid        Series ID generated for the MTL node set
+ * @param node_left  Node Ids for the left child nodes
+ * @param node_right Node Ids for the right child nodes
+ * @param hash_left  Pointers to byte arrays for left child hashes
+ * @param hash_right Pointers to byte arrays for right child hashes
+ * @param hash       Pointers where the resulting hashes are placed
+ * @param hash_len   Length of each hash byte array
+ * @param count      Number of internal nodes in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_int_sha2_batch(void *params,
+					     SERIESID * sid,
+					     uint32_t * node_left,
+					     uint32_t * node_right,
+					     uint8_t ** hash_left,
+					     uint8_t ** hash_right,
+					     uint8_t ** hash,
+					     uint32_t hash_len,
+					     uint32_t count);
+
 /**
  * Algorithm 2: SHAKE Hashing Child Nodes to Produce an Internal Node.
  * @param params     SPHINCS+ public key seed & key
@@ -412,6 +693,65 @@ uint8_t spx_mtl_node_set_hash_int_shake(void *parameters, SERIESID * sid,
 					uint8_t * hash_right, uint8_t * hash,
 					uint32_t hash_len);
 
+/**
+ * Algorithm 2: SHAKE Hashing a Batch of Child Pairs to Internal Nodes.
+ *   Uses the 4-way SHAKE256 backend when it is available.
+ * @param params     SPHINCS+ public key seed & key
+ * @param sid        Series ID generated for the MTL node set
+ * @param node_left  Node Ids for the left child nodes
+ * @param node_right Node Ids for the right child nodes
+ * @param hash_left  Pointers to byte arrays for left child hashes
+ * @param hash_right Pointers to byte arrays for right child hashes
+ * @param hash       Pointers where the resulting hashes are placed
+ * @param hash_len   Length of each hash byte array
+ * @param count      Number of internal nodes in the batch
+ * @return 0 if successful 
+ */
+uint8_t spx_mtl_node_set_hash_int_shake_batch(void *params,
+					      SERIESID * sid,
+					      uint32_t * node_left,
+					      uint32_t * node_right,
+					      uint8_t ** hash_left,
+					      uint8_t ** hash_right,
+					      uint8_t ** hash,
+					      uint32_t hash_len,
+					      uint32_t count);
+
+/**
+ * Precompute the SHA2 BlockPad(PK.seed) state for the parameters, and
+ * the HMAC key pads for SK.prf when it is set
+ * @param params   SPHINCS+ parameters with pk_seed (and optionally prf) set
+ * @param hash_len Length of the scheme hash (selects SHA-256/512)
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_sha2(SPX_PARAMS * params, uint32_t hash_len);
+
+/**
+ * Precompute the SHAKE PK.seed sponge state for the parameters
+ * @param params SPHINCS+ parameters with pk_seed set
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_shake(SPX_PARAMS * params);
+
+/**
+ * Precompute the message separator for the MTL context string
+ * @param params SPHINCS+ parameters
+ * @param ctx    MTL context string the message hashes will be given
+ *               (NULL for none)
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_msg_sep(SPX_PARAMS * params, char *ctx);
+
+/**
+ * Prebuild the MTL ADRS structures (all but the left and right index
+ * words) for a series ID, so node hashes for that series ID copy them
+ * rather than building each one.
+ * @param params SPHINCS+ parameters
+ * @param sid    Series ID the node set hashes will be given
+ * @return 0 if successful
+ */
+MTLSTATUS spx_params_init_adrs(SPX_PARAMS * params, SERIESID * sid);
+
 /**
  * Perform the SHA2 hashing for tree leaves (internal or leaf)
  * @param seed     SPHINCS+ public key seed 
@@ -428,6 +768,23 @@ MTLSTATUS spx_sha2(uint8_t * seed, uint32_t seed_len,
 		 uint8_t * adrs, uint32_t adrs_len,
 		 uint8_t * data, uint32_t data_len,
 		 uint8_t * hash, uint32_t hash_len);
+/**
+ * Perform the SHA2 hashing for a batch of tree nodes of the same shape
+ * @param seed     SPHINCS+ public key seed 
+ * @param seed_len Length of the SPHNICS+ public key
+ * @param adrs     Compressed ADRS structure for each hash
+ * @param adrs_len Length of each ADRS structure
+ * @param data     Data value for each hash
+ * @param data_len Length of each data value
+ * @param hash     Output buffer for each hash (full digest length)
+ * @param hash_len Length of the scheme hash
+ * @param count    Number of hashes in the batch
+ * @return 0 if successful
+ */
+MTLSTATUS spx_sha2_batch(uint8_t * seed, uint32_t seed_len,
+			 uint8_t ** adrs, uint32_t adrs_len,
+			 uint8_t ** data, uint32_t data_len,
+			 uint8_t ** hash, uint32_t hash_len, uint32_t count);
 /**
 * Perform the SHAKE hashing for tree leaves (internal or leaf)
  * @param seed     SPHINCS+ public key seed 
@@ -445,4 +802,31 @@ MTLSTATUS spx_shake(uint8_t * seed, uint32_t seed_len,
 		  uint8_t * data, uint32_t data_len,
 		  uint8_t * hash, uint32_t hash_len);
 
+/**
+ * Find the node hash functions specialized for a parameter set. They
+ * give the same hashes as the generic functions, and pass anything
+ * they were not built for (robust mode, other lengths) on to them.
+ * @param algorithm Type of algorithm used (#defined values)
+ * @param hash_len  Length of the scheme hash
+ * @return function table, or NULL if there is no specialization
+ */
+const SPX_NODE_FUNCS *spx_node_funcs(uint8_t algorithm, uint32_t hash_len);
+
+/**
+ * Select the node hash kernels for the parameters. The parameters are
+ * checked here once (no robust mode, an n byte seed with its seed state
+ * and ADRS templates for an 8 byte series ID) so the kernels do not
+ * check them on every hash. They only hash for the series ID the
+ * templates were built for. Rebuilding the seed state or the templates
+ * clears the selection, and the kernels then use the generic functions.
+ * @param params    SPHINCS+ parameters with the seed state and ADRS
+ *                  templates built
+ * @param algorithm Type of algorithm used (#defined values)
+ * @param hash_len  Length of the scheme hash
+ * @return function table, or NULL to use the generic functions
+ */
+const SPX_NODE_FUNCS *spx_params_init_node_funcs(SPX_PARAMS * params,
+						 uint8_t algorithm,
+						 uint32_t hash_len);
+
 #endif				//__MTL_SPX_IMPL_H__
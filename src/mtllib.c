@@ -30,12 +30,15 @@
     ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
     POSSIBILITY OF SUCH DAMAGE.
 */
+#include <pthread.h>
 #include <string.h>
+#include <time.h>
 
 #include "mtl.h"
 #include "mtllib.h"
 #include "mtl_util.h"
 #include "mtllib_util.h"
+#include "spx_funcs.h"
 
 /**
  * MTL Library New Key
@@ -45,6 +48,37 @@
  * @return MTLLIB_STATUS MTLLIB_OK if successful
  */
 MTLLIB_STATUS mtllib_key_new(char *keystr, MTLLIB_CTX **ctx, char *mtl_ctx_str)
+{
+    return mtllib_key_new_with_layout(keystr, ctx, mtl_ctx_str, 0, 0, MTL_NODE_SET_LAYOUT_LINEAR);
+}
+
+/**
+ * MTL Library New Key with a specific node set page geometry
+ * @param keystr the string identifier for the desired algorithm
+ * @param ctx pointer to what will be allocated as the MTL library key context
+ * @param ctx_str the optional MTL context string
+ * @param page_size node set page size in bytes (0 for the default)
+ * @param max_pages maximum number of node set pages (0 for the default)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_key_new_with_geometry(char *keystr, MTLLIB_CTX **ctx, char *mtl_ctx_str,
+                                           uint32_t page_size, uint32_t max_pages)
+{
+    return mtllib_key_new_with_layout(keystr, ctx, mtl_ctx_str, page_size, max_pages, MTL_NODE_SET_LAYOUT_LINEAR);
+}
+
+/**
+ * MTL Library New Key with a specific node set page geometry and layout
+ * @param keystr the string identifier for the desired algorithm
+ * @param ctx pointer to what will be allocated as the MTL library key context
+ * @param ctx_str the optional MTL context string
+ * @param page_size node set page size in bytes (0 for the default)
+ * @param max_pages maximum number of node set pages (0 for the default)
+ * @param layout node set page layout (MTL_NODE_SET_LAYOUT_LINEAR or MTL_NODE_SET_LAYOUT_BLOCKED)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_key_new_with_layout(char *keystr, MTLLIB_CTX **ctx, char *mtl_ctx_str,
+                                         uint32_t page_size, uint32_t max_pages, uint8_t layout)
 {
     MTLLIB_CTX *mtllib_ctx;
 
@@ -58,6 +92,8 @@ MTLLIB_STATUS mtllib_key_new(char *keystr, MTLLIB_CTX **ctx, char *mtl_ctx_str)
     if(mtllib_ctx == NULL) {
         return MTLLIB_MEMORY_ERROR;
     }
+    pthread_mutex_init(&mtllib_ctx->ladder_lock, NULL);
+    mtllib_ctx->threads = 1;
 
     // Find the algorithm parameters
     mtllib_ctx->algo_params = mtllib_util_get_algorithm_props(keystr);
@@ -73,6 +109,14 @@ MTLLIB_STATUS mtllib_key_new(char *keystr, MTLLIB_CTX **ctx, char *mtl_ctx_str)
         return MTLLIB_BAD_ALGORITHM;
     }
 
+    // Select the node set geometry and layout while the node set is still empty
+    if ((mtl_node_set_set_geometry(&mtllib_ctx->mtl->nodes, page_size, max_pages) != MTL_OK) ||
+        (mtl_node_set_set_layout(&mtllib_ctx->mtl->nodes, layout, 0) != MTL_OK))
+    {
+        mtllib_key_free(mtllib_ctx);
+        return MTLLIB_BAD_VALUE;
+    }
+
     *ctx = mtllib_ctx;
     return MTLLIB_OK;
 }
@@ -108,10 +152,14 @@ void mtllib_key_free(MTLLIB_CTX *ctx)
 {
     if (ctx)
     {
+        // The signer still uses the keys for a queued or running job
+        mtllib_sign_stop_background(ctx);
         free(ctx->public_key);
         ctx->public_key = NULL;
         free(ctx->secret_key);
         ctx->secret_key = NULL;
+        free(ctx->signed_ladder);
+        ctx->signed_ladder = NULL;
         if (ctx->signature)
         {
             OQS_SIG_free(ctx->signature);
@@ -124,6 +172,7 @@ void mtllib_key_free(MTLLIB_CTX *ctx)
             mtl_free(ctx->mtl);
             ctx->mtl = NULL;
         }
+        pthread_mutex_destroy(&ctx->ladder_lock);
         free(ctx);
     }
 }
@@ -163,6 +212,8 @@ MTLLIB_STATUS mtllib_key_pubkey_from_params(char *keystr, MTLLIB_CTX **ctx, char
         fprintf(stderr, "ERROR: Alloc Error\n");
         return MTLLIB_MEMORY_ERROR;
     }
+    pthread_mutex_init(&mtllib_ctx->ladder_lock, NULL);
+    mtllib_ctx->threads = 1;
 
     // Find the algorithm parameters
     mtllib_ctx->algo_params = mtllib_util_get_algorithm_props((char *)keystr);
@@ -194,6 +245,208 @@ MTLLIB_STATUS mtllib_key_pubkey_from_params(char *keystr, MTLLIB_CTX **ctx, char
     return MTLLIB_OK;
 }
 
+/**
+ * Compute the SHA-256 checksum of a V2 key section
+ * @param section  section data
+ * @param len      length of the section data in bytes
+ * @param checksum output buffer (KEY_SECTION_CHECKSUM_SIZE bytes)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_key_section_checksum(uint8_t *section,
+                                                 uint64_t len,
+                                                 uint8_t *checksum)
+{
+    // The fetched SHA-256 also takes an empty section, which sha256()
+    // does not hash
+    if (spx_md_digest(SPX_MD_SHA256, checksum, KEY_SECTION_CHECKSUM_SIZE,
+                      section, len, NULL, 0, NULL, 0) != MTL_OK)
+    {
+        LOG_ERROR("Unable to compute the key section checksum");
+        return MTLLIB_BAD_ALGORITHM;
+    }
+    return MTLLIB_OK;
+}
+
+/**
+ * Write a V2 key section table of contents entry
+ * @param toc     pointer to the TOC entry position (advanced past the entry)
+ * @param type    section type
+ * @param section section data
+ * @param len     length of the section data in bytes
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_key_write_toc_entry(uint8_t **toc, uint16_t type,
+                                                uint8_t *section, uint64_t len)
+{
+    uint8_t *toc_ptr = *toc;
+
+    uint16_to_bytes(toc_ptr, type);
+    uint32_to_bytes(toc_ptr + 2, (uint32_t)(len >> 32));
+    uint32_to_bytes(toc_ptr + 6, (uint32_t)len);
+    if (mtllib_key_section_checksum(section, len, toc_ptr + 10) != MTLLIB_OK)
+    {
+        return MTLLIB_BAD_ALGORITHM;
+    }
+
+    *toc = toc_ptr + KEY_SECTION_TOC_SIZE;
+    return MTLLIB_OK;
+}
+
+/**
+ * Write the V2 key sections (node pages and randomizers)
+ * @param ctx        MTL context to write to the buffer
+ * @param buffer     output buffer position (advanced past the sections)
+ * @param buffer_len remaining length of the output buffer
+ * @param leaf_count number of leaves to write
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_key_write_sections(MTLLIB_CTX *ctx, uint8_t **buffer, size_t *buffer_len,
+                                               uint64_t leaf_count)
+{
+    MTLNODES *nodes = &ctx->mtl->nodes;
+    uint8_t *buffer_ptr = *buffer;
+    uint8_t *toc_ptr = NULL;
+    uint8_t *rand_ptr = NULL;
+    uint64_t tree_len = 0;
+    uint64_t rand_len = 0;
+    uint16_t section_count = 1;
+
+    tree_len = mtl_node_set_node_count(leaf_count) * nodes->hash_size;
+    if (ctx->algo_params->randomize)
+    {
+        rand_len = leaf_count * nodes->hash_size;
+        section_count++;
+    }
+
+    BUFFER_VERIFY_LENGTH(*buffer_len, 2 + (section_count * KEY_SECTION_TOC_SIZE) + tree_len + rand_len, NULL);
+    uint16_to_bytes(buffer_ptr, section_count);
+    buffer_ptr += 2;
+    toc_ptr = buffer_ptr;
+    buffer_ptr += section_count * KEY_SECTION_TOC_SIZE;
+
+    // Sections follow the table of contents in the same order
+    if (ctx->algo_params->randomize)
+    {
+        rand_ptr = buffer_ptr + tree_len;
+    }
+    if (mtl_node_set_export_leaves(nodes, leaf_count, buffer_ptr, rand_ptr) != MTL_OK)
+    {
+        return MTLLIB_BAD_VALUE;
+    }
+
+    if (mtllib_key_write_toc_entry(&toc_ptr, KEY_SECTION_TREE, buffer_ptr, tree_len) != MTLLIB_OK)
+    {
+        return MTLLIB_BAD_VALUE;
+    }
+    buffer_ptr += tree_len;
+
+    if (rand_ptr != NULL)
+    {
+        if (mtllib_key_write_toc_entry(&toc_ptr, KEY_SECTION_RANDOMIZER, rand_ptr, rand_len) != MTLLIB_OK)
+        {
+            return MTLLIB_BAD_VALUE;
+        }
+        buffer_ptr += rand_len;
+    }
+
+    *buffer_len -= buffer_ptr - *buffer;
+    *buffer = buffer_ptr;
+    return MTLLIB_OK;
+}
+
+/**
+ * Read the V2 key sections and bulk load the node set
+ * @param ctx        MTL context to load the nodes into
+ * @param buffer     input buffer position (advanced past the sections)
+ * @param buffer_len remaining length of the input buffer
+ * @param leaf_count number of leaves in the key
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_key_read_sections(MTLLIB_CTX *ctx, uint8_t **buffer,
+                                              size_t *buffer_len, uint64_t leaf_count)
+{
+    MTLNODES *nodes = &ctx->mtl->nodes;
+    uint8_t checksum[EVP_MAX_MD_SIZE];
+    uint8_t *toc_ptr = NULL;
+    uint8_t *data_ptr = NULL;
+    uint8_t *tree = NULL;
+    uint8_t *randomizers = NULL;
+    uint64_t tree_len = 0;
+    uint64_t rand_len = 0;
+    uint64_t section_len = 0;
+    size_t curr_len = *buffer_len;
+    uint16_t section_count = 0;
+    uint16_t section_type = 0;
+    uint32_t len_high = 0;
+    uint32_t len_low = 0;
+    uint16_t index;
+
+    BUFFER_VERIFY_LENGTH(curr_len, 2, NULL);
+    bytes_to_uint16(*buffer, &section_count);
+    curr_len -= 2;
+    BUFFER_VERIFY_LENGTH(curr_len, (size_t)section_count * KEY_SECTION_TOC_SIZE, NULL);
+    toc_ptr = *buffer + 2;
+    data_ptr = toc_ptr + (section_count * KEY_SECTION_TOC_SIZE);
+    curr_len -= section_count * KEY_SECTION_TOC_SIZE;
+
+    // Check every section before touching the node set
+    for (index = 0; index < section_count; index++)
+    {
+        bytes_to_uint16(toc_ptr, &section_type);
+        bytes_to_uint32(toc_ptr + 2, &len_high);
+        bytes_to_uint32(toc_ptr + 6, &len_low);
+        section_len = ((uint64_t)len_high << 32) | len_low;
+        BUFFER_VERIFY_LENGTH(curr_len, section_len, NULL);
+
+        if ((mtllib_key_section_checksum(data_ptr, section_len,
+                                         checksum) != MTLLIB_OK) ||
+            (memcmp(checksum, toc_ptr + 10, KEY_SECTION_CHECKSUM_SIZE) != 0))
+        {
+            LOG_ERROR("Key section checksum mismatch");
+            return MTLLIB_BAD_VALUE;
+        }
+
+        // Unknown sections are skipped for forward compatibility
+        if (section_type == KEY_SECTION_TREE)
+        {
+            tree = data_ptr;
+            tree_len = section_len;
+        }
+        else if (section_type == KEY_SECTION_RANDOMIZER)
+        {
+            randomizers = data_ptr;
+            rand_len = section_len;
+        }
+
+        toc_ptr += KEY_SECTION_TOC_SIZE;
+        data_ptr += section_len;
+        curr_len -= section_len;
+    }
+
+    if ((tree == NULL) ||
+        (tree_len != mtl_node_set_node_count(leaf_count) * nodes->hash_size))
+    {
+        LOG_ERROR("Key tree section is invalid");
+        return MTLLIB_BAD_VALUE;
+    }
+    if (ctx->algo_params->randomize &&
+        ((randomizers == NULL) || (rand_len != (uint64_t)leaf_count * nodes->hash_size)))
+    {
+        LOG_ERROR("Key randomizer section is invalid");
+        return MTLLIB_BAD_VALUE;
+    }
+
+    if (mtl_node_set_import(nodes, leaf_count, tree,
+                            ctx->algo_params->randomize ? randomizers : NULL) != MTL_OK)
+    {
+        return MTLLIB_BAD_VALUE;
+    }
+
+    *buffer = data_ptr;
+    *buffer_len = curr_len;
+    return MTLLIB_OK;
+}
+
 /**
  * MTL Library Key from Buffer
  * @param buffer     input buffer holding the key
@@ -202,6 +455,21 @@ MTLLIB_STATUS mtllib_key_pubkey_from_params(char *keystr, MTLLIB_CTX **ctx, char
  * @return MTLLIB_STATUS MTLLIB_OK if successful
  */
 MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_CTX **ctx)
+{
+    return mtllib_key_from_buffer_threads(buffer, buffer_len, ctx, 1);
+}
+
+/**
+ * MTL Library Key from Buffer using worker threads
+ * @param buffer     input buffer holding the key
+ * @param buffer_len the length of the input buffer
+ * @param ctx        MTL context created from the buffer
+ * @param threads    threads used to rebuild the internal nodes of a V1 key
+ *                   (0 for one per online CPU, 1 to rebuild sequentially)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_key_from_buffer_threads(uint8_t *buffer, size_t buffer_len,
+                                             MTLLIB_CTX **ctx, uint32_t threads)
 {
     MTLLIB_CTX *mtllib_ctx = NULL;
     uint16_t flags = 0;
@@ -214,8 +482,14 @@ MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_
     size_t bytes_len = 0;
     SERIESID sid;
     SEED seed;
-    uint32_t leaf_count;
+    uint64_t leaf_count;
+    uint32_t count_high = 0;
+    uint32_t count_low = 0;
     uint16_t hash_size;
+    uint32_t page_size = 0;
+    uint32_t max_pages = 0;
+    uint8_t layout = MTL_NODE_SET_LAYOUT_LINEAR;
+    uint8_t tile_height = 0;
     size_t index;
     uint8_t *pk;
     uint8_t *sk;
@@ -233,6 +507,8 @@ MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_
     {
         return MTLLIB_MEMORY_ERROR;
     }
+    pthread_mutex_init(&mtllib_ctx->ladder_lock, NULL);
+    mtllib_ctx->threads = threads;
 
     // Read Algorithm String
     if (mtllib_util_buffer_read_bytes(&buffer_ptr, &curr_len, &record, &bytes_len, 1024, 1) != MTLLIB_OK)
@@ -318,43 +594,103 @@ MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_
     free(sk);
     free(pk);
 
-    // Leaf Count
-    BUFFER_VERIFY_LENGTH(curr_len, 4, mtllib_ctx);
-    bytes_to_uint32(buffer_ptr, &leaf_count);
-    buffer_ptr += 4;
-    curr_len -= 4;
+    // Leaf Count (64 bits only when it does not fit in 32 bits)
+    if (flags & LEAF_COUNT_64_FLAG)
+    {
+        BUFFER_VERIFY_KEY_LENGTH(curr_len, 8, mtllib_ctx);
+        bytes_to_uint32(buffer_ptr, &count_high);
+        bytes_to_uint32(buffer_ptr + 4, &count_low);
+        buffer_ptr += 8;
+        curr_len -= 8;
+    }
+    else
+    {
+        BUFFER_VERIFY_KEY_LENGTH(curr_len, 4, mtllib_ctx);
+        bytes_to_uint32(buffer_ptr, &count_low);
+        buffer_ptr += 4;
+        curr_len -= 4;
+    }
+    leaf_count = ((uint64_t)count_high << 32) | count_low;
+    if (leaf_count > (uint64_t)MTL_NODE_SET_MAX_LEAF + 1)
+    {
+        mtllib_key_free(mtllib_ctx);
+        return MTLLIB_BAD_VALUE;
+    }
 
     // Hash size
-    BUFFER_VERIFY_LENGTH(curr_len, 2, mtllib_ctx);
+    BUFFER_VERIFY_KEY_LENGTH(curr_len, 2, mtllib_ctx);
     bytes_to_uint16(buffer_ptr, &hash_size);
     buffer_ptr += 2;
     curr_len -= 2;
     if ((hash_size > 64) || (hash_size < 1))
     {
-        free(mtllib_ctx);
+        mtllib_key_free(mtllib_ctx);
+        return MTLLIB_BAD_VALUE;
+    }
+
+    // Node set geometry (only present when it differs from the default)
+    if (flags & GEOMETRY_FLAG)
+    {
+        BUFFER_VERIFY_KEY_LENGTH(curr_len, 8, mtllib_ctx);
+        bytes_to_uint32(buffer_ptr, &page_size);
+        bytes_to_uint32(buffer_ptr + 4, &max_pages);
+        buffer_ptr += 8;
+        curr_len -= 8;
+    }
+    // Node set layout (only present when it is not the linear layout)
+    if (flags & LAYOUT_FLAG)
+    {
+        BUFFER_VERIFY_KEY_LENGTH(curr_len, 2, mtllib_ctx);
+        layout = buffer_ptr[0];
+        tile_height = buffer_ptr[1];
+        buffer_ptr += 2;
+        curr_len -= 2;
+    }
+    if ((mtl_node_set_set_geometry(&mtllib_ctx->mtl->nodes, page_size, max_pages) != MTL_OK) ||
+        (mtl_node_set_set_layout(&mtllib_ctx->mtl->nodes, layout, tile_height) != MTL_OK))
+    {
+        mtllib_key_free(mtllib_ctx);
         return MTLLIB_BAD_VALUE;
     }
 
+    // V2 keys hold every node so no internal node is recomputed
+    if (flags & SECTIONS_FLAG)
+    {
+        if ((hash_size != mtllib_ctx->mtl->nodes.hash_size) ||
+            (mtllib_key_read_sections(mtllib_ctx, &buffer_ptr, &curr_len, leaf_count) != MTLLIB_OK))
+        {
+            mtllib_key_free(mtllib_ctx);
+            return MTLLIB_BAD_VALUE;
+        }
+
+        *ctx = mtllib_ctx;
+        return MTLLIB_OK;
+    }
+
     // Leaf Nodes
     for (index = 0; index < leaf_count; index++)
     {
-        BUFFER_VERIFY_LENGTH(curr_len, hash_size, mtllib_ctx);
-        mtl_node_set_insert(&mtllib_ctx->mtl->nodes, index, index, buffer_ptr);
-        buffer_ptr += hash_size;
-        curr_len -= hash_size;
-
-        // Compute the internal nodes
-        if (mtl_node_set_update_parents(mtllib_ctx->mtl, index) != MTL_OK)
+        BUFFER_VERIFY_KEY_LENGTH(curr_len, hash_size, mtllib_ctx);
+        if (mtl_node_set_insert(&mtllib_ctx->mtl->nodes, index, index, buffer_ptr) != MTL_OK)
         {
-            free(mtllib_ctx);
+            mtllib_key_free(mtllib_ctx);
             return MTLLIB_BAD_VALUE;
         }
+        buffer_ptr += hash_size;
+        curr_len -= hash_size;
+    }
+
+    // Compute the internal nodes
+    if (mtl_node_set_rebuild(mtllib_ctx->mtl, threads) != MTL_OK)
+    {
+        mtllib_key_free(mtllib_ctx);
+        return MTLLIB_BAD_VALUE;
     }
 
     // Randomizer Nodes
     for (index = 0; index < leaf_count; index++)
     {
-        BUFFER_VERIFY_LENGTH(curr_len, hash_size, mtllib_ctx);
+        BUFFER_VERIFY_KEY_LENGTH(curr_len, hash_size, mtllib_ctx);
         mtl_node_set_insert_randomizer(&mtllib_ctx->mtl->nodes, index, buffer_ptr);
         buffer_ptr += hash_size;
         curr_len -= hash_size;
@@ -364,6 +700,25 @@ MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_
     return MTLLIB_OK;
 }
 
+/**
+ * MTL Library set the number of worker threads for a key
+ * @param ctx     MTL context to update
+ * @param threads threads used to hash message batches
+ *                (0 for one per online CPU, 1 to hash sequentially)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_set_threads(MTLLIB_CTX *ctx, uint32_t threads)
+{
+    if (ctx == NULL)
+    {
+        LOG_ERROR("NULL input parameters");
+        return MTLLIB_NULL_PARAMS;
+    }
+
+    ctx->threads = threads;
+    return MTLLIB_OK;
+}
+
 /**
  * MTL Library Key to Buffer
  * @param ctx    MTL context to write to the buffer
@@ -371,6 +726,18 @@ MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_
  * @return size_t size of the key buffer
  */
 size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer)
+{
+    return mtllib_key_to_buffer_version(ctx, buffer, MTLLIB_KEY_FORMAT_V1);
+}
+
+/**
+ * MTL Library Key to Buffer using a specific key format
+ * @param ctx     MTL context to write to the buffer
+ * @param buffer  output buffer holding the key bytes
+ * @param version key format (MTLLIB_KEY_FORMAT_V1 or MTLLIB_KEY_FORMAT_V2)
+ * @return size_t size of the key buffer
+ */
+size_t mtllib_key_to_buffer_version(MTLLIB_CTX *ctx, uint8_t **buffer, uint16_t version)
 {
     uint8_t *buffer_ptr = NULL;
     uint8_t *key_buffer = NULL;
@@ -378,20 +745,36 @@ size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer)
     size_t mtl_hashes = 0;
     size_t hash_size = 0;
     size_t index = 0;
-    uint8_t *hash_ptr = NULL;
+    const uint8_t *hash_ptr = NULL;
     size_t buffer_len = 0;
     uint16_t flags = 0;
+    uint32_t default_page_size = 0;
 
     if ((ctx == NULL) || (ctx->mtl == NULL) || (ctx->algo_params == NULL) || (buffer == NULL))
     {
         // Also check ctx->mtl sid and nodes for null
         return 0;
     }
+    if ((version != MTLLIB_KEY_FORMAT_V1) && (version != MTLLIB_KEY_FORMAT_V2))
+    {
+        *buffer = NULL;
+        return 0;
+    }
     *buffer = NULL;
     param_len = 2400;
-    mtl_hashes = ctx->mtl->nodes.leaf_count;
+    // Leaves reserved by open streams are not written until they are committed
+    mtl_hashes = mtl_snapshot(ctx->mtl);
     hash_size = ctx->mtl->nodes.hash_size;
-    param_len += mtl_hashes * hash_size; // Allocate bytes for each leaf node
+    if (version == MTLLIB_KEY_FORMAT_V2)
+    {
+        // Allocate bytes for every node and the section table of contents
+        param_len += 2 + (2 * KEY_SECTION_TOC_SIZE);
+        param_len += mtl_node_set_node_count(mtl_hashes) * hash_size;
+    }
+    else
+    {
+        param_len += mtl_hashes * hash_size; // Allocate bytes for each leaf node
+    }
     if (ctx->algo_params->randomize)
     {
         param_len += mtl_hashes * hash_size; // Allocate bytes for each leaf node randomizer
@@ -431,6 +814,28 @@ size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer)
     {
         flags = flags | RANDOMIZER_FLAG;
     }
+    // Keys using the default geometry keep the original layout
+    if (hash_size > 0)
+    {
+        default_page_size = MTL_TREE_PAGE_SIZE - (MTL_TREE_PAGE_SIZE % hash_size);
+    }
+    if ((ctx->mtl->nodes.tree_page_size != default_page_size) ||
+        (ctx->mtl->nodes.max_pages != MTL_TREE_MAX_PAGES))
+    {
+        flags = flags | GEOMETRY_FLAG;
+    }
+    if (ctx->mtl->nodes.layout != MTL_NODE_SET_LAYOUT_LINEAR)
+    {
+        flags = flags | LAYOUT_FLAG;
+    }
+    if (version == MTLLIB_KEY_FORMAT_V2)
+    {
+        flags = flags | SECTIONS_FLAG;
+    }
+    if (mtl_hashes > UINT32_MAX)
+    {
+        flags = flags | LEAF_COUNT_64_FLAG;
+    }
     BUFFER_VERIFY_LENGTH(buffer_len, 2, NULL);
     uint16_to_bytes(buffer_ptr, flags);
     buffer_ptr += 2;
@@ -460,11 +865,22 @@ size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer)
         return MTLLIB_BAD_VALUE;
     }
 
-    // Add leaf Count
-    BUFFER_VERIFY_LENGTH(buffer_len, 4, NULL);
-    uint32_to_bytes(buffer_ptr, mtl_hashes);
-    buffer_ptr += 4;
-    buffer_len -= 4;
+    // Add leaf Count (a full node set needs all 64 bits)
+    if (flags & LEAF_COUNT_64_FLAG)
+    {
+        BUFFER_VERIFY_LENGTH(buffer_len, 8, NULL);
+        uint32_to_bytes(buffer_ptr, (uint32_t)((uint64_t)mtl_hashes >> 32));
+        uint32_to_bytes(buffer_ptr + 4, (uint32_t)mtl_hashes);
+        buffer_ptr += 8;
+        buffer_len -= 8;
+    }
+    else
+    {
+        BUFFER_VERIFY_LENGTH(buffer_len, 4, NULL);
+        uint32_to_bytes(buffer_ptr, mtl_hashes);
+        buffer_ptr += 4;
+        buffer_len -= 4;
+    }
 
     // Add hash size
     BUFFER_VERIFY_LENGTH(buffer_len, 2, NULL);
@@ -472,16 +888,48 @@ size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer)
     buffer_ptr += 2;
     buffer_len -= 2;
 
+    // Add the node set geometry if it is not the default
+    if (flags & GEOMETRY_FLAG)
+    {
+        BUFFER_VERIFY_LENGTH(buffer_len, 8, NULL);
+        uint32_to_bytes(buffer_ptr, ctx->mtl->nodes.tree_page_size);
+        uint32_to_bytes(buffer_ptr + 4, ctx->mtl->nodes.max_pages);
+        buffer_ptr += 8;
+        buffer_len -= 8;
+    }
+
+    // Add the node set layout if it is not the linear layout
+    if (flags & LAYOUT_FLAG)
+    {
+        BUFFER_VERIFY_LENGTH(buffer_len, 2, NULL);
+        buffer_ptr[0] = ctx->mtl->nodes.layout;
+        buffer_ptr[1] = ctx->mtl->nodes.tile_height;
+        buffer_ptr += 2;
+        buffer_len -= 2;
+    }
+
+    // V2 keys hold every node and randomizer in checksummed sections
+    if (version == MTLLIB_KEY_FORMAT_V2)
+    {
+        if (mtllib_key_write_sections(ctx, &buffer_ptr, &buffer_len, mtl_hashes) != MTLLIB_OK)
+        {
+            free(key_buffer);
+            return 0;
+        }
+
+        *buffer = key_buffer;
+        return buffer_ptr - key_buffer;
+    }
+
     // Add each leaf in the tree
     for (index = 0; index < mtl_hashes; index++)
     {
-        if (mtl_node_set_fetch(&ctx->mtl->nodes, index, index, &hash_ptr) == MTL_OK)
+        if (mtl_node_set_fetch_ref(&ctx->mtl->nodes, index, index, &hash_ptr) == MTL_OK)
         {
             BUFFER_VERIFY_LENGTH(buffer_len, hash_size, NULL);
             memcpy(buffer_ptr, hash_ptr, hash_size);
             buffer_ptr += hash_size;
             buffer_len -= hash_size;
-            free(hash_ptr);
         }
         else
         {
@@ -495,13 +943,12 @@ size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer)
     {
         for (index = 0; index < mtl_hashes; index++)
         {
-            if (mtl_node_set_get_randomizer(&ctx->mtl->nodes, index, &hash_ptr) == MTL_OK)
+            if (mtl_node_set_get_randomizer_ref(&ctx->mtl->nodes, index, &hash_ptr) == MTL_OK)
             {
                 BUFFER_VERIFY_LENGTH(buffer_len, hash_size, NULL);
                 memcpy(buffer_ptr, hash_ptr, hash_size);
                 buffer_ptr += hash_size;
                 buffer_len -= hash_size;
-                free(hash_ptr);
             }
             else
             {
@@ -516,61 +963,704 @@ size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer)
 }
 
 /**
- * MTL Library append a message to the node set
- * @param ctx      MTL context to use
- * @param msg      input message buffer
- * @param msg_len  length of the input message buffer
- * @param mtl_node handle for the appended message
- * @return MTLLIB_STATUS MTLLIB_OK if successful
+ * Current time in milliseconds for the ladder signing policy
+ * @return uint64_t monotonic time in milliseconds
  */
-MTLLIB_STATUS mtllib_sign_append(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, MTL_HANDLE **mtl_node)
+static uint64_t mtllib_sign_time_ms(void)
 {
-    uint32_t leaf_index = 0;
-    MTL_HANDLE *handle = NULL;
-
-    if ((ctx == NULL) || (msg == NULL) || (mtl_node == NULL))
-    {
-        LOG_ERROR("NULL input parameters");
-        if (mtl_node != NULL)
-        {
-            *mtl_node = NULL;
-        }
-        return MTLLIB_NULL_PARAMS;
-    }
-    *mtl_node = NULL;
+    struct timespec now;
 
-    if (mtl_hash_and_append(ctx->mtl, msg, msg_len, &leaf_index) != MTL_OK)
-    {
-        LOG_ERROR("Unable to add message to node set");
-        return MTLLIB_SIGN_FAIL;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000);
+}
 
-    handle = calloc(1, sizeof(MTL_HANDLE));
-    handle->leaf_index = leaf_index;
-    handle->sid_len = ctx->mtl->sid.length;
-    memcpy(handle->sid, ctx->mtl->sid.id, handle->sid_len);
+/** Ladder snapshot waiting to be signed */
+typedef struct MTLLIB_LADDER_JOB
+{
+    uint8_t *ladder_sig;
+    size_t ladder_sig_len;
+    size_t ladder_buffer_len;
+    uint8_t *underlying_buffer;
+    uint32_t underlying_buffer_len;
+    uint64_t leaf_count;
+} MTLLIB_LADDER_JOB;
+
+/** Background ladder signer attached to a MTLLIB_CTX */
+struct MTLLIB_SIGNER
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    MTLLIB_LADDER_JOB *pending;
+    uint64_t in_flight_leaf_count;
+    uint8_t stop;
+};
 
-    *mtl_node = handle;
-    return MTLLIB_OK;
+/**
+ * Lock the signed ladder cache
+ * (readers and the background signer can all publish to it)
+ * @param ctx MTL context to use
+ * @return none
+ */
+static void mtllib_sign_lock(MTLLIB_CTX *ctx)
+{
+    pthread_mutex_lock(&ctx->ladder_lock);
 }
 
 /**
- * MTL Library free a MTL handle
- * @param handle     handle to free
+ * Unlock the signed ladder cache
+ * @param ctx MTL context to use
  * @return none
  */
-void mtllib_sign_free_handle(MTL_HANDLE **mtl_node)
+static void mtllib_sign_unlock(MTLLIB_CTX *ctx)
 {
-    if ((mtl_node != NULL) && (*mtl_node != NULL))
-    {
-        free(*mtl_node);
-        *mtl_node = NULL;
-    }
+    pthread_mutex_unlock(&ctx->ladder_lock);
 }
 
 /**
- * MTL Library get the condensed signature for a handle
- * @param ctx     input buffer holding the key
+ * Check if the ladder signing policy allows a new signed ladder
+ * (the caller must hold the signed ladder cache lock)
+ * @param ctx        MTL context to use
+ * @param leaf_count leaf count of the newest ladder already signed or queued
+ * @return uint8_t 1 if a new ladder should be signed, 0 otherwise
+ */
+static uint8_t mtllib_sign_ladder_due(MTLLIB_CTX *ctx, uint64_t leaf_count)
+{
+    uint64_t current = mtl_snapshot(ctx->mtl);
+
+    if ((ctx->signed_ladder == NULL) && (leaf_count == 0))
+    {
+        return 1;
+    }
+    if (leaf_count == current)
+    {
+        return 0;
+    }
+
+    switch (ctx->ladder_policy)
+    {
+    case MTLLIB_LADDER_POLICY_EVERY_N:
+        return (current - leaf_count) >= ctx->ladder_policy_value;
+    case MTLLIB_LADDER_POLICY_INTERVAL:
+        return (mtllib_sign_time_ms() - ctx->signed_ladder_time_ms) >= ctx->ladder_policy_value;
+    case MTLLIB_LADDER_POLICY_ALIGNED:
+        return (current & (ctx->ladder_policy_value - 1)) == 0;
+    case MTLLIB_LADDER_POLICY_ALWAYS:
+    default:
+        return 1;
+    }
+}
+
+/**
+ * Free a ladder snapshot
+ * @param job ladder snapshot to free
+ * @return none
+ */
+static void mtllib_sign_ladder_job_free(MTLLIB_LADDER_JOB *job)
+{
+    if (job != NULL)
+    {
+        free(job->ladder_sig);
+        free(job->underlying_buffer);
+        free(job);
+    }
+}
+
+/**
+ * Snapshot the current ladder into a job that can be signed later
+ * (any thread may call this while other threads append)
+ * @param ctx MTL context to use
+ * @return MTLLIB_LADDER_JOB* ladder snapshot, NULL on failure
+ */
+static MTLLIB_LADDER_JOB *mtllib_sign_ladder_snapshot(MTLLIB_CTX *ctx)
+{
+    LADDER *ladder = NULL;
+    uint8_t *ladder_buffer = NULL;
+    MTLLIB_LADDER_JOB *job = NULL;
+
+    job = calloc(1, sizeof(MTLLIB_LADDER_JOB));
+    if (job == NULL)
+    {
+        return NULL;
+    }
+    // Reserved leaves are not in the ladder until they are committed,
+    // the ladder is built for the same snapshot its job is labelled with
+    job->leaf_count = mtl_snapshot(ctx->mtl);
+    ladder = mtl_ladder_at(ctx->mtl, job->leaf_count);
+    if (ladder == NULL)
+    {
+        free(job);
+        return NULL;
+    }
+    job->ladder_buffer_len = mtl_ladder_to_buffer(ladder, ctx->mtl->nodes.hash_size, &ladder_buffer);
+
+    // Get the scheme separated ladder buffer
+    job->underlying_buffer_len = mtl_get_scheme_separated_buffer(ctx->mtl, ladder,
+                                                                 ctx->mtl->nodes.hash_size,
+                                                                 &job->underlying_buffer, ctx->algo_params->oid,
+                                                                 ctx->algo_params->oid_len);
+    mtl_ladder_free(ladder);
+
+    // Ladder signatures is signature length + 4 bytes for length value
+    job->ladder_sig_len = ctx->signature->length_signature + 4 + job->ladder_buffer_len;
+    job->ladder_sig = malloc(job->ladder_sig_len);
+    if ((ladder_buffer == NULL) || (job->underlying_buffer == NULL) || (job->ladder_sig == NULL))
+    {
+        free(ladder_buffer);
+        mtllib_sign_ladder_job_free(job);
+        return NULL;
+    }
+    memcpy(job->ladder_sig, ladder_buffer, job->ladder_buffer_len);
+    free(ladder_buffer);
+    uint32_to_bytes(&job->ladder_sig[job->ladder_buffer_len], ctx->signature->length_signature);
+
+    return job;
+}
+
+/**
+ * Sign a ladder snapshot and publish it as the cached signed ladder
+ * The job is consumed whether or not signing succeeds.
+ * @param ctx MTL context to use
+ * @param job ladder snapshot to sign
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_sign_ladder_job(MTLLIB_CTX *ctx, MTLLIB_LADDER_JOB *job)
+{
+    size_t ladder_sig_len;
+
+    if (OQS_SIG_sign(ctx->signature, job->ladder_sig + 4 + job->ladder_buffer_len, &ladder_sig_len,
+                     job->underlying_buffer, job->underlying_buffer_len, ctx->secret_key) == OQS_ERROR)
+    {
+        mtllib_sign_ladder_job_free(job);
+        return MTLLIB_SIGN_FAIL;
+    }
+
+    // Never replace a newer ladder with an older one
+    mtllib_sign_lock(ctx);
+    if ((ctx->signed_ladder == NULL) || (job->leaf_count >= ctx->signed_ladder_leaf_count))
+    {
+        free(ctx->signed_ladder);
+        ctx->signed_ladder = job->ladder_sig;
+        ctx->signed_ladder_len = job->ladder_sig_len;
+        ctx->signed_ladder_leaf_count = job->leaf_count;
+        ctx->signed_ladder_time_ms = mtllib_sign_time_ms();
+        job->ladder_sig = NULL;
+    }
+    mtllib_sign_unlock(ctx);
+
+    mtllib_sign_ladder_job_free(job);
+    return MTLLIB_OK;
+}
+
+/**
+ * Sign the current ladder on the calling thread
+ * @param ctx MTL context to use
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_sign_ladder(MTLLIB_CTX *ctx)
+{
+    MTLLIB_LADDER_JOB *job = mtllib_sign_ladder_snapshot(ctx);
+
+    if (job == NULL)
+    {
+        return MTLLIB_MEMORY_ERROR;
+    }
+    return mtllib_sign_ladder_job(ctx, job);
+}
+
+/**
+ * Copy the cached signed ladder if it covers enough leaves
+ * @param ctx           MTL context to use
+ * @param leaf_count    minimum leaf count the ladder must cover
+ * @param ladder        pointer to allocate and fill with the signed ladder bytes
+ * @param ladder_len    pointer to set to the signed ladder bytes length
+ * @param ladder_leaves optional pointer to set to the leaf count the ladder
+ *                      was signed for
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_sign_copy_ladder(MTLLIB_CTX *ctx, uint64_t leaf_count,
+                                             uint8_t **ladder, size_t *ladder_len,
+                                             uint64_t *ladder_leaves)
+{
+    uint8_t *ladder_sig = NULL;
+    MTLLIB_STATUS result = MTLLIB_OK;
+
+    mtllib_sign_lock(ctx);
+    if ((ctx->signed_ladder == NULL) || (ctx->signed_ladder_leaf_count < leaf_count))
+    {
+        result = MTLLIB_NO_LADDER;
+    }
+    else if ((ladder_sig = malloc(ctx->signed_ladder_len)) == NULL)
+    {
+        result = MTLLIB_MEMORY_ERROR;
+    }
+    else
+    {
+        memcpy(ladder_sig, ctx->signed_ladder, ctx->signed_ladder_len);
+        *ladder = ladder_sig;
+        *ladder_len = ctx->signed_ladder_len;
+        if (ladder_leaves != NULL)
+        {
+            *ladder_leaves = ctx->signed_ladder_leaf_count;
+        }
+    }
+    mtllib_sign_unlock(ctx);
+
+    return result;
+}
+
+/**
+ * Background ladder signer thread
+ * @param arg MTL context the signer is attached to
+ * @return NULL
+ */
+static void *mtllib_sign_background_worker(void *arg)
+{
+    MTLLIB_CTX *ctx = (MTLLIB_CTX *)arg;
+    MTLLIB_SIGNER *signer = ctx->signer;
+    MTLLIB_LADDER_JOB *job = NULL;
+
+    pthread_mutex_lock(&signer->lock);
+    while (1)
+    {
+        // Queued ladders are still signed after a stop request
+        while ((signer->pending == NULL) && (signer->stop == 0))
+        {
+            pthread_cond_wait(&signer->wake, &signer->lock);
+        }
+        if (signer->pending == NULL)
+        {
+            break;
+        }
+        job = signer->pending;
+        signer->pending = NULL;
+        signer->in_flight_leaf_count = job->leaf_count;
+        pthread_mutex_unlock(&signer->lock);
+
+        if (mtllib_sign_ladder_job(ctx, job) != MTLLIB_OK)
+        {
+            LOG_ERROR("Unable to sign ladder in the background");
+        }
+
+        pthread_mutex_lock(&signer->lock);
+        signer->in_flight_leaf_count = 0;
+    }
+    pthread_mutex_unlock(&signer->lock);
+
+    return NULL;
+}
+
+/**
+ * Queue the current ladder for the background signer if the policy allows
+ * @param ctx MTL context to use
+ * @return none
+ */
+static void mtllib_sign_background_update(MTLLIB_CTX *ctx)
+{
+    MTLLIB_SIGNER *signer = ctx->signer;
+    MTLLIB_LADDER_JOB *job = NULL;
+    uint64_t newest;
+    uint8_t due;
+
+    if (signer == NULL)
+    {
+        return;
+    }
+
+    // The policy is checked against the ladders already signed or being
+    // signed, a queued ladder that has not started is simply replaced
+    pthread_mutex_lock(&signer->lock);
+    mtllib_sign_lock(ctx);
+    newest = ctx->signed_ladder_leaf_count;
+    if (signer->in_flight_leaf_count > newest)
+    {
+        newest = signer->in_flight_leaf_count;
+    }
+    due = mtllib_sign_ladder_due(ctx, newest);
+    mtllib_sign_unlock(ctx);
+    if (((signer->pending != NULL) &&
+         (signer->pending->leaf_count == mtl_snapshot(ctx->mtl))) ||
+        !due)
+    {
+        pthread_mutex_unlock(&signer->lock);
+        return;
+    }
+    pthread_mutex_unlock(&signer->lock);
+
+    // Several producers may get here at once, each job holds a ladder
+    // built for its own snapshot
+    job = mtllib_sign_ladder_snapshot(ctx);
+    if (job == NULL)
+    {
+        LOG_ERROR("Unable to snapshot ladder");
+        return;
+    }
+
+    // Never queue an older ladder in place of a newer one
+    pthread_mutex_lock(&signer->lock);
+    if ((signer->pending != NULL) && (signer->pending->leaf_count > job->leaf_count))
+    {
+        mtllib_sign_ladder_job_free(job);
+    }
+    else
+    {
+        mtllib_sign_ladder_job_free(signer->pending);
+        signer->pending = job;
+        pthread_cond_signal(&signer->wake);
+    }
+    pthread_mutex_unlock(&signer->lock);
+}
+
+/** Message being appended in pieces, see mtllib_sign_init */
+struct MTLLIB_SIGN_STREAM
+{
+    MTLLIB_CTX *ctx;
+    MTL_MSG_STREAM *msg;
+};
+
+/**
+ * Build the handle for an appended leaf
+ * @param ctx        MTL context the leaf was appended to
+ * @param leaf_index index of the appended leaf
+ * @return MTL_HANDLE pointer or NULL on failure
+ */
+static MTL_HANDLE *mtllib_sign_new_handle(MTLLIB_CTX *ctx, uint32_t leaf_index)
+{
+    MTL_HANDLE *handle = calloc(1, sizeof(MTL_HANDLE));
+
+    if (handle != NULL)
+    {
+        handle->leaf_index = leaf_index;
+        handle->sid_len = ctx->mtl->sid.length;
+        memcpy(handle->sid, ctx->mtl->sid.id, handle->sid_len);
+    }
+    return handle;
+}
+
+/**
+ * MTL Library start appending a message that is supplied in pieces
+ * @param ctx    MTL context to use
+ * @param stream message stream for the message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_init(MTLLIB_CTX *ctx, MTLLIB_SIGN_STREAM **stream)
+{
+    MTLLIB_SIGN_STREAM *sign_stream = NULL;
+
+    if ((ctx == NULL) || (stream == NULL))
+    {
+        LOG_ERROR("NULL input parameters");
+        return MTLLIB_NULL_PARAMS;
+    }
+    *stream = NULL;
+
+    sign_stream = calloc(1, sizeof(MTLLIB_SIGN_STREAM));
+    if (sign_stream == NULL)
+    {
+        return MTLLIB_MEMORY_ERROR;
+    }
+    if (mtl_hash_and_append_init(ctx->mtl, &sign_stream->msg) != MTL_OK)
+    {
+        LOG_ERROR("Unable to start message hash");
+        free(sign_stream);
+        return MTLLIB_SIGN_FAIL;
+    }
+    sign_stream->ctx = ctx;
+
+    *stream = sign_stream;
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library add the next piece of a message being appended
+ * @param stream  message stream from mtllib_sign_init
+ * @param msg     input message buffer
+ * @param msg_len length of the input message buffer
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_update(MTLLIB_SIGN_STREAM *stream, uint8_t *msg, size_t msg_len)
+{
+    if ((stream == NULL) || (msg == NULL))
+    {
+        LOG_ERROR("NULL input parameters");
+        return MTLLIB_NULL_PARAMS;
+    }
+
+    if (mtl_hash_stream_update(stream->msg, msg, msg_len) != MTL_OK)
+    {
+        LOG_ERROR("Unable to hash message data");
+        return MTLLIB_SIGN_FAIL;
+    }
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library finish appending a message that was supplied in pieces
+ * @param stream   message stream from mtllib_sign_init
+ * @param mtl_node handle for the appended message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_final(MTLLIB_SIGN_STREAM *stream, MTL_HANDLE **mtl_node)
+{
+    MTLLIB_CTX *ctx = NULL;
+    MTL_MSG_STREAM *msg = NULL;
+    uint32_t leaf_index = 0;
+    MTL_HANDLE *handle = NULL;
+
+    if ((stream == NULL) || (mtl_node == NULL))
+    {
+        LOG_ERROR("NULL input parameters");
+        mtllib_sign_free_stream(&stream);
+        return MTLLIB_NULL_PARAMS;
+    }
+    *mtl_node = NULL;
+    ctx = stream->ctx;
+    msg = stream->msg;
+    free(stream);
+
+    if (mtl_hash_and_append_final(msg, &leaf_index) != MTL_OK)
+    {
+        LOG_ERROR("Unable to add message to node set");
+        return MTLLIB_SIGN_FAIL;
+    }
+
+    handle = mtllib_sign_new_handle(ctx, leaf_index);
+    if (handle == NULL)
+    {
+        return MTLLIB_MEMORY_ERROR;
+    }
+
+    mtllib_sign_background_update(ctx);
+
+    *mtl_node = handle;
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library free a message stream without appending the message
+ * @param stream     stream to free
+ * @return none
+ */
+void mtllib_sign_free_stream(MTLLIB_SIGN_STREAM **stream)
+{
+    if ((stream != NULL) && (*stream != NULL))
+    {
+        mtl_hash_stream_free((*stream)->msg);
+        free(*stream);
+        *stream = NULL;
+    }
+}
+
+/**
+ * MTL Library append a message to the node set
+ * @param ctx      MTL context to use
+ * @param msg      input message buffer
+ * @param msg_len  length of the input message buffer
+ * @param mtl_node handle for the appended message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_append(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, MTL_HANDLE **mtl_node)
+{
+    uint32_t leaf_index = 0;
+    MTL_HANDLE *handle = NULL;
+    MTLLIB_SIGN_STREAM *stream = NULL;
+    MTLLIB_STATUS status;
+
+    if ((ctx == NULL) || (msg == NULL) || (mtl_node == NULL))
+    {
+        LOG_ERROR("NULL input parameters");
+        if (mtl_node != NULL)
+        {
+            *mtl_node = NULL;
+        }
+        return MTLLIB_NULL_PARAMS;
+    }
+    *mtl_node = NULL;
+
+    // Messages too long for the one shot hash are streamed instead
+    if (msg_len > UINT32_MAX)
+    {
+        status = mtllib_sign_init(ctx, &stream);
+        if (status != MTLLIB_OK)
+        {
+            return status;
+        }
+        status = mtllib_sign_update(stream, msg, msg_len);
+        if (status != MTLLIB_OK)
+        {
+            mtllib_sign_free_stream(&stream);
+            return status;
+        }
+        return mtllib_sign_final(stream, mtl_node);
+    }
+
+    if (mtl_hash_and_append(ctx->mtl, msg, (uint32_t)msg_len, &leaf_index) != MTL_OK)
+    {
+        LOG_ERROR("Unable to add message to node set");
+        return MTLLIB_SIGN_FAIL;
+    }
+
+    handle = mtllib_sign_new_handle(ctx, leaf_index);
+    if (handle == NULL)
+    {
+        return MTLLIB_MEMORY_ERROR;
+    }
+
+    mtllib_sign_background_update(ctx);
+
+    *mtl_node = handle;
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library append a batch of messages to the node set
+ * @param ctx       MTL context to use
+ * @param msgs      array of input message buffers
+ * @param msg_lens  length of each input message buffer
+ * @param count     number of messages
+ * @param mtl_nodes array filled with a handle for each appended message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_append_many(MTLLIB_CTX *ctx, uint8_t **msgs, size_t *msg_lens,
+                                      uint32_t count, MTL_HANDLE **mtl_nodes)
+{
+    uint32_t *leaf_indexes = NULL;
+    uint32_t *lens = NULL;
+    MTLLIB_STATUS status;
+    uint32_t index;
+
+    if ((ctx == NULL) || (msgs == NULL) || (msg_lens == NULL) ||
+        (count == 0) || (mtl_nodes == NULL))
+    {
+        LOG_ERROR("NULL input parameters");
+        return MTLLIB_NULL_PARAMS;
+    }
+    for (index = 0; index < count; index++)
+    {
+        mtl_nodes[index] = NULL;
+        if (msgs[index] == NULL)
+        {
+            LOG_ERROR("NULL input parameters");
+            return MTLLIB_NULL_PARAMS;
+        }
+    }
+
+    // The threaded batch takes 32 bit lengths, so a batch holding a
+    // longer message is appended one message at a time instead
+    for (index = 0; index < count; index++)
+    {
+        if (msg_lens[index] > UINT32_MAX)
+        {
+            break;
+        }
+    }
+    if (index < count)
+    {
+        for (index = 0; index < count; index++)
+        {
+            status = mtllib_sign_append(ctx, msgs[index], msg_lens[index], &mtl_nodes[index]);
+            if (status != MTLLIB_OK)
+            {
+                while (index > 0)
+                {
+                    index--;
+                    mtllib_sign_free_handle(&mtl_nodes[index]);
+                }
+                return status;
+            }
+        }
+        return MTLLIB_OK;
+    }
+
+    leaf_indexes = malloc(count * sizeof(uint32_t));
+    lens = malloc(count * sizeof(uint32_t));
+    if ((leaf_indexes == NULL) || (lens == NULL))
+    {
+        free(leaf_indexes);
+        free(lens);
+        return MTLLIB_MEMORY_ERROR;
+    }
+    for (index = 0; index < count; index++)
+    {
+        lens[index] = (uint32_t)msg_lens[index];
+    }
+
+    if (mtl_hash_and_append_threads(ctx->mtl, msgs, lens, count, leaf_indexes,
+                                    ctx->threads) != MTL_OK)
+    {
+        LOG_ERROR("Unable to add messages to node set");
+        free(leaf_indexes);
+        free(lens);
+        return MTLLIB_SIGN_FAIL;
+    }
+
+    status = MTLLIB_OK;
+    for (index = 0; index < count; index++)
+    {
+        mtl_nodes[index] = mtllib_sign_new_handle(ctx, leaf_indexes[index]);
+        if (mtl_nodes[index] == NULL)
+        {
+            status = MTLLIB_MEMORY_ERROR;
+        }
+    }
+    if (status != MTLLIB_OK)
+    {
+        for (index = 0; index < count; index++)
+        {
+            mtllib_sign_free_handle(&mtl_nodes[index]);
+        }
+    }
+    mtllib_sign_background_update(ctx);
+
+    free(leaf_indexes);
+    free(lens);
+    return status;
+}
+
+/**
+ * MTL Library free a MTL handle
+ * @param handle     handle to free
+ * @return none
+ */
+void mtllib_sign_free_handle(MTL_HANDLE **mtl_node)
+{
+    if ((mtl_node != NULL) && (*mtl_node != NULL))
+    {
+        free(*mtl_node);
+        *mtl_node = NULL;
+    }
+}
+
+/**
+ * Build the condensed signature for a leaf relative to a snapshot's ladder
+ * @param ctx        MTL context to use
+ * @param leaf_index leaf index of the signed message
+ * @param snapshot   leaf count of the ladder the signature is for
+ * @param sig        pointer to allocate and fill with the signature bytes
+ * @param sig_len    pointer to set to the signature bytes length
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+static MTLLIB_STATUS mtllib_sign_condensed_at(MTLLIB_CTX *ctx, uint32_t leaf_index, uint64_t snapshot,
+                                              uint8_t **sig, size_t *sig_len)
+{
+    RANDOMIZER *mtl_rand = NULL;
+    AUTHPATH *auth = NULL;
+
+    if (mtl_randomizer_and_authpath_at(ctx->mtl, leaf_index, snapshot, &mtl_rand, &auth) != MTL_OK)
+    {
+        return MTLLIB_SIGN_FAIL;
+    }
+
+    *sig_len = mtl_auth_path_to_buffer(mtl_rand, auth, ctx->algo_params->sec_param, sig);
+    mtl_authpath_free(auth);
+    mtl_randomizer_free(mtl_rand);
+
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library get the condensed signature for a handle
+ * @param ctx     input buffer holding the key
  * @param handle  handle to the signed message
  * @param sig     pointer to allocate and fill with the signature bytes
  * @param sig_len pointer to set to the signature bytes length
@@ -578,9 +1668,6 @@ void mtllib_sign_free_handle(MTL_HANDLE **mtl_node)
  */
 MTLLIB_STATUS mtllib_sign_get_condensed_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle, uint8_t **sig, size_t *sig_len)
 {
-    RANDOMIZER *mtl_rand = NULL;
-    AUTHPATH *auth = NULL;
-
     if (sig_len != NULL)
     {
         *sig_len = 0;
@@ -592,16 +1679,7 @@ MTLLIB_STATUS mtllib_sign_get_condensed_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle,
         return MTLLIB_NULL_PARAMS;
     }
 
-    if (mtl_randomizer_and_authpath(ctx->mtl, handle->leaf_index, &mtl_rand, &auth) != MTL_OK)
-    {
-        return MTLLIB_SIGN_FAIL;
-    }
-
-    *sig_len = mtl_auth_path_to_buffer(mtl_rand, auth, ctx->algo_params->sec_param, sig);
-    mtl_authpath_free(auth);
-    mtl_randomizer_free(mtl_rand);
-
-    return MTLLIB_OK;
+    return mtllib_sign_condensed_at(ctx, handle->leaf_index, mtl_snapshot(ctx->mtl), sig, sig_len);
 }
 
 /**
@@ -614,13 +1692,7 @@ MTLLIB_STATUS mtllib_sign_get_condensed_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle,
  */
 MTLLIB_STATUS mtllib_sign_get_signed_ladder(MTLLIB_CTX *ctx, uint8_t **ladder, size_t *ladder_len)
 {
-    LADDER *ladder_ptr = NULL;
-    uint8_t *ladder_sig = NULL;
-    size_t ladder_sig_len;
-    uint8_t *ladder_buffer = NULL;
-    uint32_t ladder_buffer_len = 0;
-    uint8_t *underlying_buffer = NULL;
-    uint32_t underlying_buffer_len = 0;
+    uint8_t due;
 
     if (ladder_len != NULL)
     {
@@ -632,36 +1704,168 @@ MTLLIB_STATUS mtllib_sign_get_signed_ladder(MTLLIB_CTX *ctx, uint8_t **ladder, s
     {
         return MTLLIB_NULL_PARAMS;
     }
+    *ladder = NULL;
 
-    // Get the latest ladder
-    ladder_ptr = mtl_ladder(ctx->mtl);
-    ladder_buffer_len = mtl_ladder_to_buffer(ladder_ptr, ctx->mtl->nodes.hash_size, &ladder_buffer);
+    // Only sign when the cache is stale and the policy allows it
+    mtllib_sign_lock(ctx);
+    due = mtllib_sign_ladder_due(ctx, ctx->signed_ladder_leaf_count);
+    mtllib_sign_unlock(ctx);
+    if (due)
+    {
+        if (mtllib_sign_ladder(ctx) != MTLLIB_OK)
+        {
+            return MTLLIB_SIGN_FAIL;
+        }
+    }
 
-    // Get the scheme separated ladder buffer
-    underlying_buffer_len = mtl_get_scheme_separated_buffer(ctx->mtl, ladder_ptr,
-                                                            ctx->mtl->nodes.hash_size,
-                                                            &underlying_buffer, ctx->algo_params->oid, ctx->algo_params->oid_len);
+    return mtllib_sign_copy_ladder(ctx, 0, ladder, ladder_len, NULL);
+}
 
-    // Ladder signatures is signature length + 4 bytes for length value
-    ladder_sig = malloc(ctx->signature->length_signature + 4 + ladder_buffer_len);
-    memcpy(ladder_sig, ladder_buffer, ladder_buffer_len);
-    free(ladder_buffer);
-    mtl_ladder_free(ladder_ptr);
-    uint32_to_bytes(&ladder_sig[ladder_buffer_len], ctx->signature->length_signature);
-    if (OQS_SIG_sign(ctx->signature, ladder_sig + 4 + ladder_buffer_len, &ladder_sig_len, underlying_buffer,
-                     underlying_buffer_len, ctx->secret_key) == OQS_ERROR)
+/**
+ * MTL Library get the latest signed ladder covering a leaf without blocking
+ * @param ctx        MTL context to use
+ * @param leaf_index leaf index the ladder has to cover
+ * @param ladder     pointer to allocate and fill with the signed ladder bytes
+ * @param ladder_len pointer to set to the signed ladder bytes length
+ * @return MTLLIB_STATUS MTLLIB_OK if successful, MTLLIB_NO_LADDER if no
+ *         signed ladder covering the leaf has been published yet
+ */
+MTLLIB_STATUS mtllib_sign_get_signed_ladder_covering(MTLLIB_CTX *ctx, uint32_t leaf_index,
+                                                     uint8_t **ladder, size_t *ladder_len)
+{
+    if (ladder_len != NULL)
     {
-        *ladder = NULL;
         *ladder_len = 0;
-        free(ladder_sig);
-        free(underlying_buffer);
-        return MTLLIB_SIGN_FAIL;
     }
-    free(underlying_buffer);
 
-    *ladder = ladder_sig;
-    *ladder_len = ctx->signature->length_signature + 4 + ladder_buffer_len;
+    if ((ctx == NULL) || (ladder == NULL) || (ladder_len == NULL))
+    {
+        return MTLLIB_NULL_PARAMS;
+    }
+    *ladder = NULL;
+
+    return mtllib_sign_copy_ladder(ctx, (uint64_t)leaf_index + 1, ladder, ladder_len, NULL);
+}
+
+/**
+ * MTL Library start signing ladders on a background thread
+ * @param ctx MTL context to use
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_start_background(MTLLIB_CTX *ctx)
+{
+    MTLLIB_SIGNER *signer = NULL;
+
+    if ((ctx == NULL) || (ctx->mtl == NULL) || (ctx->algo_params == NULL) ||
+        (ctx->signature == NULL) || (ctx->secret_key == NULL))
+    {
+        return MTLLIB_NULL_PARAMS;
+    }
+    if (ctx->signer != NULL)
+    {
+        return MTLLIB_OK;
+    }
+
+    signer = calloc(1, sizeof(MTLLIB_SIGNER));
+    if (signer == NULL)
+    {
+        return MTLLIB_MEMORY_ERROR;
+    }
+    pthread_mutex_init(&signer->lock, NULL);
+    pthread_cond_init(&signer->wake, NULL);
+
+    ctx->signer = signer;
+    if (pthread_create(&signer->thread, NULL, mtllib_sign_background_worker, ctx) != 0)
+    {
+        LOG_ERROR("Unable to start ladder signing thread");
+        ctx->signer = NULL;
+        pthread_cond_destroy(&signer->wake);
+        pthread_mutex_destroy(&signer->lock);
+        free(signer);
+        return MTLLIB_MEMORY_ERROR;
+    }
+
+    // Start with a ladder for the leaves already in the node set
+    mtllib_sign_background_update(ctx);
+
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library stop the background ladder signer
+ * @param ctx MTL context to use
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_stop_background(MTLLIB_CTX *ctx)
+{
+    MTLLIB_SIGNER *signer = NULL;
+
+    if (ctx == NULL)
+    {
+        return MTLLIB_NULL_PARAMS;
+    }
+    signer = ctx->signer;
+    if (signer == NULL)
+    {
+        return MTLLIB_OK;
+    }
+
+    pthread_mutex_lock(&signer->lock);
+    signer->stop = 1;
+    pthread_cond_signal(&signer->wake);
+    pthread_mutex_unlock(&signer->lock);
+    pthread_join(signer->thread, NULL);
+
+    ctx->signer = NULL;
+    pthread_cond_destroy(&signer->wake);
+    pthread_mutex_destroy(&signer->lock);
+    free(signer);
+
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library set the policy that decides when a new ladder is signed
+ * @param ctx    MTL context to use
+ * @param policy ladder signing policy
+ * @param value  leaves for EVERY_N, milliseconds for INTERVAL, or the
+ *               power of two alignment for ALIGNED (unused for ALWAYS)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_set_ladder_policy(MTLLIB_CTX *ctx, MTLLIB_LADDER_POLICY policy,
+                                            uint32_t value)
+{
+    if (ctx == NULL)
+    {
+        return MTLLIB_NULL_PARAMS;
+    }
+
+    switch (policy)
+    {
+    case MTLLIB_LADDER_POLICY_ALWAYS:
+    case MTLLIB_LADDER_POLICY_INTERVAL:
+        break;
+    case MTLLIB_LADDER_POLICY_EVERY_N:
+        if (value == 0)
+        {
+            LOG_ERROR("Ladder policy leaf count must be non-zero");
+            return MTLLIB_BAD_VALUE;
+        }
+        break;
+    case MTLLIB_LADDER_POLICY_ALIGNED:
+        if ((value == 0) || ((value & (value - 1)) != 0))
+        {
+            LOG_ERROR("Ladder policy alignment must be a power of two");
+            return MTLLIB_BAD_VALUE;
+        }
+        break;
+    default:
+        LOG_ERROR("Invalid ladder policy");
+        return MTLLIB_BAD_VALUE;
+    }
 
+    ctx->ladder_policy = policy;
+    ctx->ladder_policy_value = value;
     return MTLLIB_OK;
 }
 
@@ -679,7 +1883,9 @@ MTLLIB_STATUS mtllib_sign_get_full_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle, uint
     size_t condensed_len = 0;
     uint8_t *ladder = NULL;
     size_t ladder_len = 0;
+    uint64_t ladder_leaves = 0;
     uint8_t *full = NULL;
+    MTLLIB_STATUS result;
 
     if (sig_len != NULL)
     {
@@ -692,14 +1898,31 @@ MTLLIB_STATUS mtllib_sign_get_full_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle, uint
         return MTLLIB_NULL_PARAMS;
     }
 
-    if (mtllib_sign_get_condensed_sig(ctx, handle, &condensed, &condensed_len) != MTLLIB_OK)
+    // A background signer publishes ladders, otherwise sign one
+    // here when the ladder signing policy allows it
+    if (ctx->signer == NULL)
     {
-        return MTLLIB_SIGN_FAIL;
+        if (mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) != MTLLIB_OK)
+        {
+            return MTLLIB_SIGN_FAIL;
+        }
+        free(ladder);
+        ladder = NULL;
     }
 
-    if (mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) != MTLLIB_OK)
+    // The ladder policy may hold back a ladder that covers this leaf
+    result = mtllib_sign_copy_ladder(ctx, (uint64_t)handle->leaf_index + 1, &ladder, &ladder_len,
+                                     &ladder_leaves);
+    if (result != MTLLIB_OK)
     {
-        free(condensed);
+        return result;
+    }
+
+    // The auth path must reach a rung of this ladder, so it is built for
+    // the snapshot the ladder was signed for rather than the newest one
+    if (mtllib_sign_condensed_at(ctx, handle->leaf_index, ladder_leaves, &condensed, &condensed_len) != MTLLIB_OK)
+    {
+        free(ladder);
         return MTLLIB_SIGN_FAIL;
     }
 
@@ -750,6 +1973,24 @@ MTLLIB_STATUS mtllib_verify(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, uint8
         *condensed_len = 0;
     }
 
+    // Messages too long for the one shot hash are streamed instead
+    if (msg_len > UINT32_MAX)
+    {
+        MTLLIB_VERIFY_STREAM *stream = NULL;
+        MTLLIB_STATUS status = mtllib_verify_init(ctx, sig, sig_len, &stream);
+
+        if (status == MTLLIB_OK)
+        {
+            status = mtllib_verify_update(stream, msg, msg_len);
+        }
+        if (status != MTLLIB_OK)
+        {
+            mtllib_verify_free_stream(&stream);
+            return status;
+        }
+        return mtllib_verify_final(stream, ladder_buf, ladder_buf_len, condensed_len);
+    }
+
     // Fetch the signature parameters
     condensed_size = mtl_auth_path_from_buffer((char *)sig, sig_len, ctx->algo_params->sec_param, ctx->algo_params->sid_len, &mtl_rand, &auth_path);
     if (condensed_size == 0)
@@ -787,7 +2028,7 @@ MTLLIB_STATUS mtllib_verify(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, uint8
             mtl_authpath_free(auth_path);
             return MTLLIB_NULL_PARAMS;
         }
-        if (mtl_hash_and_verify(ctx->mtl, msg, msg_len, mtl_rand, auth_path, rung) == MTL_OK)
+        if (mtl_hash_and_verify(ctx->mtl, msg, (uint32_t)msg_len, mtl_rand, auth_path, rung) == MTL_OK)
         {
             mtl_ladder_free(ladder);
             mtl_randomizer_free(mtl_rand);
@@ -831,7 +2072,7 @@ MTLLIB_STATUS mtllib_verify(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, uint8
                     mtl_authpath_free(auth_path);
                     return MTLLIB_NULL_PARAMS;
                 }
-                if (mtl_hash_and_verify(ctx->mtl, msg, msg_len, mtl_rand, auth_path, rung) == MTL_OK)
+                if (mtl_hash_and_verify(ctx->mtl, msg, (uint32_t)msg_len, mtl_rand, auth_path, rung) == MTL_OK)
                 {
                     mtl_ladder_free(ladder);
                     mtl_randomizer_free(mtl_rand);
@@ -864,6 +2105,233 @@ MTLLIB_STATUS mtllib_verify(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, uint8
     return MTLLIB_OK;
 }
 
+/** Message being verified in pieces, see mtllib_verify_init */
+struct MTLLIB_VERIFY_STREAM
+{
+    MTLLIB_CTX *ctx;
+    MTL_MSG_STREAM *msg;
+    RANDOMIZER *randomizer;
+    AUTHPATH *auth_path;
+    uint8_t *sig;
+    size_t sig_len;
+    uint32_t condensed_size;
+};
+
+/**
+ * Verify a message data value against the rung a ladder has for it
+ * @param ctx        MTL context to use
+ * @param data_value message hash from mtl_hash_and_verify_final
+ * @param auth_path  authentication path from the signature
+ * @param ladder_buf ladder bytes
+ * @param ladder_buf_len length of the ladder in bytes
+ * @return MTLLIB_STATUS MTLLIB_OK if the data value is authenticated
+ */
+static MTLLIB_STATUS mtllib_verify_data_value(MTLLIB_CTX *ctx, uint8_t *data_value, AUTHPATH *auth_path,
+                                              uint8_t *ladder_buf, size_t ladder_buf_len)
+{
+    LADDER *ladder = NULL;
+    RUNG *rung = NULL;
+    MTLLIB_STATUS status = MTLLIB_BOGUS_CRYPTO;
+
+    if (mtl_ladder_from_buffer((char *)ladder_buf, ladder_buf_len, ctx->algo_params->sec_param, ctx->algo_params->sid_len, &ladder) == 0)
+    {
+        LOG_ERROR("Unable to read ladder from buffer");
+        mtl_ladder_free(ladder);
+        return MTLLIB_BOGUS_CRYPTO;
+    }
+
+    rung = mtl_rung(auth_path, ladder);
+    if (rung == NULL)
+    {
+        LOG_ERROR("NULL mtl_rung");
+        status = MTLLIB_NULL_PARAMS;
+    }
+    else if (mtl_verify(ctx->mtl, data_value, ctx->mtl->nodes.hash_size, auth_path, rung) == MTL_OK)
+    {
+        status = MTLLIB_OK;
+    }
+    else
+    {
+        LOG_ERROR("MTL authentication failed validation\n");
+    }
+    mtl_ladder_free(ladder);
+    return status;
+}
+
+/**
+ * MTL Library start verifying a signature over a message that is
+ * supplied in pieces
+ * @param ctx     MTL context to use
+ * @param sig     pointer to the signature bytes (copied)
+ * @param sig_len length of the signature in bytes
+ * @param stream  message stream for the message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_verify_init(MTLLIB_CTX *ctx, uint8_t *sig, size_t sig_len, MTLLIB_VERIFY_STREAM **stream)
+{
+    MTLLIB_VERIFY_STREAM *verify_stream = NULL;
+
+    if ((ctx == NULL) || (sig == NULL) || (sig_len == 0) || (stream == NULL))
+    {
+        return MTLLIB_NULL_PARAMS;
+    }
+    *stream = NULL;
+
+    verify_stream = calloc(1, sizeof(MTLLIB_VERIFY_STREAM));
+    if (verify_stream == NULL)
+    {
+        return MTLLIB_MEMORY_ERROR;
+    }
+    verify_stream->ctx = ctx;
+
+    // Keep the signature, a full signature carries its ladder after the
+    // condensed part
+    verify_stream->sig = malloc(sig_len);
+    if (verify_stream->sig == NULL)
+    {
+        mtllib_verify_free_stream(&verify_stream);
+        return MTLLIB_MEMORY_ERROR;
+    }
+    memcpy(verify_stream->sig, sig, sig_len);
+    verify_stream->sig_len = sig_len;
+
+    // Fetch the signature parameters
+    verify_stream->condensed_size = mtl_auth_path_from_buffer((char *)verify_stream->sig, sig_len,
+                                                              ctx->algo_params->sec_param, ctx->algo_params->sid_len,
+                                                              &verify_stream->randomizer, &verify_stream->auth_path);
+    if (verify_stream->condensed_size == 0)
+    {
+        LOG_ERROR("Authentication Path is Invalid");
+        mtllib_verify_free_stream(&verify_stream);
+        return MTLLIB_BOGUS_CRYPTO;
+    }
+
+    if (mtl_hash_and_verify_init(ctx->mtl, verify_stream->randomizer, verify_stream->auth_path->leaf_index,
+                                 &verify_stream->msg) != MTL_OK)
+    {
+        LOG_ERROR("Unable to start message hash");
+        mtllib_verify_free_stream(&verify_stream);
+        return MTLLIB_BOGUS_CRYPTO;
+    }
+
+    *stream = verify_stream;
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library add the next piece of a message being verified
+ * @param stream  message stream from mtllib_verify_init
+ * @param msg     input message buffer
+ * @param msg_len length of the input message buffer
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_verify_update(MTLLIB_VERIFY_STREAM *stream, uint8_t *msg, size_t msg_len)
+{
+    if ((stream == NULL) || (msg == NULL))
+    {
+        return MTLLIB_NULL_PARAMS;
+    }
+
+    if (mtl_hash_stream_update(stream->msg, msg, msg_len) != MTL_OK)
+    {
+        LOG_ERROR("Unable to hash message data");
+        return MTLLIB_BOGUS_CRYPTO;
+    }
+    return MTLLIB_OK;
+}
+
+/**
+ * MTL Library finish verifying a signature over a message that was
+ * supplied in pieces
+ * @param stream     message stream from mtllib_verify_init
+ * @param ladder_buf optional pointer to pre-verified ladder (for condensed signatures)
+ * @param ladder_buf_len length of the optional pre-verified ladder in bytes
+ * @param condensed_len optional pointer that will be filled in to the condensed length
+ * @return MTLLIB_STATUS MTLLIB_OK if the signature is valid
+ */
+MTLLIB_STATUS mtllib_verify_final(MTLLIB_VERIFY_STREAM *stream, uint8_t *ladder_buf, size_t ladder_buf_len, size_t *condensed_len)
+{
+    uint8_t data_value[EVP_MAX_MD_SIZE];
+    size_t full_sig_len = 0;
+    MTLLIB_STATUS status = MTLLIB_NO_LADDER;
+
+    if(condensed_len != NULL) {
+        *condensed_len = 0;
+    }
+    if (stream == NULL)
+    {
+        return MTLLIB_NULL_PARAMS;
+    }
+
+    if (mtl_hash_and_verify_final(stream->msg, &data_value[0]) != MTL_OK)
+    {
+        LOG_ERROR("Unable to hash message");
+        stream->msg = NULL;
+        mtllib_verify_free_stream(&stream);
+        return MTLLIB_BOGUS_CRYPTO;
+    }
+    stream->msg = NULL;
+    if(condensed_len != NULL) {
+        *condensed_len = stream->condensed_size;
+    }
+
+    // Try to verify with the provided ladder (for performance less crypto to verify)
+    if ((ladder_buf != NULL) && (ladder_buf_len > 0))
+    {
+        status = mtllib_verify_data_value(stream->ctx, &data_value[0], stream->auth_path,
+                                          ladder_buf, ladder_buf_len);
+    }
+
+    // If provided ladder didn't work see if we have a full signature we can use
+    if ((status != MTLLIB_OK) && (stream->condensed_size < stream->sig_len))
+    {
+        full_sig_len = stream->sig_len - stream->condensed_size;
+        if (full_sig_len <= 100)
+        {
+            LOG_ERROR("There is no ladder to use for validating this signature.  Please fetch a valid ladder.\n");
+            status = MTLLIB_NO_LADDER;
+        }
+        else if (mtllib_verify_signed_ladder(stream->ctx, stream->sig + stream->condensed_size, full_sig_len) != MTLLIB_OK)
+        {
+            LOG_ERROR("Unable to validate the provided ladder\n");
+            status = MTLLIB_BOGUS_CRYPTO;
+        }
+        else
+        {
+            status = mtllib_verify_data_value(stream->ctx, &data_value[0], stream->auth_path,
+                                              stream->sig + stream->condensed_size, full_sig_len);
+        }
+    }
+    else if (status != MTLLIB_OK)
+    {
+        status = MTLLIB_NO_LADDER;
+    }
+
+    mtllib_verify_free_stream(&stream);
+    return status;
+}
+
+/**
+ * MTL Library free a message stream without finishing the verification
+ * @param stream     stream to free
+ * @return none
+ */
+void mtllib_verify_free_stream(MTLLIB_VERIFY_STREAM **stream)
+{
+    if ((stream != NULL) && (*stream != NULL))
+    {
+        mtl_hash_stream_free((*stream)->msg);
+        mtl_randomizer_free((*stream)->randomizer);
+        if ((*stream)->auth_path != NULL)
+        {
+            mtl_authpath_free((*stream)->auth_path);
+        }
+        free((*stream)->sig);
+        free(*stream);
+        *stream = NULL;
+    }
+}
+
 /**
  * MTL Library verify a signed ladder
  * @param ctx        input buffer holding the key
@@ -110,6 +110,26 @@ typedef enum MTLLIB_STATUS
     MTLLIB_INDETERMINATE = 9,
 } MTLLIB_STATUS;
 
+typedef enum MTLLIB_LADDER_POLICY
+{
+    // Sign a new ladder whenever the leaf count has changed
+    MTLLIB_LADDER_POLICY_ALWAYS = 0,
+    // Sign a new ladder once N leaves were appended since the last one
+    MTLLIB_LADDER_POLICY_EVERY_N = 1,
+    // Sign a new ladder at most once every T milliseconds
+    MTLLIB_LADDER_POLICY_INTERVAL = 2,
+    // Sign a new ladder only when the leaf count is a multiple of
+    //     the given power of two
+    MTLLIB_LADDER_POLICY_ALIGNED = 3,
+} MTLLIB_LADDER_POLICY;
+
+// Background ladder signer state (private to mtllib.c)
+typedef struct MTLLIB_SIGNER MTLLIB_SIGNER;
+
+// Message streams for signing and verifying in pieces (private to mtllib.c)
+typedef struct MTLLIB_SIGN_STREAM MTLLIB_SIGN_STREAM;
+typedef struct MTLLIB_VERIFY_STREAM MTLLIB_VERIFY_STREAM;
+
 typedef struct MTLLIB_CTX
 {
     MTL_ALGORITHM_PROPS *algo_params;
@@ -119,6 +139,16 @@ typedef struct MTLLIB_CTX
     size_t secret_key_len;
     OQS_SIG *signature;
     MTL_CTX *mtl;
+    uint32_t threads;
+    // Signed ladder cache, guarded by ladder_lock
+    pthread_mutex_t ladder_lock;
+    uint8_t *signed_ladder;
+    size_t signed_ladder_len;
+    uint64_t signed_ladder_leaf_count;
+    uint64_t signed_ladder_time_ms;
+    MTLLIB_LADDER_POLICY ladder_policy;
+    uint32_t ladder_policy_value;
+    MTLLIB_SIGNER *signer;
 } MTLLIB_CTX;
 
 typedef struct MTL_HANDLE
@@ -129,6 +159,22 @@ typedef struct MTL_HANDLE
 } MTL_HANDLE;
 
 #define RANDOMIZER_FLAG 0x01
+#define GEOMETRY_FLAG 0x02
+#define SECTIONS_FLAG 0x04
+#define LAYOUT_FLAG 0x08
+#define LEAF_COUNT_64_FLAG 0x10
+
+// Key buffer formats
+// V1 stores the leaf hashes and rebuilds the internal nodes on load
+// V2 stores checksummed sections holding every node so load is a copy
+#define MTLLIB_KEY_FORMAT_V1 1
+#define MTLLIB_KEY_FORMAT_V2 2
+
+// Key buffer V2 sections (TOC entry: type, 64 bit length, SHA-256)
+#define KEY_SECTION_TREE 1
+#define KEY_SECTION_RANDOMIZER 2
+#define KEY_SECTION_CHECKSUM_SIZE 32
+#define KEY_SECTION_TOC_SIZE (2 + 8 + KEY_SECTION_CHECKSUM_SIZE)
 
 // Function Macros
 #define PKSEED_INIT(ptr, value, len)  \
@@ -165,6 +211,17 @@ typedef struct MTL_HANDLE
         }                                     \
     }
 
+// Same check for a key context whose MTL node set is already set up
+#define BUFFER_VERIFY_KEY_LENGTH(curr, size, ctx) \
+    {                                             \
+        if (curr < size)                          \
+        {                                         \
+            printf("ERROR: Buffer error\n");      \
+            mtllib_key_free(ctx);                 \
+            return MTLLIB_BAD_VALUE;              \
+        }                                         \
+    }
+
 // MTL Library Function Prototypes
 /**
  * MTL Library New Key
@@ -175,6 +232,31 @@ typedef struct MTL_HANDLE
  */
 MTLLIB_STATUS mtllib_key_new(char *keystr, MTLLIB_CTX **ctx, char *ctx_str);
 
+/**
+ * MTL Library New Key with a specific node set page geometry
+ * @param keystr the string identifier for the desired algorithm
+ * @param ctx pointer to what will be allocated as the MTL library key context
+ * @param ctx_str the optional MTL context string
+ * @param page_size node set page size in bytes (0 for the default)
+ * @param max_pages maximum number of node set pages (0 for the default)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_key_new_with_geometry(char *keystr, MTLLIB_CTX **ctx, char *ctx_str,
+                                           uint32_t page_size, uint32_t max_pages);
+
+/**
+ * MTL Library New Key with a specific node set page geometry and layout
+ * @param keystr the string identifier for the desired algorithm
+ * @param ctx pointer to what will be allocated as the MTL library key context
+ * @param ctx_str the optional MTL context string
+ * @param page_size node set page size in bytes (0 for the default)
+ * @param max_pages maximum number of node set pages (0 for the default)
+ * @param layout node set page layout (MTL_NODE_SET_LAYOUT_LINEAR or MTL_NODE_SET_LAYOUT_BLOCKED)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_key_new_with_layout(char *keystr, MTLLIB_CTX **ctx, char *ctx_str,
+                                         uint32_t page_size, uint32_t max_pages, uint8_t layout);
+
 /**
  * MTL Library Get Public Key
  * @param ctx pointer to the MTL library key context
@@ -216,6 +298,27 @@ MTLLIB_STATUS mtllib_key_pubkey_from_params(char *keystr, MTLLIB_CTX **ctx, char
  */
 MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_CTX **ctx);
 
+/**
+ * MTL Library Key from Buffer using worker threads
+ * @param buffer     input buffer holding the key
+ * @param buffer_len the length of the input buffer
+ * @param ctx        MTL context created from the buffer
+ * @param threads    threads used to rebuild the internal nodes of a V1 key
+ *                   (0 for one per online CPU, 1 to rebuild sequentially)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_key_from_buffer_threads(uint8_t *buffer, size_t buffer_len,
+                                             MTLLIB_CTX **ctx, uint32_t threads);
+
+/**
+ * MTL Library set the number of worker threads for a key
+ * @param ctx     MTL context to update
+ * @param threads threads used to hash message batches
+ *                (0 for one per online CPU, 1 to hash sequentially)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_set_threads(MTLLIB_CTX *ctx, uint32_t threads);
+
 /**
  * MTL Library Key to Buffer
  * @param ctx    MTL context to write to the buffer
@@ -224,6 +327,15 @@ MTLLIB_STATUS mtllib_key_from_buffer(uint8_t *buffer, size_t buffer_len, MTLLIB_
  */
 size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer);
 
+/**
+ * MTL Library Key to Buffer using a specific key format
+ * @param ctx     MTL context to write to the buffer
+ * @param buffer  output buffer holding the key bytes
+ * @param version key format (MTLLIB_KEY_FORMAT_V1 or MTLLIB_KEY_FORMAT_V2)
+ * @return size_t size of the key buffer
+ */
+size_t mtllib_key_to_buffer_version(MTLLIB_CTX *ctx, uint8_t **buffer, uint16_t version);
+
 /**
  * MTL Library append a message to the node set
  * @param ctx      MTL context to use
@@ -234,6 +346,58 @@ size_t mtllib_key_to_buffer(MTLLIB_CTX *ctx, uint8_t **buffer);
  */
 MTLLIB_STATUS mtllib_sign_append(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, MTL_HANDLE **mtl_node);
 
+/**
+ * MTL Library append a batch of messages to the node set
+ * The message hashes are computed on the context worker threads
+ * (see mtllib_set_threads) and the leaves are appended
+ * in array order, so mtl_nodes[i] always refers to msgs[i].
+ * @param ctx       MTL context to use
+ * @param msgs      array of input message buffers
+ * @param msg_lens  length of each input message buffer
+ * @param count     number of messages
+ * @param mtl_nodes array of count entries filled with a handle for each message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_append_many(MTLLIB_CTX *ctx, uint8_t **msgs, size_t *msg_lens,
+                                      uint32_t count, MTL_HANDLE **mtl_nodes);
+
+/**
+ * MTL Library start appending a message that is supplied in pieces
+ * The message is hashed as it arrives, so memory use does not depend
+ * on the message size. The next leaf is reserved for the message, so
+ * no other message may be appended to ctx until the stream is
+ * finished with mtllib_sign_final or freed with mtllib_sign_free_stream.
+ * @param ctx    MTL context to use
+ * @param stream message stream for the message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_init(MTLLIB_CTX *ctx, MTLLIB_SIGN_STREAM **stream);
+
+/**
+ * MTL Library add the next piece of a message being appended
+ * @param stream  message stream from mtllib_sign_init
+ * @param msg     input message buffer
+ * @param msg_len length of the input message buffer
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_update(MTLLIB_SIGN_STREAM *stream, uint8_t *msg, size_t msg_len);
+
+/**
+ * MTL Library finish appending a message that was supplied in pieces
+ * The stream is freed whether or not this succeeds.
+ * @param stream   message stream from mtllib_sign_init
+ * @param mtl_node handle for the appended message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_final(MTLLIB_SIGN_STREAM *stream, MTL_HANDLE **mtl_node);
+
+/**
+ * MTL Library free a message stream without appending the message
+ * @param stream     stream to free
+ * @return none
+ */
+void mtllib_sign_free_stream(MTLLIB_SIGN_STREAM **stream);
+
 /**
  * MTL Library free a MTL handle
  * @param handle     handle to free
@@ -253,6 +417,8 @@ MTLLIB_STATUS mtllib_sign_get_condensed_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle,
 
 /**
  * MTL Library get the signed ladder
+ * The signed ladder is cached and only signed again when the leaf count
+ * has changed and the ladder signing policy allows it.
  * @param ctx        input buffer holding the key
  * @param ladder     pointer to allocate and fill with the signed ladder bytes
  * @param ladder_len pointer to set to the signed ladder bytes length
@@ -260,13 +426,63 @@ MTLLIB_STATUS mtllib_sign_get_condensed_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle,
  */
 MTLLIB_STATUS mtllib_sign_get_signed_ladder(MTLLIB_CTX *ctx, uint8_t **ladder, size_t *ladder_len);
 
+/**
+ * MTL Library get the latest signed ladder covering a leaf without blocking
+ * This never signs a ladder, it returns the newest one already published.
+ * @param ctx        MTL context to use
+ * @param leaf_index leaf index the ladder has to cover
+ * @param ladder     pointer to allocate and fill with the signed ladder bytes
+ * @param ladder_len pointer to set to the signed ladder bytes length
+ * @return MTLLIB_STATUS MTLLIB_OK if successful, MTLLIB_NO_LADDER if no
+ *         signed ladder covering the leaf has been published yet
+ */
+MTLLIB_STATUS mtllib_sign_get_signed_ladder_covering(MTLLIB_CTX *ctx, uint32_t leaf_index,
+                                                     uint8_t **ladder, size_t *ladder_len);
+
+/**
+ * MTL Library start signing ladders on a background thread
+ * After each append the current ladder is snapshotted when the ladder
+ * signing policy allows a new signature, replacing a queued snapshot
+ * that has not been started, and a dedicated thread signs it and
+ * publishes it to the signed ladder cache. Appends and condensed
+ * signatures never wait for the ladder signature. Full signatures use
+ * the newest published ladder and return MTLLIB_NO_LADDER until one
+ * covers the handle.
+ * @param ctx MTL context to use
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_start_background(MTLLIB_CTX *ctx);
+
+/**
+ * MTL Library stop the background ladder signer
+ * A ladder that is already queued is signed before the thread exits.
+ * @param ctx MTL context to use
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_stop_background(MTLLIB_CTX *ctx);
+
+/**
+ * MTL Library set the policy that decides when a new ladder is signed
+ * Signed ladders are cached in the context. A request made when the
+ * policy does not allow a new signature returns the cached ladder,
+ * which still covers every leaf that existed when it was signed.
+ * @param ctx    MTL context to use
+ * @param policy ladder signing policy
+ * @param value  leaves for EVERY_N, milliseconds for INTERVAL, or the
+ *               power of two alignment for ALIGNED (unused for ALWAYS)
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_sign_set_ladder_policy(MTLLIB_CTX *ctx, MTLLIB_LADDER_POLICY policy,
+                                            uint32_t value);
+
 /**
  * MTL Library get the full signature for a handle
  * @param ctx     input buffer holding the key
  * @param handle  handle to the signed message
  * @param sig     pointer to fill with the signature bytes
  * @param sig_len pointer to set to the signature bytes length
- * @return MTLLIB_STATUS MTLLIB_OK if successful
+ * @return MTLLIB_STATUS MTLLIB_OK if successful, MTLLIB_NO_LADDER if the
+ *         ladder signing policy has not yet allowed a ladder covering the handle
  */
 MTLLIB_STATUS mtllib_sign_get_full_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle, uint8_t **sig, size_t *sig_len);
 
@@ -282,6 +498,44 @@ MTLLIB_STATUS mtllib_sign_get_full_sig(MTLLIB_CTX *ctx, MTL_HANDLE *handle, uint
  */
 MTLLIB_STATUS mtllib_verify(MTLLIB_CTX *ctx, uint8_t *msg, size_t msg_len, uint8_t *sig, size_t sig_len, uint8_t *ladder_buf, size_t ladder_buf_len, size_t* condensed_len);
 
+/**
+ * MTL Library start verifying a signature over a message that is
+ * supplied in pieces
+ * @param ctx     MTL context to use
+ * @param sig     pointer to the signature bytes (copied)
+ * @param sig_len length of the signature in bytes
+ * @param stream  message stream for the message
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_verify_init(MTLLIB_CTX *ctx, uint8_t *sig, size_t sig_len, MTLLIB_VERIFY_STREAM **stream);
+
+/**
+ * MTL Library add the next piece of a message being verified
+ * @param stream  message stream from mtllib_verify_init
+ * @param msg     input message buffer
+ * @param msg_len length of the input message buffer
+ * @return MTLLIB_STATUS MTLLIB_OK if successful
+ */
+MTLLIB_STATUS mtllib_verify_update(MTLLIB_VERIFY_STREAM *stream, uint8_t *msg, size_t msg_len);
+
+/**
+ * MTL Library finish verifying a signature over a message that was
+ * supplied in pieces. The stream is freed whether or not this succeeds.
+ * @param stream     message stream from mtllib_verify_init
+ * @param ladder_buf optional pointer to pre-verified ladder (for condensed signatures)
+ * @param ladder_buf_len length of the optional pre-verified ladder in bytes
+ * @param condensed_len optional pointer that will be filled in to the condensed length
+ * @return MTLLIB_STATUS MTLLIB_OK if the signature is valid
+ */
+MTLLIB_STATUS mtllib_verify_final(MTLLIB_VERIFY_STREAM *stream, uint8_t *ladder_buf, size_t ladder_buf_len, size_t *condensed_len);
+
+/**
+ * MTL Library free a message stream without finishing the verification
+ * @param stream     stream to free
+ * @return none
+ */
+void mtllib_verify_free_stream(MTLLIB_VERIFY_STREAM **stream);
+
 /**
  * MTL Library verify a signed ladder
  * @param ctx        input buffer holding the key
@@ -188,6 +188,7 @@ MTLLIB_STATUS mtllib_util_setup_sig_scheme(MTL_CRYPTO_LIBRARY lib,
                                            SERIESID *sid)
 {
     SPX_PARAMS *param_ptr = NULL;
+    const SPX_NODE_FUNCS *node_funcs = NULL;
     SEED *setup_seed = NULL;
     SERIESID *setup_sid = NULL;
     MTLLIB_STATUS setup_status = MTLLIB_OK;
@@ -266,24 +267,89 @@ MTLLIB_STATUS mtllib_util_setup_sig_scheme(MTL_CRYPTO_LIBRARY lib,
                 mtllib_ctx->algo_params->sec_param);
     SKPRF_INIT(param_ptr->prf, mtllib_ctx->secret_key + mtllib_ctx->algo_params->sec_param,
                mtllib_ctx->algo_params->sec_param);
+    // The series ID is fixed from here, so build its ADRS structures once
+    if (spx_params_init_adrs(param_ptr, &mtllib_ctx->mtl->sid) != MTL_OK)
+    {
+        free(param_ptr);
+        return MTLLIB_BAD_VALUE;
+    }
 
     // Select the hashing algorithm
     switch (mtllib_ctx->algo_params->hash_algo)
     {
     case HASH_SHAKE:
+        // Absorb PK.seed once for every leaf and node hash
+        if (spx_params_init_shake(param_ptr) != MTL_OK)
+        {
+            return MTLLIB_BAD_VALUE;
+        }
+        // Prefer the leaf and node kernels built for this parameter set
+        node_funcs = spx_params_init_node_funcs(param_ptr, SPX_MTL_SHAKE,
+                                                mtllib_ctx->algo_params->sec_param);
         if (mtl_set_scheme_functions(mtllib_ctx->mtl, param_ptr, mtllib_ctx->algo_params->randomize,
                                      spx_mtl_node_set_hash_message_shake,
-                                     spx_mtl_node_set_hash_leaf_shake,
-                                     spx_mtl_node_set_hash_int_shake, mtl_ctx_str) != MTL_OK)
+                                     (node_funcs != NULL) ? node_funcs->hash_leaf : spx_mtl_node_set_hash_leaf_shake,
+                                     (node_funcs != NULL) ? node_funcs->hash_node : spx_mtl_node_set_hash_int_shake,
+                                     mtl_ctx_str) != MTL_OK)
+        {
+            return MTLLIB_NULL_PARAMS;
+        }
+        // Serialize the message separator once for the stored context string
+        if (spx_params_init_msg_sep(param_ptr, mtllib_ctx->mtl->ctx_str) != MTL_OK)
+        {
+            return MTLLIB_BAD_VALUE;
+        }
+        if (mtl_set_scheme_batch_functions(mtllib_ctx->mtl,
+                                           (node_funcs != NULL) ? node_funcs->hash_leaf_batch
+                                                                : spx_mtl_node_set_hash_leaf_shake_batch,
+                                           (node_funcs != NULL) ? node_funcs->hash_node_batch
+                                                                : spx_mtl_node_set_hash_int_shake_batch) != MTL_OK)
+        {
+            return MTLLIB_NULL_PARAMS;
+        }
+        if (mtl_set_scheme_stream_functions(mtllib_ctx->mtl,
+                                            spx_mtl_node_set_hash_message_init_shake,
+                                            spx_mtl_node_set_hash_message_update,
+                                            spx_mtl_node_set_hash_message_final) != MTL_OK)
         {
             return MTLLIB_NULL_PARAMS;
         }
         break;
     case HASH_SHA2:
+        // Absorb BlockPad(PK.seed) once for every leaf and node hash, and
+        // the SK.prf HMAC pads once for every message
+        if (spx_params_init_sha2(param_ptr, mtllib_ctx->algo_params->sec_param) != MTL_OK)
+        {
+            return MTLLIB_BAD_VALUE;
+        }
+        // Prefer the leaf and node kernels built for this parameter set
+        node_funcs = spx_params_init_node_funcs(param_ptr, SPX_MTL_SHA2,
+                                                mtllib_ctx->algo_params->sec_param);
         if (mtl_set_scheme_functions(mtllib_ctx->mtl, param_ptr, mtllib_ctx->algo_params->randomize,
                                      spx_mtl_node_set_hash_message_sha2,
-                                     spx_mtl_node_set_hash_leaf_sha2,
-                                     spx_mtl_node_set_hash_int_sha2, mtl_ctx_str) != MTL_OK)
+                                     (node_funcs != NULL) ? node_funcs->hash_leaf : spx_mtl_node_set_hash_leaf_sha2,
+                                     (node_funcs != NULL) ? node_funcs->hash_node : spx_mtl_node_set_hash_int_sha2,
+                                     mtl_ctx_str) != MTL_OK)
+        {
+            return MTLLIB_NULL_PARAMS;
+        }
+        // Serialize the message separator once for the stored context string
+        if (spx_params_init_msg_sep(param_ptr, mtllib_ctx->mtl->ctx_str) != MTL_OK)
+        {
+            return MTLLIB_BAD_VALUE;
+        }
+        if (mtl_set_scheme_batch_functions(mtllib_ctx->mtl,
+                                           (node_funcs != NULL) ? node_funcs->hash_leaf_batch
+                                                                : spx_mtl_node_set_hash_leaf_sha2_batch,
+                                           (node_funcs != NULL) ? node_funcs->hash_node_batch
+                                                                : spx_mtl_node_set_hash_int_sha2_batch) != MTL_OK)
+        {
+            return MTLLIB_NULL_PARAMS;
+        }
+        if (mtl_set_scheme_stream_functions(mtllib_ctx->mtl,
+                                            spx_mtl_node_set_hash_message_init_sha2,
+                                            spx_mtl_node_set_hash_message_update,
+                                            spx_mtl_node_set_hash_message_final) != MTL_OK)
         {
             return MTLLIB_NULL_PARAMS;
         }
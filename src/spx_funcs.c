@@ -32,8 +32,15 @@
 */
 // The functions in this file can be replaced by routines in the SPHINCS+ library
 
+// The native SHA2 midstates use the low level digest API, which is the only
+// OpenSSL 3 interface that allows a midstate to be copied without allocation.
+// In provider mode (spx_md_provider_only) they are not used for hashing.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
 #include <math.h>
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +49,309 @@
 #include "mtl_util.h"
 #include "spx_funcs.h"
 
+/** Digests fetched once per process by spx_md_fetch */
+static EVP_MD *spx_md_handles[SPX_MD_COUNT];
+/** Fetch names for spx_md_handles */
+static const char *spx_md_names[SPX_MD_COUNT] = {
+	"SHA2-256", "SHA2-512", "SHAKE-256"
+};
+static pthread_once_t spx_md_once = PTHREAD_ONCE_INIT;
+/** Key for the per-thread digest contexts */
+static pthread_key_t spx_md_key;
+static uint8_t spx_md_key_ready = 0;
+/** Set when the default library context has the FIPS properties */
+static uint8_t spx_md_fips = 0;
+/** Set when every digest must go through the fetched providers */
+static uint8_t spx_md_provider = 0;
+
+/**
+ * \brief Provider midstate that is reused while the block it holds repeats
+ */
+typedef struct SPX_MD_MIDSTATE {
+	/** Digest context with the block absorbed */
+	EVP_MD_CTX *ctx;
+	/** Block that was absorbed */
+	uint8_t block[SHA2_512_BLOCK_SIZE];
+	/** Length of the block (0 while the context holds nothing) */
+	uint32_t block_len;
+} SPX_MD_MIDSTATE;
+
+/**
+ * \brief Digest contexts kept by each thread
+ */
+typedef struct SPX_MD_THREAD {
+	/** Context for one-shot digests and midstate copies */
+	EVP_MD_CTX *work;
+	/** Context lent out by spx_md_msg_ctx */
+	EVP_MD_CTX *msg;
+	/** BlockPad(seed) midstate for sha2_seeded */
+	SPX_MD_MIDSTATE seed;
+	/** (K ^ ipad) midstate for HMAC-SHA2 */
+	SPX_MD_MIDSTATE inner;
+	/** (K ^ opad) midstate for HMAC-SHA2 */
+	SPX_MD_MIDSTATE outer;
+} SPX_MD_THREAD;
+
+/*****************************************************************
+* Free the digest contexts of an exiting thread
+******************************************************************
+ * @param data: SPX_MD_THREAD of the thread
+ * @return none
+ */
+static void spx_md_thread_free(void *data)
+{
+	SPX_MD_THREAD *thread = data;
+
+	if (thread == NULL) {
+		return;
+	}
+	EVP_MD_CTX_free(thread->work);
+	EVP_MD_CTX_free(thread->msg);
+	EVP_MD_CTX_free(thread->seed.ctx);
+	EVP_MD_CTX_free(thread->inner.ctx);
+	EVP_MD_CTX_free(thread->outer.ctx);
+	// The HMAC midstate blocks are derived from SK.prf
+	OPENSSL_cleanse(thread, sizeof(SPX_MD_THREAD));
+	free(thread);
+}
+
+/*****************************************************************
+* Fetch the digests and create the per-thread context key (run once)
+******************************************************************
+ * @return none
+ */
+static void spx_md_fetch(void)
+{
+	uint8_t md;
+
+	for (md = 0; md < SPX_MD_COUNT; md++) {
+		spx_md_handles[md] = EVP_MD_fetch(NULL, spx_md_names[md], NULL);
+		if (spx_md_handles[md] == NULL) {
+			LOG_ERROR("Unable to fetch digest");
+		}
+	}
+	if (pthread_key_create(&spx_md_key, spx_md_thread_free) == 0) {
+		spx_md_key_ready = 1;
+	}
+	if (EVP_default_properties_is_fips_enabled(NULL) == 1) {
+		spx_md_fips = 1;
+		spx_md_provider = 1;
+	}
+}
+
+/*****************************************************************
+* Get a digest fetched for the process
+******************************************************************
+ * @param md: Digest to get (SPX_MD_SHA256, SPX_MD_SHA512 or SPX_MD_SHAKE256)
+ * @return digest, or NULL if it could not be fetched
+ */
+const EVP_MD *spx_md(uint8_t md)
+{
+	if ((md >= SPX_MD_COUNT) ||
+	    (pthread_once(&spx_md_once, spx_md_fetch) != 0)) {
+		return NULL;
+	}
+	return spx_md_handles[md];
+}
+
+/*****************************************************************
+* Check if the digests must go through the fetched providers
+******************************************************************
+ * @return 1 in provider mode, 0 when the native code may be used
+ */
+uint8_t spx_md_provider_only(void)
+{
+	if (pthread_once(&spx_md_once, spx_md_fetch) != 0) {
+		return 1;
+	}
+	return spx_md_provider;
+}
+
+/*****************************************************************
+* Select whether the digests must go through the fetched providers
+******************************************************************
+ * @param enable: 1 for provider mode, 0 to allow the native code
+ * @return none
+ */
+void spx_md_set_provider_only(uint8_t enable)
+{
+	if (pthread_once(&spx_md_once, spx_md_fetch) != 0) {
+		return;
+	}
+	// A FIPS library context always stays in provider mode
+	spx_md_provider = (enable != 0) || spx_md_fips;
+}
+
+/*****************************************************************
+* Get the digest contexts of the calling thread
+******************************************************************
+ * @return thread contexts, or NULL if they could not be allocated
+ */
+static SPX_MD_THREAD *spx_md_thread(void)
+{
+	SPX_MD_THREAD *thread = NULL;
+
+	if ((pthread_once(&spx_md_once, spx_md_fetch) != 0) ||
+	    (spx_md_key_ready == 0)) {
+		return NULL;
+	}
+	thread = pthread_getspecific(spx_md_key);
+	if (thread != NULL) {
+		return thread;
+	}
+
+	thread = calloc(1, sizeof(SPX_MD_THREAD));
+	if (thread == NULL) {
+		return NULL;
+	}
+	thread->work = EVP_MD_CTX_new();
+	thread->msg = EVP_MD_CTX_new();
+	thread->seed.ctx = EVP_MD_CTX_new();
+	thread->inner.ctx = EVP_MD_CTX_new();
+	thread->outer.ctx = EVP_MD_CTX_new();
+	if ((thread->work == NULL) || (thread->msg == NULL) ||
+	    (thread->seed.ctx == NULL) || (thread->inner.ctx == NULL) ||
+	    (thread->outer.ctx == NULL) ||
+	    (pthread_setspecific(spx_md_key, thread) != 0)) {
+		LOG_ERROR("Unable to allocate digest contexts");
+		spx_md_thread_free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+/*****************************************************************
+* Get the message digest context of the calling thread
+******************************************************************
+ * @return digest context, or NULL if it could not be allocated
+ */
+EVP_MD_CTX *spx_md_msg_ctx(void)
+{
+	SPX_MD_THREAD *thread = spx_md_thread();
+
+	if (thread == NULL) {
+		return NULL;
+	}
+	return thread->msg;
+}
+
+/*****************************************************************
+* One-shot digest of in1 || in2 || in3 with a fetched digest
+******************************************************************
+ * @param md:      Digest (SPX_MD_SHA256, SPX_MD_SHA512 or SPX_MD_SHAKE256)
+ * @param out:     output hash buffer
+ * @param out_len: Output length for SHAKE256 (SHA2 writes the full digest)
+ * @param in1:     First input buffer (may be empty)
+ * @param in1_len: Size of the first input buffer
+ * @param in2:     Second input buffer (NULL if unused)
+ * @param in2_len: Size of the second input buffer
+ * @param in3:     Third input buffer (NULL if unused)
+ * @param in3_len: Size of the third input buffer
+ * @return 0 if successful
+ */
+uint8_t spx_md_digest(uint8_t md, uint8_t * out, size_t out_len,
+		      const uint8_t * in1, size_t in1_len,
+		      const uint8_t * in2, size_t in2_len,
+		      const uint8_t * in3, size_t in3_len)
+{
+	SPX_MD_THREAD *thread = spx_md_thread();
+	const EVP_MD *digest = spx_md(md);
+	uint8_t status = MTL_ERROR;
+
+	if ((out == NULL) || ((in1 == NULL) && (in1_len > 0))) {
+		return MTL_NULL_PTR;
+	}
+	if ((thread == NULL) || (digest == NULL)) {
+		LOG_ERROR("Unable to allocate hash function");
+		return MTL_RESOURCE_FAIL;
+	}
+
+	if ((EVP_DigestInit_ex2(thread->work, digest, NULL) == 1) &&
+	    (EVP_DigestUpdate(thread->work, in1, in1_len) == 1) &&
+	    ((in2 == NULL) ||
+	     (EVP_DigestUpdate(thread->work, in2, in2_len) == 1)) &&
+	    ((in3 == NULL) ||
+	     (EVP_DigestUpdate(thread->work, in3, in3_len) == 1))) {
+		if (md == SPX_MD_SHAKE256) {
+			if (EVP_DigestFinalXOF(thread->work, out, out_len) == 1) {
+				status = MTL_OK;
+			}
+		} else if (EVP_DigestFinal_ex(thread->work, out, NULL) == 1) {
+			status = MTL_OK;
+		}
+	}
+	if (status != MTL_OK) {
+		LOG_ERROR("Unable to compute digest");
+		EVP_MD_CTX_reset(thread->work);
+	}
+	return status;
+}
+
+/*****************************************************************
+* Get a provider midstate holding a block, absorbing it if needed
+******************************************************************
+ * @param mid:       Midstate of the calling thread
+ * @param block:     Block the midstate must hold
+ * @param block_len: Block length (SHA2_256_BLOCK_SIZE selects SHA-256)
+ * @return digest context holding the block, or NULL on failure
+ */
+static EVP_MD_CTX *spx_md_midstate(SPX_MD_MIDSTATE * mid,
+				   const uint8_t * block, uint32_t block_len)
+{
+	uint8_t md = SPX_MD_SHA512;
+
+	if ((mid->block_len == block_len) &&
+	    (memcmp(mid->block, block, block_len) == 0)) {
+		return mid->ctx;
+	}
+
+	if (block_len == SHA2_256_BLOCK_SIZE) {
+		md = SPX_MD_SHA256;
+	}
+	mid->block_len = 0;
+	if ((spx_md(md) == NULL) ||
+	    (EVP_DigestInit_ex2(mid->ctx, spx_md(md), NULL) != 1) ||
+	    (EVP_DigestUpdate(mid->ctx, block, block_len) != 1)) {
+		EVP_MD_CTX_reset(mid->ctx);
+		return NULL;
+	}
+	memcpy(mid->block, block, block_len);
+	mid->block_len = block_len;
+	return mid->ctx;
+}
+
+/*****************************************************************
+* Finish a SHA2 digest of a midstate || in1 || in2 with the work context
+******************************************************************
+ * @param out:     output hash buffer (full digest length)
+ * @param thread:  Digest contexts of the calling thread
+ * @param mid:     Midstate to continue from (not modified)
+ * @param in1:     First input buffer
+ * @param in1_len: Size of the first input buffer
+ * @param in2:     Second input buffer
+ * @param in2_len: Size of the second input buffer
+ * @return length of the digest written, 0 on failure
+ */
+static uint32_t spx_md_midstate_finish(uint8_t * out, SPX_MD_THREAD * thread,
+				       const EVP_MD_CTX * mid,
+				       const uint8_t * in1, size_t in1_len,
+				       const uint8_t * in2, size_t in2_len)
+{
+	unsigned int digest_len = 0;
+
+	// Copying keeps the provider in charge of its own midstate layout
+	if ((mid == NULL) ||
+	    (EVP_MD_CTX_copy_ex(thread->work, mid) != 1) ||
+	    (EVP_DigestUpdate(thread->work, in1, in1_len) != 1) ||
+	    (EVP_DigestUpdate(thread->work, in2, in2_len) != 1) ||
+	    (EVP_DigestFinal_ex(thread->work, out, &digest_len) != 1)) {
+		LOG_ERROR("Unable to compute digest");
+		EVP_MD_CTX_reset(thread->work);
+		return 0;
+	}
+	return digest_len;
+}
+
 /*****************************************************************
 * Block Pad data
 ****************************************************************** 
@@ -141,8 +451,70 @@ void mgf1_512(unsigned char *out, unsigned long out_len,
 	}
 }
 
+/** SHA-256 initial chaining value */
+static const uint32_t sha256_iv[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/*****************************************************************
+* Finish a SHA-256 hash with sha256_compress from a chaining value
+******************************************************************
+ * @param out:         output hash buffer (32 bytes)
+ * @param chain:       Chaining value after the already hashed prefix
+ * @param prefix_bits: Length of the already hashed prefix in bits
+ * @param in1:         First input buffer
+ * @param in1_len:     Size of the first input buffer
+ * @param in2:         Second input buffer
+ * @param in2_len:     Size of the second input buffer
+ * @return 1 if hashed, 0 if the inputs do not fit in two blocks
+ */
+static uint8_t sha256_native_finish(uint8_t * out, const uint32_t * chain,
+				    uint64_t prefix_bits, const uint8_t * in1,
+				    size_t in1_len, const uint8_t * in2,
+				    size_t in2_len)
+{
+	uint8_t blocks[2 * SHA2_256_BLOCK_SIZE];
+	uint32_t state[8];
+	size_t msg_len = in1_len + in2_len;
+	size_t block_count;
+	uint64_t total_bits;
+	uint32_t index;
+
+	// Room for the 0x80 marker and the 64-bit length
+	if (msg_len + 9 > sizeof(blocks)) {
+		return 0;
+	}
+	block_count = (msg_len + 9 + SHA2_256_BLOCK_SIZE - 1) /
+	    SHA2_256_BLOCK_SIZE;
+
+	memset(blocks, 0, block_count * SHA2_256_BLOCK_SIZE);
+	if (in1_len > 0) {
+		memcpy(blocks, in1, in1_len);
+	}
+	if (in2_len > 0) {
+		memcpy(blocks + in1_len, in2, in2_len);
+	}
+	blocks[msg_len] = 0x80;
+	total_bits = prefix_bits + ((uint64_t) msg_len * 8);
+	for (index = 0; index < 8; index++) {
+		blocks[(block_count * SHA2_256_BLOCK_SIZE) - 8 + index] =
+		    (uint8_t) (total_bits >> (56 - (8 * index)));
+	}
+
+	memcpy(state, chain, sizeof(state));
+	sha256_compress(state, blocks, block_count);
+	for (index = 0; index < 8; index++) {
+		out[4 * index] = (uint8_t) (state[index] >> 24);
+		out[4 * index + 1] = (uint8_t) (state[index] >> 16);
+		out[4 * index + 2] = (uint8_t) (state[index] >> 8);
+		out[4 * index + 3] = (uint8_t) state[index];
+	}
+	return 1;
+}
+
 /*****************************************************************
-* SHA256 Hash Function - Based on OpenSSL EVP API
+* SHA256 Hash Function - Based on OpenSSL SHA API
 ******************************************************************
  * @param out:     output hash buffer
  * @param in:      Input buffer
@@ -151,39 +523,38 @@ void mgf1_512(unsigned char *out, unsigned long out_len,
  */
 void sha256(uint8_t * out, const uint8_t * in, size_t in_len)
 {
-	EVP_MD *hash_func = NULL;
-	EVP_MD_CTX *mdctx = NULL;
-	unsigned int hash_len;
+	uint32_t chain[8];
+	size_t full_blocks;
 
 	if ((out == NULL) || (in == NULL) || (in_len == 0)) {
 		return;
 	}
-	// Create the SHA256 instantiation
-	hash_func = (EVP_MD *) EVP_sha256();
-	mdctx = EVP_MD_CTX_new();
 
-	// Initalize the digest
-	if (1 != EVP_DigestInit_ex(mdctx, hash_func, NULL)) {
-		EVP_MD_CTX_free(mdctx);
-		LOG_ERROR("Unable to allocate hash function");
+	if (spx_md_provider_only()) {
+		spx_md_digest(SPX_MD_SHA256, out, SHA256_DIGEST_LENGTH, in,
+			      in_len, NULL, 0, NULL, 0);
 		return;
 	}
-	// Add the data buffer
-	if (1 != EVP_DigestUpdate(mdctx, in, in_len)) {
-		EVP_MD_CTX_free(mdctx);
-		LOG_ERROR("Unable to add message to digest");
+	// With the SHA extensions the library call costs more than the
+	// compression for the short MGF1 and tree inputs
+	if (sha256_ni_enabled()) {
+		full_blocks = in_len / SHA2_256_BLOCK_SIZE;
+		memcpy(chain, sha256_iv, sizeof(chain));
+		if (full_blocks > 0) {
+			sha256_compress(chain, in, full_blocks);
+		}
+		sha256_native_finish(out, chain,
+				     (uint64_t) full_blocks *
+				     SHA2_256_BLOCK_SIZE * 8,
+				     in + (full_blocks * SHA2_256_BLOCK_SIZE),
+				     in_len % SHA2_256_BLOCK_SIZE, NULL, 0);
 		return;
 	}
-	// Finalize the digest
-	if (1 != EVP_DigestFinal_ex(mdctx, &out[0], &hash_len)) {
-		LOG_ERROR("Unable to finalize digest");
-	}
-
-	EVP_MD_CTX_free(mdctx);
+	SHA256(in, in_len, &out[0]);
 }
 
 /*****************************************************************
-* SHA512 Hash Function - Based on OpenSSL EVP API
+* SHA512 Hash Function - Based on OpenSSL SHA API
 ******************************************************************
  * @param out:     output hash buffer
  * @param in:      Input buffer
@@ -192,75 +563,765 @@ void sha256(uint8_t * out, const uint8_t * in, size_t in_len)
  */
 void sha512(uint8_t * out, const uint8_t * in, size_t in_len)
 {
-	EVP_MD *hash_func = NULL;
-	EVP_MD_CTX *mdctx = NULL;
-	unsigned int hash_len;
-
 	if ((out == NULL) || (in == NULL) || (in_len == 0)) {
 		return;
 	}
-	// Create the SHA512 instantiation
-	hash_func = (EVP_MD *) EVP_sha512();
-	mdctx = EVP_MD_CTX_new();
+	if (spx_md_provider_only()) {
+		spx_md_digest(SPX_MD_SHA512, out, SHA512_DIGEST_LENGTH, in,
+			      in_len, NULL, 0, NULL, 0);
+		return;
+	}
+	SHA512(in, in_len, &out[0]);
+}
 
-	// Initalize the digest
-	if (1 != EVP_DigestInit_ex(mdctx, hash_func, NULL)) {
-		EVP_MD_CTX_free(mdctx);
-		LOG_ERROR("Unable to allocate hash function");
+/*****************************************************************
+* Start a multi-part SHA2 digest
+******************************************************************
+ * @param state:    SHA2 state to initialize
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return none
+ */
+void sha2_init(SHA2_STATE * state, uint32_t hash_len)
+{
+	state->hash_len = hash_len;
+	if (hash_len <= 16) {
+		SHA256_Init(&state->sha256);
+	} else {
+		SHA512_Init(&state->sha512);
+	}
+}
 
+/*****************************************************************
+* Add data to a multi-part SHA2 digest
+******************************************************************
+ * @param state:  SHA2 state
+ * @param in:     Input buffer
+ * @param in_len: Size of the input buffer
+ * @return none
+ */
+void sha2_update(SHA2_STATE * state, const uint8_t * in, size_t in_len)
+{
+	if (state->hash_len <= 16) {
+		SHA256_Update(&state->sha256, in, in_len);
+	} else {
+		SHA512_Update(&state->sha512, in, in_len);
+	}
+}
+
+/*****************************************************************
+* Finish a multi-part SHA2 digest
+******************************************************************
+ * @param out:   output hash buffer (full digest length)
+ * @param state: SHA2 state (consumed by the call)
+ * @return length of the digest written
+ */
+uint32_t sha2_final(uint8_t * out, SHA2_STATE * state)
+{
+	if (state->hash_len <= 16) {
+		SHA256_Final(out, &state->sha256);
+		return SHA256_DIGEST_LENGTH;
+	}
+	SHA512_Final(out, &state->sha512);
+	return SHA512_DIGEST_LENGTH;
+}
+
+/*****************************************************************
+* Build the HMAC-SHA2 key block from the key
+******************************************************************
+ * @param block:    Key block output (SHA2_512_BLOCK_SIZE bytes)
+ * @param key:      HMAC key
+ * @param key_len:  Length of the HMAC key
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return length of the key block
+ */
+static uint32_t hmac_sha2_key_block(uint8_t * block, const uint8_t * key,
+				    size_t key_len, uint32_t hash_len)
+{
+	uint32_t block_len = SHA2_512_BLOCK_SIZE;
+
+	if (hash_len <= 16) {
+		block_len = SHA2_256_BLOCK_SIZE;
+	}
+
+	// Keys longer than a block are hashed first (RFC 2104)
+	memset(block, 0, SHA2_512_BLOCK_SIZE);
+	if (key_len > block_len) {
+		if (hash_len <= 16) {
+			sha256(block, key, key_len);
+		} else {
+			sha512(block, key, key_len);
+		}
+	} else if (key_len > 0) {
+		memcpy(block, key, key_len);
+	}
+	return block_len;
+}
+
+/*****************************************************************
+* HMAC-SHA2 of in1 || in2 with the fetched digests (provider mode)
+******************************************************************
+ * @param out:      output hash buffer (full digest length)
+ * @param key:      HMAC key
+ * @param key_len:  Length of the HMAC key
+ * @param in1:      First input buffer
+ * @param in1_len:  Size of the first input buffer
+ * @param in2:      Second input buffer
+ * @param in2_len:  Size of the second input buffer
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return none
+ */
+static void hmac_sha2_provider(uint8_t * out, const uint8_t * key,
+			       size_t key_len, const uint8_t * in1,
+			       size_t in1_len, const uint8_t * in2,
+			       size_t in2_len, uint32_t hash_len)
+{
+	SPX_MD_THREAD *thread = spx_md_thread();
+	uint8_t block[SHA2_512_BLOCK_SIZE];
+	uint8_t inner_hash[SHA512_DIGEST_LENGTH];
+	EVP_MD_CTX *inner = NULL;
+	EVP_MD_CTX *outer = NULL;
+	uint32_t block_len;
+	uint32_t digest_len;
+	uint32_t index;
+
+	if (thread == NULL) {
+		LOG_ERROR("Unable to allocate hash function");
 		return;
 	}
-	// Add the data buffer
-	if (1 != EVP_DigestUpdate(mdctx, in, in_len)) {
-		EVP_MD_CTX_free(mdctx);
-		LOG_ERROR("Unable to add message to digest");
+
+	// The pad midstates are kept per thread while the key repeats
+	block_len = hmac_sha2_key_block(block, key, key_len, hash_len);
+	for (index = 0; index < block_len; index++) {
+		block[index] ^= 0x36;
+	}
+	inner = spx_md_midstate(&thread->inner, block, block_len);
+	for (index = 0; index < block_len; index++) {
+		block[index] ^= 0x36 ^ 0x5c;
+	}
+	outer = spx_md_midstate(&thread->outer, block, block_len);
+
+	// H((K ^ ipad) || in1 || in2), then H((K ^ opad) || inner)
+	digest_len = spx_md_midstate_finish(inner_hash, thread, inner,
+					    in1, in1_len, in2, in2_len);
+	if (digest_len > 0) {
+		spx_md_midstate_finish(out, thread, outer, inner_hash,
+				       digest_len, NULL, 0);
+	}
+}
+
+/*****************************************************************
+* Absorb the HMAC-SHA2 (K ^ ipad) and (K ^ opad) blocks
+******************************************************************
+ * @param inner:    SHA2 state to absorb (K ^ ipad) into
+ * @param outer:    SHA2 state to absorb (K ^ opad) into
+ * @param key:      HMAC key
+ * @param key_len:  Length of the HMAC key
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return none
+ */
+static void hmac_sha2_pads(SHA2_STATE * inner, SHA2_STATE * outer,
+			   const uint8_t * key, size_t key_len,
+			   uint32_t hash_len)
+{
+	uint8_t block[SHA2_512_BLOCK_SIZE];
+	uint32_t block_len;
+	uint32_t index;
+
+	block_len = hmac_sha2_key_block(block, key, key_len, hash_len);
+	for (index = 0; index < block_len; index++) {
+		block[index] ^= 0x36;
+	}
+	sha2_init(inner, hash_len);
+	sha2_update(inner, block, block_len);
+
+	for (index = 0; index < block_len; index++) {
+		block[index] ^= 0x36 ^ 0x5c;
+	}
+	sha2_init(outer, hash_len);
+	sha2_update(outer, block, block_len);
+}
+
+/*****************************************************************
+* Finish HMAC-SHA2 of in1 || in2 from the keyed pad states
+******************************************************************
+ * @param out:     output hash buffer (full digest length)
+ * @param inner:   SHA2 state with (K ^ ipad) absorbed (not modified)
+ * @param outer:   SHA2 state with (K ^ opad) absorbed (not modified)
+ * @param in1:     First input buffer
+ * @param in1_len: Size of the first input buffer
+ * @param in2:     Second input buffer
+ * @param in2_len: Size of the second input buffer
+ * @return none
+ */
+static void hmac_sha2_finish(uint8_t * out, const SHA2_STATE * inner,
+			     const SHA2_STATE * outer,
+			     const uint8_t * in1, size_t in1_len,
+			     const uint8_t * in2, size_t in2_len)
+{
+	SHA2_STATE state;
+	uint8_t inner_hash[SHA512_DIGEST_LENGTH];
+	uint32_t digest_len;
+
+	// H((K ^ ipad) || in1 || in2)
+	state = *inner;
+	sha2_update(&state, in1, in1_len);
+	sha2_update(&state, in2, in2_len);
+	digest_len = sha2_final(inner_hash, &state);
+
+	// H((K ^ opad) || inner)
+	state = *outer;
+	sha2_update(&state, inner_hash, digest_len);
+	sha2_final(out, &state);
+}
+
+/*****************************************************************
+* HMAC-SHA2 of in1 || in2 without building the concatenation
+******************************************************************
+ * @param out:      output hash buffer (full digest length)
+ * @param key:      HMAC key
+ * @param key_len:  Length of the HMAC key
+ * @param in1:      First input buffer
+ * @param in1_len:  Size of the first input buffer
+ * @param in2:      Second input buffer
+ * @param in2_len:  Size of the second input buffer
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return none
+ */
+void hmac_sha2(uint8_t * out, const uint8_t * key, size_t key_len,
+	       const uint8_t * in1, size_t in1_len,
+	       const uint8_t * in2, size_t in2_len, uint32_t hash_len)
+{
+	SHA2_STATE inner;
+	SHA2_STATE outer;
+
+	if (spx_md_provider_only()) {
+		hmac_sha2_provider(out, key, key_len, in1, in1_len, in2,
+				   in2_len, hash_len);
 		return;
 	}
-	// Finalize the digest
-	if (1 != EVP_DigestFinal_ex(mdctx, &out[0], &hash_len)) {
-		LOG_ERROR("Unable to compute digest");
+	hmac_sha2_pads(&inner, &outer, key, key_len, hash_len);
+	hmac_sha2_finish(out, &inner, &outer, in1, in1_len, in2, in2_len);
+}
+
+/*****************************************************************
+* Absorb the HMAC-SHA2 key pads into states that can be reused per MAC
+******************************************************************
+ * @param state:    HMAC-SHA2 state to initialize
+ * @param key:      HMAC key
+ * @param key_len:  Length of the HMAC key
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return 0 if successful
+ */
+uint8_t hmac_sha2_state_init(HMAC_SHA2_STATE * state, const uint8_t * key,
+			     uint32_t key_len, uint32_t hash_len)
+{
+	if ((state == NULL) || (key == NULL) || (key_len == 0) ||
+	    (key_len > SHA2_512_BLOCK_SIZE)) {
+		return MTL_BAD_PARAM;
 	}
 
-	EVP_MD_CTX_free(mdctx);
+	state->ready = 0;
+	hmac_sha2_pads(&state->inner, &state->outer, key, key_len, hash_len);
+	memcpy(state->key, key, key_len);
+	state->key_len = key_len;
+	state->ready = SPX_STATE_READY;
+
+	return MTL_OK;
 }
 
 /*****************************************************************
-* SHAKE256 Hash Function - Based on OpenSSL EVP API
+* HMAC-SHA2 of in1 || in2 from a precomputed key state
 ******************************************************************
- * @param out:     output hash buffer
- * @param in:      Input buffer
- * @param in_len:  Size of the input buffer
+ * @param out:     output hash buffer (full digest length)
+ * @param state:   HMAC-SHA2 state from hmac_sha2_state_init
+ * @param in1:     First input buffer
+ * @param in1_len: Size of the first input buffer
+ * @param in2:     Second input buffer
+ * @param in2_len: Size of the second input buffer
  * @return none
  */
-void shake256(uint8_t * out, const uint8_t * in, size_t in_len, size_t hash_len)
+void hmac_sha2_keyed(uint8_t * out, const HMAC_SHA2_STATE * state,
+		     const uint8_t * in1, size_t in1_len,
+		     const uint8_t * in2, size_t in2_len)
 {
-	EVP_MD *hash_func = NULL;
-	EVP_MD_CTX *mdctx = NULL;
+	if ((out == NULL) || (state == NULL) ||
+	    (state->ready != SPX_STATE_READY)) {
+		return;
+	}
 
-	if ((out == NULL) || (in == NULL) || (in_len == 0) || (hash_len == 0)) {
+	if (spx_md_provider_only()) {
+		hmac_sha2_provider(out, state->key, state->key_len, in1,
+				   in1_len, in2, in2_len,
+				   state->inner.hash_len);
 		return;
 	}
-	// Create the SHAKE256 instantiation
-	hash_func = (EVP_MD *) EVP_shake256();
-	mdctx = EVP_MD_CTX_new();
+	// Clone the pad midstates so the key blocks are never compressed again
+	hmac_sha2_finish(out, &state->inner, &state->outer, in1, in1_len,
+			 in2, in2_len);
+}
+
+/*****************************************************************
+* Absorb BlockPad(seed) into a SHA2 state that can be reused per hash
+******************************************************************
+ * @param state:    SHA2 seed state to initialize
+ * @param seed:     Seed value to absorb
+ * @param seed_len: Length of the seed value
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return 0 if successful
+ */
+uint8_t sha2_seed_state_init(SHA2_SEED_STATE * state, const uint8_t * seed,
+			     uint32_t seed_len, uint32_t hash_len)
+{
+	uint8_t padded_seed[SHA2_512_BLOCK_SIZE];
+	uint32_t block_len = SHA2_512_BLOCK_SIZE;
+
+	if ((state == NULL) || (seed == NULL) || (seed_len == 0) ||
+	    (seed_len > SHA2_512_BLOCK_SIZE)) {
+		return MTL_BAD_PARAM;
+	}
+
+	// BlockPad(PK.seed)
+	if (hash_len <= 16) {
+		block_len = SHA2_256_BLOCK_SIZE;
+	}
+	if (seed_len > block_len) {
+		return MTL_BAD_PARAM;
+	}
+	memset(padded_seed, 0, block_len);
+	memcpy(padded_seed, seed, seed_len);
+
+	state->ready = 0;
+	sha2_init(&state->digest, hash_len);
+	sha2_update(&state->digest, padded_seed, block_len);
+	memcpy(state->seed, seed, seed_len);
+	state->seed_len = seed_len;
+	state->ready = SPX_STATE_READY;
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* SHA2 hash of BlockPad(seed) || adrs || data (provider mode)
+******************************************************************
+ * @param out:      output hash buffer (full digest length)
+ * @param state:    SHA2 seed state from sha2_seed_state_init
+ * @param adrs:     ADRS buffer
+ * @param adrs_len: Size of the ADRS buffer
+ * @param data:     Data buffer
+ * @param data_len: Size of the data buffer
+ * @return none
+ */
+static void sha2_seeded_provider(uint8_t * out, const SHA2_SEED_STATE * state,
+				 const uint8_t * adrs, size_t adrs_len,
+				 const uint8_t * data, size_t data_len)
+{
+	SPX_MD_THREAD *thread = spx_md_thread();
+	uint8_t padded_seed[SHA2_512_BLOCK_SIZE];
+	uint32_t block_len = SHA2_512_BLOCK_SIZE;
 
-	// Initalize the digest
-	if (1 != EVP_DigestInit_ex(mdctx, hash_func, NULL)) {
-		EVP_MD_CTX_free(mdctx);
+	if (thread == NULL) {
 		LOG_ERROR("Unable to allocate hash function");
+		return;
+	}
+
+	// The provider midstate is kept per thread while the seed repeats
+	if (state->digest.hash_len <= 16) {
+		block_len = SHA2_256_BLOCK_SIZE;
+	}
+	memset(padded_seed, 0, block_len);
+	memcpy(padded_seed, state->seed, state->seed_len);
+	spx_md_midstate_finish(out, thread,
+			       spx_md_midstate(&thread->seed, padded_seed,
+					       block_len), adrs, adrs_len,
+			       data, data_len);
+}
 
+/*****************************************************************
+* SHA2 hash of BlockPad(seed) || adrs || data from a precomputed state
+******************************************************************
+ * @param out:      output hash buffer (full digest length)
+ * @param state:    SHA2 seed state from sha2_seed_state_init
+ * @param adrs:     ADRS buffer
+ * @param adrs_len: Size of the ADRS buffer
+ * @param data:     Data buffer
+ * @param data_len: Size of the data buffer
+ * @return none
+ */
+void sha2_seeded(uint8_t * out, const SHA2_SEED_STATE * state,
+		 const uint8_t * adrs, size_t adrs_len,
+		 const uint8_t * data, size_t data_len)
+{
+	SHA2_STATE digest;
+
+	if ((out == NULL) || (state == NULL) ||
+	    (state->ready != SPX_STATE_READY)) {
 		return;
 	}
-	// Add the data buffer
-	if (1 != EVP_DigestUpdate(mdctx, in, in_len)) {
-		EVP_MD_CTX_free(mdctx);
-		LOG_ERROR("Unable to add message to digest");
+
+	if (spx_md_provider_only()) {
+		sha2_seeded_provider(out, state, adrs, adrs_len, data,
+				     data_len);
 		return;
 	}
-	// Finalize the digest
-	if (1 != EVP_DigestFinalXOF(mdctx, &out[0], hash_len)) {
-		LOG_ERROR("Unable to compute digest");
+	// SHA-256 midstates end on a block boundary, so with the SHA
+	// extensions the tail can go straight to the compression function
+	if ((state->digest.hash_len <= 16) &&
+	    (state->digest.sha256.num == 0) && sha256_ni_enabled() &&
+	    sha256_native_finish(out, state->digest.sha256.h,
+				 ((uint64_t) state->digest.sha256.Nh << 32) |
+				 state->digest.sha256.Nl, adrs, adrs_len,
+				 data, data_len)) {
+		return;
+	}
+
+	// Clone the midstate so the seed block is never compressed again
+	digest = state->digest;
+	sha2_update(&digest, adrs, adrs_len);
+	sha2_update(&digest, data, data_len);
+	sha2_final(out, &digest);
+}
+
+/*****************************************************************
+* SHA2 hashes of BlockPad(seed) || adrs[i] || data[i] for a batch
+******************************************************************
+ * @param out:      output hash buffers (full digest length each)
+ * @param state:    SHA2 seed state from sha2_seed_state_init
+ * @param adrs:     ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Data buffers
+ * @param data_len: Size of each data buffer
+ * @param count:    Number of hashes in the batch
+ * @return none
+ */
+void sha2_seeded_batch(uint8_t ** out, const SHA2_SEED_STATE * state,
+		       uint8_t ** adrs, size_t adrs_len,
+		       uint8_t ** data, size_t data_len, uint32_t count)
+{
+	uint32_t lanes = 0;
+	uint32_t index = 0;
+
+	if ((out == NULL) || (state == NULL) || (adrs == NULL) ||
+	    (data == NULL) || (state->ready != SPX_STATE_READY)) {
+		return;
 	}
 
-	EVP_MD_CTX_free(mdctx);
+	// Full groups go to the multi-buffer backend, the rest run scalar
+	if (!spx_md_provider_only()) {
+		lanes = sha2_avx2_lanes(&state->digest, adrs_len + data_len);
+	}
+	if (lanes > 0) {
+		for (; index + lanes <= count; index += lanes) {
+			sha2_avx2_seeded(&out[index], &state->digest, &adrs[index],
+					 adrs_len, &data[index], data_len);
+		}
+	}
+	for (; index < count; index++) {
+		sha2_seeded(out[index], state, adrs[index], adrs_len,
+			    data[index], data_len);
+	}
+}
+
+/** Keccak-f[1600] round constants */
+static const uint64_t keccak_round_constants[24] = {
+	0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+	0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+	0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+	0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+	0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+	0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+	0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+	0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+/** Keccak-f[1600] rho rotation offsets in pi order */
+static const uint8_t keccak_rho[24] = {
+	1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14,
+	27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+
+/** Keccak-f[1600] pi lane order */
+static const uint8_t keccak_pi[24] = {
+	10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4,
+	15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+};
+
+#define KECCAK_ROTL(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+/*****************************************************************
+* Keccak-f[1600] permutation
+******************************************************************
+ * @param lanes: Keccak state lanes
+ * @return none
+ */
+static void keccak_f1600(uint64_t * lanes)
+{
+	uint64_t column[5];
+	uint64_t tmp;
+	uint32_t round;
+	uint32_t x;
+	uint32_t y;
+
+	for (round = 0; round < 24; round++) {
+		// Theta
+		for (x = 0; x < 5; x++) {
+			column[x] = lanes[x] ^ lanes[x + 5] ^ lanes[x + 10] ^
+			    lanes[x + 15] ^ lanes[x + 20];
+		}
+		for (x = 0; x < 5; x++) {
+			tmp = column[(x + 4) % 5] ^
+			    KECCAK_ROTL(column[(x + 1) % 5], 1);
+			for (y = 0; y < 25; y += 5) {
+				lanes[y + x] ^= tmp;
+			}
+		}
+		// Rho and Pi
+		tmp = lanes[1];
+		for (x = 0; x < 24; x++) {
+			column[0] = lanes[keccak_pi[x]];
+			lanes[keccak_pi[x]] = KECCAK_ROTL(tmp, keccak_rho[x]);
+			tmp = column[0];
+		}
+		// Chi
+		for (y = 0; y < 25; y += 5) {
+			for (x = 0; x < 5; x++) {
+				column[x] = lanes[y + x];
+			}
+			for (x = 0; x < 5; x++) {
+				lanes[y + x] ^= (~column[(x + 1) % 5]) &
+				    column[(x + 2) % 5];
+			}
+		}
+		// Iota
+		lanes[0] ^= keccak_round_constants[round];
+	}
+}
+
+/*****************************************************************
+* Initialize an empty SHAKE256 sponge
+******************************************************************
+ * @param state: Sponge state to initialize
+ * @return none
+ */
+void shake256_init(SHAKE256_STATE * state)
+{
+	memset(state, 0, sizeof(SHAKE256_STATE));
+}
+
+/*****************************************************************
+* Load a little endian Keccak lane
+******************************************************************
+ * @param in: Input buffer (8 bytes)
+ * @return lane value
+ */
+static uint64_t keccak_load_lane(const uint8_t * in)
+{
+	uint64_t lane = 0;
+	uint32_t index;
+
+	for (index = 8; index > 0; index--) {
+		lane = (lane << 8) | in[index - 1];
+	}
+	return lane;
+}
+
+/*****************************************************************
+* Absorb data into a SHAKE256 sponge
+******************************************************************
+ * @param state:  Sponge state
+ * @param in:     Input buffer
+ * @param in_len: Size of the input buffer
+ * @return none
+ */
+void shake256_absorb(SHAKE256_STATE * state, const uint8_t * in,
+		     size_t in_len)
+{
+	size_t index = 0;
+	uint32_t lane;
+
+	// Fill a partly absorbed block one byte at a time
+	while ((index < in_len) && (state->offset != 0)) {
+		state->lanes[state->offset / 8] ^=
+		    (uint64_t) in[index] << (8 * (state->offset % 8));
+		state->offset++;
+		index++;
+		if (state->offset == SHAKE256_RATE) {
+			keccak_f1600(state->lanes);
+			state->offset = 0;
+		}
+	}
+
+	// Whole blocks are absorbed a lane at a time, which is where
+	// long messages spend their time
+	while (in_len - index >= SHAKE256_RATE) {
+		for (lane = 0; lane < SHAKE256_RATE / 8; lane++) {
+			state->lanes[lane] ^=
+			    keccak_load_lane(&in[index + (8 * lane)]);
+		}
+		keccak_f1600(state->lanes);
+		index += SHAKE256_RATE;
+	}
+
+	// The tail never fills a block
+	for (; index < in_len; index++) {
+		state->lanes[state->offset / 8] ^=
+		    (uint64_t) in[index] << (8 * (state->offset % 8));
+		state->offset++;
+	}
+}
+
+/*****************************************************************
+* Finalize a SHAKE256 sponge and squeeze the output
+******************************************************************
+ * @param out:      output hash buffer
+ * @param state:    Sponge state (consumed by the call)
+ * @param hash_len: Number of bytes to squeeze
+ * @return none
+ */
+void shake256_squeeze(uint8_t * out, SHAKE256_STATE * state,
+		      size_t hash_len)
+{
+	size_t index;
+	uint32_t offset;
+
+	// SHAKE domain separation and pad10*1
+	state->lanes[state->offset / 8] ^=
+	    (uint64_t) 0x1f << (8 * (state->offset % 8));
+	state->lanes[(SHAKE256_RATE - 1) / 8] ^=
+	    (uint64_t) 0x80 << (8 * ((SHAKE256_RATE - 1) % 8));
+	keccak_f1600(state->lanes);
+
+	offset = 0;
+	for (index = 0; index < hash_len; index++) {
+		if (offset == SHAKE256_RATE) {
+			keccak_f1600(state->lanes);
+			offset = 0;
+		}
+		out[index] =
+		    (uint8_t) (state->lanes[offset / 8] >> (8 * (offset % 8)));
+		offset++;
+	}
+}
+
+/*****************************************************************
+* Absorb seed into a SHAKE256 state that can be reused per hash
+******************************************************************
+ * @param state:    SHAKE seed state to initialize
+ * @param seed:     Seed value to absorb
+ * @param seed_len: Length of the seed value
+ * @return 0 if successful
+ */
+uint8_t shake_seed_state_init(SHAKE_SEED_STATE * state, const uint8_t * seed,
+			      uint32_t seed_len)
+{
+	if ((state == NULL) || (seed == NULL) || (seed_len == 0) ||
+	    (seed_len > SHA2_512_BLOCK_SIZE)) {
+		return MTL_BAD_PARAM;
+	}
+
+	state->ready = 0;
+	shake256_init(&state->sponge);
+	shake256_absorb(&state->sponge, seed, seed_len);
+	memcpy(state->seed, seed, seed_len);
+	state->seed_len = seed_len;
+	state->ready = SPX_STATE_READY;
+
+	return MTL_OK;
+}
+
+/*****************************************************************
+* SHAKE256 hash of seed || adrs || data from a precomputed state
+******************************************************************
+ * @param out:      output hash buffer
+ * @param state:    SHAKE seed state from shake_seed_state_init
+ * @param adrs:     ADRS buffer
+ * @param adrs_len: Size of the ADRS buffer
+ * @param data:     Data buffer
+ * @param data_len: Size of the data buffer
+ * @param hash_len: Number of bytes to squeeze
+ * @return none
+ */
+void shake_seeded(uint8_t * out, const SHAKE_SEED_STATE * state,
+		  const uint8_t * adrs, size_t adrs_len,
+		  const uint8_t * data, size_t data_len, size_t hash_len)
+{
+	SHAKE256_STATE sponge;
+
+	if ((out == NULL) || (state == NULL) ||
+	    (state->ready != SPX_STATE_READY)) {
+		return;
+	}
+
+	// The seed is shorter than the SHAKE256 rate, so no block of it is
+	// permuted ahead of time and a provider midstate would save nothing
+	if (spx_md_provider_only()) {
+		spx_md_digest(SPX_MD_SHAKE256, out, hash_len, state->seed,
+			      state->seed_len, adrs, adrs_len, data, data_len);
+		return;
+	}
+	// Copy the sponge so the seed is never absorbed again
+	sponge = state->sponge;
+	shake256_absorb(&sponge, adrs, adrs_len);
+	shake256_absorb(&sponge, data, data_len);
+	shake256_squeeze(out, &sponge, hash_len);
+}
+
+/*****************************************************************
+* SHAKE256 hashes of seed || adrs[i] || data[i] for a batch
+******************************************************************
+ * @param out:      output hash buffers (hash_len bytes each)
+ * @param state:    SHAKE seed state from shake_seed_state_init
+ * @param adrs:     ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Data buffers
+ * @param data_len: Size of each data buffer
+ * @param hash_len: Number of bytes to squeeze
+ * @param count:    Number of hashes in the batch
+ * @return none
+ */
+void shake_seeded_batch(uint8_t ** out, const SHAKE_SEED_STATE * state,
+			uint8_t ** adrs, size_t adrs_len,
+			uint8_t ** data, size_t data_len, size_t hash_len,
+			uint32_t count)
+{
+	uint32_t lanes = 0;
+	uint32_t index = 0;
+
+	if ((out == NULL) || (state == NULL) || (adrs == NULL) ||
+	    (data == NULL) || (state->ready != SPX_STATE_READY)) {
+		return;
+	}
+
+	// Full groups go to the 4-way backend, the rest run scalar
+	if (!spx_md_provider_only()) {
+		lanes = shake256x4_lanes(&state->sponge, adrs_len + data_len,
+					 hash_len);
+	}
+	if (lanes > 0) {
+		for (; index + lanes <= count; index += lanes) {
+			shake256x4(&out[index], &state->sponge, &adrs[index],
+				   adrs_len, &data[index], data_len, hash_len);
+		}
+	}
+	for (; index < count; index++) {
+		shake_seeded(out[index], state, adrs[index], adrs_len,
+			     data[index], data_len, hash_len);
+	}
+}
+
+/*****************************************************************
+* SHAKE256 Hash Function - Based on OpenSSL EVP API
+******************************************************************
+ * @param out:     output hash buffer
+ * @param in:      Input buffer
+ * @param in_len:  Size of the input buffer
+ * @param hash_len: Number of bytes to squeeze
+ * @return none
+ */
+void shake256(uint8_t * out, const uint8_t * in, size_t in_len, size_t hash_len)
+{
+	if ((out == NULL) || (in == NULL) || (in_len == 0) || (hash_len == 0)) {
+		return;
+	}
+	spx_md_digest(SPX_MD_SHAKE256, out, hash_len, in, in_len, NULL, 0,
+		      NULL, 0);
 }
@@ -40,16 +40,71 @@
 #ifndef __SPX_FUNCS_H__
 #define __SPX_FUNCS_H__
 
+#include <openssl/evp.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "spx_state.h"
 
 // Definitions
-/** Byte size of a SHA2_256 hash */ 
-#define SHA2_256_BLOCK_SIZE 64
-/** Byte size of a SHA2_512 hash */ 
-#define SHA2_512_BLOCK_SIZE 128
+/** Digests fetched by spx_md */
+#define SPX_MD_SHA256   0
+#define SPX_MD_SHA512   1
+#define SPX_MD_SHAKE256 2
+#define SPX_MD_COUNT    3
 
 // Function Prototypes
+/**
+ * Get a digest fetched for the process (fetched on the first call)
+ * @param md: Digest to get (SPX_MD_SHA256, SPX_MD_SHA512 or SPX_MD_SHAKE256)
+ * @return digest, or NULL if it could not be fetched
+ */
+const EVP_MD *spx_md(uint8_t md);
+
+/**
+ * Check if the digests must go through the fetched providers.  This is
+ * set when the default library context has the FIPS properties enabled
+ * or by spx_md_set_provider_only.  In provider mode the SHA-NI, AVX2 and
+ * native Keccak paths and the low level SHA2 midstates are not used.
+ * @return 1 in provider mode, 0 when the native code may be used
+ */
+uint8_t spx_md_provider_only(void);
+
+/**
+ * Select whether the digests must go through the fetched providers.
+ * Call it while no other thread is hashing.  A FIPS library context
+ * stays in provider mode.
+ * @param enable: 1 for provider mode, 0 to allow the native code
+ * @return none
+ */
+void spx_md_set_provider_only(uint8_t enable);
+
+/**
+ * Get the message digest context of the calling thread.  None of the
+ * functions here use it, so a caller can keep a digest running in it
+ * across calls into them.  It is freed when the thread exits.
+ * @return digest context, or NULL if it could not be allocated
+ */
+EVP_MD_CTX *spx_md_msg_ctx(void);
+
+/**
+ * One-shot digest of in1 || in2 || in3 with a fetched digest and the
+ * work context of the calling thread
+ * @param md:      Digest (SPX_MD_SHA256, SPX_MD_SHA512 or SPX_MD_SHAKE256)
+ * @param out:     output hash buffer
+ * @param out_len: Output length for SHAKE256 (SHA2 writes the full digest)
+ * @param in1:     First input buffer (may be empty)
+ * @param in1_len: Size of the first input buffer
+ * @param in2:     Second input buffer (NULL if unused)
+ * @param in2_len: Size of the second input buffer
+ * @param in3:     Third input buffer (NULL if unused)
+ * @param in3_len: Size of the third input buffer
+ * @return 0 if successful
+ */
+uint8_t spx_md_digest(uint8_t md, uint8_t * out, size_t out_len,
+		      const uint8_t * in1, size_t in1_len,
+		      const uint8_t * in2, size_t in2_len,
+		      const uint8_t * in3, size_t in3_len);
+
 /**
  * Block Pad data
  * @param data:      Byte array of data to pad
@@ -84,7 +139,7 @@ void mgf1_512(unsigned char *out, unsigned long outlen,
 	      const unsigned char *in, unsigned long inlen);
 
 /**
- * SHA256 Hash Function - Based on OpenSSL EVP API
+ * SHA256 Hash Function - Based on OpenSSL SHA API
  * @param out:     output hash buffer
  * @param in:      Input buffer
  * @param in_len:  Size of the input buffer
@@ -93,7 +148,7 @@ void mgf1_512(unsigned char *out, unsigned long outlen,
 void sha256(uint8_t * out, const uint8_t * in, size_t inlen);
 
 /**
- * SHA512 Hash Function - Based on OpenSSL EVP API
+ * SHA512 Hash Function - Based on OpenSSL SHA API
  * @param out:     output hash buffer
  * @param in:      Input buffer
  * @param in_len:  Size of the input buffer
@@ -102,7 +157,255 @@ void sha256(uint8_t * out, const uint8_t * in, size_t inlen);
 void sha512(uint8_t * out, const uint8_t * in, size_t inlen);
 
 /**
- * SHAKE256 Hash Function - Based on OpenSSL EVP API
+ * Start a multi-part SHA2 digest
+ * @param state:    SHA2 state to initialize
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return none
+ */
+void sha2_init(SHA2_STATE * state, uint32_t hash_len);
+
+/**
+ * Add data to a multi-part SHA2 digest
+ * @param state:  SHA2 state
+ * @param in:     Input buffer
+ * @param in_len: Size of the input buffer
+ * @return none
+ */
+void sha2_update(SHA2_STATE * state, const uint8_t * in, size_t in_len);
+
+/**
+ * Finish a multi-part SHA2 digest
+ * @param out:   output hash buffer (full digest length)
+ * @param state: SHA2 state (consumed by the call)
+ * @return length of the digest written
+ */
+uint32_t sha2_final(uint8_t * out, SHA2_STATE * state);
+
+/**
+ * HMAC-SHA2 of in1 || in2 without building the concatenation
+ * @param out:      output hash buffer (full digest length)
+ * @param key:      HMAC key
+ * @param key_len:  Length of the HMAC key
+ * @param in1:      First input buffer
+ * @param in1_len:  Size of the first input buffer
+ * @param in2:      Second input buffer
+ * @param in2_len:  Size of the second input buffer
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return none
+ */
+void hmac_sha2(uint8_t * out, const uint8_t * key, size_t key_len,
+	       const uint8_t * in1, size_t in1_len,
+	       const uint8_t * in2, size_t in2_len, uint32_t hash_len);
+
+/**
+ * Absorb the HMAC-SHA2 key pads into states that can be reused per MAC
+ * @param state:    HMAC-SHA2 state to initialize
+ * @param key:      HMAC key
+ * @param key_len:  Length of the HMAC key
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return 0 if successful
+ */
+uint8_t hmac_sha2_state_init(HMAC_SHA2_STATE * state, const uint8_t * key,
+			     uint32_t key_len, uint32_t hash_len);
+
+/**
+ * HMAC-SHA2 of in1 || in2 from a precomputed key state
+ * @param out:     output hash buffer (full digest length)
+ * @param state:   HMAC-SHA2 state from hmac_sha2_state_init
+ * @param in1:     First input buffer
+ * @param in1_len: Size of the first input buffer
+ * @param in2:     Second input buffer
+ * @param in2_len: Size of the second input buffer
+ * @return none
+ */
+void hmac_sha2_keyed(uint8_t * out, const HMAC_SHA2_STATE * state,
+		     const uint8_t * in1, size_t in1_len,
+		     const uint8_t * in2, size_t in2_len);
+
+/**
+ * Absorb BlockPad(seed) into a SHA2 state that can be reused per hash
+ * @param state:    SHA2 seed state to initialize
+ * @param seed:     Seed value to absorb
+ * @param seed_len: Length of the seed value
+ * @param hash_len: Hash length (16 bytes or less uses SHA-256)
+ * @return 0 if successful
+ */
+uint8_t sha2_seed_state_init(SHA2_SEED_STATE * state, const uint8_t * seed,
+			     uint32_t seed_len, uint32_t hash_len);
+
+/**
+ * SHA2 hash of BlockPad(seed) || adrs || data from a precomputed state
+ * @param out:      output hash buffer (full digest length)
+ * @param state:    SHA2 seed state from sha2_seed_state_init
+ * @param adrs:     ADRS buffer
+ * @param adrs_len: Size of the ADRS buffer
+ * @param data:     Data buffer
+ * @param data_len: Size of the data buffer
+ * @return none
+ */
+void sha2_seeded(uint8_t * out, const SHA2_SEED_STATE * state,
+		 const uint8_t * adrs, size_t adrs_len,
+		 const uint8_t * data, size_t data_len);
+
+/**
+ * SHA2 hashes of BlockPad(seed) || adrs[i] || data[i] for a batch
+ * Uses the multi-buffer backend when the CPU supports it.
+ * @param out:      output hash buffers (full digest length each)
+ * @param state:    SHA2 seed state from sha2_seed_state_init
+ * @param adrs:     ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Data buffers
+ * @param data_len: Size of each data buffer
+ * @param count:    Number of hashes in the batch
+ * @return none
+ */
+void sha2_seeded_batch(uint8_t ** out, const SHA2_SEED_STATE * state,
+		       uint8_t ** adrs, size_t adrs_len,
+		       uint8_t ** data, size_t data_len, uint32_t count);
+
+/**
+ * Number of lanes the AVX2 backend hashes for this midstate and input
+ * (implemented in spx_sha2_avx2.c)
+ * @param digest:  SHA2 midstate shared by all lanes
+ * @param msg_len: Length of the ADRS || data tail of each lane
+ * @return 8 or 4 lanes, or 0 when the scalar path must be used
+ */
+uint32_t sha2_avx2_lanes(const SHA2_STATE * digest, size_t msg_len);
+
+/**
+ * Hash one group of lanes with the AVX2 backend
+ * (implemented in spx_sha2_avx2.c)
+ * @param out:      Output buffers (full digest length)
+ * @param digest:   SHA2 midstate shared by all lanes
+ * @param adrs:     ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Data buffers
+ * @param data_len: Size of each data buffer
+ * @return none
+ */
+void sha2_avx2_seeded(uint8_t ** out, const SHA2_STATE * digest,
+		      uint8_t ** adrs, size_t adrs_len,
+		      uint8_t ** data, size_t data_len);
+
+/**
+ * Check if SHA-256 compression uses the x86 SHA extensions, which needs
+ * a build with SPX_SHA256_NI (./configure --enable-sha-ni) and a CPU
+ * that reports them (implemented in spx_sha256_ni.c)
+ * @return 1 if the SHA extensions are used, 0 otherwise
+ */
+uint8_t sha256_ni_enabled(void);
+
+/**
+ * SHA-256 compression of whole blocks into a chaining value, with the
+ * SHA extensions when sha256_ni_enabled() and portable rounds otherwise
+ * (implemented in spx_sha256_ni.c)
+ * @param state:       Chaining value (a..h)
+ * @param blocks:      Message blocks
+ * @param block_count: Number of 64 byte blocks
+ * @return none
+ */
+void sha256_compress(uint32_t state[8], const uint8_t * blocks,
+		     size_t block_count);
+
+/**
+ * Initialize an empty SHAKE256 sponge
+ * @param state: Sponge state to initialize
+ * @return none
+ */
+void shake256_init(SHAKE256_STATE * state);
+
+/**
+ * Absorb data into a SHAKE256 sponge
+ * @param state:  Sponge state
+ * @param in:     Input buffer
+ * @param in_len: Size of the input buffer
+ * @return none
+ */
+void shake256_absorb(SHAKE256_STATE * state, const uint8_t * in,
+		     size_t in_len);
+
+/**
+ * Finalize a SHAKE256 sponge and squeeze the output
+ * @param out:      output hash buffer
+ * @param state:    Sponge state (consumed by the call)
+ * @param hash_len: Number of bytes to squeeze
+ * @return none
+ */
+void shake256_squeeze(uint8_t * out, SHAKE256_STATE * state,
+		      size_t hash_len);
+
+/**
+ * Absorb seed into a SHAKE256 state that can be reused per hash
+ * @param state:    SHAKE seed state to initialize
+ * @param seed:     Seed value to absorb
+ * @param seed_len: Length of the seed value
+ * @return 0 if successful
+ */
+uint8_t shake_seed_state_init(SHAKE_SEED_STATE * state, const uint8_t * seed,
+			      uint32_t seed_len);
+
+/**
+ * SHAKE256 hash of seed || adrs || data from a precomputed state
+ * @param out:      output hash buffer
+ * @param state:    SHAKE seed state from shake_seed_state_init
+ * @param adrs:     ADRS buffer
+ * @param adrs_len: Size of the ADRS buffer
+ * @param data:     Data buffer
+ * @param data_len: Size of the data buffer
+ * @param hash_len: Number of bytes to squeeze
+ * @return none
+ */
+void shake_seeded(uint8_t * out, const SHAKE_SEED_STATE * state,
+		  const uint8_t * adrs, size_t adrs_len,
+		  const uint8_t * data, size_t data_len, size_t hash_len);
+
+/**
+ * SHAKE256 hashes of seed || adrs[i] || data[i] for a batch
+ * Uses the 4-way backend when the CPU supports it.
+ * @param out:      output hash buffers (hash_len bytes each)
+ * @param state:    SHAKE seed state from shake_seed_state_init
+ * @param adrs:     ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Data buffers
+ * @param data_len: Size of each data buffer
+ * @param hash_len: Number of bytes to squeeze
+ * @param count:    Number of hashes in the batch
+ * @return none
+ */
+void shake_seeded_batch(uint8_t ** out, const SHAKE_SEED_STATE * state,
+			uint8_t ** adrs, size_t adrs_len,
+			uint8_t ** data, size_t data_len, size_t hash_len,
+			uint32_t count);
+
+/**
+ * Number of lanes the AVX2 SHAKE256 backend hashes for an input
+ * (implemented in spx_shake_avx2.c)
+ * @param sponge:   SHAKE256 sponge shared by all lanes
+ * @param msg_len:  Length of the ADRS || data tail of each lane
+ * @param hash_len: Number of bytes to squeeze per lane
+ * @return 4 lanes, or 0 when the scalar path must be used
+ */
+uint32_t shake256x4_lanes(const SHAKE256_STATE * sponge, size_t msg_len,
+			  size_t hash_len);
+
+/**
+ * SHAKE256 over four lanes continuing from a shared sponge
+ * (implemented in spx_shake_avx2.c)
+ * @param out:      Four output buffers (hash_len bytes each)
+ * @param sponge:   SHAKE256 sponge shared by all lanes
+ * @param adrs:     Four ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Four data buffers
+ * @param data_len: Size of each data buffer
+ * @param hash_len: Number of bytes to squeeze per lane
+ * @return none
+ */
+void shake256x4(uint8_t ** out, const SHAKE256_STATE * sponge,
+		uint8_t ** adrs, size_t adrs_len,
+		uint8_t ** data, size_t data_len, size_t hash_len);
+
+/**
+ * SHAKE256 Hash Function
  * @param out:     output hash buffer
  * @param in:      Input buffer
  * @param in_len:  Size of the input buffer
@@ -0,0 +1,239 @@
+/*
+	Copyright (c) 2025, VeriSign, Inc.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted (subject to the limitations in the disclaimer
+	below) provided that the following conditions are met:
+
+		* Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		* Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		* Neither the name of the copyright holder nor the names of its
+		contributors may be used to endorse or promote products derived from this
+		software without specific prior written permission.
+
+	NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+	THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+	CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+	PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+	CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+	EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+	PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+	BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+	IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+*/
+// Single buffer SHA-256 block compression. With SPX_SHA256_NI defined
+// (./configure --enable-sha-ni) the x86 SHA extensions are used when
+// the CPU reports them, everything else runs the portable rounds.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "spx_funcs.h"
+
+/** SHA-256 round constants */
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+	0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+	0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*****************************************************************
+* SHA-256 compression with the portable rounds
+******************************************************************
+ * @param state:       Chaining value (a..h)
+ * @param blocks:      Message blocks
+ * @param block_count: Number of 64 byte blocks
+ * @return none
+ */
+static void sha256_compress_scalar(uint32_t state[8], const uint8_t * blocks,
+				   size_t block_count)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2;
+	uint32_t round;
+
+	for (; block_count > 0; block_count--, blocks += SHA2_256_BLOCK_SIZE) {
+		for (round = 0; round < 16; round++) {
+			w[round] = ((uint32_t) blocks[4 * round] << 24) |
+			    ((uint32_t) blocks[4 * round + 1] << 16) |
+			    ((uint32_t) blocks[4 * round + 2] << 8) |
+			    (uint32_t) blocks[4 * round + 3];
+		}
+		for (round = 16; round < 64; round++) {
+			w[round] = w[round - 16] + w[round - 7] +
+			    (ROTR32(w[round - 15], 7) ^ ROTR32(w[round - 15], 18) ^
+			     (w[round - 15] >> 3)) +
+			    (ROTR32(w[round - 2], 17) ^ ROTR32(w[round - 2], 19) ^
+			     (w[round - 2] >> 10));
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+		for (round = 0; round < 64; round++) {
+			t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+			    ((e & f) ^ (~e & g)) + sha256_k[round] + w[round];
+			t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+			    ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e;
+			e = d + t1;
+			d = c; c = b; b = a;
+			a = t1 + t2;
+		}
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+#if defined(SPX_SHA256_NI) && defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+/*****************************************************************
+* SHA-256 compression with the x86 SHA extensions
+******************************************************************
+ * @param state:       Chaining value (a..h)
+ * @param blocks:      Message blocks
+ * @param block_count: Number of 64 byte blocks
+ * @return none
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_compress_ni(uint32_t state[8], const uint8_t * blocks,
+			       size_t block_count)
+{
+	const __m128i byte_swap =
+	    _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i state0, state1, abef_save, cdgh_save, msg, tmp;
+	__m128i w[4];
+	uint32_t quad;
+
+	// The instructions work on ABEF / CDGH halves of the state
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]),
+				0xB1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]),
+				   0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	for (; block_count > 0; block_count--, blocks += SHA2_256_BLOCK_SIZE) {
+		abef_save = state0;
+		cdgh_save = state1;
+
+		// Each quad runs four rounds while the schedule keeps the
+		// next four words of W in a rolling window of four registers
+		for (quad = 0; quad < 16; quad++) {
+			if (quad < 4) {
+				w[quad] = _mm_shuffle_epi8(
+					_mm_loadu_si128((const __m128i *)
+							(blocks + (16 * quad))),
+					byte_swap);
+			}
+			msg = _mm_add_epi32(w[quad & 3],
+					    _mm_loadu_si128((const __m128i *)
+							    &sha256_k[4 * quad]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			if ((quad >= 3) && (quad <= 14)) {
+				tmp = _mm_alignr_epi8(w[quad & 3],
+						      w[(quad + 3) & 3], 4);
+				w[(quad + 1) & 3] =
+				    _mm_add_epi32(w[(quad + 1) & 3], tmp);
+				w[(quad + 1) & 3] =
+				    _mm_sha256msg2_epu32(w[(quad + 1) & 3],
+							 w[quad & 3]);
+			}
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			if ((quad >= 1) && (quad <= 12)) {
+				w[(quad + 3) & 3] =
+				    _mm_sha256msg1_epu32(w[(quad + 3) & 3],
+							 w[quad & 3]);
+			}
+		}
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+	}
+
+	// Back to a..h order
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *) & state[0], state0);
+	_mm_storeu_si128((__m128i *) & state[4], state1);
+}
+
+/*****************************************************************
+* Check if SHA-256 compression uses the x86 SHA extensions
+******************************************************************
+ * @return 1 if the CPU has them, 0 if the portable rounds are used
+ */
+uint8_t sha256_ni_enabled(void)
+{
+	return (__builtin_cpu_supports("sha") &&
+		__builtin_cpu_supports("sse4.1") &&
+		__builtin_cpu_supports("ssse3")) ? 1 : 0;
+}
+
+/*****************************************************************
+* SHA-256 compression of whole blocks into a chaining value
+******************************************************************
+ * @param state:       Chaining value (a..h)
+ * @param blocks:      Message blocks
+ * @param block_count: Number of 64 byte blocks
+ * @return none
+ */
+void sha256_compress(uint32_t state[8], const uint8_t * blocks,
+		     size_t block_count)
+{
+	if (sha256_ni_enabled()) {
+		sha256_compress_ni(state, blocks, block_count);
+	} else {
+		sha256_compress_scalar(state, blocks, block_count);
+	}
+}
+
+#else
+
+/*****************************************************************
+* Check if SHA-256 compression uses the x86 SHA extensions
+******************************************************************
+ * @return 0, the SHA extensions backend is not built for this target
+ */
+uint8_t sha256_ni_enabled(void)
+{
+	return 0;
+}
+
+/*****************************************************************
+* SHA-256 compression of whole blocks into a chaining value
+******************************************************************
+ * @param state:       Chaining value (a..h)
+ * @param blocks:      Message blocks
+ * @param block_count: Number of 64 byte blocks
+ * @return none
+ */
+void sha256_compress(uint32_t state[8], const uint8_t * blocks,
+		     size_t block_count)
+{
+	sha256_compress_scalar(state, blocks, block_count);
+}
+
+#endif
@@ -0,0 +1,449 @@
+/*
+	Copyright (c) 2025, VeriSign, Inc.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted (subject to the limitations in the disclaimer
+	below) provided that the following conditions are met:
+
+		* Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		* Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		* Neither the name of the copyright holder nor the names of its
+		contributors may be used to endorse or promote products derived from this
+		software without specific prior written permission.
+
+	NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+	THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+	CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+	PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+	CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+	EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+	PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+	BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+	IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+*/
+// Multi-buffer SHA-256 (8 lanes) and SHA-512 (4 lanes) using AVX2.
+// Every lane continues from the same BlockPad(PK.seed) midstate and
+// hashes an ADRS || data tail of the same length, which is the shape of
+// every leaf and node hash in a tree level.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "spx_funcs.h"
+
+/** Largest number of final blocks a lane may need for the AVX2 path */
+#define SHA2_AVX2_MAX_BLOCKS 4
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+/** SHA-256 round constants */
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+	0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+	0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/** SHA-512 round constants */
+static const uint64_t sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+	0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+	0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+	0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+	0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+	0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+	0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+	0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+	0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+	0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+#define ROTR32X8(x, n) \
+	_mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define ROTR64X4(x, n) \
+	_mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - (n)))
+#define XOR3(a, b, c) _mm256_xor_si256(_mm256_xor_si256(a, b), c)
+#define CH(e, f, g) \
+	_mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g))
+#define MAJ(a, b, c) \
+	_mm256_or_si256(_mm256_and_si256(a, b), \
+			_mm256_and_si256(c, _mm256_or_si256(a, b)))
+
+/*****************************************************************
+* Read a big endian 32-bit word
+******************************************************************
+ * @param in: Input bytes
+ * @return word value
+ */
+static uint32_t load_be32(const uint8_t * in)
+{
+	return ((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16) |
+	    ((uint32_t) in[2] << 8) | (uint32_t) in[3];
+}
+
+/*****************************************************************
+* Read a big endian 64-bit word
+******************************************************************
+ * @param in: Input bytes
+ * @return word value
+ */
+static uint64_t load_be64(const uint8_t * in)
+{
+	return ((uint64_t) load_be32(in) << 32) | load_be32(in + 4);
+}
+
+/*****************************************************************
+* Build the padded final blocks of one lane
+******************************************************************
+ * @param blocks:      Output buffer for the padded blocks
+ * @param block_len:   SHA-2 block size in bytes
+ * @param len_bytes:   Size of the length field in bytes (8 or 16)
+ * @param adrs:        ADRS buffer
+ * @param adrs_len:    Size of the ADRS buffer
+ * @param data:        Data buffer
+ * @param data_len:    Size of the data buffer
+ * @param prefix_bits: Bits already absorbed into the midstate
+ * @return number of blocks
+ */
+static uint32_t sha2_avx2_pad(uint8_t * blocks, uint32_t block_len,
+			      uint32_t len_bytes, const uint8_t * adrs,
+			      size_t adrs_len, const uint8_t * data,
+			      size_t data_len, uint64_t prefix_bits)
+{
+	size_t msg_len = adrs_len + data_len;
+	uint32_t block_count =
+	    (uint32_t) ((msg_len + 1 + len_bytes + block_len - 1) / block_len);
+	uint64_t total_bits = prefix_bits + ((uint64_t) msg_len * 8);
+	uint8_t *len_ptr = blocks + (block_count * block_len) - 8;
+	uint32_t index;
+
+	memset(blocks, 0, block_count * block_len);
+	memcpy(blocks, adrs, adrs_len);
+	memcpy(blocks + adrs_len, data, data_len);
+	blocks[msg_len] = 0x80;
+	for (index = 0; index < 8; index++) {
+		len_ptr[index] = (uint8_t) (total_bits >> (56 - (8 * index)));
+	}
+	return block_count;
+}
+
+/*****************************************************************
+* SHA-256 over eight lanes continuing from a shared midstate
+******************************************************************
+ * @param out:      Eight output buffers (32 bytes each)
+ * @param digest:   Shared SHA-256 midstate
+ * @param adrs:     Eight ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Eight data buffers
+ * @param data_len: Size of each data buffer
+ * @return none
+ */
+__attribute__((target("avx2")))
+static void sha256_seeded_x8(uint8_t ** out, const SHA2_STATE * digest,
+			     uint8_t ** adrs, size_t adrs_len,
+			     uint8_t ** data, size_t data_len)
+{
+	uint8_t blocks[8][SHA2_AVX2_MAX_BLOCKS * SHA2_256_BLOCK_SIZE];
+	uint32_t words[8][8];
+	uint64_t prefix_bits = ((uint64_t) digest->sha256.Nh << 32) |
+	    digest->sha256.Nl;
+	uint32_t block_count = 0;
+	uint32_t block;
+	uint32_t lane;
+	uint32_t round;
+	__m256i state[8];
+	__m256i w[16];
+	__m256i a, b, c, d, e, f, g, h, t1, t2;
+
+	for (lane = 0; lane < 8; lane++) {
+		block_count = sha2_avx2_pad(blocks[lane], SHA2_256_BLOCK_SIZE, 8,
+					    adrs[lane], adrs_len, data[lane],
+					    data_len, prefix_bits);
+	}
+	for (round = 0; round < 8; round++) {
+		state[round] = _mm256_set1_epi32((int)digest->sha256.h[round]);
+	}
+
+	for (block = 0; block < block_count; block++) {
+		for (round = 0; round < 16; round++) {
+			uint32_t offset = (block * SHA2_256_BLOCK_SIZE) + (4 * round);
+			w[round] = _mm256_setr_epi32(
+				(int)load_be32(blocks[0] + offset),
+				(int)load_be32(blocks[1] + offset),
+				(int)load_be32(blocks[2] + offset),
+				(int)load_be32(blocks[3] + offset),
+				(int)load_be32(blocks[4] + offset),
+				(int)load_be32(blocks[5] + offset),
+				(int)load_be32(blocks[6] + offset),
+				(int)load_be32(blocks[7] + offset));
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+		for (round = 0; round < 64; round++) {
+			if (round >= 16) {
+				// Message schedule kept as a rolling 16 word window
+				__m256i w15 = w[(round + 1) & 15];
+				__m256i w2 = w[(round + 14) & 15];
+				__m256i s0 = XOR3(ROTR32X8(w15, 7), ROTR32X8(w15, 18),
+						  _mm256_srli_epi32(w15, 3));
+				__m256i s1 = XOR3(ROTR32X8(w2, 17), ROTR32X8(w2, 19),
+						  _mm256_srli_epi32(w2, 10));
+				w[round & 15] = _mm256_add_epi32(
+					_mm256_add_epi32(w[round & 15], s0),
+					_mm256_add_epi32(w[(round + 9) & 15], s1));
+			}
+			t1 = _mm256_add_epi32(h, XOR3(ROTR32X8(e, 6),
+						      ROTR32X8(e, 11),
+						      ROTR32X8(e, 25)));
+			t1 = _mm256_add_epi32(t1, CH(e, f, g));
+			t1 = _mm256_add_epi32(t1,
+					      _mm256_set1_epi32((int)sha256_k[round]));
+			t1 = _mm256_add_epi32(t1, w[round & 15]);
+			t2 = _mm256_add_epi32(XOR3(ROTR32X8(a, 2), ROTR32X8(a, 13),
+						   ROTR32X8(a, 22)), MAJ(a, b, c));
+			h = g; g = f; f = e;
+			e = _mm256_add_epi32(d, t1);
+			d = c; c = b; b = a;
+			a = _mm256_add_epi32(t1, t2);
+		}
+		state[0] = _mm256_add_epi32(state[0], a);
+		state[1] = _mm256_add_epi32(state[1], b);
+		state[2] = _mm256_add_epi32(state[2], c);
+		state[3] = _mm256_add_epi32(state[3], d);
+		state[4] = _mm256_add_epi32(state[4], e);
+		state[5] = _mm256_add_epi32(state[5], f);
+		state[6] = _mm256_add_epi32(state[6], g);
+		state[7] = _mm256_add_epi32(state[7], h);
+	}
+
+	for (round = 0; round < 8; round++) {
+		_mm256_storeu_si256((__m256i *) words[round], state[round]);
+	}
+	for (lane = 0; lane < 8; lane++) {
+		for (round = 0; round < 8; round++) {
+			out[lane][4 * round] = (uint8_t) (words[round][lane] >> 24);
+			out[lane][4 * round + 1] = (uint8_t) (words[round][lane] >> 16);
+			out[lane][4 * round + 2] = (uint8_t) (words[round][lane] >> 8);
+			out[lane][4 * round + 3] = (uint8_t) words[round][lane];
+		}
+	}
+}
+
+/*****************************************************************
+* SHA-512 over four lanes continuing from a shared midstate
+******************************************************************
+ * @param out:      Four output buffers (64 bytes each)
+ * @param digest:   Shared SHA-512 midstate
+ * @param adrs:     Four ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Four data buffers
+ * @param data_len: Size of each data buffer
+ * @return none
+ */
+__attribute__((target("avx2")))
+static void sha512_seeded_x4(uint8_t ** out, const SHA2_STATE * digest,
+			     uint8_t ** adrs, size_t adrs_len,
+			     uint8_t ** data, size_t data_len)
+{
+	uint8_t blocks[4][SHA2_AVX2_MAX_BLOCKS * SHA2_512_BLOCK_SIZE];
+	uint64_t words[8][4];
+	uint64_t prefix_bits = digest->sha512.Nl;
+	uint32_t block_count = 0;
+	uint32_t block;
+	uint32_t lane;
+	uint32_t round;
+	uint32_t index;
+	__m256i state[8];
+	__m256i w[16];
+	__m256i a, b, c, d, e, f, g, h, t1, t2;
+
+	for (lane = 0; lane < 4; lane++) {
+		block_count = sha2_avx2_pad(blocks[lane], SHA2_512_BLOCK_SIZE, 16,
+					    adrs[lane], adrs_len, data[lane],
+					    data_len, prefix_bits);
+	}
+	for (round = 0; round < 8; round++) {
+		state[round] =
+		    _mm256_set1_epi64x((long long)digest->sha512.h[round]);
+	}
+
+	for (block = 0; block < block_count; block++) {
+		for (round = 0; round < 16; round++) {
+			uint32_t offset = (block * SHA2_512_BLOCK_SIZE) + (8 * round);
+			w[round] = _mm256_setr_epi64x(
+				(long long)load_be64(blocks[0] + offset),
+				(long long)load_be64(blocks[1] + offset),
+				(long long)load_be64(blocks[2] + offset),
+				(long long)load_be64(blocks[3] + offset));
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+		for (round = 0; round < 80; round++) {
+			if (round >= 16) {
+				__m256i w15 = w[(round + 1) & 15];
+				__m256i w2 = w[(round + 14) & 15];
+				__m256i s0 = XOR3(ROTR64X4(w15, 1), ROTR64X4(w15, 8),
+						  _mm256_srli_epi64(w15, 7));
+				__m256i s1 = XOR3(ROTR64X4(w2, 19), ROTR64X4(w2, 61),
+						  _mm256_srli_epi64(w2, 6));
+				w[round & 15] = _mm256_add_epi64(
+					_mm256_add_epi64(w[round & 15], s0),
+					_mm256_add_epi64(w[(round + 9) & 15], s1));
+			}
+			t1 = _mm256_add_epi64(h, XOR3(ROTR64X4(e, 14),
+						      ROTR64X4(e, 18),
+						      ROTR64X4(e, 41)));
+			t1 = _mm256_add_epi64(t1, CH(e, f, g));
+			t1 = _mm256_add_epi64(t1,
+					      _mm256_set1_epi64x((long long)sha512_k[round]));
+			t1 = _mm256_add_epi64(t1, w[round & 15]);
+			t2 = _mm256_add_epi64(XOR3(ROTR64X4(a, 28), ROTR64X4(a, 34),
+						   ROTR64X4(a, 39)), MAJ(a, b, c));
+			h = g; g = f; f = e;
+			e = _mm256_add_epi64(d, t1);
+			d = c; c = b; b = a;
+			a = _mm256_add_epi64(t1, t2);
+		}
+		state[0] = _mm256_add_epi64(state[0], a);
+		state[1] = _mm256_add_epi64(state[1], b);
+		state[2] = _mm256_add_epi64(state[2], c);
+		state[3] = _mm256_add_epi64(state[3], d);
+		state[4] = _mm256_add_epi64(state[4], e);
+		state[5] = _mm256_add_epi64(state[5], f);
+		state[6] = _mm256_add_epi64(state[6], g);
+		state[7] = _mm256_add_epi64(state[7], h);
+	}
+
+	for (round = 0; round < 8; round++) {
+		_mm256_storeu_si256((__m256i *) words[round], state[round]);
+	}
+	for (lane = 0; lane < 4; lane++) {
+		for (round = 0; round < 8; round++) {
+			for (index = 0; index < 8; index++) {
+				out[lane][8 * round + index] =
+				    (uint8_t) (words[round][lane] >>
+					       (56 - (8 * index)));
+			}
+		}
+	}
+}
+
+/*****************************************************************
+* Number of lanes the AVX2 backend hashes for this midstate and input
+******************************************************************
+ * @param digest:  SHA2 midstate shared by all lanes
+ * @param msg_len: Length of the ADRS || data tail of each lane
+ * @return 8 or 4 lanes, or 0 when the scalar path must be used
+ */
+uint32_t sha2_avx2_lanes(const SHA2_STATE * digest, size_t msg_len)
+{
+	if (!__builtin_cpu_supports("avx2")) {
+		return 0;
+	}
+	// Midstates must end on a block boundary so the tail starts a block
+	if (digest->hash_len <= 16) {
+		if ((digest->sha256.num != 0) || (msg_len + 9 >
+		     SHA2_AVX2_MAX_BLOCKS * SHA2_256_BLOCK_SIZE)) {
+			return 0;
+		}
+		return 8;
+	}
+	if ((digest->sha512.num != 0) || (digest->sha512.Nh != 0) ||
+	    (msg_len + 17 > SHA2_AVX2_MAX_BLOCKS * SHA2_512_BLOCK_SIZE)) {
+		return 0;
+	}
+	return 4;
+}
+
+/*****************************************************************
+* Hash one group of lanes with the AVX2 backend
+******************************************************************
+ * @param out:      Output buffers (full digest length)
+ * @param digest:   SHA2 midstate shared by all lanes
+ * @param adrs:     ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Data buffers
+ * @param data_len: Size of each data buffer
+ * @return none
+ */
+void sha2_avx2_seeded(uint8_t ** out, const SHA2_STATE * digest,
+		      uint8_t ** adrs, size_t adrs_len,
+		      uint8_t ** data, size_t data_len)
+{
+	if (digest->hash_len <= 16) {
+		sha256_seeded_x8(out, digest, adrs, adrs_len, data, data_len);
+	} else {
+		sha512_seeded_x4(out, digest, adrs, adrs_len, data, data_len);
+	}
+}
+
+#else
+
+/*****************************************************************
+* Number of lanes the AVX2 backend hashes for this midstate and input
+******************************************************************
+ * @param digest:  SHA2 midstate shared by all lanes
+ * @param msg_len: Length of the ADRS || data tail of each lane
+ * @return 0, the AVX2 backend is not built for this target
+ */
+uint32_t sha2_avx2_lanes(const SHA2_STATE * digest, size_t msg_len)
+{
+	(void)digest;
+	(void)msg_len;
+	return 0;
+}
+
+/*****************************************************************
+* Hash one group of lanes with the AVX2 backend
+******************************************************************
+ * Not available for this target, sha2_avx2_lanes always returns 0
+ */
+void sha2_avx2_seeded(uint8_t ** out, const SHA2_STATE * digest,
+		      uint8_t ** adrs, size_t adrs_len,
+		      uint8_t ** data, size_t data_len)
+{
+	(void)out;
+	(void)digest;
+	(void)adrs;
+	(void)adrs_len;
+	(void)data;
+	(void)data_len;
+}
+
+#endif
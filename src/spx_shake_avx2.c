@@ -0,0 +1,267 @@
+/*
+	Copyright (c) 2025, VeriSign, Inc.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted (subject to the limitations in the disclaimer
+	below) provided that the following conditions are met:
+
+		* Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		* Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		* Neither the name of the copyright holder nor the names of its
+		contributors may be used to endorse or promote products derived from this
+		software without specific prior written permission.
+
+	NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+	THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+	CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+	PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+	CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+	EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+	PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+	BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+	IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+*/
+// 4-way interleaved Keccak-f[1600] for SHAKE256 using AVX2.
+// Each 256-bit register holds the same lane of four independent sponges
+// that all continue from one PK.seed sponge and absorb an ADRS || data
+// tail of the same length, which is the shape of a tree level.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "spx_funcs.h"
+
+/** Largest number of rate blocks a lane may need for the AVX2 path */
+#define SHAKE_X4_MAX_BLOCKS 4
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+/** Keccak-f[1600] round constants */
+static const uint64_t keccakx4_round_constants[24] = {
+	0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+	0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+	0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+	0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+	0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+	0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+	0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+	0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+/** Keccak-f[1600] rho rotation offsets in pi order */
+static const uint8_t keccakx4_rho[24] = {
+	1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14,
+	27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+
+/** Keccak-f[1600] pi lane order */
+static const uint8_t keccakx4_pi[24] = {
+	10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4,
+	15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+};
+
+#define ROTL64X4(x, n) \
+	_mm256_or_si256(_mm256_sllv_epi64(x, _mm256_set1_epi64x(n)), \
+			_mm256_srlv_epi64(x, _mm256_set1_epi64x(64 - (n))))
+
+/*****************************************************************
+* Keccak-f[1600] permutation on four interleaved states
+******************************************************************
+ * @param lanes: Keccak state lanes, one state per 64-bit element
+ * @return none
+ */
+__attribute__((target("avx2")))
+static void keccakx4_f1600(__m256i * lanes)
+{
+	__m256i column[5];
+	__m256i tmp;
+	uint32_t round;
+	uint32_t x;
+	uint32_t y;
+
+	for (round = 0; round < 24; round++) {
+		// Theta
+		for (x = 0; x < 5; x++) {
+			column[x] = _mm256_xor_si256(_mm256_xor_si256(lanes[x],
+								      lanes[x + 5]),
+						     _mm256_xor_si256(lanes[x + 10],
+								      lanes[x + 15]));
+			column[x] = _mm256_xor_si256(column[x], lanes[x + 20]);
+		}
+		for (x = 0; x < 5; x++) {
+			tmp = _mm256_xor_si256(column[(x + 4) % 5],
+					       ROTL64X4(column[(x + 1) % 5], 1));
+			for (y = 0; y < 25; y += 5) {
+				lanes[y + x] = _mm256_xor_si256(lanes[y + x], tmp);
+			}
+		}
+		// Rho and Pi
+		tmp = lanes[1];
+		for (x = 0; x < 24; x++) {
+			column[0] = lanes[keccakx4_pi[x]];
+			lanes[keccakx4_pi[x]] = ROTL64X4(tmp, keccakx4_rho[x]);
+			tmp = column[0];
+		}
+		// Chi
+		for (y = 0; y < 25; y += 5) {
+			for (x = 0; x < 5; x++) {
+				column[x] = lanes[y + x];
+			}
+			for (x = 0; x < 5; x++) {
+				lanes[y + x] =
+				    _mm256_xor_si256(lanes[y + x],
+						     _mm256_andnot_si256(column
+									 [(x + 1) % 5],
+									 column[(x + 2) % 5]));
+			}
+		}
+		// Iota
+		lanes[0] =
+		    _mm256_xor_si256(lanes[0],
+				     _mm256_set1_epi64x((long long)
+							keccakx4_round_constants
+							[round]));
+	}
+}
+
+/*****************************************************************
+* Number of lanes the AVX2 SHAKE256 backend hashes for an input
+******************************************************************
+ * @param sponge:   SHAKE256 sponge shared by all lanes
+ * @param msg_len:  Length of the ADRS || data tail of each lane
+ * @param hash_len: Number of bytes to squeeze per lane
+ * @return 4 lanes, or 0 when the scalar path must be used
+ */
+uint32_t shake256x4_lanes(const SHAKE256_STATE * sponge, size_t msg_len,
+			  size_t hash_len)
+{
+	if (!__builtin_cpu_supports("avx2")) {
+		return 0;
+	}
+	// A single squeeze block and a bounded absorb keep it on the stack
+	if ((hash_len > SHAKE256_RATE) || (sponge->offset + msg_len + 1 >
+					    SHAKE_X4_MAX_BLOCKS *
+					    SHAKE256_RATE)) {
+		return 0;
+	}
+	return 4;
+}
+
+/*****************************************************************
+* SHAKE256 over four lanes continuing from a shared sponge
+******************************************************************
+ * @param out:      Four output buffers (hash_len bytes each)
+ * @param sponge:   SHAKE256 sponge shared by all lanes
+ * @param adrs:     Four ADRS buffers
+ * @param adrs_len: Size of each ADRS buffer
+ * @param data:     Four data buffers
+ * @param data_len: Size of each data buffer
+ * @param hash_len: Number of bytes to squeeze per lane
+ * @return none
+ */
+__attribute__((target("avx2")))
+void shake256x4(uint8_t ** out, const SHAKE256_STATE * sponge,
+		uint8_t ** adrs, size_t adrs_len,
+		uint8_t ** data, size_t data_len, size_t hash_len)
+{
+	uint8_t blocks[4][SHAKE_X4_MAX_BLOCKS * SHAKE256_RATE];
+	uint64_t words[4];
+	__m256i lanes[25];
+	size_t total = sponge->offset + adrs_len + data_len;
+	uint32_t block_count = (uint32_t) (total / SHAKE256_RATE) + 1;
+	uint32_t block;
+	uint32_t lane;
+	uint32_t index;
+	size_t copy_len;
+
+	// Lay out each tail after the bytes already in the sponge block
+	for (lane = 0; lane < 4; lane++) {
+		memset(blocks[lane], 0, block_count * SHAKE256_RATE);
+		memcpy(blocks[lane] + sponge->offset, adrs[lane], adrs_len);
+		memcpy(blocks[lane] + sponge->offset + adrs_len, data[lane],
+		       data_len);
+		// SHAKE domain separation and pad10*1
+		blocks[lane][total] ^= 0x1f;
+		blocks[lane][(block_count * SHAKE256_RATE) - 1] ^= 0x80;
+	}
+
+	for (index = 0; index < 25; index++) {
+		lanes[index] =
+		    _mm256_set1_epi64x((long long)sponge->lanes[index]);
+	}
+
+	for (block = 0; block < block_count; block++) {
+		for (index = 0; index < SHAKE256_RATE / 8; index++) {
+			for (lane = 0; lane < 4; lane++) {
+				memcpy(&words[lane],
+				       blocks[lane] + (block * SHAKE256_RATE) +
+				       (index * 8), 8);
+			}
+			lanes[index] =
+			    _mm256_xor_si256(lanes[index],
+					     _mm256_loadu_si256((const __m256i *)
+								words));
+		}
+		keccakx4_f1600(lanes);
+	}
+
+	for (index = 0; index * 8 < hash_len; index++) {
+		_mm256_storeu_si256((__m256i *) words, lanes[index]);
+		copy_len = hash_len - (index * 8);
+		if (copy_len > 8) {
+			copy_len = 8;
+		}
+		for (lane = 0; lane < 4; lane++) {
+			memcpy(out[lane] + (index * 8), &words[lane], copy_len);
+		}
+	}
+}
+
+#else
+
+/*****************************************************************
+* Number of lanes the AVX2 SHAKE256 backend hashes for an input
+******************************************************************
+ * @param sponge:   SHAKE256 sponge shared by all lanes
+ * @param msg_len:  Length of the ADRS || data tail of each lane
+ * @param hash_len: Number of bytes to squeeze per lane
+ * @return 0, the AVX2 backend is not built for this target
+ */
+uint32_t shake256x4_lanes(const SHAKE256_STATE * sponge, size_t msg_len,
+			  size_t hash_len)
+{
+	(void)sponge;
+	(void)msg_len;
+	(void)hash_len;
+	return 0;
+}
+
+/*****************************************************************
+* SHAKE256 over four lanes continuing from a shared sponge
+******************************************************************
+ * Not available for this target, shake256x4_lanes always returns 0
+ */
+void shake256x4(uint8_t ** out, const SHAKE256_STATE * sponge,
+		uint8_t ** adrs, size_t adrs_len,
+		uint8_t ** data, size_t data_len, size_t hash_len)
+{
+	(void)out;
+	(void)sponge;
+	(void)adrs;
+	(void)adrs_len;
+	(void)data;
+	(void)data_len;
+	(void)hash_len;
+}
+
+#endif
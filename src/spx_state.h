@@ -0,0 +1,123 @@
+/*
+	Copyright (c) 2025, VeriSign, Inc.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted (subject to the limitations in the disclaimer
+	below) provided that the following conditions are met:
+
+		* Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		* Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		* Neither the name of the copyright holder nor the names of its
+		contributors may be used to endorse or promote products derived from this
+		software without specific prior written permission.
+
+	NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+	THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+	CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+	PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+	CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+	EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+	PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+	BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+	IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ *  \file spx_state.h
+ *  \brief Hash states kept by the SPHINCS+ parameters
+ *  Plain structures for the precomputed digest states that SPX_PARAMS
+ *  carries. They are copied by value for every hash, so they hold no
+ *  pointers. The functions that fill and use them are in spx_funcs.h.
+*/
+#ifndef __SPX_STATE_H__
+#define __SPX_STATE_H__
+
+#include <stdint.h>
+#include <openssl/sha.h>
+
+// Definitions
+/** Byte size of a SHA2_256 hash */ 
+#define SHA2_256_BLOCK_SIZE 64
+/** Byte size of a SHA2_512 hash */ 
+#define SHA2_512_BLOCK_SIZE 128
+/** Byte rate of the SHAKE256 sponge */
+#define SHAKE256_RATE 136
+/** Marker for a precomputed state (seed, key pads, templates) */
+#define SPX_STATE_READY 0x53505852
+
+// Types & Structures
+/**
+ * \brief Multi-part SHA-256/SHA-512 state selected by the hash length
+ */
+typedef struct SHA2_STATE {
+	/** Hash length the state was created for (selects SHA-256/512) */
+	uint32_t hash_len;
+	/** SHA-256 state (hash_len <= 16) */
+	SHA256_CTX sha256;
+	/** SHA-512 state (hash_len > 16) */
+	SHA512_CTX sha512;
+} SHA2_STATE;
+
+/**
+ * \brief SHA2 compression state after absorbing BlockPad(PK.seed)
+ */
+typedef struct SHA2_SEED_STATE {
+	/** Set to SPX_STATE_READY once the state is computed */
+	uint32_t ready;
+	/** Seed value that was absorbed */
+	uint8_t seed[SHA2_512_BLOCK_SIZE];
+	/** Seed value length */
+	uint32_t seed_len;
+	/** Digest state with the padded seed absorbed */
+	SHA2_STATE digest;
+} SHA2_SEED_STATE;
+
+/**
+ * \brief HMAC-SHA2 states after absorbing the (K ^ ipad) and (K ^ opad) blocks
+ */
+typedef struct HMAC_SHA2_STATE {
+	/** Set to SPX_STATE_READY once the state is computed */
+	uint32_t ready;
+	/** Key value that was absorbed */
+	uint8_t key[SHA2_512_BLOCK_SIZE];
+	/** Key value length */
+	uint32_t key_len;
+	/** Digest state with (K ^ ipad) absorbed */
+	SHA2_STATE inner;
+	/** Digest state with (K ^ opad) absorbed */
+	SHA2_STATE outer;
+} HMAC_SHA2_STATE;
+
+/**
+ * \brief SHAKE256 sponge state (Keccak-f[1600] lanes)
+ */
+typedef struct SHAKE256_STATE {
+	/** Keccak state lanes */
+	uint64_t lanes[25];
+	/** Bytes absorbed into the current block */
+	uint32_t offset;
+} SHAKE256_STATE;
+
+/**
+ * \brief SHAKE256 sponge state after absorbing PK.seed
+ */
+typedef struct SHAKE_SEED_STATE {
+	/** Set to SPX_STATE_READY once the state is computed */
+	uint32_t ready;
+	/** Seed value that was absorbed */
+	uint8_t seed[SHA2_512_BLOCK_SIZE];
+	/** Seed value length */
+	uint32_t seed_len;
+	/** Sponge state with the seed absorbed */
+	SHAKE256_STATE sponge;
+} SHAKE_SEED_STATE;
+
+#endif				//__SPX_STATE_H__
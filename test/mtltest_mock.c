@@ -217,3 +217,55 @@ uint8_t mtl_test_hash_node(void *params,
 	EVP_MD_CTX_free(mdctx);
 	return 0;
 }
+
+uint32_t mtl_test_batch_nodes = 0;
+
+/**
+ * Mock function for batch leaf hashing operations
+ */
+uint8_t mtl_test_hash_leaf_batch(void *params,
+				 SERIESID * sid,
+				 uint32_t * node_ids,
+				 uint8_t ** msg_buffers,
+				 uint32_t msg_length,
+				 uint8_t ** hashes,
+				 uint32_t hash_length, uint32_t count)
+{
+	uint32_t index;
+
+	for (index = 0; index < count; index++) {
+		if (mtl_test_hash_leaf(params, sid, node_ids[index],
+				       msg_buffers[index], msg_length,
+				       hashes[index], hash_length) != 0) {
+			return 1;
+		}
+		mtl_test_batch_nodes++;
+	}
+	return 0;
+}
+
+/**
+ * Mock function for batch internal hashing operations
+ */
+uint8_t mtl_test_hash_node_batch(void *params,
+				 SERIESID * sid,
+				 uint32_t * left_index,
+				 uint32_t * right_index,
+				 uint8_t ** left_hash,
+				 uint8_t ** right_hash,
+				 uint8_t ** hash, uint32_t hash_length,
+				 uint32_t count)
+{
+	uint32_t index;
+
+	for (index = 0; index < count; index++) {
+		if (mtl_test_hash_node(params, sid, left_index[index],
+				       right_index[index], left_hash[index],
+				       right_hash[index], hash[index],
+				       hash_length) != 0) {
+			return 1;
+		}
+		mtl_test_batch_nodes++;
+	}
+	return 0;
+}
@@ -56,5 +56,23 @@ uint8_t mtl_test_hash_node(void *params,
 			   uint8_t * left_hash,
 			   uint8_t * right_hash,
 			   uint8_t * hash, uint32_t hash_length);
+uint8_t mtl_test_hash_leaf_batch(void *params,
+				 SERIESID * sid,
+				 uint32_t * node_ids,
+				 uint8_t ** msg_buffers,
+				 uint32_t msg_length,
+				 uint8_t ** hashes,
+				 uint32_t hash_length, uint32_t count);
+uint8_t mtl_test_hash_node_batch(void *params,
+				 SERIESID * sid,
+				 uint32_t * left_index,
+				 uint32_t * right_index,
+				 uint8_t ** left_hash,
+				 uint8_t ** right_hash,
+				 uint8_t ** hash, uint32_t hash_length,
+				 uint32_t count);
+
+// Number of nodes hashed through the mock batch functions
+extern uint32_t mtl_test_batch_nodes;
 
 #endif				// __MTLTEST_MOCK_H__
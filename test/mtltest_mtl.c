@@ -34,6 +34,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "mtltest.h"
 #include "mtl_node_set.h"
@@ -50,14 +51,19 @@ uint8_t mtltest_mtl_set_scheme_functions_null(void);
 uint8_t mtltest_mtl_append(void);
 uint8_t mtltest_mtl_append_random(void);
 uint8_t mtltest_mtl_append_null(void);
+uint8_t mtltest_mtl_append_batch(void);
 uint8_t mtltest_mtl_node_set_update_parents(void);
 uint8_t mtltest_mtl_node_set_update_parents_null(void);
+uint8_t mtltest_mtl_node_set_rebuild(void);
+uint8_t mtltest_mtl_scheme_batch_functions(void);
 uint8_t mtltest_mtl_authpath(void);
 uint8_t mtltest_mtl_authpath_multi(void);
 uint8_t mtltest_mtl_authpath_null(void);
 uint8_t mtltest_mtl_ladder(void);
 uint8_t mtltest_mtl_ladder_multi(void);
 uint8_t mtltest_mtl_ladder_null(void);
+uint8_t mtltest_mtl_ladder_ref(void);
+uint8_t mtltest_mtl_snapshot_readers(void);
 uint8_t mtltest_mtl_rung(void);
 uint8_t mtltest_mtl_rung_null(void);
 uint8_t mtltest_mtl_verify(void);
@@ -80,10 +86,16 @@ uint8_t mtltest_mtl(void)
 		 "Verify MTL append function w/randomizer");
 	RUN_TEST(mtltest_mtl_append_null,
 		 "Verify MTL append function w/null parameters");
+	RUN_TEST(mtltest_mtl_append_batch,
+		 "Verify MTL batch append function");
 	RUN_TEST(mtltest_mtl_node_set_update_parents,
 		 "Verify the MTL node set parent hash function");
 	RUN_TEST(mtltest_mtl_node_set_update_parents_null,
 		 "Verify the MTL node set parent hash function w/null parameters");		 
+	RUN_TEST(mtltest_mtl_node_set_rebuild,
+		 "Verify the MTL node set rebuild function w/worker threads");
+	RUN_TEST(mtltest_mtl_scheme_batch_functions,
+		 "Verify MTL tree hashing through scheme batch functions");
 	RUN_TEST(mtltest_mtl_authpath,
 		 "Verify MTL authentication path function");
 	RUN_TEST(mtltest_mtl_authpath_multi,
@@ -95,6 +107,10 @@ uint8_t mtltest_mtl(void)
 		 "Verify MTL ladder function w/multiple rungs");
 	RUN_TEST(mtltest_mtl_ladder,
 		 "Verify MTL ladder function w/null parameters");
+	RUN_TEST(mtltest_mtl_ladder_ref,
+		 "Verify MTL ladder kept up to date in the context");
+	RUN_TEST(mtltest_mtl_snapshot_readers,
+		 "Verify MTL snapshots read while another thread appends");
 	RUN_TEST(mtltest_mtl_rung, "Verify MTL rung function");
 	RUN_TEST(mtltest_mtl_rung_null,
 		 "Verify MTL rung function w/null parameters");
@@ -719,6 +735,265 @@ uint8_t mtltest_mtl_node_set_update_parents_null(void) {
 	return 0;
 }
 
+/**
+ * Test the mtl batch append against single appends
+ */
+uint8_t mtltest_mtl_append_batch(void)
+{
+	uint32_t hash_len = 32;
+	uint32_t batch_sizes[] = { 1, 3, 8, 5, 16, 1, 1, 30, 64, 2 };
+	uint32_t batch_index;
+	uint32_t leaf_count = 0;
+	uint32_t index;
+	uint8_t values[64][32];
+	uint8_t *value_ptrs[64];
+	uint16_t value_lens[64];
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	uint64_t tree_len;
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *reference = NULL;
+	MTL_CTX *mtl_ctx = NULL;
+
+	sid.length = 8;
+	memset(sid.id, 0, sid.length);
+	pk_seed.length = hash_len;
+	memset(pk_seed.seed, 0, hash_len);
+
+	assert(mtl_initns(&reference, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(reference, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+	assert(mtl_initns(&mtl_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(mtl_ctx, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+
+	// Batches of different sizes end up with the same tree
+	for (batch_index = 0; batch_index < sizeof(batch_sizes) / sizeof(uint32_t);
+	     batch_index++) {
+		for (index = 0; index < batch_sizes[batch_index]; index++) {
+			memset(values[index], (leaf_count + index) & 0xff, hash_len);
+			value_ptrs[index] = values[index];
+			value_lens[index] = hash_len;
+			assert(mtl_append(reference, values[index], hash_len,
+					  leaf_count + index) == MTL_OK);
+		}
+		assert(mtl_append_batch(mtl_ctx, value_ptrs, value_lens,
+					batch_sizes[batch_index]) == MTL_OK);
+		leaf_count += batch_sizes[batch_index];
+		assert(mtl_ctx->nodes.leaf_count == leaf_count);
+
+		tree_len = mtl_node_set_node_count(leaf_count) * hash_len;
+		expected = malloc(tree_len);
+		actual = malloc(tree_len);
+		assert(mtl_node_set_export(&reference->nodes, expected, NULL) == MTL_OK);
+		assert(mtl_node_set_export(&mtl_ctx->nodes, actual, NULL) == MTL_OK);
+		assert(memcmp(actual, expected, tree_len) == 0);
+		free(expected);
+		free(actual);
+	}
+
+	// Invalid parameters
+	assert(mtl_append_batch(NULL, value_ptrs, value_lens, 1) == MTL_NULL_PTR);
+	assert(mtl_append_batch(mtl_ctx, NULL, value_lens, 1) == MTL_NULL_PTR);
+	assert(mtl_append_batch(mtl_ctx, value_ptrs, NULL, 1) == MTL_NULL_PTR);
+	assert(mtl_append_batch(mtl_ctx, value_ptrs, value_lens, 0) == MTL_NULL_PTR);
+	value_ptrs[0] = NULL;
+	assert(mtl_append_batch(mtl_ctx, value_ptrs, value_lens, 1) == MTL_NULL_PTR);
+
+	assert(mtl_free(reference) == MTL_OK);
+	assert(mtl_free(mtl_ctx) == MTL_OK);
+
+	return 0;
+}
+
+/**
+ * Test the mtl node set rebuild against sequential appends
+ */
+uint8_t mtltest_mtl_node_set_rebuild(void)
+{
+	uint32_t hash_len = 32;
+	uint32_t leaf_counts[] = { 0, 1, 7, 64, 103, 1000 };
+	uint32_t thread_counts[] = { 0, 1, 2, 4, 7 };
+	uint32_t test_index;
+	uint32_t thread_index;
+	uint32_t leaf_count;
+	uint32_t index;
+	uint8_t buffer[32];
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	const uint8_t *leaf = NULL;
+	uint64_t tree_len;
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *reference = NULL;
+	MTL_CTX *mtl_ctx = NULL;
+
+	sid.length = 8;
+	memset(sid.id, 0, sid.length);
+	pk_seed.length = hash_len;
+	memset(pk_seed.seed, 0, hash_len);
+
+	assert(mtl_node_set_rebuild(NULL, 1) == MTL_NULL_PTR);
+
+	for (test_index = 0; test_index < sizeof(leaf_counts) / sizeof(uint32_t);
+	     test_index++) {
+		leaf_count = leaf_counts[test_index];
+
+		// Reference tree built one leaf at a time
+		assert(mtl_initns(&reference, &pk_seed, &sid, NULL) == MTL_OK);
+		assert(mtl_set_scheme_functions(reference, NULL, 0,
+						mtl_test_hash_msg,
+						mtl_test_hash_leaf,
+						mtl_test_hash_node, NULL) == MTL_OK);
+		for (index = 0; index < leaf_count; index++) {
+			memset(buffer, index & 0xff, hash_len);
+			assert(mtl_append(reference, buffer, hash_len, index) == MTL_OK);
+		}
+		tree_len = mtl_node_set_node_count(leaf_count) * hash_len;
+		expected = malloc(tree_len + 1);
+		actual = malloc(tree_len + 1);
+		assert(mtl_node_set_export(&reference->nodes, expected, NULL) == MTL_OK);
+
+		for (thread_index = 0;
+		     thread_index < sizeof(thread_counts) / sizeof(uint32_t);
+		     thread_index++) {
+			// Small pages so subtrees span several pages
+			assert(mtl_initns(&mtl_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+			assert(mtl_node_set_set_geometry(&mtl_ctx->nodes, 5 * hash_len, 0) == MTL_OK);
+			assert(mtl_set_scheme_functions(mtl_ctx, NULL, 0,
+							mtl_test_hash_msg,
+							mtl_test_hash_leaf,
+							mtl_test_hash_node, NULL) == MTL_OK);
+
+			// Insert only the leaves then rebuild every parent
+			for (index = 0; index < leaf_count; index++) {
+				assert(mtl_node_set_fetch_ref(&reference->nodes, index, index, &leaf) == MTL_OK);
+				assert(mtl_node_set_insert(&mtl_ctx->nodes, index, index, (uint8_t *) leaf) == MTL_OK);
+			}
+			assert(mtl_node_set_rebuild(mtl_ctx, thread_counts[thread_index]) == MTL_OK);
+			assert(mtl_ctx->nodes.leaf_count == leaf_count);
+
+			assert(mtl_node_set_export(&mtl_ctx->nodes, actual, NULL) == MTL_OK);
+			assert(memcmp(actual, expected, tree_len) == 0);
+			assert(mtl_free(mtl_ctx) == MTL_OK);
+		}
+
+		free(expected);
+		free(actual);
+		assert(mtl_free(reference) == MTL_OK);
+	}
+
+	return 0;
+}
+
+/**
+ * Test the scheme batch functions against the single node functions
+ */
+uint8_t mtltest_mtl_scheme_batch_functions(void)
+{
+	uint32_t hash_len = 32;
+	uint32_t index;
+	uint8_t values[100][32];
+	uint8_t *value_ptrs[100];
+	uint16_t value_lens[100];
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	const uint8_t *leaf = NULL;
+	uint64_t tree_len;
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *reference = NULL;
+	MTL_CTX *mtl_ctx = NULL;
+	MTL_CTX *rebuild_ctx = NULL;
+
+	sid.length = 8;
+	memset(sid.id, 0, sid.length);
+	pk_seed.length = hash_len;
+	memset(pk_seed.seed, 0, hash_len);
+
+	assert(mtl_set_scheme_batch_functions(NULL, mtl_test_hash_leaf_batch,
+					      mtl_test_hash_node_batch) ==
+	       MTL_RESOURCE_FAIL);
+
+	assert(mtl_initns(&reference, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(reference->hash_leaf_batch == NULL);
+	assert(reference->hash_node_batch == NULL);
+	assert(mtl_set_scheme_functions(reference, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+	assert(mtl_initns(&mtl_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(mtl_ctx, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+	assert(mtl_set_scheme_batch_functions(mtl_ctx, mtl_test_hash_leaf_batch,
+					      mtl_test_hash_node_batch) == MTL_OK);
+	assert(mtl_ctx->hash_leaf_batch == mtl_test_hash_leaf_batch);
+	assert(mtl_ctx->hash_node_batch == mtl_test_hash_node_batch);
+
+	// One shorter value after the first batch mixes the lengths
+	for (index = 0; index < 100; index++) {
+		memset(values[index], index & 0xff, hash_len);
+		value_ptrs[index] = values[index];
+		value_lens[index] = (index == 40) ? hash_len - 1 : hash_len;
+		assert(mtl_append(reference, values[index], value_lens[index],
+				  index) == MTL_OK);
+	}
+
+	// Equal length values go through both batch functions
+	mtl_test_batch_nodes = 0;
+	assert(mtl_append_batch(mtl_ctx, value_ptrs, value_lens, 37) == MTL_OK);
+	assert(mtl_test_batch_nodes == mtl_node_set_node_count(37));
+
+	// Mixed lengths fall back to the single leaf function
+	mtl_test_batch_nodes = 0;
+	assert(mtl_append_batch(mtl_ctx, &value_ptrs[37], &value_lens[37],
+				63) == MTL_OK);
+	assert(mtl_test_batch_nodes == mtl_node_set_node_count(100) -
+	       mtl_node_set_node_count(37) - 63);
+
+	// Rebuilding from the leaves also hashes through the batch function
+	assert(mtl_initns(&rebuild_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(rebuild_ctx, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+	assert(mtl_set_scheme_batch_functions(rebuild_ctx, NULL,
+					      mtl_test_hash_node_batch) == MTL_OK);
+	for (index = 0; index < 100; index++) {
+		assert(mtl_node_set_fetch_ref(&reference->nodes, index, index, &leaf) == MTL_OK);
+		assert(mtl_node_set_insert(&rebuild_ctx->nodes, index, index, (uint8_t *) leaf) == MTL_OK);
+	}
+	mtl_test_batch_nodes = 0;
+	assert(mtl_node_set_rebuild(rebuild_ctx, 1) == MTL_OK);
+	assert(mtl_test_batch_nodes == mtl_node_set_node_count(100) - 100);
+
+	tree_len = mtl_node_set_node_count(100) * hash_len;
+	expected = malloc(tree_len);
+	actual = malloc(tree_len);
+	assert(mtl_node_set_export(&reference->nodes, expected, NULL) == MTL_OK);
+	assert(mtl_node_set_export(&mtl_ctx->nodes, actual, NULL) == MTL_OK);
+	assert(memcmp(actual, expected, tree_len) == 0);
+	assert(mtl_node_set_export(&rebuild_ctx->nodes, actual, NULL) == MTL_OK);
+	assert(memcmp(actual, expected, tree_len) == 0);
+	free(expected);
+	free(actual);
+
+	// Setting the scheme functions again clears the batch functions
+	assert(mtl_set_scheme_functions(mtl_ctx, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+	assert(mtl_ctx->hash_leaf_batch == NULL);
+	assert(mtl_ctx->hash_node_batch == NULL);
+
+	assert(mtl_free(reference) == MTL_OK);
+	assert(mtl_free(mtl_ctx) == MTL_OK);
+	assert(mtl_free(rebuild_ctx) == MTL_OK);
+
+	return 0;
+}
+
 /**
  * Test the mtl authentication path function
  */
@@ -1109,6 +1384,235 @@ uint8_t mtltest_mtl_ladder_null(void)
 /**
  * Test the mtl rung function
  */
+uint8_t mtltest_mtl_ladder_ref(void)
+{
+	uint32_t hash_len = 32;
+	uint32_t leaf_count;
+	uint32_t index;
+	uint32_t rung_index;
+	uint32_t left;
+	uint8_t values[40][32];
+	uint8_t *value_ptrs[40];
+	uint16_t value_lens[40];
+	const uint8_t *hash;
+	const LADDER *ladder;
+	LADDER *copy;
+	AUTHPATH *auth;
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *mtl_ctx = NULL;
+
+	sid.length = 8;
+	memset(sid.id, 0x5a, sid.length);
+	pk_seed.length = hash_len;
+	memset(pk_seed.seed, 0, hash_len);
+
+	assert(mtl_initns(&mtl_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(mtl_ctx, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+	ladder = mtl_ladder_ref(mtl_ctx);
+	assert(ladder == &mtl_ctx->ladder);
+	assert(ladder->rung_count == 0);
+
+	for (index = 0; index < 40; index++) {
+		memset(values[index], index, hash_len);
+		value_ptrs[index] = values[index];
+		value_lens[index] = hash_len;
+	}
+
+	// Single appends followed by a batch, the ladder has to match
+	// the node set after each of them
+	for (leaf_count = 1; leaf_count <= 120; leaf_count++) {
+		if (leaf_count <= 80) {
+			assert(mtl_append(mtl_ctx, values[leaf_count % 40], hash_len,
+					  leaf_count - 1) == MTL_OK);
+		} else {
+			assert(mtl_append_batch(mtl_ctx, value_ptrs, value_lens,
+						40) == MTL_OK);
+			leaf_count += 39;
+		}
+
+		ladder = mtl_ladder_ref(mtl_ctx);
+		assert(ladder == &mtl_ctx->ladder);
+		assert(ladder->rung_count ==
+		       2 * leaf_count - mtl_node_set_node_count(leaf_count));
+		assert(memcmp(ladder->sid.id, sid.id, sid.length) == 0);
+		left = 0;
+		for (rung_index = 0; rung_index < ladder->rung_count; rung_index++) {
+			assert(ladder->rungs[rung_index].left_index == left);
+			left = ladder->rungs[rung_index].right_index + 1;
+			assert(mtl_node_set_fetch_ref(&mtl_ctx->nodes,
+						      ladder->rungs[rung_index].left_index,
+						      ladder->rungs[rung_index].right_index,
+						      &hash) == MTL_OK);
+			assert(memcmp(ladder->rungs[rung_index].hash, hash, hash_len) == 0);
+		}
+		assert(left == leaf_count);
+
+		// Each auth path ends on the ladder rung covering its leaf
+		for (index = 0; index < leaf_count; index++) {
+			auth = mtl_authpath(mtl_ctx, index);
+			assert(auth != NULL);
+			for (rung_index = 0; rung_index < ladder->rung_count; rung_index++) {
+				if (ladder->rungs[rung_index].right_index >= index) {
+					break;
+				}
+			}
+			assert(auth->rung_left == ladder->rungs[rung_index].left_index);
+			assert(auth->rung_right == ladder->rungs[rung_index].right_index);
+			mtl_authpath_free(auth);
+		}
+	}
+
+	// mtl_ladder still hands out an independent copy
+	copy = mtl_ladder(mtl_ctx);
+	assert(copy != NULL);
+	assert(copy->rungs != mtl_ctx->ladder.rungs);
+	assert(copy->rung_count == mtl_ctx->ladder.rung_count);
+	assert(memcmp(copy->rungs, mtl_ctx->ladder.rungs,
+		      sizeof(RUNG) * copy->rung_count) == 0);
+	mtl_ladder_free(copy);
+
+	// Rebuilding the internal nodes also refreshes the ladder
+	assert(mtl_node_set_rebuild(mtl_ctx, 4) == MTL_OK);
+	assert(mtl_ctx->ladder.rung_count == 4);
+	assert(mtl_ctx->ladder.rungs[3].right_index == 119);
+
+	assert(mtl_ladder_ref(NULL) == NULL);
+	assert(mtl_free(mtl_ctx) == MTL_OK);
+
+	return 0;
+}
+
+/** Work item for a thread reading snapshots while leaves are appended */
+typedef struct MTL_READER_TEST {
+	MTL_CTX *ctx;
+	uint8_t (*values)[32];
+	uint32_t leaf_count;
+	uint32_t reads;
+} MTL_READER_TEST;
+
+/**
+ * Authenticate leaves against the ladder of each snapshot until the
+ * appending thread is done
+ */
+static void *mtltest_mtl_snapshot_reader(void *arg)
+{
+	MTL_READER_TEST *task = (MTL_READER_TEST *) arg;
+	uint64_t snapshot = 0;
+	uint64_t previous = 0;
+	uint32_t leaf;
+	LADDER *ladder;
+	AUTHPATH *auth;
+	RUNG *rung;
+
+	while (snapshot < task->leaf_count) {
+		snapshot = mtl_snapshot(task->ctx);
+		assert(snapshot >= previous);
+		previous = snapshot;
+		if (snapshot == 0) {
+			continue;
+		}
+
+		// Any leaf of the snapshot verifies against its ladder
+		leaf = (uint32_t)((task->reads * 7919) % snapshot);
+		ladder = mtl_ladder_at(task->ctx, snapshot);
+		assert(ladder != NULL);
+		assert(ladder->rung_count == mtl_bit_width(snapshot));
+		auth = mtl_authpath_at(task->ctx, leaf, snapshot);
+		assert(auth != NULL);
+		rung = mtl_rung(auth, ladder);
+		assert(rung != NULL);
+		assert(mtl_verify(task->ctx, task->values[leaf % 40], 32, auth,
+				  rung) == MTL_OK);
+		mtl_authpath_free(auth);
+		mtl_ladder_free(ladder);
+		task->reads++;
+	}
+	return NULL;
+}
+
+/**
+ * Test readers using snapshots while another thread appends
+ */
+uint8_t mtltest_mtl_snapshot_readers(void)
+{
+	uint32_t hash_len = 32;
+	uint32_t leaf_count = 600;
+	uint32_t index;
+	uint8_t values[40][32];
+	MTL_READER_TEST tasks[4];
+	pthread_t threads[4];
+	LADDER *ladder;
+	AUTHPATH *auth;
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *mtl_ctx = NULL;
+
+	sid.length = 8;
+	memset(sid.id, 0x3d, sid.length);
+	pk_seed.length = hash_len;
+	memset(pk_seed.seed, 0, hash_len);
+	for (index = 0; index < 40; index++) {
+		memset(values[index], index + 1, hash_len);
+	}
+
+	assert(mtl_initns(&mtl_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	// Small pages so the page directory grows while it is being read
+	assert(mtl_node_set_set_geometry(&mtl_ctx->nodes, 2 * hash_len, 0) == MTL_OK);
+	assert(mtl_set_scheme_functions(mtl_ctx, NULL, 0, mtl_test_hash_msg,
+					mtl_test_hash_leaf, mtl_test_hash_node,
+					NULL) == MTL_OK);
+
+	// Nothing is published before the first append
+	assert(mtl_snapshot(mtl_ctx) == 0);
+	assert(mtl_snapshot(NULL) == 0);
+	assert(mtl_authpath_at(mtl_ctx, 0, 0) == NULL);
+	ladder = mtl_ladder_at(mtl_ctx, 0);
+	assert(ladder != NULL);
+	assert(ladder->rung_count == 0);
+	mtl_ladder_free(ladder);
+
+	for (index = 0; index < 4; index++) {
+		tasks[index].ctx = mtl_ctx;
+		tasks[index].values = values;
+		tasks[index].leaf_count = leaf_count;
+		tasks[index].reads = index;
+		assert(pthread_create(&threads[index], NULL,
+				      mtltest_mtl_snapshot_reader,
+				      &tasks[index]) == 0);
+	}
+	for (index = 0; index < leaf_count; index++) {
+		assert(mtl_append(mtl_ctx, values[index % 40], hash_len,
+				  index) == MTL_OK);
+	}
+	for (index = 0; index < 4; index++) {
+		assert(pthread_join(threads[index], NULL) == 0);
+	}
+	assert(mtl_ctx->nodes.retired_count > 0);
+
+	// Older snapshots stay valid, newer ones are refused
+	assert(mtl_snapshot(mtl_ctx) == leaf_count);
+	ladder = mtl_ladder_at(mtl_ctx, 100);
+	assert(ladder != NULL);
+	assert(ladder->rung_count == 3);
+	assert(ladder->rungs[2].right_index == 99);
+	auth = mtl_authpath_at(mtl_ctx, 99, 100);
+	assert(auth != NULL);
+	assert(mtl_verify(mtl_ctx, values[99 % 40], hash_len, auth,
+			  mtl_rung(auth, ladder)) == MTL_OK);
+	mtl_authpath_free(auth);
+	mtl_ladder_free(ladder);
+	assert(mtl_ladder_at(mtl_ctx, leaf_count + 1) == NULL);
+	assert(mtl_authpath_at(mtl_ctx, 0, leaf_count + 1) == NULL);
+	assert(mtl_authpath_at(NULL, 0, 1) == NULL);
+
+	assert(mtl_free(mtl_ctx) == MTL_OK);
+
+	return 0;
+}
+
 uint8_t mtltest_mtl_rung(void)
 {
 	MTL_CTX *mtl_ctx = NULL;
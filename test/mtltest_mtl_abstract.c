@@ -31,6 +31,7 @@
 	POSSIBILITY OF SUCH DAMAGE.
 */
 #include <config.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
@@ -47,6 +48,9 @@ uint8_t mtltest_mtl_generate_randomizer(void);
 uint8_t mtltest_mtl_get_scheme_separated_buffer(void);
 uint8_t mtltest_mtl_hash_and_append(void);
 uint8_t mtltest_mtl_hash_and_append_random(void);
+uint8_t mtltest_mtl_hash_and_append_batch(void);
+uint8_t mtltest_mtl_reserve_and_commit(void);
+uint8_t mtltest_mtl_reserve_threads(void);
 uint8_t mtltest_mtl_hash_and_verify(void);
 uint8_t mtltest_mtl_hash_and_verify_random(void);
 uint8_t mtltest_mtl_randomizer_and_authpath(void);
@@ -63,6 +67,12 @@ uint8_t mtltest_mtl_abstract(void)
 	RUN_TEST(mtltest_mtl_hash_and_append, "Test MTL hash and append");
 	RUN_TEST(mtltest_mtl_hash_and_append_random,
 		 "Test MTL hash and append w/randomization");
+	RUN_TEST(mtltest_mtl_hash_and_append_batch,
+		 "Test MTL hash and append of a batch of messages");
+	RUN_TEST(mtltest_mtl_reserve_and_commit,
+		 "Test MTL leaf reservation and in order commit");
+	RUN_TEST(mtltest_mtl_reserve_threads,
+		 "Test MTL leaf reservation from several threads");
 	RUN_TEST(mtltest_mtl_hash_and_verify, "Test MTL hash and verify");
 	RUN_TEST(mtltest_mtl_hash_and_verify_random,
 		 "Test MTL hash and verify w/randomization");
@@ -217,7 +227,7 @@ uint8_t mtltest_mtl_hash_and_append(void)
 	assert(mtl_ctx->nodes.leaf_count == 16);
 	assert(mtl_ctx->nodes.hash_size == 32);
 	assert(mtl_ctx->nodes.tree_pages[0] != NULL);
-	assert(mtl_ctx->nodes.tree_pages[1] == NULL);
+	assert(mtl_ctx->nodes.tree_page_count == 1);
 
 	// Verify NULL parameters
 	assert(mtl_hash_and_append
@@ -234,6 +244,367 @@ uint8_t mtltest_mtl_hash_and_append(void)
 	return 0;
 }
 
+/**
+ * Verify batch message hashing and appending.
+ */
+uint8_t mtltest_mtl_hash_and_append_batch(void)
+{
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *single_ctx = NULL;
+	MTL_CTX *batch_ctx = NULL;
+	char message_buffer[20][32];
+	uint8_t *messages[20];
+	uint32_t message_lens[20];
+	uint32_t node_ids[20];
+	uint32_t index, added_index;
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	uint64_t tree_len;
+	static const SPX_PARAMS params;
+
+	memset(&sid, 0, sizeof(SERIESID));
+	sid.length = 8;
+
+	memset(&pk_seed, 0, sizeof(SEED));
+	pk_seed.length = 32;
+	memset(pk_seed.seed, 0x55, 32);
+
+	assert(mtl_initns(&single_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(single_ctx, (void*)&params, 0,
+					mtl_test_hash_msg,
+					mtl_test_hash_leaf,
+					mtl_test_hash_node, NULL) == MTL_OK);
+	assert(mtl_initns(&batch_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(batch_ctx, (void*)&params, 0,
+					mtl_test_hash_msg,
+					mtl_test_hash_leaf,
+					mtl_test_hash_node, NULL) == MTL_OK);
+
+	for (index = 0; index < 20; index++) {
+		sprintf(message_buffer[index], "Verification Msg %d\n", index);
+		messages[index] = (uint8_t *) message_buffer[index];
+		message_lens[index] = strlen(message_buffer[index]);
+		assert(mtl_hash_and_append(single_ctx, messages[index],
+					   message_lens[index], &added_index) == MTL_OK);
+	}
+
+	// Append in two batches and compare with single appends
+	assert(mtl_hash_and_append_batch(batch_ctx, messages, message_lens, 7,
+					 node_ids) == MTL_OK);
+	assert(mtl_hash_and_append_batch(batch_ctx, &messages[7], &message_lens[7],
+					 13, &node_ids[7]) == MTL_OK);
+	for (index = 0; index < 20; index++) {
+		assert(node_ids[index] == index);
+	}
+	assert(batch_ctx->nodes.leaf_count == 20);
+
+	tree_len = mtl_node_set_node_count(20) * 32;
+	expected = malloc(tree_len);
+	actual = malloc(tree_len);
+	assert(mtl_node_set_export(&single_ctx->nodes, expected, NULL) == MTL_OK);
+	assert(mtl_node_set_export(&batch_ctx->nodes, actual, NULL) == MTL_OK);
+	assert(memcmp(actual, expected, tree_len) == 0);
+	free(expected);
+	free(actual);
+
+	// Verify NULL parameters
+	assert(mtl_hash_and_append_batch(NULL, messages, message_lens, 1,
+					 node_ids) == MTL_NULL_PTR);
+	assert(mtl_hash_and_append_batch(batch_ctx, NULL, message_lens, 1,
+					 node_ids) == MTL_NULL_PTR);
+	assert(mtl_hash_and_append_batch(batch_ctx, messages, NULL, 1,
+					 node_ids) == MTL_NULL_PTR);
+	assert(mtl_hash_and_append_batch(batch_ctx, messages, message_lens, 0,
+					 node_ids) == MTL_NULL_PTR);
+	assert(mtl_hash_and_append_batch(batch_ctx, messages, message_lens, 1,
+					 NULL) == MTL_NULL_PTR);
+
+	assert(mtl_free(single_ctx) == MTL_OK);
+	assert(mtl_free(batch_ctx) == MTL_OK);
+
+	return 0;
+}
+
+/**
+ * Verify reserved leaves are committed in order when they are
+ * hashed out of order, and that given up leaves are filled.
+ */
+uint8_t mtltest_mtl_reserve_and_commit(void)
+{
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *single_ctx = NULL;
+	MTL_CTX *reserve_ctx = NULL;
+	char message_buffer[8][32];
+	uint32_t leaf_ids[8];
+	uint32_t index, added_index;
+	uint8_t *batch[2];
+	uint32_t batch_lens[2];
+	uint16_t value_lens[2] = { 32, 32 };
+	RANDOMIZER *mtl_rand;
+	AUTHPATH *auth;
+	LADDER *ladder;
+	uint64_t leaf_count;
+	uint8_t zero_data[32];
+	uint8_t filler[32];
+	uint8_t *hash = NULL;
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	uint64_t tree_len;
+	static const SPX_PARAMS params;
+
+	memset(&sid, 0, sizeof(SERIESID));
+	sid.length = 8;
+
+	memset(&pk_seed, 0, sizeof(SEED));
+	pk_seed.length = 32;
+	memset(pk_seed.seed, 0x55, 32);
+
+	assert(mtl_initns(&single_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(single_ctx, (void*)&params, 0,
+					mtl_test_hash_msg,
+					mtl_test_hash_leaf,
+					mtl_test_hash_node, NULL) == MTL_OK);
+	assert(mtl_initns(&reserve_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(reserve_ctx, (void*)&params, 0,
+					mtl_test_hash_msg,
+					mtl_test_hash_leaf,
+					mtl_test_hash_node, NULL) == MTL_OK);
+
+	for (index = 0; index < 8; index++) {
+		sprintf(message_buffer[index], "Verification Msg %d\n", index);
+		assert(mtl_hash_and_append(single_ctx,
+					   (uint8_t *) message_buffer[index],
+					   strlen(message_buffer[index]),
+					   &added_index) == MTL_OK);
+		assert(mtl_reserve(reserve_ctx, &leaf_ids[index]) == MTL_OK);
+		assert(leaf_ids[index] == index);
+	}
+	assert(reserve_ctx->nodes.leaf_count == 8);
+
+	// Hash the leaves newest first, nothing commits until leaf 0 is done
+	for (index = 8; index > 0; index--) {
+		assert(mtl_hash_reserved(reserve_ctx, leaf_ids[index - 1],
+					 (uint8_t *) message_buffer[index - 1],
+					 strlen(message_buffer[index - 1]))
+		       == MTL_OK);
+		assert(mtl_commit(reserve_ctx, &leaf_count) == MTL_OK);
+		assert(leaf_count == ((index == 1) ? 8 : 0));
+	}
+	assert(reserve_ctx->pending.leaf_count == 0);
+	assert(reserve_ctx->pending.first_leaf == 8);
+
+	tree_len = mtl_node_set_node_count(8) * 32;
+	expected = malloc(tree_len);
+	actual = malloc(tree_len);
+	assert(mtl_node_set_export(&single_ctx->nodes, expected, NULL) == MTL_OK);
+	assert(mtl_node_set_export(&reserve_ctx->nodes, actual, NULL) == MTL_OK);
+	assert(memcmp(actual, expected, tree_len) == 0);
+	free(expected);
+	free(actual);
+
+	// The newest reservation is handed back when it is released
+	assert(mtl_reserve(reserve_ctx, &added_index) == MTL_OK);
+	assert(added_index == 8);
+	assert(mtl_release(reserve_ctx, added_index) == MTL_OK);
+	assert(reserve_ctx->nodes.leaf_count == 8);
+	assert(mtl_release(reserve_ctx, added_index) == MTL_BAD_PARAM);
+
+	// Any other released leaf is committed as a filler leaf
+	assert(mtl_reserve(reserve_ctx, &leaf_ids[0]) == MTL_OK);
+	assert(mtl_reserve(reserve_ctx, &leaf_ids[1]) == MTL_OK);
+	assert(mtl_hash_reserved(reserve_ctx, leaf_ids[1],
+				 (uint8_t *) message_buffer[1],
+				 strlen(message_buffer[1])) == MTL_OK);
+	assert(mtl_hash_reserved(reserve_ctx, leaf_ids[1],
+				 (uint8_t *) message_buffer[1],
+				 strlen(message_buffer[1])) == MTL_BAD_PARAM);
+	assert(mtl_release(reserve_ctx, leaf_ids[0]) == MTL_OK);
+	assert(reserve_ctx->nodes.leaf_count == 10);
+	assert(mtl_commit(reserve_ctx, &leaf_count) == MTL_OK);
+	assert(leaf_count == 10);
+
+	memset(zero_data, 0, sizeof(zero_data));
+	assert(mtl_test_hash_leaf(NULL, &sid, 8, zero_data, 32, filler, 32) == 0);
+	assert(mtl_node_set_fetch(&reserve_ctx->nodes, 8, 8, &hash) == MTL_OK);
+	assert(memcmp(hash, filler, 32) == 0);
+	free(hash);
+
+	// Committed or never reserved leaves are not pending
+	assert(mtl_hash_reserved(reserve_ctx, 3, (uint8_t *) message_buffer[3],
+				 strlen(message_buffer[3])) == MTL_BAD_PARAM);
+	assert(mtl_hash_reserved(reserve_ctx, 12, (uint8_t *) message_buffer[3],
+				 strlen(message_buffer[3])) == MTL_BAD_PARAM);
+	assert(mtl_release(reserve_ctx, 12) == MTL_BAD_PARAM);
+
+	// A batch appended while a leaf is reserved goes after it
+	assert(mtl_reserve(reserve_ctx, &added_index) == MTL_OK);
+	assert(added_index == 10);
+	batch[0] = (uint8_t *) message_buffer[4];
+	batch[1] = (uint8_t *) message_buffer[5];
+	batch_lens[0] = strlen(message_buffer[4]);
+	batch_lens[1] = strlen(message_buffer[5]);
+	assert(mtl_append_batch(reserve_ctx, batch, value_lens, 2) == MTL_ERROR);
+	assert(mtl_hash_and_append_batch(reserve_ctx, batch, batch_lens, 2,
+					 leaf_ids) == MTL_OK);
+	assert(leaf_ids[0] == 11);
+	assert(leaf_ids[1] == 12);
+	assert(mtl_snapshot(reserve_ctx) == 10);
+	assert(mtl_hash_reserved(reserve_ctx, added_index,
+				 (uint8_t *) message_buffer[3],
+				 strlen(message_buffer[3])) == MTL_OK);
+	assert(mtl_commit(reserve_ctx, &leaf_count) == MTL_OK);
+	assert(leaf_count == 13);
+	ladder = mtl_ladder(reserve_ctx);
+	for (index = 10; index < 13; index++) {
+		assert(mtl_randomizer_and_authpath(reserve_ctx, index, &mtl_rand,
+						   &auth) == MTL_OK);
+		assert(mtl_hash_and_verify(reserve_ctx,
+					   (uint8_t *) message_buffer[index - 7],
+					   strlen(message_buffer[index - 7]),
+					   mtl_rand, auth,
+					   mtl_rung(auth, ladder)) == MTL_OK);
+		assert(mtl_authpath_free(auth) == MTL_OK);
+		assert(mtl_randomizer_free(mtl_rand) == MTL_OK);
+	}
+	assert(mtl_ladder_free(ladder) == MTL_OK);
+
+	// A leaf that fails to commit stays pending and is retried
+	assert(mtl_reserve(reserve_ctx, &added_index) == MTL_OK);
+	assert(reserve_ctx->pending.leaf_count == 1);
+	assert(mtl_hash_reserved(reserve_ctx, added_index, NULL, 0) ==
+	       MTL_NULL_PTR);
+	reserve_ctx->hash_leaf = NULL;
+	assert(mtl_commit(reserve_ctx, &leaf_count) == MTL_ERROR);
+	assert(leaf_count == 13);
+	assert(reserve_ctx->pending.leaf_count == 1);
+	assert(reserve_ctx->pending.first_leaf == 13);
+	reserve_ctx->hash_leaf = mtl_test_hash_leaf;
+	assert(mtl_commit(reserve_ctx, &leaf_count) == MTL_OK);
+	assert(leaf_count == 14);
+	assert(reserve_ctx->pending.leaf_count == 0);
+	assert(reserve_ctx->pending.first_leaf == 14);
+
+	// A full node set has nothing to reserve
+	mtl_node_set_set_leaf_count(&reserve_ctx->nodes,
+				    (uint64_t)MTL_NODE_SET_MAX_LEAF + 1);
+	assert(mtl_reserve(reserve_ctx, &added_index) == MTL_BAD_PARAM);
+	mtl_node_set_set_leaf_count(&reserve_ctx->nodes, 10);
+
+	// Verify NULL parameters
+	assert(mtl_reserve(NULL, &added_index) == MTL_NULL_PTR);
+	assert(mtl_reserve(reserve_ctx, NULL) == MTL_NULL_PTR);
+	assert(mtl_hash_reserved(NULL, 0, (uint8_t *) message_buffer[0],
+				 strlen(message_buffer[0])) == MTL_NULL_PTR);
+	assert(mtl_release(NULL, 0) == MTL_NULL_PTR);
+	assert(mtl_commit(NULL, &leaf_count) == MTL_NULL_PTR);
+
+	assert(mtl_free(single_ctx) == MTL_OK);
+	assert(mtl_free(reserve_ctx) == MTL_OK);
+
+	return 0;
+}
+
+/** Number of leaves each producer thread appends */
+#define MTLTEST_PRODUCER_LEAVES 50
+
+/**
+ * Reserve, hash and commit leaves from a producer thread
+ */
+static void *mtltest_mtl_reserve_producer(void *arg)
+{
+	MTL_CTX *ctx = (MTL_CTX *) arg;
+	char message_buffer[32];
+	uint32_t leaf_index;
+	uint32_t index;
+
+	for (index = 0; index < MTLTEST_PRODUCER_LEAVES; index++) {
+		assert(mtl_reserve(ctx, &leaf_index) == MTL_OK);
+		// The message depends on the leaf so the tree is deterministic
+		sprintf(message_buffer, "Verification Msg %d\n", leaf_index);
+		assert(mtl_hash_reserved(ctx, leaf_index,
+					 (uint8_t *) message_buffer,
+					 strlen(message_buffer)) == MTL_OK);
+		assert(mtl_commit(ctx, NULL) == MTL_OK);
+	}
+	return NULL;
+}
+
+/**
+ * Verify several threads appending through reservations build the
+ * same tree as sequential appends.
+ */
+uint8_t mtltest_mtl_reserve_threads(void)
+{
+	SEED pk_seed;
+	SERIESID sid;
+	MTL_CTX *single_ctx = NULL;
+	MTL_CTX *reserve_ctx = NULL;
+	pthread_t producers[4];
+	char message_buffer[32];
+	uint32_t index, added_index;
+	uint32_t leaves = 4 * MTLTEST_PRODUCER_LEAVES;
+	uint64_t leaf_count;
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	uint64_t tree_len;
+	static const SPX_PARAMS params;
+
+	memset(&sid, 0, sizeof(SERIESID));
+	sid.length = 8;
+
+	memset(&pk_seed, 0, sizeof(SEED));
+	pk_seed.length = 32;
+	memset(pk_seed.seed, 0x55, 32);
+
+	assert(mtl_initns(&single_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(single_ctx, (void*)&params, 0,
+					mtl_test_hash_msg,
+					mtl_test_hash_leaf,
+					mtl_test_hash_node, NULL) == MTL_OK);
+	assert(mtl_initns(&reserve_ctx, &pk_seed, &sid, NULL) == MTL_OK);
+	assert(mtl_set_scheme_functions(reserve_ctx, (void*)&params, 0,
+					mtl_test_hash_msg,
+					mtl_test_hash_leaf,
+					mtl_test_hash_node, NULL) == MTL_OK);
+
+	for (index = 0; index < leaves; index++) {
+		sprintf(message_buffer, "Verification Msg %d\n", index);
+		assert(mtl_hash_and_append(single_ctx, (uint8_t *) message_buffer,
+					   strlen(message_buffer),
+					   &added_index) == MTL_OK);
+	}
+
+	for (index = 0; index < 4; index++) {
+		assert(pthread_create(&producers[index], NULL,
+				      mtltest_mtl_reserve_producer,
+				      reserve_ctx) == 0);
+	}
+	for (index = 0; index < 4; index++) {
+		assert(pthread_join(producers[index], NULL) == 0);
+	}
+
+	// Every leaf was committed by whichever producer got there first
+	assert(mtl_commit(reserve_ctx, &leaf_count) == MTL_OK);
+	assert(leaf_count == leaves);
+	assert(reserve_ctx->nodes.leaf_count == leaves);
+
+	tree_len = mtl_node_set_node_count(leaves) * 32;
+	expected = malloc(tree_len);
+	actual = malloc(tree_len);
+	assert(mtl_node_set_export(&single_ctx->nodes, expected, NULL) == MTL_OK);
+	assert(mtl_node_set_export(&reserve_ctx->nodes, actual, NULL) == MTL_OK);
+	assert(memcmp(actual, expected, tree_len) == 0);
+	free(expected);
+	free(actual);
+
+	assert(mtl_free(single_ctx) == MTL_OK);
+	assert(mtl_free(reserve_ctx) == MTL_OK);
+
+	return 0;
+}
+
 /**
  * Verify message hashing and appending w/random.
  */
@@ -273,7 +644,7 @@ uint8_t mtltest_mtl_hash_and_append_random(void)
 	assert(mtl_ctx->nodes.leaf_count == 16);
 	assert(mtl_ctx->nodes.hash_size == 32);
 	assert(mtl_ctx->nodes.tree_pages[0] != NULL);
-	assert(mtl_ctx->nodes.tree_pages[1] == NULL);
+	assert(mtl_ctx->nodes.tree_page_count == 1);
 
 	// Verify NULL parameters
 	assert(mtl_hash_and_append
@@ -45,6 +45,12 @@ uint8_t mtltest_mtl_node_set_init(void);
 uint8_t mtltest_mtl_node_set_init_null(void);
 uint8_t mtltest_mtl_node_set_insert(void);
 uint8_t mtltest_mtl_node_set_fetch(void);
+uint8_t mtltest_mtl_node_set_fetch_ref(void);
+uint8_t mtltest_mtl_node_set_geometry(void);
+uint8_t mtltest_mtl_node_set_import_export(void);
+uint8_t mtltest_mtl_node_set_layout(void);
+uint8_t mtltest_mtl_node_set_last_leaf(void);
+uint8_t mtltest_mtl_node_set_publish(void);
 uint8_t mtltest_mtl_node_set_get_randomizer(void);
 uint8_t mtltest_mtl_node_set_get_randomizer_null(void);
 uint8_t mtltest_mtl_node_set_maximum(void);
@@ -72,6 +78,18 @@ uint8_t mtltest_mtl_node_set(void)
 		 "Verify node set insert operations");
 	RUN_TEST(mtltest_mtl_node_set_fetch,
 		 "Verify node set fetch operations");
+	RUN_TEST(mtltest_mtl_node_set_fetch_ref,
+		 "Verify node set fetch by reference operations");
+	RUN_TEST(mtltest_mtl_node_set_geometry,
+		 "Verify node set page geometry selection");
+	RUN_TEST(mtltest_mtl_node_set_import_export,
+		 "Verify node set bulk import and export");
+	RUN_TEST(mtltest_mtl_node_set_layout,
+		 "Verify node set blocked page layout");
+	RUN_TEST(mtltest_mtl_node_set_last_leaf,
+		 "Verify node set operations on the last leaf index");
+	RUN_TEST(mtltest_mtl_node_set_publish,
+		 "Verify node set leaf counts published to readers");
 	RUN_TEST(mtltest_mtl_node_set_get_randomizer,
 		 "Verify randomizer fetch operations");
 	RUN_TEST(mtltest_mtl_node_set_get_randomizer_null,
@@ -93,7 +111,6 @@ uint8_t mtltest_mtl_node_set_init(void)
 {
 	SEED seed;
 	MTLNODES nodes;
-	uint32_t index;
 	SERIESID sid;
 	uint8_t sid_val[] = { 0x28, 0xe7, 0x56, 0xf0, 0xb4, 0x61, 0xf6, 0x79 };
 	uint8_t seed_val[] = { 0x66, 0x87, 0x0c, 0x58, 0x1e, 0x05, 0x1e, 0x75,
@@ -113,9 +130,8 @@ uint8_t mtltest_mtl_node_set_init(void)
 	assert(nodes.hash_size == seed.length);
 	assert(nodes.tree_page_size == MTL_TREE_PAGE_SIZE);
 
-	for (index = 0; index < MTL_TREE_MAX_PAGES; index++) {
-		assert(nodes.tree_pages[index] == NULL);
-	}
+	assert(nodes.tree_pages == NULL);
+	assert(nodes.tree_page_count == 0);
 
 	// Cleanup and verify clean up works
 	mtl_node_set_free(&nodes);
@@ -123,9 +139,8 @@ uint8_t mtltest_mtl_node_set_init(void)
 	assert(nodes.hash_size == 0);
 	assert(nodes.tree_page_size == 0);
 
-	for (index = 0; index < MTL_TREE_MAX_PAGES; index++) {
-		assert(nodes.tree_pages[index] == NULL);
-	}
+	assert(nodes.tree_pages == NULL);
+	assert(nodes.tree_page_count == 0);
 
 	mtl_node_set_free(&nodes);
 
@@ -197,7 +212,7 @@ uint8_t mtltest_mtl_node_set_insert(void)
 
 	assert(nodes.leaf_count == 0);
 	assert(nodes.hash_size == seed.length);
-	assert(nodes.tree_pages[0] == NULL);
+	assert(nodes.tree_page_count == 0);
 	nodes.tree_page_size = test_page_size * hash_len;
 
 	// Insert the first node
@@ -211,7 +226,7 @@ uint8_t mtltest_mtl_node_set_insert(void)
 			reverse_map_right[node_index], buffer) == MTL_OK);
 		// Test correct pages added
 		assert(nodes.tree_pages[0] != NULL);
-		for (page_index = 1; page_index < MTL_TREE_MAX_PAGES; page_index++) {
+		for (page_index = 1; page_index < nodes.tree_page_count; page_index++) {
 			assert(nodes.tree_pages[page_index] == NULL);
 		}
 	}
@@ -225,7 +240,7 @@ uint8_t mtltest_mtl_node_set_insert(void)
 		// Test correct pages added
 		assert(nodes.tree_pages[0] != NULL);
 		assert(nodes.tree_pages[1] != NULL);
-		for (page_index = 2; page_index < MTL_TREE_MAX_PAGES; page_index++) {
+		for (page_index = 2; page_index < nodes.tree_page_count; page_index++) {
 			assert(nodes.tree_pages[page_index] == NULL);
 		}
 	}
@@ -239,7 +254,7 @@ uint8_t mtltest_mtl_node_set_insert(void)
 		assert(nodes.tree_pages[0] != NULL);
 		assert(nodes.tree_pages[1] != NULL);
 		assert(nodes.tree_pages[2] != NULL);
-		for (page_index = 3; page_index < MTL_TREE_MAX_PAGES; page_index++) {
+		for (page_index = 3; page_index < nodes.tree_page_count; page_index++) {
 			assert(nodes.tree_pages[page_index] == NULL);
 		}
 	}
@@ -250,9 +265,8 @@ uint8_t mtltest_mtl_node_set_insert(void)
 	assert(nodes.hash_size == 0);
 	assert(nodes.tree_page_size == 0);
 
-	for (page_index = 0; page_index < MTL_TREE_MAX_PAGES; page_index++) {
-		assert(nodes.tree_pages[page_index] == NULL);
-	}
+	assert(nodes.tree_pages == NULL);
+	assert(nodes.tree_page_count == 0);
 
 	mtl_node_set_free(&nodes);
 
@@ -287,7 +301,7 @@ uint8_t mtltest_mtl_node_set_fetch(void)
 
 	assert(nodes.leaf_count == 0);
 	assert(nodes.hash_size == seed.length);
-	assert(nodes.tree_pages[0] == NULL);
+	assert(nodes.tree_page_count == 0);
 	nodes.tree_page_size = 8 * hash_len;
 
 	// Insert test nodes
@@ -320,15 +334,497 @@ uint8_t mtltest_mtl_node_set_fetch(void)
 	assert(nodes.hash_size == 0);
 	assert(nodes.tree_page_size == 0);
 
-	for (index = 0; index < MTL_TREE_MAX_PAGES; index++) {
-		assert(nodes.tree_pages[index] == NULL);
+	assert(nodes.tree_pages == NULL);
+	assert(nodes.tree_page_count == 0);
+
+	mtl_node_set_free(&nodes);
+
+	return 0;
+}
+
+/**
+ * Test the mtl node set fetch by reference functions
+ */
+uint8_t mtltest_mtl_node_set_fetch_ref(void)
+{
+	SEED seed;
+	SERIESID sid;
+	MTLNODES nodes;
+	uint32_t index;
+	uint8_t buffer[32];
+	uint8_t random[32];
+	const uint8_t *hash;
+	uint8_t *hash_copy;
+	uint32_t hash_len = 32;
+	uint8_t sid_val[] = { 0x28, 0xe7, 0x56, 0xf0, 0xb4, 0x61, 0xf6, 0x79 };
+	uint8_t seed_val[] = { 0x66, 0x87, 0x0c, 0x58, 0x1e, 0x05, 0x1e, 0x75,
+		0x06, 0xb5, 0x59, 0x89, 0x75, 0x08, 0xe7, 0x2c,
+		0x03, 0x69, 0x6e, 0x98, 0x22, 0x87, 0x08, 0xe2,
+		0xf1, 0x85, 0xb2, 0xe5, 0x60, 0xbf, 0xaa, 0x46
+	};
+
+	seed.length = hash_len;
+	memcpy(seed.seed, seed_val, seed.length);
+	sid.length = 8;
+	memcpy(sid.id, sid_val, sid.length);
+
+	mtl_node_set_init(&nodes, &seed, &sid);
+	nodes.tree_page_size = 8 * hash_len;
+
+	// Fetching nodes not yet inserted should fail
+	assert(mtl_node_set_fetch_ref(&nodes, 0, 0, &hash) == MTL_ERROR);
+	assert(mtl_node_set_get_randomizer_ref(&nodes, 0, &hash) == MTL_ERROR);
+
+	for (index = 0; index < 20; index++) {
+		memset(buffer, 0xff - index, hash_len);
+		memset(random, index + 1, hash_len);
+		assert(mtl_node_set_insert(&nodes, index, index, buffer)
+		       == MTL_OK);
+		assert(mtl_node_set_insert_randomizer(&nodes, index, random)
+		       == MTL_OK);
+	}
+
+	// References match the inserted values and the copying API
+	for (index = 0; index < 20; index++) {
+		memset(buffer, 0xff - index, hash_len);
+		assert(mtl_node_set_fetch_ref(&nodes, index, index, &hash)
+		       == MTL_OK);
+		assert(memcmp(buffer, hash, hash_len) == 0);
+		assert(mtl_node_set_fetch(&nodes, index, index, &hash_copy)
+		       == MTL_OK);
+		assert(hash_copy != hash);
+		assert(memcmp(hash_copy, hash, hash_len) == 0);
+		free(hash_copy);
+
+		memset(random, index + 1, hash_len);
+		assert(mtl_node_set_get_randomizer_ref(&nodes, index, &hash)
+		       == MTL_OK);
+		assert(memcmp(random, hash, hash_len) == 0);
 	}
 
+	// References point into the node set so updates are visible
+	assert(mtl_node_set_fetch_ref(&nodes, 3, 3, &hash) == MTL_OK);
+	memset(buffer, 0x5a, hash_len);
+	assert(mtl_node_set_insert(&nodes, 3, 3, buffer) == MTL_OK);
+	assert(memcmp(buffer, hash, hash_len) == 0);
+
+	// Invalid nodes and parameters
+	assert(mtl_node_set_fetch_ref(&nodes, 30, 30, &hash) == MTL_ERROR);
+	assert(mtl_node_set_fetch_ref(&nodes, 1, 2, &hash) == MTL_BAD_PARAM);
+	assert(mtl_node_set_fetch_ref(NULL, 0, 0, &hash) == MTL_BAD_PARAM);
+	assert(mtl_node_set_fetch_ref(&nodes, 0, 0, NULL) == MTL_BAD_PARAM);
+	assert(mtl_node_set_get_randomizer_ref(&nodes, 30, &hash) == MTL_ERROR);
+	assert(mtl_node_set_get_randomizer_ref(&nodes, MTL_NODE_SET_MAX_LEAF, &hash) == MTL_ERROR);
+	assert(mtl_node_set_get_randomizer_ref(NULL, 0, &hash) == MTL_BAD_PARAM);
+	assert(mtl_node_set_get_randomizer_ref(&nodes, 0, NULL) == MTL_BAD_PARAM);
+
 	mtl_node_set_free(&nodes);
 
 	return 0;
 }
 
+/**
+ * Test the mtl node set page geometry selection
+ */
+uint8_t mtltest_mtl_node_set_geometry(void)
+{
+	SEED seed;
+	SERIESID sid;
+	MTLNODES nodes;
+	uint32_t index;
+	uint8_t buffer[24];
+	uint8_t *page = NULL;
+	const uint8_t *hash;
+	uint32_t hash_len = 24;
+
+	memset(seed.seed, 0x5a, hash_len);
+	seed.length = hash_len;
+	sid.length = 0;
+
+	mtl_node_set_init(&nodes, &seed, &sid);
+	assert(nodes.tree_page_size == MTL_TREE_PAGE_SIZE - (MTL_TREE_PAGE_SIZE % hash_len));
+	assert(nodes.max_pages == MTL_TREE_MAX_PAGES);
+
+	// Invalid geometry is rejected
+	assert(mtl_node_set_set_geometry(NULL, 0, 0) == MTL_NULL_PTR);
+	assert(mtl_node_set_set_geometry(&nodes, hash_len - 1, 0) == MTL_BAD_PARAM);
+
+	// Pages are rounded down to hold whole hashes
+	assert(mtl_node_set_set_geometry(&nodes, 100, 3) == MTL_OK);
+	assert(nodes.tree_page_size == 96);
+	assert(nodes.max_pages == 3);
+
+	// Directories grow as needed up to the page limit (4 nodes per page)
+	for (index = 0; index < 6; index++) {
+		memset(buffer, index, hash_len);
+		assert(mtl_node_set_insert(&nodes, index, index, buffer) == MTL_OK);
+		assert(mtl_node_set_insert_randomizer(&nodes, index, buffer) == MTL_OK);
+	}
+	assert(nodes.tree_page_count == 3);
+	assert(nodes.randomizer_page_count == 2);
+	memset(buffer, 8, hash_len);
+	assert(mtl_node_set_insert(&nodes, 8, 8, buffer) == MTL_BAD_PARAM);
+	assert(mtl_node_set_alloc_page(&nodes, 3, 0, &page) == MTL_BAD_PARAM);
+	assert(mtl_node_set_alloc_page(&nodes, 2, 1, &page) == MTL_OK);
+	assert(page == nodes.randomizer_pages[2]);
+	assert(nodes.randomizer_page_count == 3);
+
+	// Nodes at the end of a page do not spill into the next page
+	for (index = 0; index < 6; index++) {
+		memset(buffer, index, hash_len);
+		assert(mtl_node_set_fetch_ref(&nodes, index, index, &hash) == MTL_OK);
+		assert(memcmp(hash, buffer, hash_len) == 0);
+	}
+
+	// Geometry can not change once nodes are in the set
+	assert(mtl_node_set_set_geometry(&nodes, 0, 0) == MTL_ERROR);
+
+	mtl_node_set_free(&nodes);
+	assert(nodes.tree_pages == NULL);
+	assert(nodes.randomizer_pages == NULL);
+	assert(nodes.max_pages == 0);
+
+	// A directory past 2^31 pages is clamped to the limit, not wrapped
+	// (sanitizer allocators abort on the 32GB request instead of failing)
+#if !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+	mtl_node_set_init(&nodes, &seed, &sid);
+	assert(mtl_node_set_set_geometry(&nodes, hash_len, 0xFFFFFFFF) == MTL_OK);
+	MTLSTATUS status = mtl_node_set_alloc_page(&nodes, 0x80000001, 0, &page);
+	assert((status == MTL_OK) || (status == MTL_RESOURCE_FAIL));
+	if (status == MTL_OK) {
+		assert(nodes.tree_page_count == 0xFFFFFFFF);
+	}
+	mtl_node_set_free(&nodes);
+#endif
+
+	return 0;
+}
+
+/**
+ * Test the mtl node set bulk import and export
+ */
+uint8_t mtltest_mtl_node_set_import_export(void)
+{
+	SEED seed;
+	SERIESID sid;
+	MTLNODES nodes;
+	MTLNODES copy;
+	uint32_t index;
+	uint8_t tree[20 * 16];
+	uint8_t randomizers[11 * 16];
+	uint8_t tree_copy[20 * 16];
+	uint8_t randomizers_copy[11 * 16];
+	uint8_t buffer[16];
+	const uint8_t *hash;
+	uint32_t hash_len = 16;
+
+	memset(seed.seed, 0x3c, hash_len);
+	seed.length = hash_len;
+	sid.length = 0;
+
+	assert(mtl_node_set_node_count(0) == 0);
+	assert(mtl_node_set_node_count(1) == 1);
+	assert(mtl_node_set_node_count(8) == 15);
+	assert(mtl_node_set_node_count(11) == 19);
+
+	// Build a node set with every node and randomizer filled in
+	mtl_node_set_init(&nodes, &seed, &sid);
+	assert(mtl_node_set_set_geometry(&nodes, 3 * hash_len, 0) == MTL_OK);
+	for (index = 0; index < mtl_node_set_node_count(11); index++) {
+		memset(&tree[index * hash_len], index + 1, hash_len);
+	}
+	for (index = 0; index < 11; index++) {
+		memset(&randomizers[index * hash_len], 0x80 + index, hash_len);
+	}
+	assert(mtl_node_set_import(&nodes, 11, tree, randomizers) == MTL_OK);
+	assert(nodes.leaf_count == 11);
+	assert(nodes.tree_page_count >= 7);
+	assert(mtl_node_set_import(&nodes, 11, tree, randomizers) == MTL_ERROR);
+
+	// Imported nodes are found by their left/right indices
+	memset(buffer, 15, hash_len);
+	assert(mtl_node_set_fetch_ref(&nodes, 0, 7, &hash) == MTL_OK);
+	assert(memcmp(hash, buffer, hash_len) == 0);
+	memset(buffer, 0x80 + 10, hash_len);
+	assert(mtl_node_set_get_randomizer_ref(&nodes, 10, &hash) == MTL_OK);
+	assert(memcmp(hash, buffer, hash_len) == 0);
+
+	// Export returns exactly what was imported, across page geometries
+	mtl_node_set_init(&copy, &seed, &sid);
+	assert(mtl_node_set_export(&nodes, tree_copy, randomizers_copy) == MTL_OK);
+	assert(memcmp(tree_copy, tree, 19 * hash_len) == 0);
+	assert(memcmp(randomizers_copy, randomizers, 11 * hash_len) == 0);
+	assert(mtl_node_set_import(&copy, 11, tree_copy, NULL) == MTL_OK);
+	assert(copy.randomizer_page_count == 0);
+	memset(tree_copy, 0, sizeof(tree_copy));
+	assert(mtl_node_set_export(&copy, tree_copy, NULL) == MTL_OK);
+	assert(memcmp(tree_copy, tree, 19 * hash_len) == 0);
+
+	// The first leaves export on their own
+	memset(tree_copy, 0, sizeof(tree_copy));
+	memset(randomizers_copy, 0, sizeof(randomizers_copy));
+	assert(mtl_node_set_export_leaves(&nodes, 8, tree_copy,
+					  randomizers_copy) == MTL_OK);
+	assert(memcmp(tree_copy, tree, 15 * hash_len) == 0);
+	assert(memcmp(randomizers_copy, randomizers, 8 * hash_len) == 0);
+	assert(mtl_node_set_export_leaves(&nodes, 12, tree_copy, NULL) ==
+	       MTL_BAD_PARAM);
+
+	// Invalid parameters
+	assert(mtl_node_set_export(NULL, tree_copy, NULL) == MTL_NULL_PTR);
+	assert(mtl_node_set_export(&copy, NULL, NULL) == MTL_NULL_PTR);
+	assert(mtl_node_set_export(&copy, tree_copy, randomizers_copy) == MTL_ERROR);
+	assert(mtl_node_set_import(NULL, 11, tree, NULL) == MTL_NULL_PTR);
+
+	mtl_node_set_free(&copy);
+	mtl_node_set_free(&nodes);
+
+	return 0;
+}
+
+/**
+ * Test the mtl node set blocked page layout
+ */
+uint8_t mtltest_mtl_node_set_layout(void)
+{
+	SEED seed;
+	SERIESID sid;
+	MTLNODES linear;
+	MTLNODES blocked;
+	uint32_t index;
+	uint32_t left;
+	uint32_t right;
+	uint32_t height;
+	uint32_t leaf_count = 37;
+	uint64_t node_count;
+	uint64_t page_count;
+	uint8_t *tree;
+	uint8_t *tree_copy;
+	const uint8_t *hash;
+	const uint8_t *hash_linear;
+	uint32_t hash_len = 24;
+
+	memset(seed.seed, 0x6b, hash_len);
+	seed.length = hash_len;
+	sid.length = 0;
+
+	node_count = mtl_node_set_node_count(leaf_count);
+	tree = malloc(node_count * hash_len);
+	tree_copy = malloc(node_count * hash_len);
+	assert(tree != NULL);
+	assert(tree_copy != NULL);
+	for (index = 0; index < node_count; index++) {
+		memset(&tree[index * hash_len], index + 1, hash_len);
+	}
+
+	// Invalid layouts are rejected
+	mtl_node_set_init(&blocked, &seed, &sid);
+	assert(blocked.layout == MTL_NODE_SET_LAYOUT_LINEAR);
+	assert(blocked.slot_size == hash_len);
+	assert(mtl_node_set_set_layout(NULL, MTL_NODE_SET_LAYOUT_BLOCKED, 0) == MTL_NULL_PTR);
+	assert(mtl_node_set_set_layout(&blocked, 2, 0) == MTL_BAD_PARAM);
+	assert(mtl_node_set_set_layout(&blocked, MTL_NODE_SET_LAYOUT_BLOCKED,
+				       MTL_NODE_SET_MAX_TILE_HEIGHT + 1) == MTL_BAD_PARAM);
+
+	// Default tiles fill a memory page with power of two slots
+	assert(mtl_node_set_set_layout(&blocked, MTL_NODE_SET_LAYOUT_BLOCKED, 0) == MTL_OK);
+	assert(blocked.slot_size == 32);
+	assert(blocked.tile_height == 7);
+
+	// Pages must hold a whole tile (two 256 byte tiles per page here)
+	assert(mtl_node_set_set_layout(&blocked, MTL_NODE_SET_LAYOUT_BLOCKED, 3) == MTL_OK);
+	assert(mtl_node_set_set_geometry(&blocked, 255, 0) == MTL_BAD_PARAM);
+	assert(mtl_node_set_set_geometry(&blocked, 520, 0) == MTL_OK);
+	assert(blocked.tree_page_size == 504);
+
+	// Import and export keep the linear node order
+	assert(mtl_node_set_import(&blocked, leaf_count, tree, NULL) == MTL_OK);
+	assert(blocked.leaf_count == leaf_count);
+	assert(mtl_node_set_export(&blocked, tree_copy, NULL) == MTL_OK);
+	assert(memcmp(tree_copy, tree, node_count * hash_len) == 0);
+	assert(mtl_node_set_set_layout(&blocked, MTL_NODE_SET_LAYOUT_LINEAR, 0) == MTL_ERROR);
+
+	// Tiles in use are a dense prefix of the pages
+	page_count = mtl_node_set_page_count(&blocked, leaf_count);
+	assert(page_count > 0);
+	assert(page_count <= blocked.tree_page_count);
+	for (index = 0; index < blocked.tree_page_count; index++) {
+		assert((blocked.tree_pages[index] != NULL) == (index < page_count));
+		if (index < page_count) {
+			assert(((uintptr_t)blocked.tree_pages[index] %
+				MTL_NODE_SET_CACHE_LINE) == 0);
+		}
+	}
+
+	// Every node matches the linear layout and sits on its own slot
+	mtl_node_set_init(&linear, &seed, &sid);
+	assert(mtl_node_set_import(&linear, leaf_count, tree, NULL) == MTL_OK);
+	assert(mtl_node_set_page_count(&linear, leaf_count) == 1);
+	for (right = 0; right < leaf_count; right++) {
+		for (height = 0; height <= mtl_lsb(right + 1); height++) {
+			left = right + 1 - (1 << height);
+			assert(mtl_node_set_fetch_ref(&blocked, left, right, &hash) == MTL_OK);
+			assert(mtl_node_set_fetch_ref(&linear, left, right, &hash_linear) == MTL_OK);
+			assert(memcmp(hash, hash_linear, hash_len) == 0);
+			assert(((uintptr_t)hash % blocked.slot_size) == 0);
+		}
+	}
+
+	// Inserting past the last leaf grows the set in place
+	memset(tree_copy, 0xee, hash_len);
+	assert(mtl_node_set_insert(&blocked, leaf_count, leaf_count, tree_copy) == MTL_OK);
+	assert(mtl_node_set_fetch_ref(&blocked, leaf_count, leaf_count, &hash) == MTL_OK);
+	assert(memcmp(hash, tree_copy, hash_len) == 0);
+	assert(mtl_node_set_fetch_ref(&blocked, 0, 31, &hash) == MTL_OK);
+	assert(mtl_node_set_fetch_ref(&linear, 0, 31, &hash_linear) == MTL_OK);
+	assert(memcmp(hash, hash_linear, hash_len) == 0);
+
+	mtl_node_set_free(&linear);
+	mtl_node_set_free(&blocked);
+	assert(blocked.layout == MTL_NODE_SET_LAYOUT_LINEAR);
+	free(tree);
+	free(tree_copy);
+
+	return 0;
+}
+
+/**
+ * Test the authentication path of the last leaf in a sparse node set
+ */
+uint8_t mtltest_mtl_node_set_last_leaf(void)
+{
+	SEED seed;
+	SERIESID sid;
+	MTLNODES nodes;
+	uint8_t layout;
+	uint32_t height;
+	uint32_t left;
+	uint32_t right;
+	uint8_t buffer[32];
+	const uint8_t *hash;
+	uint32_t hash_len = 32;
+
+	memset(seed.seed, 0x3c, hash_len);
+	seed.length = hash_len;
+	sid.length = 0;
+
+	for (layout = MTL_NODE_SET_LAYOUT_LINEAR;
+	     layout <= MTL_NODE_SET_LAYOUT_BLOCKED; layout++) {
+		mtl_node_set_init(&nodes, &seed, &sid);
+		assert(mtl_node_set_set_layout(&nodes, layout, 0) == MTL_OK);
+		// Large sparse pages so the directory reaches the last node
+		assert(mtl_node_set_set_geometry(&nodes, 1 << 20, 1 << 20) == MTL_OK);
+
+		// Insert the last leaf and the siblings on its path to the root
+		memset(buffer, 0xa5, hash_len);
+		assert(mtl_node_set_insert(&nodes, MTL_NODE_SET_MAX_LEAF,
+					   MTL_NODE_SET_MAX_LEAF, buffer) == MTL_OK);
+		assert(nodes.leaf_count == (uint64_t)MTL_NODE_SET_MAX_LEAF + 1);
+		for (height = 0; height < 32; height++) {
+			left = (uint32_t)(((uint64_t)MTL_NODE_SET_MAX_LEAF + 1) -
+					  ((uint64_t)2 << height));
+			right = left + ((uint32_t)1 << height) - 1;
+			memset(buffer, height, hash_len);
+			assert(mtl_node_set_insert(&nodes, left, right, buffer) == MTL_OK);
+		}
+		assert(nodes.leaf_count == (uint64_t)MTL_NODE_SET_MAX_LEAF + 1);
+
+		// Read the path back
+		assert(mtl_node_set_fetch_ref(&nodes, MTL_NODE_SET_MAX_LEAF,
+					      MTL_NODE_SET_MAX_LEAF, &hash) == MTL_OK);
+		memset(buffer, 0xa5, hash_len);
+		assert(memcmp(hash, buffer, hash_len) == 0);
+		for (height = 0; height < 32; height++) {
+			left = (uint32_t)(((uint64_t)MTL_NODE_SET_MAX_LEAF + 1) -
+					  ((uint64_t)2 << height));
+			right = left + ((uint32_t)1 << height) - 1;
+			assert(mtl_node_set_fetch_ref(&nodes, left, right, &hash) == MTL_OK);
+			memset(buffer, height, hash_len);
+			assert(memcmp(hash, buffer, hash_len) == 0);
+		}
+
+		// Pages that were never written are not allocated
+		assert(mtl_node_set_fetch_ref(&nodes, 0, 0, &hash) != MTL_OK);
+		assert(mtl_node_set_page_count(&nodes, nodes.leaf_count) <= nodes.max_pages);
+
+		mtl_node_set_free(&nodes);
+	}
+
+	return 0;
+}
+
+/**
+ * Test publishing leaf counts and retiring page directories
+ */
+uint8_t mtltest_mtl_node_set_publish(void)
+{
+	SEED seed;
+	SERIESID sid;
+	MTLNODES nodes;
+	uint32_t index;
+	uint8_t buffer[32];
+	uint8_t **directory;
+	const uint8_t *hash;
+	const uint8_t *first_hash;
+	const uint8_t *first_rand;
+	uint32_t hash_len = 32;
+
+	memset(seed.seed, 0x27, hash_len);
+	seed.length = hash_len;
+	sid.length = 0;
+
+	mtl_node_set_init(&nodes, &seed, &sid);
+	assert(mtl_node_set_published(NULL) == 0);
+	assert(mtl_node_set_published(&nodes) == 0);
+	assert(nodes.retired_count == 0);
+
+	// One node per page so the directories grow on most inserts
+	assert(mtl_node_set_set_geometry(&nodes, hash_len, 0) == MTL_OK);
+	memset(buffer, 0x11, hash_len);
+	assert(mtl_node_set_insert(&nodes, 0, 0, buffer) == MTL_OK);
+	assert(mtl_node_set_insert_randomizer(&nodes, 0, buffer) == MTL_OK);
+	assert(mtl_node_set_fetch_ref(&nodes, 0, 0, &first_hash) == MTL_OK);
+	assert(mtl_node_set_get_randomizer_ref(&nodes, 0, &first_rand) == MTL_OK);
+	directory = nodes.tree_pages;
+
+	// Inserting does not publish, the writer decides when leaves are done
+	for (index = 1; index < 40; index++) {
+		memset(buffer, index, hash_len);
+		assert(mtl_node_set_insert(&nodes, index, index, buffer) == MTL_OK);
+		assert(mtl_node_set_insert_randomizer(&nodes, index, buffer) == MTL_OK);
+	}
+	assert(nodes.leaf_count == 40);
+	assert(mtl_node_set_published(&nodes) == 0);
+	mtl_node_set_publish(&nodes, 24);
+	assert(mtl_node_set_published(&nodes) == 24);
+	mtl_node_set_publish(&nodes, 10);
+	assert(mtl_node_set_published(&nodes) == 24);
+
+	// Replaced directories are kept, so older references stay valid
+	assert(nodes.tree_pages != directory);
+	assert(nodes.retired_count > 0);
+	assert(nodes.retired_directories[0] == directory);
+	assert(mtl_node_set_fetch_ref(&nodes, 0, 0, &hash) == MTL_OK);
+	assert(hash == first_hash);
+	assert(mtl_node_set_get_randomizer_ref(&nodes, 0, &hash) == MTL_OK);
+	assert(hash == first_rand);
+	memset(buffer, 0x11, hash_len);
+	assert(memcmp(directory[0], buffer, hash_len) == 0);
+
+	// Reserving a leaf only moves the leaf count
+	mtl_node_set_set_leaf_count(&nodes, 41);
+	assert(nodes.leaf_count == 41);
+	assert(mtl_node_set_published(&nodes) == 24);
+	mtl_node_set_set_leaf_count(&nodes, 40);
+
+	mtl_node_set_free(&nodes);
+	assert(nodes.retired_directories == NULL);
+	assert(nodes.retired_count == 0);
+	assert(nodes.published_count == 0);
+
+	return 0;
+}
+
 /**
  * Test the randomizer retrieval operations
  */
@@ -358,7 +854,7 @@ uint8_t mtltest_mtl_node_set_get_randomizer(void)
 
 	assert(nodes.leaf_count == 0);
 	assert(nodes.hash_size == seed.length);
-	assert(nodes.tree_pages[0] == NULL);
+	assert(nodes.tree_page_count == 0);
 	nodes.tree_page_size = 8 * hash_len;
 
 	// Insert test nodes
@@ -381,10 +877,8 @@ uint8_t mtltest_mtl_node_set_get_randomizer(void)
 	// Fetch randomizer that doesn't exist in the set
 	assert(mtl_node_set_get_randomizer(&nodes, 10, &buffer_ptr) == MTL_ERROR);
 	assert(mtl_node_set_get_randomizer(&nodes, MTL_NODE_SET_MAX_LEAF, &buffer_ptr) == MTL_ERROR);
-	// Fetch randomizer for invalid index
-	assert(mtl_node_set_get_randomizer(&nodes, MTL_NODE_SET_MAX_LEAF+1, &buffer_ptr) == MTL_BAD_PARAM);
-	assert(mtl_node_set_get_randomizer(&nodes, MTL_NODE_SET_MAX_INDEX, &buffer_ptr) == MTL_BAD_PARAM);
-	assert(mtl_node_set_get_randomizer(&nodes, MTL_NODE_SET_MAX_INDEX+1, &buffer_ptr) == MTL_BAD_PARAM);
+	assert(buffer_ptr == NULL);
+	assert(mtl_node_set_get_randomizer(&nodes, MTL_NODE_SET_MAX_LEAF - 1, &buffer_ptr) == MTL_ERROR);
 
 	mtl_node_set_free(&nodes);
 
@@ -419,7 +913,7 @@ uint8_t mtltest_mtl_node_set_get_randomizer_null(void)
 
 	assert(nodes.leaf_count == 0);
 	assert(nodes.hash_size == seed.length);
-	assert(nodes.tree_pages[0] == NULL);
+	assert(nodes.tree_page_count == 0);
 	nodes.tree_page_size = 8 * hash_len;
 
 	// Test if 
@@ -450,7 +944,7 @@ uint8_t mtltest_mtl_node_set_get_randomizer_null(void)
  */
 uint8_t mtltest_mtl_node_id(void)
 {
-	uint32_t output;
+	uint64_t output;
 	assert(mtl_node_set_int_node_id(0, 0, &output) == MTL_OK);
 	assert(output == 0);
 	assert(mtl_node_set_int_node_id(1, 1, &output) == MTL_OK);
@@ -495,6 +989,13 @@ uint8_t mtltest_mtl_node_id(void)
 	assert(output == 20);
 	assert(mtl_node_set_int_node_id(0, 15, &output) == MTL_OK);
 	assert(output == 30);
+	// Nodes past 2^31 leaves need more than 32 bits
+	assert(mtl_node_set_int_node_id(0, 0x7fffffff, &output) == MTL_OK);
+	assert(output == 0xfffffffe);
+	assert(mtl_node_set_int_node_id(0x80000000, 0x80000000, &output) == MTL_OK);
+	assert(output == 0xffffffff);
+	assert(mtl_node_set_int_node_id(0x80000000, 0xffffffff, &output) == MTL_OK);
+	assert(output == MTL_NODE_SET_MAX_INDEX - 1);
 	// Check largest allowed index
 	assert(mtl_node_set_int_node_id(0, MTL_NODE_SET_MAX_LEAF, &output) == MTL_OK);
 	assert(output == MTL_NODE_SET_MAX_INDEX);
@@ -508,7 +1009,7 @@ uint8_t mtltest_mtl_node_id(void)
  */
 uint8_t mtltest_mtl_node_id_invalid(void)
 {
-	uint32_t out;
+	uint64_t out;
 	// Null check
 	assert(mtl_node_set_int_node_id(0, 0, NULL) == MTL_NULL_PTR);
 
@@ -533,17 +1034,15 @@ uint8_t mtltest_mtl_node_id_invalid(void)
 	assert(mtl_node_set_int_node_id(1, 16, &out) == MTL_BAD_PARAM);
 	assert(mtl_node_set_int_node_id(16, 32, &out) == MTL_BAD_PARAM);
 
-	// Leaf index out-of-bounds error
-	assert(mtl_node_set_int_node_id(0, MTL_NODE_SET_MAX_LEAF + 1, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_LEAF + 1, MTL_NODE_SET_MAX_LEAF + 1, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_LEAF, MTL_NODE_SET_MAX_LEAF + 1, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_LEAF + 1, MTL_NODE_SET_MAX_LEAF + 2, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_LEAF + 2, MTL_NODE_SET_MAX_LEAF + 3, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(0, MTL_NODE_SET_MAX_INDEX, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_INDEX, MTL_NODE_SET_MAX_INDEX, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_INDEX, MTL_NODE_SET_MAX_INDEX + 1, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(0, UINT32_MAX, &out) == MTL_BAD_PARAM);
-	assert(mtl_node_set_int_node_id(UINT32_MAX, UINT32_MAX, &out) == MTL_BAD_PARAM);
+	// Every 32 bit leaf index is in bounds, so the errors at the top
+	// of the range are subtrees that are not complete
+	assert(mtl_node_set_int_node_id(0, MTL_NODE_SET_MAX_LEAF - 1, &out) == MTL_BAD_PARAM);
+	assert(mtl_node_set_int_node_id(1, MTL_NODE_SET_MAX_LEAF, &out) == MTL_BAD_PARAM);
+	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_LEAF - 1, MTL_NODE_SET_MAX_LEAF - 1, &out) == MTL_OK);
+	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_LEAF, MTL_NODE_SET_MAX_LEAF - 1, &out) == MTL_BAD_PARAM);
+	assert(mtl_node_set_int_node_id(MTL_NODE_SET_MAX_LEAF - 2, MTL_NODE_SET_MAX_LEAF, &out) == MTL_BAD_PARAM);
+	assert(mtl_node_set_int_node_id(0x80000000, MTL_NODE_SET_MAX_LEAF - 1, &out) == MTL_BAD_PARAM);
+	assert(mtl_node_set_int_node_id(UINT32_MAX, UINT32_MAX, &out) == MTL_OK);
 	assert(mtl_node_set_int_node_id(UINT32_MAX, UINT32_MAX + 1, &out) == MTL_BAD_PARAM);
 
 	return 0;
@@ -560,7 +1059,7 @@ uint8_t mtltest_mtl_lsb(void)
 
 	// Make sure that all 32 bit positions work
 	for (index = 0; index < 32; index++) {
-		assert(mtl_lsb(1 << index) == index);
+		assert(mtl_lsb((uint32_t)1 << index) == index);
 	}
 
 	// Test out multiple bit numbers
@@ -569,10 +1068,11 @@ uint8_t mtltest_mtl_lsb(void)
 	assert(mtl_lsb(0xAAAA0000) == 17);
 	assert(mtl_lsb(0xC0000000) == 30);
 
-	// Test "overflow"
+	// Node indexes use the upper 32 bit positions as well
 	for (index = 32; index < 64; index++) {
-		assert(mtl_lsb((1L << index)) == 0xffffffff);
+		assert(mtl_lsb(((uint64_t)1 << index)) == index);
 	}
+	assert(mtl_lsb(0) == 0xffffffff);
 
 	return 0;
 }
@@ -605,8 +1105,10 @@ uint8_t mtltest_mtl_bit_width(void)
 	assert(mtl_bit_width(0xAAAA0000) == 8);
 	assert(mtl_bit_width(0xC0000000) == 2);
 
-	// Test "overflow"
+	// Node indexes use the upper 32 bit positions as well
 	assert(mtl_bit_width((uint32_t) 0xC00000000L) == 0);
+	assert(mtl_bit_width(0xC00000000ULL) == 2);
+	assert(mtl_bit_width(UINT64_MAX) == 64);
 
 	return 0;
 }
@@ -621,7 +1123,7 @@ uint8_t mtltest_mtl_msb(void)
 
 	// Make sure that all 32 bit positions work
 	for (index = 0; index < 32; index++) {
-		assert(mtl_msb(1 << index) == index);
+		assert(mtl_msb((uint32_t)1 << index) == index);
 	}
 
 	// Test out multiple bit numbers
@@ -630,10 +1132,11 @@ uint8_t mtltest_mtl_msb(void)
 	assert(mtl_msb(0xAAAA0000) == 31);
 	assert(mtl_msb(0xC0000000) == 31);
 
-	// Test "overflow"
+	// Node indexes use the upper 32 bit positions as well
 	for (index = 32; index < 64; index++) {
-		assert(mtl_msb((1L << index)) == 0);
+		assert(mtl_msb(((uint64_t)1 << index)) == index);
 	}
+	assert(mtl_msb(0) == 0);
 
 	return 0;
 }
@@ -646,7 +1149,8 @@ uint8_t mtltest_mtl_node_set_maximum(void)
 	SEED seed;
 	SERIESID sid;
 	MTLNODES nodes;
-	uint32_t index, left_index, right_index, width_index;
+	uint32_t index;
+	uint64_t left_index, right_index, width_index;
 	uint8_t write_buffer[32], read_buffer[32];
 	uint8_t *hash;
 	uint32_t hash_len = 32;
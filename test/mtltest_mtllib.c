@@ -33,7 +33,9 @@
 #include <config.h>
 #include <stdio.h>
 #include <assert.h>
+#include <pthread.h>
 #include <string.h>
+#include <time.h>
 
 #include "mtltest.h"
 #include "mtllib.h"
@@ -50,15 +52,27 @@ uint8_t mtltest_mtllib_key_from_buffer(void);
 uint8_t mtltest_mtllib_key_from_buffer_null(void);
 uint8_t mtltest_mtllib_key_to_buffer(void);
 uint8_t mtltest_mtllib_key_to_buffer_null(void);
+uint8_t mtltest_mtllib_key_geometry(void);
+uint8_t mtltest_mtllib_key_layout(void);
+uint8_t mtltest_mtllib_key_leaf_count_64(void);
+uint8_t mtltest_mtllib_key_format_v2(void);
+uint8_t mtltest_mtllib_key_from_buffer_threads(void);
 uint8_t mtltest_mtllib_sign_append(void);
 uint8_t mtltest_mtllib_sign_append_null(void);
+uint8_t mtltest_mtllib_sign_append_many(void);
 uint8_t mtltest_mtllib_sign_free_handle_null(void);
 uint8_t mtltest_mtllib_sign_get_condensed_sig(void);
 uint8_t mtltest_mtllib_sign_get_condensed_sig_null(void);
 uint8_t mtltest_mtllib_sign_get_signed_ladder(void);
 uint8_t mtltest_mtllib_sign_get_signed_ladder_null(void);
+uint8_t mtltest_mtllib_sign_ladder_policy(void);
+uint8_t mtltest_mtllib_sign_background(void);
+uint8_t mtltest_mtllib_sign_background_free(void);
+uint8_t mtltest_mtllib_sign_threads(void);
 uint8_t mtltest_mtllib_sign_get_full_sig(void);
 uint8_t mtltest_mtllib_sign_get_full_sig_null(void);
+uint8_t mtltest_mtllib_sign_stream(void);
+uint8_t mtltest_mtllib_sign_stream_open(void);
 
 uint8_t mtltest_mtllib_verify_condensed(void);
 uint8_t mtltest_mtllib_verify_condensed_no_ladder(void);
@@ -94,10 +108,22 @@ uint8_t mtltest_mtllib(void)
 			 "Verify MTL library write a key to a byte buffer");
 	RUN_TEST(mtltest_mtllib_key_to_buffer_null,
 			 "Verify MTL library write a key to a byte buffer with NULL parameters");
+	RUN_TEST(mtltest_mtllib_key_geometry,
+			 "Verify MTL library key with a non-default node set geometry");
+	RUN_TEST(mtltest_mtllib_key_layout,
+			 "Verify MTL library key with the blocked node set layout");
+	RUN_TEST(mtltest_mtllib_key_leaf_count_64,
+			 "Verify MTL library keys with a 64 bit leaf count");
+	RUN_TEST(mtltest_mtllib_key_format_v2,
+			 "Verify MTL library key buffer format with stored node sections");
+	RUN_TEST(mtltest_mtllib_key_from_buffer_threads,
+			 "Verify MTL library get a key from a byte buffer with worker threads");
 	RUN_TEST(mtltest_mtllib_sign_append,
 			 "Verify MTL library signer append message");
 	RUN_TEST(mtltest_mtllib_sign_append_null,
 			 "Verify MTL library signer append message with NULL parameters");
+	RUN_TEST(mtltest_mtllib_sign_append_many,
+			 "Verify MTL library signer append a batch of messages w/worker threads");
 	RUN_TEST(mtltest_mtllib_sign_free_handle_null,
 			 "Verify MTL library signer free message handle with NULL parameters");
 	RUN_TEST(mtltest_mtllib_sign_get_condensed_sig,
@@ -108,10 +134,22 @@ uint8_t mtltest_mtllib(void)
 			 "Verify MTL library signer get signed ladder");
 	RUN_TEST(mtltest_mtllib_sign_get_signed_ladder_null,
 			 "Verify MTL library signer get signed ladder with NULL parameters");
+	RUN_TEST(mtltest_mtllib_sign_ladder_policy,
+			 "Verify MTL library signer signed ladder cache and signing policy");
+	RUN_TEST(mtltest_mtllib_sign_background,
+			 "Verify MTL library signer background ladder signing");
+	RUN_TEST(mtltest_mtllib_sign_background_free,
+			 "Verify MTL library free a key while a ladder is being signed");
+	RUN_TEST(mtltest_mtllib_sign_threads,
+			 "Verify MTL library signers appending from several threads");
 	RUN_TEST(mtltest_mtllib_sign_get_full_sig,
 			 "Verify MTL library signer get full signature");
 	RUN_TEST(mtltest_mtllib_sign_get_full_sig_null,
 			 "Verify MTL library signer get full signature with NULL parameters");
+	RUN_TEST(mtltest_mtllib_sign_stream,
+			 "Verify MTL library sign and verify a large message fed in pieces");
+	RUN_TEST(mtltest_mtllib_sign_stream_open,
+			 "Verify MTL library ladders and keys while a message stream is open");
 	RUN_TEST(mtltest_mtllib_verify_condensed,
 			 "Verify MTL library verify a condensed signature");
 	RUN_TEST(mtltest_mtllib_verify_condensed_no_ladder,
@@ -491,6 +529,354 @@ uint8_t mtltest_mtllib_key_to_buffer_null(void)
 	return 0;
 }
 
+/**
+ * Test the MTL library key with a non-default node set geometry
+ */
+uint8_t mtltest_mtllib_key_geometry(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTLLIB_CTX *ctx_copy = NULL;
+	MTL_HANDLE *handle = NULL;
+	size_t buffer_size = 0;
+	uint8_t *buffer = NULL;
+	size_t copy_size = 0;
+	uint8_t *copy = NULL;
+	uint8_t msg[] = "Geometry Test Message";
+	uint32_t index;
+
+	// Page size is rounded down to a whole number of 16 byte hashes
+	assert(mtllib_key_new_with_geometry("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL,
+					    135, 2) == MTLLIB_OK);
+	assert(ctx->mtl->nodes.tree_page_size == 128);
+	assert(ctx->mtl->nodes.max_pages == 2);
+	assert(ctx->mtl->nodes.tree_page_count == 0);
+
+	// Two 128 byte pages hold the nodes for the first 9 leaves
+	for (index = 0; index < 9; index++) {
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+	}
+	assert(ctx->mtl->nodes.tree_page_count == 2);
+	assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) != MTLLIB_OK);
+	mtllib_key_free(ctx);
+
+	// Geometry is written after the hash size and flagged in the key
+	assert(mtllib_key_new_with_geometry("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL,
+					    4096, 16) == MTLLIB_OK);
+	for (index = 0; index < 5; index++) {
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+	}
+	buffer_size = mtllib_key_to_buffer(ctx, &buffer);
+	assert(buffer_size == 154 + 8 + (5 * 16 * 2));
+	assert(buffer[131] == (RANDOMIZER_FLAG | GEOMETRY_FLAG));
+	assert(buffer[154] == 0x00);
+	assert(buffer[155] == 0x00);
+	assert(buffer[156] == 0x10);
+	assert(buffer[157] == 0x00);
+	assert(buffer[158] == 0x00);
+	assert(buffer[159] == 0x00);
+	assert(buffer[160] == 0x00);
+	assert(buffer[161] == 0x10);
+
+	// Loading the key restores the geometry and the same key bytes
+	assert(mtllib_key_from_buffer(buffer, buffer_size, &ctx_copy) == MTLLIB_OK);
+	assert(ctx_copy->mtl->nodes.tree_page_size == 4096);
+	assert(ctx_copy->mtl->nodes.max_pages == 16);
+	assert(ctx_copy->mtl->nodes.leaf_count == 5);
+	copy_size = mtllib_key_to_buffer(ctx_copy, &copy);
+	assert(copy_size == buffer_size);
+	assert(memcmp(copy, buffer, buffer_size) == 0);
+	mtllib_key_free(ctx_copy);
+
+	// Keys cut off after the node set is set up free it again
+	for (copy_size = 150; copy_size < buffer_size; copy_size++) {
+		ctx_copy = NULL;
+		assert(mtllib_key_from_buffer(buffer, copy_size, &ctx_copy) == MTLLIB_BAD_VALUE);
+		assert(ctx_copy == NULL);
+	}
+
+	free(copy);
+	free(buffer);
+	mtllib_key_free(ctx);
+
+	// Default geometry keys do not carry the geometry fields
+	assert(mtllib_key_new_with_geometry("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL,
+					    0, 0) == MTLLIB_OK);
+	buffer_size = mtllib_key_to_buffer(ctx, &buffer);
+	assert(buffer_size == 154);
+	assert(buffer[131] == RANDOMIZER_FLAG);
+	free(buffer);
+	mtllib_key_free(ctx);
+
+	// Page size must hold at least one hash
+	assert(mtllib_key_new_with_geometry("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL,
+					    8, 0) == MTLLIB_BAD_VALUE);
+
+	return 0;
+}
+
+/**
+ * Test the MTL library key with the blocked node set layout
+ */
+uint8_t mtltest_mtllib_key_layout(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTLLIB_CTX *ctx_v1 = NULL;
+	MTLLIB_CTX *ctx_v2 = NULL;
+	MTL_HANDLE *handle = NULL;
+	uint8_t *buffer_v1 = NULL;
+	uint8_t *buffer_v2 = NULL;
+	uint8_t *copy = NULL;
+	size_t size_v1 = 0;
+	size_t size_v2 = 0;
+	size_t copy_size = 0;
+	uint8_t msg[] = "Layout Test Message";
+	uint32_t index;
+
+	assert(mtllib_key_new_with_layout("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL,
+					  0, 0, 2) == MTLLIB_BAD_VALUE);
+	assert(mtllib_key_new_with_layout("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL,
+					  0, 0, MTL_NODE_SET_LAYOUT_BLOCKED) == MTLLIB_OK);
+	assert(ctx->mtl->nodes.layout == MTL_NODE_SET_LAYOUT_BLOCKED);
+	assert(ctx->mtl->nodes.tile_height == 8);
+	for (index = 0; index < 21; index++) {
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+	}
+
+	// Layout is written after the hash size and flagged in the key
+	size_v1 = mtllib_key_to_buffer_version(ctx, &buffer_v1, MTLLIB_KEY_FORMAT_V1);
+	assert(size_v1 == 154 + 2 + (21 * 16 * 2));
+	assert(buffer_v1[131] == (RANDOMIZER_FLAG | LAYOUT_FLAG));
+	assert(buffer_v1[154] == MTL_NODE_SET_LAYOUT_BLOCKED);
+	assert(buffer_v1[155] == 8);
+	size_v2 = mtllib_key_to_buffer_version(ctx, &buffer_v2, MTLLIB_KEY_FORMAT_V2);
+	assert(buffer_v2[131] == (RANDOMIZER_FLAG | LAYOUT_FLAG | SECTIONS_FLAG));
+
+	// Both formats restore the layout and the same key bytes
+	assert(mtllib_key_from_buffer(buffer_v1, size_v1, &ctx_v1) == MTLLIB_OK);
+	assert(mtllib_key_from_buffer(buffer_v2, size_v2, &ctx_v2) == MTLLIB_OK);
+	assert(ctx_v1->mtl->nodes.layout == MTL_NODE_SET_LAYOUT_BLOCKED);
+	assert(ctx_v2->mtl->nodes.tile_height == 8);
+	copy_size = mtllib_key_to_buffer_version(ctx_v1, &copy, MTLLIB_KEY_FORMAT_V2);
+	assert(copy_size == size_v2);
+	assert(memcmp(copy, buffer_v2, size_v2) == 0);
+	free(copy);
+	copy_size = mtllib_key_to_buffer_version(ctx_v2, &copy, MTLLIB_KEY_FORMAT_V1);
+	assert(copy_size == size_v1);
+	assert(memcmp(copy, buffer_v1, size_v1) == 0);
+	free(copy);
+
+	// An unknown layout is rejected on load
+	buffer_v1[154] = 2;
+	assert(mtllib_key_from_buffer(buffer_v1, size_v1, &ctx) != MTLLIB_OK);
+
+	free(buffer_v1);
+	free(buffer_v2);
+	mtllib_key_free(ctx_v1);
+	mtllib_key_free(ctx_v2);
+	mtllib_key_free(ctx);
+
+	return 0;
+}
+
+/**
+ * Test the MTL library key buffer with a 64 bit leaf count
+ */
+uint8_t mtltest_mtllib_key_leaf_count_64(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTLLIB_CTX *ctx_copy = NULL;
+	MTL_HANDLE *handle = NULL;
+	uint8_t *buffer = NULL;
+	uint8_t *wide = NULL;
+	uint8_t *copy = NULL;
+	size_t size = 0;
+	size_t copy_size = 0;
+	uint8_t msg[] = "Leaf Count Test Message";
+	uint32_t index;
+
+	assert(mtllib_key_new("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL) == MTLLIB_OK);
+	for (index = 0; index < 5; index++) {
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+	}
+
+	// Counts that fit in 32 bits keep the short encoding
+	size = mtllib_key_to_buffer_version(ctx, &buffer, MTLLIB_KEY_FORMAT_V1);
+	assert(buffer[131] == RANDOMIZER_FLAG);
+	assert(buffer[151] == 5);
+
+	// The wide encoding of the same count loads the same key
+	wide = malloc(size + 4);
+	assert(wide != NULL);
+	memcpy(wide, buffer, 148);
+	memset(wide + 148, 0, 4);
+	memcpy(wide + 152, buffer + 148, size - 148);
+	wide[131] |= LEAF_COUNT_64_FLAG;
+	assert(mtllib_key_from_buffer(wide, size + 4, &ctx_copy) == MTLLIB_OK);
+	assert(ctx_copy->mtl->nodes.leaf_count == 5);
+	copy_size = mtllib_key_to_buffer_version(ctx_copy, &copy, MTLLIB_KEY_FORMAT_V1);
+	assert(copy_size == size);
+	assert(memcmp(copy, buffer, size) == 0);
+	free(copy);
+	mtllib_key_free(ctx_copy);
+	ctx_copy = NULL;
+
+	// Counts past the last 32 bit leaf index are rejected
+	wide[151] = 1;
+	assert(mtllib_key_from_buffer(wide, size + 4, &ctx_copy) == MTLLIB_BAD_VALUE);
+	// A full node set is within range but the buffer is too short for it
+	wide[155] = 0;
+	assert(mtllib_key_from_buffer(wide, size + 4, &ctx_copy) != MTLLIB_OK);
+
+	free(wide);
+	free(buffer);
+	mtllib_key_free(ctx);
+
+	return 0;
+}
+
+/**
+ * Test the MTL library V2 key buffer format
+ */
+uint8_t mtltest_mtllib_key_format_v2(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTLLIB_CTX *ctx_v1 = NULL;
+	MTLLIB_CTX *ctx_v2 = NULL;
+	MTL_HANDLE *handle = NULL;
+	uint8_t *buffer_v1 = NULL;
+	uint8_t *buffer_v2 = NULL;
+	uint8_t *buffer_copy = NULL;
+	size_t size_v1 = 0;
+	size_t size_v2 = 0;
+	size_t size_copy = 0;
+	const uint8_t *hash = NULL;
+	const uint8_t *hash_v2 = NULL;
+	uint8_t checksum[EVP_MAX_MD_SIZE];
+	uint8_t msg[] = "Key Format Test Message";
+	uint32_t index;
+
+	assert(mtllib_key_new("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL) == MTLLIB_OK);
+	for (index = 0; index < 13; index++) {
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+	}
+
+	// Unknown formats are rejected
+	assert(mtllib_key_to_buffer_version(ctx, &buffer_v2, 3) == 0);
+	assert(buffer_v2 == NULL);
+
+	size_v1 = mtllib_key_to_buffer_version(ctx, &buffer_v1, MTLLIB_KEY_FORMAT_V1);
+	size_v2 = mtllib_key_to_buffer_version(ctx, &buffer_v2, MTLLIB_KEY_FORMAT_V2);
+	assert(size_v1 == 154 + (13 * 16 * 2));
+	// 13 leaves hold 23 nodes, plus the section count and two TOC entries
+	assert(size_v2 == 154 + 2 + (2 * KEY_SECTION_TOC_SIZE) + (23 * 16) + (13 * 16));
+	assert(buffer_v2[131] == (RANDOMIZER_FLAG | SECTIONS_FLAG));
+
+	// Both formats load to the same node set
+	assert(mtllib_key_from_buffer(buffer_v1, size_v1, &ctx_v1) == MTLLIB_OK);
+	assert(mtllib_key_from_buffer(buffer_v2, size_v2, &ctx_v2) == MTLLIB_OK);
+	assert(ctx_v2->mtl->nodes.leaf_count == 13);
+	assert(mtl_node_set_fetch_ref(&ctx->mtl->nodes, 0, 7, &hash) == MTL_OK);
+	assert(mtl_node_set_fetch_ref(&ctx_v2->mtl->nodes, 0, 7, &hash_v2) == MTL_OK);
+	assert(memcmp(hash, hash_v2, 16) == 0);
+	assert(mtl_node_set_get_randomizer_ref(&ctx->mtl->nodes, 12, &hash) == MTL_OK);
+	assert(mtl_node_set_get_randomizer_ref(&ctx_v2->mtl->nodes, 12, &hash_v2) == MTL_OK);
+	assert(memcmp(hash, hash_v2, 16) == 0);
+
+	size_copy = mtllib_key_to_buffer_version(ctx_v1, &buffer_copy, MTLLIB_KEY_FORMAT_V2);
+	assert(size_copy == size_v2);
+	assert(memcmp(buffer_copy, buffer_v2, size_v2) == 0);
+	free(buffer_copy);
+	size_copy = mtllib_key_to_buffer_version(ctx_v2, &buffer_copy, MTLLIB_KEY_FORMAT_V1);
+	assert(size_copy == size_v1);
+	assert(memcmp(buffer_copy, buffer_v1, size_v1) == 0);
+	free(buffer_copy);
+	mtllib_key_free(ctx_v1);
+	mtllib_key_free(ctx_v2);
+
+	// A corrupt node section fails the checksum
+	buffer_v2[size_v2 - (13 * 16) - 1] ^= 0x01;
+	assert(mtllib_key_from_buffer(buffer_v2, size_v2, &ctx_v2) == MTLLIB_BAD_VALUE);
+	buffer_v2[size_v2 - (13 * 16) - 1] ^= 0x01;
+
+	// A truncated key is rejected
+	assert(mtllib_key_from_buffer(buffer_v2, size_v2 - 1, &ctx_v2) == MTLLIB_BAD_VALUE);
+
+	// Section checksums are the SHA-256 of the section data
+	assert(EVP_Digest(buffer_v2 + 156 + (2 * KEY_SECTION_TOC_SIZE), 23 * 16,
+			  checksum, NULL, EVP_sha256(), NULL) == 1);
+	assert(memcmp(buffer_v2 + 156 + 10, checksum, KEY_SECTION_CHECKSUM_SIZE) == 0);
+
+	free(buffer_v1);
+	free(buffer_v2);
+	mtllib_key_free(ctx);
+
+	// A key without leaves has empty sections
+	assert(mtllib_key_new("SLH-DSA-MTL-SHAKE-128S", &ctx, NULL) == MTLLIB_OK);
+	size_v2 = mtllib_key_to_buffer_version(ctx, &buffer_v2, MTLLIB_KEY_FORMAT_V2);
+	assert(size_v2 > 0);
+	assert(mtllib_key_from_buffer(buffer_v2, size_v2, &ctx_v2) == MTLLIB_OK);
+	assert(ctx_v2->mtl->nodes.leaf_count == 0);
+	free(buffer_v2);
+	mtllib_key_free(ctx_v2);
+	mtllib_key_free(ctx);
+
+	return 0;
+}
+
+/**
+ * Test the MTL library key load with a parallel node rebuild
+ */
+uint8_t mtltest_mtllib_key_from_buffer_threads(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTLLIB_CTX *ctx_threads = NULL;
+	MTL_HANDLE *handle = NULL;
+	uint8_t *buffer = NULL;
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	size_t buffer_size = 0;
+	size_t expected_size = 0;
+	size_t actual_size = 0;
+	uint8_t msg[] = "Threaded Load Test Message";
+	uint32_t index;
+
+	assert(mtllib_key_new("SLH-DSA-MTL-SHA2-128S", &ctx, NULL) == MTLLIB_OK);
+	for (index = 0; index < 150; index++) {
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+	}
+	buffer_size = mtllib_key_to_buffer_version(ctx, &buffer, MTLLIB_KEY_FORMAT_V1);
+	expected_size = mtllib_key_to_buffer_version(ctx, &expected, MTLLIB_KEY_FORMAT_V2);
+
+	assert(mtllib_key_from_buffer_threads(buffer, buffer_size, &ctx_threads, 4) == MTLLIB_OK);
+	assert(ctx_threads->threads == 4);
+	actual_size = mtllib_key_to_buffer_version(ctx_threads, &actual, MTLLIB_KEY_FORMAT_V2);
+	assert(actual_size == expected_size);
+	assert(memcmp(actual, expected, expected_size) == 0);
+	free(actual);
+	mtllib_key_free(ctx_threads);
+
+	assert(mtllib_key_from_buffer_threads(buffer, buffer_size, &ctx_threads, 0) == MTLLIB_OK);
+	actual_size = mtllib_key_to_buffer_version(ctx_threads, &actual, MTLLIB_KEY_FORMAT_V2);
+	assert(actual_size == expected_size);
+	assert(memcmp(actual, expected, expected_size) == 0);
+	free(actual);
+	mtllib_key_free(ctx_threads);
+
+	assert(mtllib_key_from_buffer_threads(NULL, buffer_size, &ctx_threads, 4) == MTLLIB_NULL_PARAMS);
+
+	free(buffer);
+	free(expected);
+	mtllib_key_free(ctx);
+
+	return 0;
+}
+
 uint8_t mtltest_mtllib_sign_append(void)
 {
 	MTLLIB_CTX *ctx = NULL;
@@ -576,6 +962,121 @@ uint8_t mtltest_mtllib_sign_append_null(void)
 	return 0;
 }
 
+uint8_t mtltest_mtllib_sign_append_many(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTL_HANDLE *handles[40];
+	MTL_HANDLE *handle;
+	uint8_t messages[40][16];
+	uint8_t *long_msg = NULL;
+	uint8_t *msgs[40];
+	size_t msg_lens[40];
+	RANDOMIZER *randomizer = NULL;
+	AUTHPATH *auth = NULL;
+	LADDER *ladder = NULL;
+	RUNG *rung = NULL;
+	size_t buffer_no_ctx_size = 153;
+	uint8_t sid_val[] = {0x32, 0x34, 0xf0, 0xf5, 0xbe, 0x58, 0xc4, 0xc6};
+	uint8_t msg[] = "Test Message";
+	size_t msg_len = 13;
+	uint32_t index;
+	uint8_t buffer_no_ctx[] =
+		{0x00, 0x00, 0x00, 0x15, 0x53, 0x4c, 0x48, 0x2d, 0x44, 0x53, 0x41, 0x2d, 0x4d, 0x54, 0x4c, 0x2d,
+		 0x53, 0x48, 0x41, 0x32, 0x2d, 0x31, 0x32, 0x38, 0x53, 0x00, 0x00, 0x00, 0x40, 0x79, 0x11, 0xc8,
+		 0x41, 0x32, 0x11, 0x3a, 0x53, 0x86, 0x75, 0x37, 0xf4, 0x45, 0x4c, 0xf3, 0xa0, 0x40, 0x74, 0xab,
+		 0x4b, 0xb4, 0x82, 0x9e, 0x85, 0x1a, 0x77, 0x3e, 0xb8, 0xc0, 0x5e, 0x2b, 0x2c, 0x5c, 0x23, 0x57,
+		 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4, 0xdc, 0xfa, 0xd1, 0x78,
+		 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56, 0x86, 0x00, 0x00, 0x00,
+		 0x20, 0x5c, 0x23, 0x57, 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4,
+		 0xdc, 0xfa, 0xd1, 0x78, 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56,
+		 0x86, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x32, 0x34, 0xf0, 0xf5, 0xbe,
+		 0x58, 0xc4, 0xc6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10};
+
+	for (index = 0; index < 40; index++)
+	{
+		memset(messages[index], (uint8_t)index, 16);
+		msgs[index] = messages[index];
+		msg_lens[index] = 16;
+	}
+
+	assert(mtllib_key_from_buffer_threads(buffer_no_ctx, buffer_no_ctx_size, &ctx, 4) == MTLLIB_OK);
+	assert(ctx->threads == 4);
+
+	// Mix single appends with batches so the leaf order is checked
+	assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+	assert(handle->leaf_index == 0);
+	mtllib_sign_free_handle(&handle);
+	assert(mtllib_sign_append_many(ctx, msgs, msg_lens, 3, handles) == MTLLIB_OK);
+	assert(mtllib_sign_append_many(ctx, &msgs[3], &msg_lens[3], 37, &handles[3]) == MTLLIB_OK);
+	assert(ctx->mtl->nodes.leaf_count == 41);
+
+	ladder = mtl_ladder(ctx->mtl);
+	assert(ladder != NULL);
+	for (index = 0; index < 40; index++)
+	{
+		assert(handles[index] != NULL);
+		assert(handles[index]->leaf_index == index + 1);
+		assert(handles[index]->sid_len == 8);
+		assert(memcmp(handles[index]->sid, &sid_val[0], 8) == 0);
+
+		// Each handle has to authenticate the message at the same position
+		assert(mtl_randomizer_and_authpath(ctx->mtl, handles[index]->leaf_index,
+										   &randomizer, &auth) == MTL_OK);
+		rung = mtl_rung(auth, ladder);
+		assert(rung != NULL);
+		assert(mtl_hash_and_verify(ctx->mtl, msgs[index], msg_lens[index],
+								   randomizer, auth, rung) == MTL_OK);
+		mtl_randomizer_free(randomizer);
+		mtl_authpath_free(auth);
+		mtllib_sign_free_handle(&handles[index]);
+	}
+	mtl_ladder_free(ladder);
+
+	// A message longer than 16 bits stays in the threaded batch
+	assert(mtllib_set_threads(ctx, 2) == MTLLIB_OK);
+	assert(ctx->threads == 2);
+	long_msg = malloc(UINT16_MAX + 100);
+	assert(long_msg != NULL);
+	memset(long_msg, 0xa5, UINT16_MAX + 100);
+	msgs[1] = long_msg;
+	msg_lens[1] = UINT16_MAX + 100;
+	assert(mtllib_sign_append_many(ctx, msgs, msg_lens, 3, handles) == MTLLIB_OK);
+	assert(ctx->mtl->nodes.leaf_count == 44);
+	ladder = mtl_ladder(ctx->mtl);
+	assert(ladder != NULL);
+	for (index = 0; index < 3; index++)
+	{
+		assert(handles[index]->leaf_index == index + 41);
+		assert(mtl_randomizer_and_authpath(ctx->mtl, handles[index]->leaf_index,
+										   &randomizer, &auth) == MTL_OK);
+		rung = mtl_rung(auth, ladder);
+		assert(rung != NULL);
+		assert(mtl_hash_and_verify(ctx->mtl, msgs[index], msg_lens[index],
+								   randomizer, auth, rung) == MTL_OK);
+		mtl_randomizer_free(randomizer);
+		mtl_authpath_free(auth);
+		mtllib_sign_free_handle(&handles[index]);
+	}
+	mtl_ladder_free(ladder);
+	msgs[1] = messages[1];
+	msg_lens[1] = 16;
+	free(long_msg);
+	assert(mtllib_set_threads(NULL, 2) == MTLLIB_NULL_PARAMS);
+
+	assert(mtllib_sign_append_many(NULL, msgs, msg_lens, 1, handles) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_append_many(ctx, NULL, msg_lens, 1, handles) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_append_many(ctx, msgs, NULL, 1, handles) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_append_many(ctx, msgs, msg_lens, 0, handles) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_append_many(ctx, msgs, msg_lens, 1, NULL) == MTLLIB_NULL_PARAMS);
+	msgs[1] = NULL;
+	assert(mtllib_sign_append_many(ctx, msgs, msg_lens, 2, handles) == MTLLIB_NULL_PARAMS);
+	assert(handles[0] == NULL);
+	assert(ctx->mtl->nodes.leaf_count == 44);
+
+	mtllib_key_free(ctx);
+	return 0;
+}
+
 uint8_t mtltest_mtllib_sign_free_handle_null(void)
 {
 	// Run free on NULL to make sure this doesn't crash
@@ -810,6 +1311,311 @@ uint8_t mtltest_mtllib_sign_get_signed_ladder_null(void)
 	mtllib_key_free(ctx);
 	return 0;
 }
+uint8_t mtltest_mtllib_sign_ladder_policy(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTL_HANDLE *first = NULL;
+	MTL_HANDLE *handle = NULL;
+	size_t buffer_no_ctx_size = 153;
+	uint8_t msg[] = "Test Message";
+	size_t msg_len = 13;
+	size_t index = 0;
+	uint8_t *ladder;
+	size_t ladder_len;
+	uint8_t *cached;
+	size_t cached_len;
+	uint8_t *sig;
+	size_t sig_len;
+	uint8_t buffer_no_ctx[] =
+		{0x00, 0x00, 0x00, 0x15, 0x53, 0x4c, 0x48, 0x2d, 0x44, 0x53, 0x41, 0x2d, 0x4d, 0x54, 0x4c, 0x2d,
+		 0x53, 0x48, 0x41, 0x32, 0x2d, 0x31, 0x32, 0x38, 0x53, 0x00, 0x00, 0x00, 0x40, 0x79, 0x11, 0xc8,
+		 0x41, 0x32, 0x11, 0x3a, 0x53, 0x86, 0x75, 0x37, 0xf4, 0x45, 0x4c, 0xf3, 0xa0, 0x40, 0x74, 0xab,
+		 0x4b, 0xb4, 0x82, 0x9e, 0x85, 0x1a, 0x77, 0x3e, 0xb8, 0xc0, 0x5e, 0x2b, 0x2c, 0x5c, 0x23, 0x57,
+		 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4, 0xdc, 0xfa, 0xd1, 0x78,
+		 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56, 0x86, 0x00, 0x00, 0x00,
+		 0x20, 0x5c, 0x23, 0x57, 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4,
+		 0xdc, 0xfa, 0xd1, 0x78, 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56,
+		 0x86, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x32, 0x34, 0xf0, 0xf5, 0xbe,
+		 0x58, 0xc4, 0xc6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10};
+
+	assert(mtllib_key_from_buffer(buffer_no_ctx, buffer_no_ctx_size, &ctx) == MTLLIB_OK);
+	assert(ctx->ladder_policy == MTLLIB_LADDER_POLICY_ALWAYS);
+	assert(ctx->signed_ladder == NULL);
+
+	assert(mtllib_sign_append(ctx, msg, msg_len, &first) == MTLLIB_OK);
+	for (index = 1; index < 5; index++)
+	{
+		assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+	}
+
+	// Repeated requests for the same leaf count come from the cache
+	assert(mtllib_sign_get_signed_ladder(ctx, &cached, &cached_len) == MTLLIB_OK);
+	assert(ctx->signed_ladder_leaf_count == 5);
+	assert(cached_len == 12 + (2 * 24) + 4 + 7856);
+	assert(mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) == MTLLIB_OK);
+	assert(ladder != cached);
+	assert(ladder_len == cached_len);
+	assert(memcmp(ladder, cached, ladder_len) == 0);
+	free(ladder);
+
+	// The default policy signs again after any append
+	assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+	mtllib_sign_free_handle(&handle);
+	assert(mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) == MTLLIB_OK);
+	assert(ctx->signed_ladder_leaf_count == 6);
+	assert(ladder_len == cached_len);
+	assert(memcmp(ladder, cached, ladder_len) != 0);
+	free(ladder);
+	free(cached);
+
+	// Every N leaves
+	assert(mtllib_sign_set_ladder_policy(ctx, MTLLIB_LADDER_POLICY_EVERY_N, 4) == MTLLIB_OK);
+	for (index = 6; index < 9; index++)
+	{
+		assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+		if (index < 8)
+		{
+			mtllib_sign_free_handle(&handle);
+		}
+	}
+	assert(mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) == MTLLIB_OK);
+	assert(ctx->signed_ladder_leaf_count == 6);
+	free(ladder);
+	assert(mtllib_sign_get_full_sig(ctx, handle, &sig, &sig_len) == MTLLIB_NO_LADDER);
+	// The auth path is for the older ladder the signature carries
+	assert(mtllib_sign_get_full_sig(ctx, first, &sig, &sig_len) == MTLLIB_OK);
+	assert(mtllib_verify(ctx, msg, msg_len, sig, sig_len, NULL, 0, NULL) == MTLLIB_OK);
+	free(sig);
+	mtllib_sign_free_handle(&handle);
+	assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+	assert(mtllib_sign_get_full_sig(ctx, handle, &sig, &sig_len) == MTLLIB_OK);
+	assert(ctx->signed_ladder_leaf_count == 10);
+	free(sig);
+	mtllib_sign_free_handle(&handle);
+
+	// Power of two aligned leaf counts
+	assert(mtllib_sign_set_ladder_policy(ctx, MTLLIB_LADDER_POLICY_ALIGNED, 8) == MTLLIB_OK);
+	for (index = 10; index < 16; index++)
+	{
+		assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+		assert(mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) == MTLLIB_OK);
+		assert(ctx->signed_ladder_leaf_count == ((index + 1 == 16) ? 16 : 10));
+		free(ladder);
+	}
+	assert(ladder_len == 12 + 24 + 4 + 7856);
+
+	// Time interval
+	assert(mtllib_sign_set_ladder_policy(ctx, MTLLIB_LADDER_POLICY_INTERVAL, 3600000) == MTLLIB_OK);
+	assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+	mtllib_sign_free_handle(&handle);
+	assert(mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) == MTLLIB_OK);
+	assert(ctx->signed_ladder_leaf_count == 16);
+	free(ladder);
+	assert(mtllib_sign_set_ladder_policy(ctx, MTLLIB_LADDER_POLICY_INTERVAL, 0) == MTLLIB_OK);
+	assert(mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) == MTLLIB_OK);
+	assert(ctx->signed_ladder_leaf_count == 17);
+	free(ladder);
+
+	assert(mtllib_sign_set_ladder_policy(NULL, MTLLIB_LADDER_POLICY_ALWAYS, 0) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_set_ladder_policy(ctx, MTLLIB_LADDER_POLICY_EVERY_N, 0) == MTLLIB_BAD_VALUE);
+	assert(mtllib_sign_set_ladder_policy(ctx, MTLLIB_LADDER_POLICY_ALIGNED, 0) == MTLLIB_BAD_VALUE);
+	assert(mtllib_sign_set_ladder_policy(ctx, MTLLIB_LADDER_POLICY_ALIGNED, 12) == MTLLIB_BAD_VALUE);
+	assert(mtllib_sign_set_ladder_policy(ctx, (MTLLIB_LADDER_POLICY)7, 1) == MTLLIB_BAD_VALUE);
+	assert(ctx->ladder_policy == MTLLIB_LADDER_POLICY_INTERVAL);
+
+	mtllib_sign_free_handle(&first);
+	mtllib_key_free(ctx);
+	return 0;
+}
+
+uint8_t mtltest_mtllib_sign_background(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTL_HANDLE *handles[20];
+	size_t buffer_no_ctx_size = 153;
+	uint8_t msg[] = "Test Message";
+	size_t msg_len = 13;
+	size_t index = 0;
+	uint8_t *ladder;
+	size_t ladder_len;
+	uint8_t *sig;
+	size_t sig_len;
+	MTLLIB_STATUS result;
+	struct timespec delay = {0, 1000000};
+	uint8_t buffer_no_ctx[] =
+		{0x00, 0x00, 0x00, 0x15, 0x53, 0x4c, 0x48, 0x2d, 0x44, 0x53, 0x41, 0x2d, 0x4d, 0x54, 0x4c, 0x2d,
+		 0x53, 0x48, 0x41, 0x32, 0x2d, 0x31, 0x32, 0x38, 0x53, 0x00, 0x00, 0x00, 0x40, 0x79, 0x11, 0xc8,
+		 0x41, 0x32, 0x11, 0x3a, 0x53, 0x86, 0x75, 0x37, 0xf4, 0x45, 0x4c, 0xf3, 0xa0, 0x40, 0x74, 0xab,
+		 0x4b, 0xb4, 0x82, 0x9e, 0x85, 0x1a, 0x77, 0x3e, 0xb8, 0xc0, 0x5e, 0x2b, 0x2c, 0x5c, 0x23, 0x57,
+		 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4, 0xdc, 0xfa, 0xd1, 0x78,
+		 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56, 0x86, 0x00, 0x00, 0x00,
+		 0x20, 0x5c, 0x23, 0x57, 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4,
+		 0xdc, 0xfa, 0xd1, 0x78, 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56,
+		 0x86, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x32, 0x34, 0xf0, 0xf5, 0xbe,
+		 0x58, 0xc4, 0xc6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10};
+
+	assert(mtllib_key_from_buffer(buffer_no_ctx, buffer_no_ctx_size, &ctx) == MTLLIB_OK);
+	assert(mtllib_sign_start_background(ctx) == MTLLIB_OK);
+	assert(ctx->signer != NULL);
+	assert(mtllib_sign_start_background(ctx) == MTLLIB_OK);
+
+	// Appends and condensed signatures do not wait on the ladder
+	for (index = 0; index < 20; index++)
+	{
+		assert(mtllib_sign_append(ctx, msg, msg_len, &handles[index]) == MTLLIB_OK);
+		assert(mtllib_sign_get_condensed_sig(ctx, handles[index], &sig, &sig_len) == MTLLIB_OK);
+		free(sig);
+		result = mtllib_sign_get_full_sig(ctx, handles[index], &sig, &sig_len);
+		assert((result == MTLLIB_OK) || (result == MTLLIB_NO_LADDER));
+		if (result == MTLLIB_OK)
+		{
+			free(sig);
+		}
+	}
+
+	// A ladder covering the first leaf is published eventually
+	for (index = 0; index < 5000; index++)
+	{
+		result = mtllib_sign_get_signed_ladder_covering(ctx, 0, &ladder, &ladder_len);
+		if (result != MTLLIB_NO_LADDER)
+		{
+			break;
+		}
+		nanosleep(&delay, NULL);
+	}
+	assert(result == MTLLIB_OK);
+	free(ladder);
+
+	// Stopping signs the newest ladder before the thread exits
+	assert(mtllib_sign_stop_background(ctx) == MTLLIB_OK);
+	assert(ctx->signer == NULL);
+	assert(mtllib_sign_stop_background(ctx) == MTLLIB_OK);
+	assert(ctx->signed_ladder_leaf_count == 20);
+	assert(mtllib_sign_get_signed_ladder_covering(ctx, 19, &ladder, &ladder_len) == MTLLIB_OK);
+	assert(ladder_len == 12 + (2 * 24) + 4 + 7856);
+	free(ladder);
+	assert(mtllib_sign_get_signed_ladder_covering(ctx, 20, &ladder, &ladder_len) == MTLLIB_NO_LADDER);
+	assert(ladder == NULL);
+	assert(mtllib_sign_get_full_sig(ctx, handles[19], &sig, &sig_len) == MTLLIB_OK);
+	free(sig);
+
+	assert(mtllib_sign_start_background(NULL) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_stop_background(NULL) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_get_signed_ladder_covering(NULL, 0, &ladder, &ladder_len) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_get_signed_ladder_covering(ctx, 0, NULL, &ladder_len) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_get_signed_ladder_covering(ctx, 0, &ladder, NULL) == MTLLIB_NULL_PARAMS);
+
+	// Freeing the key also stops a running signer
+	assert(mtllib_sign_start_background(ctx) == MTLLIB_OK);
+	for (index = 0; index < 20; index++)
+	{
+		mtllib_sign_free_handle(&handles[index]);
+	}
+	mtllib_key_free(ctx);
+	return 0;
+}
+
+uint8_t mtltest_mtllib_sign_background_free(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTL_HANDLE *handle = NULL;
+	uint8_t msg[] = "Test Message";
+	size_t index = 0;
+
+	// Free the key while a ladder job is queued or being signed
+	for (index = 0; index < 3; index++)
+	{
+		assert(mtllib_key_new("SLH-DSA-MTL-SHA2-128S", &ctx, NULL) == MTLLIB_OK);
+		assert(mtllib_sign_start_background(ctx) == MTLLIB_OK);
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+		assert(mtllib_sign_append(ctx, msg, sizeof(msg), &handle) == MTLLIB_OK);
+		mtllib_sign_free_handle(&handle);
+		mtllib_key_free(ctx);
+		ctx = NULL;
+	}
+	return 0;
+}
+
+/** Number of messages each signer thread appends */
+#define MTLTEST_SIGNER_LEAVES 8
+
+/**
+ * Append messages from a signer thread and check their full signatures
+ */
+static void *mtltest_mtllib_signer(void *arg)
+{
+	MTLLIB_CTX *ctx = (MTLLIB_CTX *)arg;
+	MTL_HANDLE *handle = NULL;
+	char msg[32];
+	uint8_t *sig = NULL;
+	size_t sig_len = 0;
+	MTLLIB_STATUS result;
+	uint32_t index;
+
+	for (index = 0; index < MTLTEST_SIGNER_LEAVES; index++)
+	{
+		sprintf(msg, "Signer Msg %u", index);
+		assert(mtllib_sign_append(ctx, (uint8_t *)msg, strlen(msg), &handle) == MTLLIB_OK);
+
+		// The leaf is not in a ladder yet while a leaf before it is
+		// still being hashed, or before the background signer gets to it
+		result = mtllib_sign_get_full_sig(ctx, handle, &sig, &sig_len);
+		assert((result == MTLLIB_OK) || (result == MTLLIB_NO_LADDER));
+		if (result == MTLLIB_OK)
+		{
+			assert(mtllib_verify(ctx, (uint8_t *)msg, strlen(msg), sig, sig_len, NULL, 0, NULL) == MTLLIB_OK);
+			free(sig);
+		}
+		mtllib_sign_free_handle(&handle);
+	}
+	return NULL;
+}
+
+uint8_t mtltest_mtllib_sign_threads(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	pthread_t signers[4];
+	uint8_t *ladder = NULL;
+	size_t ladder_len = 0;
+	size_t index = 0;
+	uint32_t round;
+
+	assert(mtllib_key_new("SLH-DSA-MTL-SHA2-128S", &ctx, NULL) == MTLLIB_OK);
+
+	// Without a signer every reader signs the ladder it returns, and
+	// with one the appends queue ladders for it from every thread
+	for (round = 0; round < 2; round++)
+	{
+		if (round == 1)
+		{
+			assert(mtllib_sign_start_background(ctx) == MTLLIB_OK);
+		}
+		for (index = 0; index < 4; index++)
+		{
+			assert(pthread_create(&signers[index], NULL, mtltest_mtllib_signer, ctx) == 0);
+		}
+		for (index = 0; index < 4; index++)
+		{
+			assert(pthread_join(signers[index], NULL) == 0);
+		}
+	}
+
+	// The last ladder signed covers every appended leaf
+	assert(mtllib_sign_stop_background(ctx) == MTLLIB_OK);
+	assert(mtl_snapshot(ctx->mtl) == 2 * 4 * MTLTEST_SIGNER_LEAVES);
+	assert(ctx->signed_ladder_leaf_count == 2 * 4 * MTLTEST_SIGNER_LEAVES);
+	assert(mtllib_sign_get_signed_ladder_covering(ctx, (2 * 4 * MTLTEST_SIGNER_LEAVES) - 1,
+						      &ladder, &ladder_len) == MTLLIB_OK);
+	assert(mtllib_verify_signed_ladder(ctx, ladder, ladder_len) == MTLLIB_OK);
+	free(ladder);
+
+	mtllib_key_free(ctx);
+	return 0;
+}
+
 uint8_t mtltest_mtllib_sign_get_full_sig(void)
 {
 	MTLLIB_CTX *ctx = NULL;
@@ -867,6 +1673,212 @@ uint8_t mtltest_mtllib_sign_get_full_sig(void)
 	mtllib_key_free(ctx);
 	return 0;
 }
+uint8_t mtltest_mtllib_sign_stream(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTL_HANDLE *handle = NULL;
+	MTL_HANDLE *handle_large = NULL;
+	MTLLIB_SIGN_STREAM *sign_stream = NULL;
+	MTLLIB_VERIFY_STREAM *verify_stream = NULL;
+	size_t buffer_no_ctx_size = 153;
+	size_t msg_len = 70000;
+	size_t chunk = 4096;
+	uint8_t *msg = NULL;
+	uint8_t short_msg[] = "Test Message";
+	size_t index = 0;
+	size_t condensed_len = 0;
+	uint8_t *sig;
+	size_t siglen;
+	uint8_t buffer_no_ctx[] =
+		{0x00, 0x00, 0x00, 0x15, 0x53, 0x4c, 0x48, 0x2d, 0x44, 0x53, 0x41, 0x2d, 0x4d, 0x54, 0x4c, 0x2d,
+		 0x53, 0x48, 0x41, 0x32, 0x2d, 0x31, 0x32, 0x38, 0x53, 0x00, 0x00, 0x00, 0x40, 0x79, 0x11, 0xc8,
+		 0x41, 0x32, 0x11, 0x3a, 0x53, 0x86, 0x75, 0x37, 0xf4, 0x45, 0x4c, 0xf3, 0xa0, 0x40, 0x74, 0xab,
+		 0x4b, 0xb4, 0x82, 0x9e, 0x85, 0x1a, 0x77, 0x3e, 0xb8, 0xc0, 0x5e, 0x2b, 0x2c, 0x5c, 0x23, 0x57,
+		 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4, 0xdc, 0xfa, 0xd1, 0x78,
+		 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56, 0x86, 0x00, 0x00, 0x00,
+		 0x20, 0x5c, 0x23, 0x57, 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4,
+		 0xdc, 0xfa, 0xd1, 0x78, 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56,
+		 0x86, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x32, 0x34, 0xf0, 0xf5, 0xbe,
+		 0x58, 0xc4, 0xc6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10};
+
+	// Longer than the 16 bit message lengths used to allow
+	msg = malloc(msg_len);
+	assert(msg != NULL);
+	for (index = 0; index < msg_len; index++)
+	{
+		msg[index] = (uint8_t)(index * 13);
+	}
+
+	assert(mtllib_key_from_buffer(buffer_no_ctx, buffer_no_ctx_size, &ctx) == MTLLIB_OK);
+
+	// Sign the large message in pieces
+	assert(mtllib_sign_init(ctx, &sign_stream) == MTLLIB_OK);
+	for (index = 0; index < msg_len; index += chunk)
+	{
+		assert(mtllib_sign_update(sign_stream, msg + index,
+								  (msg_len - index < chunk) ? msg_len - index : chunk) == MTLLIB_OK);
+	}
+	assert(mtllib_sign_final(sign_stream, &handle_large) == MTLLIB_OK);
+	assert(handle_large->leaf_index == 0);
+
+	// A freed stream gives its leaf back
+	assert(mtllib_sign_init(ctx, &sign_stream) == MTLLIB_OK);
+	assert(ctx->mtl->nodes.leaf_count == 2);
+	assert(mtllib_sign_update(sign_stream, short_msg, sizeof(short_msg)) == MTLLIB_OK);
+	mtllib_sign_free_stream(&sign_stream);
+	assert(sign_stream == NULL);
+	assert(ctx->mtl->nodes.leaf_count == 1);
+
+	// The one shot append takes the whole message as well
+	assert(mtllib_sign_append(ctx, msg, msg_len, &handle) == MTLLIB_OK);
+	assert(handle->leaf_index == 1);
+	for (index = 0; index < 6; index++)
+	{
+		mtllib_sign_free_handle(&handle);
+		assert(mtllib_sign_append(ctx, short_msg, sizeof(short_msg), &handle) == MTLLIB_OK);
+	}
+
+	// Verify the streamed signature with the one shot and streamed verify
+	assert(mtllib_sign_get_full_sig(ctx, handle_large, &sig, &siglen) == MTLLIB_OK);
+	assert(mtllib_verify(ctx, msg, msg_len, sig, siglen, NULL, 0, NULL) == MTLLIB_OK);
+	assert(mtllib_verify_init(ctx, sig, siglen, &verify_stream) == MTLLIB_OK);
+	for (index = 0; index < msg_len; index += chunk)
+	{
+		assert(mtllib_verify_update(verify_stream, msg + index,
+									(msg_len - index < chunk) ? msg_len - index : chunk) == MTLLIB_OK);
+	}
+	assert(mtllib_verify_final(verify_stream, NULL, 0, &condensed_len) == MTLLIB_OK);
+	assert(condensed_len == 88);
+
+	// A changed message does not verify
+	msg[msg_len - 1] ^= 0x01;
+	assert(mtllib_verify_init(ctx, sig, siglen, &verify_stream) == MTLLIB_OK);
+	assert(mtllib_verify_update(verify_stream, msg, msg_len) == MTLLIB_OK);
+	assert(mtllib_verify_final(verify_stream, NULL, 0, NULL) == MTLLIB_BOGUS_CRYPTO);
+	msg[msg_len - 1] ^= 0x01;
+	free(sig);
+
+	// The one shot signature of the large message verifies in pieces
+	handle->leaf_index = 1;
+	assert(mtllib_sign_get_full_sig(ctx, handle, &sig, &siglen) == MTLLIB_OK);
+	assert(mtllib_verify_init(ctx, sig, siglen, &verify_stream) == MTLLIB_OK);
+	assert(mtllib_verify_update(verify_stream, msg, 1) == MTLLIB_OK);
+	assert(mtllib_verify_update(verify_stream, msg + 1, msg_len - 1) == MTLLIB_OK);
+	assert(mtllib_verify_final(verify_stream, NULL, 0, NULL) == MTLLIB_OK);
+
+	// Without a ladder there is nothing to verify against
+	assert(mtllib_verify_init(ctx, sig, condensed_len, &verify_stream) == MTLLIB_OK);
+	assert(mtllib_verify_update(verify_stream, msg, msg_len) == MTLLIB_OK);
+	assert(mtllib_verify_final(verify_stream, NULL, 0, NULL) == MTLLIB_NO_LADDER);
+
+	// NULL parameters
+	assert(mtllib_sign_init(NULL, &sign_stream) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_init(ctx, NULL) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_update(NULL, msg, msg_len) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_sign_final(NULL, &handle) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_verify_init(NULL, sig, siglen, &verify_stream) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_verify_init(ctx, NULL, siglen, &verify_stream) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_verify_init(ctx, sig, siglen, NULL) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_verify_init(ctx, sig, 4, &verify_stream) == MTLLIB_BOGUS_CRYPTO);
+	assert(verify_stream == NULL);
+	assert(mtllib_verify_update(NULL, msg, msg_len) == MTLLIB_NULL_PARAMS);
+	assert(mtllib_verify_final(NULL, NULL, 0, NULL) == MTLLIB_NULL_PARAMS);
+	mtllib_sign_free_stream(NULL);
+	mtllib_verify_free_stream(NULL);
+
+	free(sig);
+	free(msg);
+	mtllib_sign_free_handle(&handle);
+	mtllib_sign_free_handle(&handle_large);
+	mtllib_key_free(ctx);
+	return 0;
+}
+
+uint8_t mtltest_mtllib_sign_stream_open(void)
+{
+	MTLLIB_CTX *ctx = NULL;
+	MTLLIB_CTX *ctx_copy = NULL;
+	uint8_t *key = NULL;
+	size_t key_len = 0;
+	uint16_t version;
+	MTL_HANDLE *handle = NULL;
+	MTL_HANDLE *handle_stream = NULL;
+	MTLLIB_SIGN_STREAM *sign_stream = NULL;
+	size_t buffer_no_ctx_size = 153;
+	uint8_t msg0[] = "Test Message 0";
+	uint8_t msg1[] = "Test Message 1";
+	uint8_t msg2[] = "Test Message 2";
+	uint8_t msg3[] = "Test Message 3";
+	uint8_t *batch[2] = {msg2, msg3};
+	size_t batch_lens[2] = {sizeof(msg2), sizeof(msg3)};
+	MTL_HANDLE *batch_handles[2];
+	size_t index;
+	uint8_t *ladder;
+	size_t ladder_len;
+	uint8_t *sig;
+	size_t siglen;
+	uint8_t buffer_no_ctx[] =
+		{0x00, 0x00, 0x00, 0x15, 0x53, 0x4c, 0x48, 0x2d, 0x44, 0x53, 0x41, 0x2d, 0x4d, 0x54, 0x4c, 0x2d,
+		 0x53, 0x48, 0x41, 0x32, 0x2d, 0x31, 0x32, 0x38, 0x53, 0x00, 0x00, 0x00, 0x40, 0x79, 0x11, 0xc8,
+		 0x41, 0x32, 0x11, 0x3a, 0x53, 0x86, 0x75, 0x37, 0xf4, 0x45, 0x4c, 0xf3, 0xa0, 0x40, 0x74, 0xab,
+		 0x4b, 0xb4, 0x82, 0x9e, 0x85, 0x1a, 0x77, 0x3e, 0xb8, 0xc0, 0x5e, 0x2b, 0x2c, 0x5c, 0x23, 0x57,
+		 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4, 0xdc, 0xfa, 0xd1, 0x78,
+		 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56, 0x86, 0x00, 0x00, 0x00,
+		 0x20, 0x5c, 0x23, 0x57, 0x30, 0x9a, 0x37, 0x07, 0xd1, 0x08, 0xfe, 0x5c, 0x31, 0xe5, 0xdc, 0xb4,
+		 0xdc, 0xfa, 0xd1, 0x78, 0xfc, 0xaa, 0x51, 0x16, 0xb6, 0x69, 0xb8, 0xb2, 0x63, 0x23, 0xd5, 0x56,
+		 0x86, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x32, 0x34, 0xf0, 0xf5, 0xbe,
+		 0x58, 0xc4, 0xc6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10};
+
+	assert(mtllib_key_from_buffer(buffer_no_ctx, buffer_no_ctx_size, &ctx) == MTLLIB_OK);
+	assert(mtllib_sign_append(ctx, msg0, sizeof(msg0), &handle) == MTLLIB_OK);
+
+	// A ladder signed while a leaf is reserved only claims committed leaves
+	assert(mtllib_sign_init(ctx, &sign_stream) == MTLLIB_OK);
+	assert(mtllib_sign_get_signed_ladder(ctx, &ladder, &ladder_len) == MTLLIB_OK);
+	free(ladder);
+	assert(ctx->signed_ladder_leaf_count == 1);
+	assert(mtllib_sign_update(sign_stream, msg1, sizeof(msg1)) == MTLLIB_OK);
+
+	// Keys written while the leaf is reserved leave it out
+	for (version = MTLLIB_KEY_FORMAT_V1; version <= MTLLIB_KEY_FORMAT_V2; version++)
+	{
+		key_len = mtllib_key_to_buffer_version(ctx, &key, version);
+		assert(key_len > 0);
+		assert(mtllib_key_from_buffer(key, key_len, &ctx_copy) == MTLLIB_OK);
+		assert(ctx_copy->mtl->nodes.leaf_count == 1);
+		assert(mtl_snapshot(ctx_copy->mtl) == 1);
+		mtllib_key_free(ctx_copy);
+		ctx_copy = NULL;
+		free(key);
+	}
+
+	// A batch appended meanwhile goes after the reserved leaf
+	assert(mtllib_sign_append_many(ctx, batch, batch_lens, 2, batch_handles) == MTLLIB_OK);
+	assert(batch_handles[0]->leaf_index == 2);
+	assert(batch_handles[1]->leaf_index == 3);
+	assert(mtl_snapshot(ctx->mtl) == 1);
+
+	assert(mtllib_sign_final(sign_stream, &handle_stream) == MTLLIB_OK);
+	assert(handle_stream->leaf_index == 1);
+	assert(mtl_snapshot(ctx->mtl) == 4);
+	for (index = 0; index < 2; index++)
+	{
+		assert(mtllib_sign_get_full_sig(ctx, batch_handles[index], &sig, &siglen) == MTLLIB_OK);
+		assert(mtllib_verify(ctx, batch[index], batch_lens[index], sig, siglen, NULL, 0, NULL) == MTLLIB_OK);
+		free(sig);
+		mtllib_sign_free_handle(&batch_handles[index]);
+	}
+
+	assert(mtllib_sign_get_full_sig(ctx, handle_stream, &sig, &siglen) == MTLLIB_OK);
+	assert(mtllib_verify(ctx, msg1, sizeof(msg1), sig, siglen, NULL, 0, NULL) == MTLLIB_OK);
+	free(sig);
+
+	mtllib_sign_free_handle(&handle);
+	mtllib_sign_free_handle(&handle_stream);
+	mtllib_key_free(ctx);
+	return 0;
+}
+
 uint8_t mtltest_mtllib_sign_get_full_sig_null(void)
 {
 	MTLLIB_CTX *ctx = NULL;
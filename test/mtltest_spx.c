@@ -35,6 +35,7 @@
 #include "mtl_spx.h"
 #include "spx_funcs.h"
 #include <assert.h>
+#include <pthread.h>
 #include <string.h>
 
 #include "mtltest.h"
@@ -45,9 +46,12 @@ uint8_t test_SPX_mtlns_adrs_compressed(void);
 uint8_t test_SPX_mtlns_adrs_full(void);
 uint8_t test_SPX_spx_sha2(void);
 uint8_t test_SPX_spx_shake(void);
+uint8_t test_SPX_spx_sha2_batch(void);
 uint8_t test_SPX_mtl_node_set_hash_message(void);
 uint8_t test_SPX_mtl_node_set_hash_message_sha2(void);
 uint8_t test_SPX_mtl_node_set_hash_message_shake(void);
+uint8_t test_SPX_mtl_node_set_hash_message_stream(void);
+uint8_t test_SPX_mtl_node_set_hash_message_cached(void);
 uint8_t test_SPX_mtl_node_set_hash_leaf(void);
 uint8_t test_SPX_mtl_node_set_hash_leaf_robust(void);
 uint8_t test_SPX_mtl_node_set_hash_leaf_sha2(void);
@@ -56,8 +60,16 @@ uint8_t test_SPX_mtl_node_set_hash_int(void);
 uint8_t test_SPX_mtl_node_set_hash_int_robust(void);
 uint8_t test_SPX_mtl_node_set_hash_int_sha2(void);
 uint8_t test_SPX_mtl_node_set_hash_int_shake(void);
+uint8_t test_SPX_spx_params_init_sha2(void);
+uint8_t test_SPX_spx_params_init_shake(void);
+uint8_t test_SPX_mtl_node_set_hash_shake_batch(void);
+uint8_t test_SPX_mtl_node_set_hash_sha2_batch(void);
+uint8_t test_SPX_spx_node_funcs(void);
+uint8_t test_SPX_spx_params_init_adrs(void);
+uint8_t test_SPX_hash_threads(void);
 uint8_t test_SPX_spx_mtl_prf_sha2(void);
 uint8_t test_SPX_spx_mtl_prf_shake(void);
+uint8_t test_SPX_provider_mode(void);
 
 uint8_t mtltest_spx(void)
 {
@@ -70,12 +82,18 @@ uint8_t mtltest_spx(void)
 		 "Verify the SHA2 implementation for tree hashing");
 	RUN_TEST(test_SPX_spx_shake,
 		 "Verify the SHAKE implementation for tree hashing");
+	RUN_TEST(test_SPX_spx_sha2_batch,
+		 "Verify the batched SHA2 implementation for tree hashing");
 	RUN_TEST(test_SPX_mtl_node_set_hash_message,
 		 "Verify the SPX message hash functions");
 	RUN_TEST(test_SPX_mtl_node_set_hash_message_sha2,
 		 "Verify the SPX SHA2 message hash wrapper");
 	RUN_TEST(test_SPX_mtl_node_set_hash_message_shake,
 		 "Verify the SPX SHAKE message hash wrapper");
+	RUN_TEST(test_SPX_mtl_node_set_hash_message_stream,
+		 "Verify the SPX message hash fed in pieces");
+	RUN_TEST(test_SPX_mtl_node_set_hash_message_cached,
+		 "Verify the SPX message hash with precomputed PRF and separator");
 	RUN_TEST(test_SPX_mtl_node_set_hash_leaf,
 		 "Verify the SPX leaf hashing function");
 	RUN_TEST(test_SPX_mtl_node_set_hash_leaf_robust,
@@ -92,10 +110,26 @@ uint8_t mtltest_spx(void)
 		 "Verify the SPX SHA2 int hashing wrapper");
 	RUN_TEST(test_SPX_mtl_node_set_hash_int_shake,
 		 "Verify the SPX SHAKE int hashing wrapper");
+	RUN_TEST(test_SPX_spx_params_init_sha2,
+		 "Verify the precomputed SHA2 seed state");
+	RUN_TEST(test_SPX_spx_params_init_shake,
+		 "Verify the SHAKE sponge and precomputed seed state");
+	RUN_TEST(test_SPX_mtl_node_set_hash_shake_batch,
+		 "Verify the batched SPX SHAKE leaf and int hashing");
+	RUN_TEST(test_SPX_mtl_node_set_hash_sha2_batch,
+		 "Verify the batched SPX SHA2 leaf and int hashing");
+	RUN_TEST(test_SPX_spx_node_funcs,
+		 "Verify the parameter set specific node hash kernels");
+	RUN_TEST(test_SPX_spx_params_init_adrs,
+		 "Verify the prebuilt ADRS templates");
+	RUN_TEST(test_SPX_hash_threads,
+		 "Verify shared parameters hash the same on many threads");
 	RUN_TEST(test_SPX_spx_mtl_prf_sha2,
 		 "Verify the SPX SHA2 PRF message function");
 	RUN_TEST(test_SPX_spx_mtl_prf_shake,
 		 "Verify the SPX SHAKE PRF message function");
+	RUN_TEST(test_SPX_provider_mode,
+		 "Verify the SPX hashes with every digest from a provider");
 	return 0;
 }
 
@@ -209,6 +243,51 @@ uint8_t test_SPX_spx_sha2(void)
 	return 0;
 }
 
+/**
+ * Verify the batched spx_sha2 hashing function
+ */
+uint8_t test_SPX_spx_sha2_batch(void)
+{
+	uint8_t seed[64] = { 0x55 };
+	uint8_t adrs[9][22];
+	uint8_t data[9][64];
+	uint8_t hash[9][EVP_MAX_MD_SIZE];
+	uint8_t ref[EVP_MAX_MD_SIZE];
+	uint8_t *adrs_ptrs[9];
+	uint8_t *data_ptrs[9];
+	uint8_t *hash_ptrs[9];
+	uint32_t hash_lens[] = { 16, 24, 32 };
+	uint32_t len_index;
+	uint32_t index;
+
+	for (index = 0; index < 9; index++) {
+		memcpy(adrs[index], adrs_compress, 22);
+		adrs[index][21] = (uint8_t) index;
+		memset(data[index], (int)(0x30 + index), 64);
+		adrs_ptrs[index] = adrs[index];
+		data_ptrs[index] = data[index];
+		hash_ptrs[index] = hash[index];
+	}
+
+	// Every batch entry matches spx_sha2 for the same inputs
+	for (len_index = 0; len_index < 3; len_index++) {
+		assert(spx_sha2_batch(&seed[0], hash_lens[len_index], adrs_ptrs,
+				      22, data_ptrs, 2 * hash_lens[len_index],
+				      hash_ptrs, hash_lens[len_index], 9) == 0);
+		for (index = 0; index < 9; index++) {
+			memset(ref, 0, EVP_MAX_MD_SIZE);
+			assert(spx_sha2(&seed[0], hash_lens[len_index], adrs[index],
+					22, data[index], 2 * hash_lens[len_index],
+					ref, hash_lens[len_index]) == 0);
+			assert(memcmp(hash[index], ref, hash_lens[len_index]) == 0);
+		}
+	}
+
+	assert(spx_sha2_batch(&seed[0], 32, NULL, 22, data_ptrs, 64,
+			      hash_ptrs, 32, 9) == MTL_NULL_PTR);
+	return 0;
+}
+
 /**
  * Verify the spx_shake hashing function
  */
@@ -631,6 +710,246 @@ uint8_t test_SPX_mtl_node_set_hash_message_shake(void)
 	return 0;
 }
 
+/**
+ * Verify a message hashed in pieces matches the one shot message hash
+ */
+uint8_t test_SPX_mtl_node_set_hash_message_stream(void)
+{
+	uint8_t msg_buffer[1000];
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	uint8_t hash_stream[EVP_MAX_MD_SIZE];
+	uint32_t hash_lens[] = { 16, 32, 32 };
+	uint8_t algorithms[] = { SPX_MTL_SHA2, SPX_MTL_SHA2, SPX_MTL_SHAKE };
+	uint32_t pieces[] = { 1, 7, 128, 300 };
+	SERIESID sid;
+	char* context_str = "MTL_TEST_STR";
+	uint8_t* rmtl_ptr = NULL;
+	uint32_t rmtl_len = 0;
+	uint8_t* rmtl_stream = NULL;
+	uint32_t rmtl_stream_len = 0;
+	void *state = NULL;
+	uint32_t offset;
+	uint32_t piece;
+	uint32_t index;
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	params->pk_seed.length = 32;
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	params->pk_root.length = 32;
+	memcpy(&params->prf.data, &seed[0], 32);
+	params->prf.length = 32;
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+	for (index = 0; index < sizeof(msg_buffer); index++) {
+		msg_buffer[index] = (uint8_t)(index * 7);
+	}
+
+	for (index = 0; index < 3; index++) {
+		rmtl_ptr = NULL;
+		rmtl_len = 0;
+		assert(spx_mtl_node_set_hash_message
+		       (params, &sid, 5, (uint8_t *) & randomizer[0],
+			randomizer_len, &msg_buffer[0], sizeof(msg_buffer),
+			&hash[0], hash_lens[index], context_str, &rmtl_ptr,
+			&rmtl_len, algorithms[index]) == MTL_OK);
+
+		// Generated randomness matches and pieces of any size work
+		rmtl_stream = NULL;
+		rmtl_stream_len = 0;
+		assert(spx_mtl_node_set_hash_message_init
+		       (params, &sid, 5, (uint8_t *) & randomizer[0],
+			randomizer_len, hash_lens[index], context_str,
+			&rmtl_stream, &rmtl_stream_len, &state,
+			algorithms[index]) == MTL_OK);
+		assert(rmtl_stream_len == rmtl_len);
+		assert(memcmp(rmtl_stream, rmtl_ptr, rmtl_len) == 0);
+		offset = 0;
+		for (piece = 0; offset < sizeof(msg_buffer); piece = (piece + 1) % 4) {
+			if (offset + pieces[piece] > sizeof(msg_buffer)) {
+				pieces[piece] = sizeof(msg_buffer) - offset;
+			}
+			assert(spx_mtl_node_set_hash_message_update
+			       (state, &msg_buffer[offset], pieces[piece]) == MTL_OK);
+			offset += pieces[piece];
+		}
+		assert(spx_mtl_node_set_hash_message_update(state, NULL, 0) == MTL_OK);
+		assert(spx_mtl_node_set_hash_message_final
+		       (state, &hash_stream[0], hash_lens[index]) == MTL_OK);
+		assert(memcmp(hash, hash_stream, hash_lens[index]) == 0);
+		free(rmtl_stream);
+
+		// Provided randomness (verification) gives the same hash
+		rmtl_stream_len = rmtl_len;
+		assert(spx_mtl_node_set_hash_message_init
+		       (params, &sid, 5, (uint8_t *) & randomizer[0],
+			randomizer_len, hash_lens[index], context_str,
+			&rmtl_ptr, &rmtl_stream_len, &state,
+			algorithms[index]) == MTL_OK);
+		assert(spx_mtl_node_set_hash_message_update
+		       (state, &msg_buffer[0], sizeof(msg_buffer)) == MTL_OK);
+		memset(hash_stream, 0, EVP_MAX_MD_SIZE);
+		assert(spx_mtl_node_set_hash_message_final
+		       (state, &hash_stream[0], hash_lens[index]) == MTL_OK);
+		assert(memcmp(hash, hash_stream, hash_lens[index]) == 0);
+
+		// Discarding a stream frees it
+		assert(spx_mtl_node_set_hash_message_init
+		       (params, &sid, 5, (uint8_t *) & randomizer[0],
+			randomizer_len, hash_lens[index], context_str,
+			&rmtl_ptr, &rmtl_stream_len, &state,
+			algorithms[index]) == MTL_OK);
+		assert(spx_mtl_node_set_hash_message_final(state, NULL, 0) == MTL_OK);
+		free(rmtl_ptr);
+	}
+
+	// Invalid parameters
+	rmtl_len = 0;
+	assert(spx_mtl_node_set_hash_message_init
+	       (NULL, &sid, 5, (uint8_t *) & randomizer[0], randomizer_len, 32,
+		NULL, &rmtl_ptr, &rmtl_len, &state, SPX_MTL_SHA2) != MTL_OK);
+	assert(state == NULL);
+	assert(spx_mtl_node_set_hash_message_init
+	       (params, &sid, 5, (uint8_t *) & randomizer[0], randomizer_len, 32,
+		NULL, &rmtl_ptr, &rmtl_len, NULL, SPX_MTL_SHA2) != MTL_OK);
+	assert(spx_mtl_node_set_hash_message_update(NULL, &msg_buffer[0], 1) != MTL_OK);
+	assert(spx_mtl_node_set_hash_message_final(NULL, &hash[0], 32) != MTL_OK);
+
+	free(params);
+	return 0;
+}
+
+/**
+ * Verify the precomputed PRF key pads and separator give the same hash
+ */
+uint8_t test_SPX_mtl_node_set_hash_message_cached(void)
+{
+	uint8_t msg_buffer[] = "test_SPX_mtl_node_set_hash_message";
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	uint8_t hash_cached[EVP_MAX_MD_SIZE];
+	uint32_t hash_lens[] = { 16, 32, 32 };
+	uint8_t algorithms[] = { SPX_MTL_SHA2, SPX_MTL_SHA2, SPX_MTL_SHAKE };
+	SERIESID sid;
+	char context_str[] = "MTL_TEST_STR";
+	char context_copy[] = "MTL_TEST_STR";
+	char long_str[UINT8_MAX + 2];
+	uint8_t* rmtl_ptr = NULL;
+	uint32_t rmtl_len = 0;
+	uint8_t* rmtl_cached = NULL;
+	uint32_t rmtl_cached_len = 0;
+	uint32_t index;
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	SPX_PARAMS *plain = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	params->pk_seed.length = 32;
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	params->pk_root.length = 32;
+	memcpy(&params->prf.data, &pubkey[0], 32);
+	params->prf.length = 32;
+	memcpy(plain, params, sizeof(SPX_PARAMS));
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+
+	for (index = 0; index < 3; index++) {
+		assert(spx_params_init_sha2(params, hash_lens[index]) == MTL_OK);
+		assert(spx_params_init_msg_sep(params, context_str) == MTL_OK);
+		if (algorithms[index] == SPX_MTL_SHA2) {
+			assert(params->prf_hmac.ready == SPX_STATE_READY);
+		}
+		assert(params->msg_sep.length == 2 + strlen(context_str));
+
+		rmtl_len = 0;
+		assert(spx_mtl_node_set_hash_message
+		       (plain, &sid, 3, (uint8_t *) & randomizer[0],
+			randomizer_len, &msg_buffer[0], 34, &hash[0],
+			hash_lens[index], context_str, &rmtl_ptr, &rmtl_len,
+			algorithms[index]) == MTL_OK);
+		rmtl_cached_len = 0;
+		assert(spx_mtl_node_set_hash_message
+		       (params, &sid, 3, (uint8_t *) & randomizer[0],
+			randomizer_len, &msg_buffer[0], 34, &hash_cached[0],
+			hash_lens[index], context_str, &rmtl_cached,
+			&rmtl_cached_len, algorithms[index]) == MTL_OK);
+		assert(rmtl_len == rmtl_cached_len);
+		assert(memcmp(rmtl_ptr, rmtl_cached, rmtl_len) == 0);
+		assert(memcmp(hash, hash_cached, hash_lens[index]) == 0);
+		free(rmtl_cached);
+
+		// A copy of the context string matches the separator
+		rmtl_cached_len = 0;
+		assert(spx_mtl_node_set_hash_message
+		       (params, &sid, 3, (uint8_t *) & randomizer[0],
+			randomizer_len, &msg_buffer[0], 34, &hash_cached[0],
+			hash_lens[index], context_copy, &rmtl_cached,
+			&rmtl_cached_len, algorithms[index]) == MTL_OK);
+		assert(memcmp(hash, hash_cached, hash_lens[index]) == 0);
+		free(rmtl_cached);
+		rmtl_cached_len = 0;
+		assert(spx_mtl_node_set_hash_message
+		       (params, &sid, 3, (uint8_t *) & randomizer[0],
+			randomizer_len, &msg_buffer[0], 34, &hash_cached[0],
+			hash_lens[index], NULL, &rmtl_cached,
+			&rmtl_cached_len, algorithms[index]) == MTL_OK);
+		assert(memcmp(hash, hash_cached, hash_lens[index]) != 0);
+		free(rmtl_cached);
+		free(rmtl_ptr);
+	}
+
+	// A context string changed in place is not served from the separator
+	context_str[0] ^= 0x01;
+	rmtl_len = 0;
+	assert(spx_mtl_node_set_hash_message
+	       (plain, &sid, 3, (uint8_t *) & randomizer[0], randomizer_len,
+		&msg_buffer[0], 34, &hash[0], 32, context_str, &rmtl_ptr,
+		&rmtl_len, SPX_MTL_SHA2) == MTL_OK);
+	rmtl_cached_len = 0;
+	assert(spx_mtl_node_set_hash_message
+	       (params, &sid, 3, (uint8_t *) & randomizer[0], randomizer_len,
+		&msg_buffer[0], 34, &hash_cached[0], 32, context_str,
+		&rmtl_cached, &rmtl_cached_len, SPX_MTL_SHA2) == MTL_OK);
+	assert(memcmp(rmtl_ptr, rmtl_cached, rmtl_len) == 0);
+	assert(memcmp(hash, hash_cached, 32) == 0);
+	free(rmtl_ptr);
+	free(rmtl_cached);
+	context_str[0] ^= 0x01;
+
+	// A changed SK.prf is not served from the stale key pads
+	params->prf.data[0] ^= 0x01;
+	plain->prf.data[0] ^= 0x01;
+	rmtl_len = 0;
+	assert(spx_mtl_node_set_hash_message
+	       (plain, &sid, 3, (uint8_t *) & randomizer[0], randomizer_len,
+		&msg_buffer[0], 34, &hash[0], 32, context_str, &rmtl_ptr,
+		&rmtl_len, SPX_MTL_SHA2) == MTL_OK);
+	rmtl_cached_len = 0;
+	assert(spx_mtl_node_set_hash_message
+	       (params, &sid, 3, (uint8_t *) & randomizer[0], randomizer_len,
+		&msg_buffer[0], 34, &hash_cached[0], 32, context_str,
+		&rmtl_cached, &rmtl_cached_len, SPX_MTL_SHA2) == MTL_OK);
+	assert(memcmp(rmtl_ptr, rmtl_cached, rmtl_len) == 0);
+	assert(memcmp(hash, hash_cached, 32) == 0);
+	free(rmtl_ptr);
+	free(rmtl_cached);
+
+	// Separator limits
+	memset(long_str, 'a', sizeof(long_str) - 1);
+	long_str[sizeof(long_str) - 1] = 0;
+	assert(spx_params_init_msg_sep(params, long_str) == MTL_BAD_PARAM);
+	assert(params->msg_sep.ready != SPX_STATE_READY);
+	assert(spx_params_init_msg_sep(params, NULL) == MTL_OK);
+	assert(params->msg_sep.length == 2);
+	assert(spx_params_init_msg_sep(NULL, context_str) == MTL_NULL_PTR);
+
+	free(params);
+	free(plain);
+	return 0;
+}
+
 /**
  * Verify the node set leaf hashing function
  */
@@ -1815,6 +2134,745 @@ uint8_t test_SPX_mtl_node_set_hash_int_shake(void)
 	return 0;
 }
 
+/**
+ * Verify the precomputed SHA2 seed state
+ */
+uint8_t test_SPX_spx_params_init_sha2(void)
+{
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	uint8_t ref_hash[EVP_MAX_MD_SIZE];
+	uint8_t data[] = "Test Message";
+	uint8_t other_seed[32];
+	SERIESID sid;
+	uint8_t sha2_1[] = { 0x35, 0x52, 0x06, 0x12, 0xab, 0xb3, 0xfd, 0xeb,
+		0xd3, 0xd4, 0x44, 0x92, 0xca, 0xb6, 0x63, 0x89,
+		0xfa, 0xe6, 0x06, 0x9a, 0x85, 0x56, 0x2f, 0x3c,
+		0x8d, 0x18, 0xaf, 0xf6, 0x8e, 0xa8, 0x28, 0x18
+	};
+	uint8_t sha2_2[] = { 0xd7, 0x15, 0x44, 0x8d, 0x1d, 0xe9, 0xbe, 0x86,
+		0xda, 0xf6, 0xe4, 0x09, 0x69, 0x5e, 0x58, 0xf0,
+		0xe5, 0xf1, 0xa6, 0xe9, 0x2d, 0x2e, 0x09, 0xea,
+		0x5d, 0xf4, 0xc5, 0x30, 0x0a, 0xff, 0xdd, 0xc3
+	};
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	SPX_PARAMS *unprimed = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	params->pk_seed.length = 32;
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	params->pk_root.length = 32;
+	params->robust = 0;
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+
+	assert(spx_params_init_sha2(NULL, 32) == MTL_NULL_PTR);
+	assert(spx_params_init_sha2(params, 32) == MTL_OK);
+	assert(params->sha2_seed.ready == SPX_STATE_READY);
+
+	// Precomputed state gives the same nodes as the unprimed path
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_sha2
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &hash[0], 32) == 0);
+	assert(memcmp(&hash[0], sha2_1, 32) == 0);
+
+	// A SHA-256 hash length does not use the SHA-512 state
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_sha2
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &hash[0], 16) == 0);
+	assert(memcmp(&hash[0], sha2_2, 32) == 0);
+
+	assert(spx_params_init_sha2(params, 16) == MTL_OK);
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_sha2
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &hash[0], 16) == 0);
+	assert(memcmp(&hash[0], sha2_2, 32) == 0);
+
+	// Leaf hashes match parameters without a precomputed state
+	memcpy(unprimed, params, sizeof(SPX_PARAMS));
+	unprimed->sha2_seed.ready = 0;
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	memset(ref_hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_leaf_sha2
+	       (params, &sid, 4, data, 13, &hash[0], 16) == 0);
+	assert(spx_mtl_node_set_hash_leaf_sha2
+	       (unprimed, &sid, 4, data, 13, &ref_hash[0], 16) == 0);
+	assert(memcmp(&hash[0], ref_hash, 16) == 0);
+
+	// A changed seed is not hashed with the stale state
+	memset(other_seed, 0xa5, 32);
+	memcpy(&params->pk_seed.seed, other_seed, 32);
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_sha2
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &hash[0], 16) == 0);
+	assert(memcmp(&hash[0], sha2_2, 16) != 0);
+	assert(spx_params_init_sha2(params, 16) == MTL_OK);
+	memset(ref_hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_sha2
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &ref_hash[0], 16) == 0);
+	assert(memcmp(&hash[0], ref_hash, 16) == 0);
+
+	free(unprimed);
+	free(params);
+	return 0;
+}
+
+/**
+ * Verify the SHAKE sponge and precomputed seed state
+ */
+uint8_t test_SPX_spx_params_init_shake(void)
+{
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	uint8_t ref_hash[EVP_MAX_MD_SIZE];
+	uint8_t long_out[300];
+	uint8_t long_ref[300];
+	uint8_t input[400];
+	size_t input_lens[] = { 1, 135, 136, 137, 141, 272, 277, 400 };
+	uint32_t index;
+	SHAKE256_STATE sponge;
+	EVP_MD_CTX *mdctx;
+	SERIESID sid;
+	uint8_t shake1[] = { 0xfb, 0x72, 0x40, 0xdb, 0x2b, 0x7b, 0x04, 0x0c,
+		0xa1, 0xb2, 0x55, 0x3f, 0xdb, 0xff, 0xe5, 0x59,
+		0x54, 0x80, 0x28, 0x49, 0x60, 0xb8, 0xe4, 0x4d,
+		0x32, 0x65, 0xbc, 0x5e, 0x29, 0x29, 0x64, 0x73
+	};
+
+	// Sponge matches the OpenSSL SHAKE256 around the rate boundaries
+	for (index = 0; index < sizeof(input); index++) {
+		input[index] = (uint8_t) (index * 7 + 3);
+	}
+	for (index = 0; index < sizeof(input_lens) / sizeof(size_t); index++) {
+		mdctx = EVP_MD_CTX_new();
+		assert(mdctx != NULL);
+		assert(EVP_DigestInit_ex(mdctx, EVP_shake256(), NULL) == 1);
+		assert(EVP_DigestUpdate(mdctx, input, input_lens[index]) == 1);
+		assert(EVP_DigestFinalXOF(mdctx, long_ref, sizeof(long_ref)) == 1);
+		EVP_MD_CTX_free(mdctx);
+
+		shake256(long_out, input, input_lens[index], sizeof(long_out));
+		assert(memcmp(long_out, long_ref, sizeof(long_out)) == 0);
+		shake256_init(&sponge);
+		shake256_absorb(&sponge, input, 5 % input_lens[index]);
+		shake256_absorb(&sponge, input + (5 % input_lens[index]),
+				input_lens[index] - (5 % input_lens[index]));
+		shake256_squeeze(long_out, &sponge, sizeof(long_out));
+		assert(memcmp(long_out, long_ref, sizeof(long_out)) == 0);
+	}
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	params->pk_seed.length = 32;
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	params->pk_root.length = 32;
+	params->robust = 0;
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+
+	assert(spx_params_init_shake(NULL) == MTL_NULL_PTR);
+	assert(spx_params_init_shake(params) == MTL_OK);
+	assert(params->shake_seed.ready == SPX_STATE_READY);
+
+	// Precomputed sponge gives the same nodes as the unprimed path
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_shake
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &hash[0], 32) == 0);
+	assert(memcmp(&hash[0], shake1, 32) == 0);
+
+	// A changed seed is not hashed with the stale sponge
+	memset(&params->pk_seed.seed, 0xa5, 32);
+	memset(hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_shake
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &hash[0], 32) == 0);
+	assert(memcmp(&hash[0], shake1, 32) != 0);
+	assert(spx_params_init_shake(params) == MTL_OK);
+	memset(ref_hash, 0, EVP_MAX_MD_SIZE);
+	assert(spx_mtl_node_set_hash_int_shake
+	       (params, &sid, 8, 9, (uint8_t *) & hash_left[0],
+		(uint8_t *) & hash_right[0], &ref_hash[0], 32) == 0);
+	assert(memcmp(&hash[0], ref_hash, 32) == 0);
+
+	free(params);
+	return 0;
+}
+
+/**
+ * Verify the batched SHAKE leaf and int hashing functions
+ */
+uint8_t test_SPX_mtl_node_set_hash_shake_batch(void)
+{
+	uint8_t hashes[9][EVP_MAX_MD_SIZE];
+	uint8_t ref[EVP_MAX_MD_SIZE];
+	uint8_t *hash_ptrs[9];
+	uint8_t *left_ptrs[9];
+	uint8_t *right_ptrs[9];
+	uint8_t *msg_ptrs[9];
+	uint32_t node_left[9];
+	uint32_t node_right[9];
+	uint32_t mode;
+	uint32_t index;
+	SERIESID sid;
+	uint8_t shake1[] = { 0xfb, 0x72, 0x40, 0xdb, 0x2b, 0x7b, 0x04, 0x0c,
+		0xa1, 0xb2, 0x55, 0x3f, 0xdb, 0xff, 0xe5, 0x59,
+		0x54, 0x80, 0x28, 0x49, 0x60, 0xb8, 0xe4, 0x4d,
+		0x32, 0x65, 0xbc, 0x5e, 0x29, 0x29, 0x64, 0x73
+	};
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	params->pk_seed.length = 32;
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	params->pk_root.length = 32;
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+
+	for (index = 0; index < 9; index++) {
+		node_left[index] = 8 + (2 * index);
+		node_right[index] = 9 + (2 * index);
+		left_ptrs[index] = (uint8_t *) hash_left;
+		right_ptrs[index] = (uint8_t *) hash_right;
+		msg_ptrs[index] = (uint8_t *) hash_left;
+		hash_ptrs[index] = hashes[index];
+	}
+
+	// Unprimed, primed and robust parameters match the single path
+	for (mode = 0; mode < 3; mode++) {
+		if (mode == 1) {
+			assert(spx_params_init_shake(params) == MTL_OK);
+		}
+		params->robust = (mode == 2);
+
+		memset(hashes, 0, sizeof(hashes));
+		assert(spx_mtl_node_set_hash_int_shake_batch
+		       (params, &sid, node_left, node_right, left_ptrs,
+			right_ptrs, hash_ptrs, 32, 9) == 0);
+		if (mode < 2) {
+			assert(memcmp(hashes[0], shake1, 32) == 0);
+		}
+		for (index = 0; index < 9; index++) {
+			memset(ref, 0, EVP_MAX_MD_SIZE);
+			assert(spx_mtl_node_set_hash_int_shake
+			       (params, &sid, node_left[index], node_right[index],
+				left_ptrs[index], right_ptrs[index], ref,
+				32) == 0);
+			assert(memcmp(hashes[index], ref, 32) == 0);
+		}
+
+		memset(hashes, 0, sizeof(hashes));
+		assert(spx_mtl_node_set_hash_leaf_shake_batch
+		       (params, &sid, node_left, msg_ptrs, 32, hash_ptrs, 32,
+			9) == 0);
+		for (index = 0; index < 9; index++) {
+			memset(ref, 0, EVP_MAX_MD_SIZE);
+			assert(spx_mtl_node_set_hash_leaf_shake
+			       (params, &sid, node_left[index], msg_ptrs[index],
+				32, ref, 32) == 0);
+			assert(memcmp(hashes[index], ref, 32) == 0);
+		}
+	}
+
+	assert(spx_mtl_node_set_hash_int_shake_batch
+	       (params, &sid, NULL, node_right, left_ptrs, right_ptrs,
+		hash_ptrs, 32, 9) == MTL_NULL_PTR);
+	assert(spx_mtl_node_set_hash_leaf_shake_batch
+	       (params, &sid, node_left, NULL, 32, hash_ptrs, 32,
+		9) == MTL_NULL_PTR);
+
+	free(params);
+	return 0;
+}
+
+/**
+ * Verify the batched SHA2 leaf and int hashing functions
+ */
+uint8_t test_SPX_mtl_node_set_hash_sha2_batch(void)
+{
+	uint8_t hashes[11][EVP_MAX_MD_SIZE];
+	uint8_t ref[EVP_MAX_MD_SIZE];
+	uint8_t *hash_ptrs[11];
+	uint8_t *left_ptrs[11];
+	uint8_t *right_ptrs[11];
+	uint32_t node_left[11];
+	uint32_t node_right[11];
+	uint32_t hash_lens[] = { 16, 32 };
+	uint32_t len_index;
+	uint32_t mode;
+	uint32_t index;
+	SERIESID sid;
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+
+	for (index = 0; index < 11; index++) {
+		node_left[index] = 2 * index;
+		node_right[index] = (2 * index) + 1;
+		left_ptrs[index] = (uint8_t *) hash_left;
+		right_ptrs[index] = (uint8_t *) hash_right;
+		hash_ptrs[index] = hashes[index];
+	}
+
+	// Unprimed, primed and robust parameters match the single path
+	for (len_index = 0; len_index < 2; len_index++) {
+		params->pk_seed.length = hash_lens[len_index];
+		params->pk_root.length = hash_lens[len_index];
+		params->sha2_seed.ready = 0;
+		for (mode = 0; mode < 3; mode++) {
+			if (mode == 1) {
+				assert(spx_params_init_sha2(params,
+							    hash_lens[len_index]) ==
+				       MTL_OK);
+			}
+			params->robust = (mode == 2);
+
+			memset(hashes, 0, sizeof(hashes));
+			assert(spx_mtl_node_set_hash_int_sha2_batch
+			       (params, &sid, node_left, node_right, left_ptrs,
+				right_ptrs, hash_ptrs, hash_lens[len_index],
+				11) == 0);
+			for (index = 0; index < 11; index++) {
+				memset(ref, 0, EVP_MAX_MD_SIZE);
+				assert(spx_mtl_node_set_hash_int_sha2
+				       (params, &sid, node_left[index],
+					node_right[index], left_ptrs[index],
+					right_ptrs[index], ref,
+					hash_lens[len_index]) == 0);
+				assert(memcmp(hashes[index], ref,
+					      hash_lens[len_index]) == 0);
+			}
+
+			memset(hashes, 0, sizeof(hashes));
+			assert(spx_mtl_node_set_hash_leaf_sha2_batch
+			       (params, &sid, node_left, left_ptrs,
+				hash_lens[len_index], hash_ptrs,
+				hash_lens[len_index], 11) == 0);
+			for (index = 0; index < 11; index++) {
+				memset(ref, 0, EVP_MAX_MD_SIZE);
+				assert(spx_mtl_node_set_hash_leaf_sha2
+				       (params, &sid, node_left[index],
+					left_ptrs[index], hash_lens[len_index],
+					ref, hash_lens[len_index]) == 0);
+				assert(memcmp(hashes[index], ref,
+					      hash_lens[len_index]) == 0);
+			}
+		}
+	}
+
+	assert(spx_mtl_node_set_hash_int_batch
+	       (params, &sid, node_left, node_right, left_ptrs, right_ptrs,
+		hash_ptrs, 32, 11, 0xff) == MTL_BAD_PARAM);
+
+	free(params);
+	return 0;
+}
+
+/**
+ * Verify the specialized node hash kernels match the generic functions
+ */
+uint8_t test_SPX_spx_node_funcs(void)
+{
+	uint8_t hashes[11][EVP_MAX_MD_SIZE];
+	uint8_t ref[EVP_MAX_MD_SIZE];
+	uint8_t *hash_ptrs[11];
+	uint8_t *left_ptrs[11];
+	uint8_t *right_ptrs[11];
+	uint32_t node_left[11];
+	uint32_t node_right[11];
+	uint32_t hash_lens[] = { 16, 24, 32 };
+	uint8_t algorithms[] = { SPX_MTL_SHA2, SPX_MTL_SHAKE };
+	const SPX_NODE_FUNCS *funcs = NULL;
+	uint32_t alg_index;
+	uint32_t len_index;
+	uint32_t hash_len;
+	uint32_t mode;
+	uint32_t index;
+	SERIESID sid;
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	memcpy(sid.id, sid_val, 8);
+	memset(sid.id + 8, 0x5a, 4);
+
+	for (index = 0; index < 11; index++) {
+		node_left[index] = 2 * index;
+		node_right[index] = (2 * index) + 1;
+		left_ptrs[index] = (uint8_t *) hash_left;
+		right_ptrs[index] = (uint8_t *) hash_right;
+		hash_ptrs[index] = hashes[index];
+	}
+
+	// Unselected, selected, robust and long SID parameters all match
+	for (alg_index = 0; alg_index < 2; alg_index++) {
+		for (len_index = 0; len_index < 3; len_index++) {
+			hash_len = hash_lens[len_index];
+			funcs = spx_node_funcs(algorithms[alg_index], hash_len);
+			assert(funcs != NULL);
+			assert(funcs->algorithm == algorithms[alg_index]);
+			assert(funcs->hash_len == hash_len);
+
+			params->pk_seed.length = hash_len;
+			params->pk_root.length = hash_len;
+			params->sha2_seed.ready = 0;
+			params->shake_seed.ready = 0;
+			params->adrs.ready = 0;
+			params->node_funcs = NULL;
+			for (mode = 0; mode < 4; mode++) {
+				params->robust = (mode == 2);
+				sid.length = (mode == 3) ? 12 : 8;
+				if (mode == 1) {
+					assert(spx_params_init_sha2
+					       (params, hash_len) == MTL_OK);
+					assert(spx_params_init_shake(params) ==
+					       MTL_OK);
+					assert(spx_params_init_adrs
+					       (params, &sid) == MTL_OK);
+					assert(spx_params_init_node_funcs
+					       (params, algorithms[alg_index],
+						hash_len) == funcs);
+					assert(params->node_funcs == funcs);
+				} else if (mode == 2) {
+					assert(spx_params_init_node_funcs
+					       (params, algorithms[alg_index],
+						hash_len) == NULL);
+				} else if (mode == 3) {
+					assert(spx_params_init_adrs
+					       (params, &sid) == MTL_OK);
+					assert(params->node_funcs == NULL);
+					assert(spx_params_init_node_funcs
+					       (params, algorithms[alg_index],
+						hash_len) == NULL);
+				}
+
+				memset(hashes, 0, sizeof(hashes));
+				assert(funcs->hash_node_batch
+				       (params, &sid, node_left, node_right,
+					left_ptrs, right_ptrs, hash_ptrs,
+					hash_len, 11) == MTL_OK);
+				for (index = 0; index < 11; index++) {
+					memset(ref, 0, EVP_MAX_MD_SIZE);
+					assert(spx_mtl_node_set_hash_int
+					       (params, &sid, node_left[index],
+						node_right[index],
+						left_ptrs[index],
+						right_ptrs[index], ref,
+						hash_len,
+						algorithms[alg_index]) ==
+					       MTL_OK);
+					assert(memcmp(hashes[index], ref,
+						      hash_len) == 0);
+					memset(hashes[index], 0,
+					       EVP_MAX_MD_SIZE);
+					assert(funcs->hash_node
+					       (params, &sid, node_left[index],
+						node_right[index],
+						left_ptrs[index],
+						right_ptrs[index],
+						hashes[index],
+						hash_len) == MTL_OK);
+					assert(memcmp(hashes[index], ref,
+						      hash_len) == 0);
+				}
+
+				memset(hashes, 0, sizeof(hashes));
+				assert(funcs->hash_leaf_batch
+				       (params, &sid, node_left, left_ptrs,
+					hash_len, hash_ptrs, hash_len,
+					11) == MTL_OK);
+				for (index = 0; index < 11; index++) {
+					memset(ref, 0, EVP_MAX_MD_SIZE);
+					assert(spx_mtl_node_set_hash_leaf
+					       (params, &sid, node_left[index],
+						left_ptrs[index], hash_len,
+						ref, hash_len,
+						algorithms[alg_index]) ==
+					       MTL_OK);
+					assert(memcmp(hashes[index], ref,
+						      hash_len) == 0);
+					memset(hashes[index], 0,
+					       EVP_MAX_MD_SIZE);
+					assert(funcs->hash_leaf
+					       (params, &sid, node_left[index],
+						left_ptrs[index], hash_len,
+						hashes[index],
+						hash_len) == MTL_OK);
+					assert(memcmp(hashes[index], ref,
+						      hash_len) == 0);
+				}
+			}
+
+			// Other data lengths take the generic path
+			sid.length = 8;
+			params->robust = 0;
+			assert(spx_params_init_adrs(params, &sid) == MTL_OK);
+			assert(spx_params_init_node_funcs
+			       (params, algorithms[alg_index],
+				hash_len) == funcs);
+			memset(ref, 0, EVP_MAX_MD_SIZE);
+			assert(spx_mtl_node_set_hash_leaf
+			       (params, &sid, 7, (uint8_t *) hash_left, 5, ref,
+				hash_len, algorithms[alg_index]) == MTL_OK);
+			memset(hashes[0], 0, EVP_MAX_MD_SIZE);
+			assert(funcs->hash_leaf
+			       (params, &sid, 7, (uint8_t *) hash_left, 5,
+				hashes[0], hash_len) == MTL_OK);
+			assert(memcmp(hashes[0], ref, hash_len) == 0);
+		}
+	}
+
+	// Rebuilding the seed state clears the selection
+	assert(params->node_funcs != NULL);
+	assert(spx_params_init_shake(params) == MTL_OK);
+	assert(params->node_funcs == NULL);
+	params->pk_seed.length = 32;
+	assert(spx_params_init_sha2(params, 32) == MTL_OK);
+	assert(spx_params_init_node_funcs(params, SPX_MTL_SHA2, 32) != NULL);
+	assert(spx_params_init_sha2(params, 32) == MTL_OK);
+	assert(params->node_funcs == NULL);
+
+	// The seed state must be for the parameter seed and length
+	params->pk_seed.length = 24;
+	assert(spx_params_init_node_funcs(params, SPX_MTL_SHA2, 24) == NULL);
+	params->pk_seed.length = 32;
+	params->pk_seed.seed[0] ^= 0x01;
+	assert(spx_params_init_node_funcs(params, SPX_MTL_SHA2, 32) == NULL);
+	params->pk_seed.seed[0] ^= 0x01;
+	assert(spx_params_init_node_funcs(params, SPX_MTL_SHA2, 20) == NULL);
+	assert(spx_params_init_node_funcs(NULL, SPX_MTL_SHA2, 32) == NULL);
+
+	assert(spx_node_funcs(SPX_MTL_SHA2, 20) == NULL);
+	assert(spx_node_funcs(0xff, 32) == NULL);
+	funcs = spx_node_funcs(SPX_MTL_SHA2, 32);
+	assert(funcs->hash_leaf(NULL, &sid, 0, (uint8_t *) hash_left, 32,
+				ref, 32) == MTL_NULL_PTR);
+	assert(funcs->hash_node(params, &sid, 0, 1, (uint8_t *) hash_left,
+				(uint8_t *) hash_right, NULL,
+				32) == MTL_NULL_PTR);
+
+	free(params);
+	return 0;
+}
+
+/**
+ * Verify the prebuilt ADRS templates give the same hashes
+ */
+uint8_t test_SPX_spx_params_init_adrs(void)
+{
+	uint8_t adrs[ADRS_ADDR_SIZE];
+	uint8_t hash[EVP_MAX_MD_SIZE];
+	uint8_t ref[EVP_MAX_MD_SIZE];
+	uint8_t algorithms[] = { SPX_MTL_SHA2, SPX_MTL_SHAKE };
+	uint8_t msg_buffer[] = "test_SPX_spx_params_init_adrs";
+	char context_str[] = "MTL_TEST_STR";
+	uint8_t *rmtl_ptr = NULL;
+	uint32_t rmtl_len = 0;
+	const SPX_NODE_FUNCS *funcs = NULL;
+	uint32_t alg_index;
+	uint32_t round;
+	uint8_t type;
+	SERIESID sid;
+	SERIESID other_sid;
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	SPX_PARAMS *plain = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	params->pk_seed.length = 32;
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	params->pk_root.length = 32;
+	memcpy(&params->prf.data, &pubkey[0], 32);
+	params->prf.length = 32;
+	memcpy(plain, params, sizeof(SPX_PARAMS));
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+	memcpy(&other_sid, &sid, sizeof(SERIESID));
+	other_sid.id[7] ^= 0x01;
+
+	assert(spx_params_init_adrs(params, &sid) == MTL_OK);
+	assert(params->adrs.ready == SPX_STATE_READY);
+	for (type = SPX_ADRS_MTL_MSG; type <= SPX_ADRS_MTL_TREE; type++) {
+		mtlns_adrs_compressed(adrs, type, &sid, 0, 0);
+		assert(memcmp(params->adrs.compressed[type - SPX_ADRS_MTL_MSG],
+			      adrs, ADRS_ADDR_SIZE_C) == 0);
+		mtlns_adrs_full(adrs, type, &sid, 0, 0);
+		assert(memcmp(params->adrs.full[type - SPX_ADRS_MTL_MSG],
+			      adrs, ADRS_ADDR_SIZE) == 0);
+	}
+
+	// The matching SID uses the templates, another one builds its own
+	for (alg_index = 0; alg_index < 2; alg_index++) {
+		funcs = spx_node_funcs(algorithms[alg_index], 32);
+		for (round = 0; round < 2; round++) {
+			SERIESID *use_sid = (round == 0) ? &sid : &other_sid;
+
+			memset(ref, 0, EVP_MAX_MD_SIZE);
+			memset(hash, 0, EVP_MAX_MD_SIZE);
+			assert(spx_mtl_node_set_hash_leaf
+			       (plain, use_sid, 5, (uint8_t *) hash_left, 32,
+				ref, 32, algorithms[alg_index]) == MTL_OK);
+			assert(spx_mtl_node_set_hash_leaf
+			       (params, use_sid, 5, (uint8_t *) hash_left, 32,
+				hash, 32, algorithms[alg_index]) == MTL_OK);
+			assert(memcmp(hash, ref, 32) == 0);
+			memset(hash, 0, EVP_MAX_MD_SIZE);
+			assert(funcs->hash_leaf
+			       (params, use_sid, 5, (uint8_t *) hash_left, 32,
+				hash, 32) == MTL_OK);
+			assert(memcmp(hash, ref, 32) == 0);
+
+			memset(ref, 0, EVP_MAX_MD_SIZE);
+			memset(hash, 0, EVP_MAX_MD_SIZE);
+			assert(spx_mtl_node_set_hash_int
+			       (plain, use_sid, 4, 7, (uint8_t *) hash_left,
+				(uint8_t *) hash_right, ref, 32,
+				algorithms[alg_index]) == MTL_OK);
+			assert(spx_mtl_node_set_hash_int
+			       (params, use_sid, 4, 7, (uint8_t *) hash_left,
+				(uint8_t *) hash_right, hash, 32,
+				algorithms[alg_index]) == MTL_OK);
+			assert(memcmp(hash, ref, 32) == 0);
+			memset(hash, 0, EVP_MAX_MD_SIZE);
+			assert(funcs->hash_node
+			       (params, use_sid, 4, 7, (uint8_t *) hash_left,
+				(uint8_t *) hash_right, hash, 32) == MTL_OK);
+			assert(memcmp(hash, ref, 32) == 0);
+
+			rmtl_len = 0;
+			assert(spx_mtl_node_set_hash_message
+			       (plain, use_sid, 3, (uint8_t *) & randomizer[0],
+				randomizer_len, &msg_buffer[0],
+				sizeof(msg_buffer), &ref[0], 32, context_str,
+				&rmtl_ptr, &rmtl_len,
+				algorithms[alg_index]) == MTL_OK);
+			free(rmtl_ptr);
+			rmtl_len = 0;
+			assert(spx_mtl_node_set_hash_message
+			       (params, use_sid, 3, (uint8_t *) & randomizer[0],
+				randomizer_len, &msg_buffer[0],
+				sizeof(msg_buffer), &hash[0], 32, context_str,
+				&rmtl_ptr, &rmtl_len,
+				algorithms[alg_index]) == MTL_OK);
+			free(rmtl_ptr);
+			assert(memcmp(hash, ref, 32) == 0);
+		}
+	}
+
+	sid.length = EVP_MAX_MD_SIZE + 1;
+	assert(spx_params_init_adrs(params, &sid) == MTL_BAD_PARAM);
+	assert(params->adrs.ready != SPX_STATE_READY);
+	assert(spx_params_init_adrs(NULL, &sid) == MTL_NULL_PTR);
+	assert(spx_params_init_adrs(params, NULL) == MTL_NULL_PTR);
+
+	free(params);
+	free(plain);
+	return 0;
+}
+
+/**
+ * Worker for test_SPX_hash_threads, hashes nodes into its own slice
+ */
+typedef struct SPX_THREAD_TEST {
+	SPX_PARAMS *params;
+	uint8_t algorithm;
+	uint32_t first;
+	uint8_t hashes[64][32];
+} SPX_THREAD_TEST;
+
+static void *test_SPX_hash_thread(void *arg)
+{
+	SPX_THREAD_TEST *task = arg;
+	SERIESID sid;
+	uint32_t index;
+
+	sid.length = 8;
+	memcpy(sid.id, sid_val, 8);
+	for (index = 0; index < 64; index++) {
+		if (task->algorithm == SPX_MTL_SHA2) {
+			spx_mtl_node_set_hash_int_sha2(task->params, &sid,
+						       task->first + index,
+						       task->first + index + 1,
+						       (uint8_t *) hash_left,
+						       (uint8_t *) hash_right,
+						       task->hashes[index], 16);
+		} else {
+			spx_mtl_node_set_hash_int_shake(task->params, &sid,
+							task->first + index,
+							task->first + index + 1,
+							(uint8_t *) hash_left,
+							(uint8_t *) hash_right,
+							task->hashes[index], 32);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Verify shared parameters hash the same on many threads
+ */
+uint8_t test_SPX_hash_threads(void)
+{
+	SPX_THREAD_TEST tasks[4];
+	SPX_THREAD_TEST serial;
+	pthread_t threads[4];
+	uint8_t algorithms[] = { SPX_MTL_SHA2, SPX_MTL_SHAKE };
+	uint32_t algo;
+	uint32_t index;
+
+	SPX_PARAMS *params = malloc(sizeof(SPX_PARAMS));
+	memset(params, 0, sizeof(SPX_PARAMS));
+	memcpy(&params->pk_seed.seed, &seed[0], 32);
+	params->pk_seed.length = 32;
+	memcpy(&params->pk_root.key, &pubkey[0], 32);
+	params->pk_root.length = 32;
+	assert(spx_params_init_sha2(params, 16) == MTL_OK);
+	assert(spx_params_init_shake(params) == MTL_OK);
+
+	for (algo = 0; algo < 2; algo++) {
+		for (index = 0; index < 4; index++) {
+			tasks[index].params = params;
+			tasks[index].algorithm = algorithms[algo];
+			tasks[index].first = index * 64;
+			assert(pthread_create(&threads[index], NULL,
+					      test_SPX_hash_thread,
+					      &tasks[index]) == 0);
+		}
+		for (index = 0; index < 4; index++) {
+			assert(pthread_join(threads[index], NULL) == 0);
+		}
+
+		// Every threaded slice matches a serial run of the same nodes
+		for (index = 0; index < 4; index++) {
+			serial.params = params;
+			serial.algorithm = algorithms[algo];
+			serial.first = index * 64;
+			test_SPX_hash_thread(&serial);
+			assert(memcmp(serial.hashes, tasks[index].hashes,
+				      sizeof(serial.hashes)) == 0);
+		}
+	}
+
+	free(params);
+	return 0;
+}
+
 /**
  * Verify the spx_sha2 message prf function
  */
@@ -1947,3 +3005,30 @@ uint8_t test_SPX_spx_mtl_prf_shake(void)
 	return 0;
 
 }
+
+/**
+ * Verify the known answers again with every digest from a provider
+ */
+uint8_t test_SPX_provider_mode(void)
+{
+	spx_md_set_provider_only(1);
+	assert(spx_md_provider_only() == 1);
+
+	assert(test_SPX_spx_sha2() == 0);
+	assert(test_SPX_spx_shake() == 0);
+	assert(test_SPX_spx_sha2_batch() == 0);
+	assert(test_SPX_mtl_node_set_hash_message() == 0);
+	assert(test_SPX_mtl_node_set_hash_message_stream() == 0);
+	assert(test_SPX_mtl_node_set_hash_message_cached() == 0);
+	assert(test_SPX_mtl_node_set_hash_leaf_robust() == 0);
+	assert(test_SPX_mtl_node_set_hash_int_robust() == 0);
+	assert(test_SPX_mtl_node_set_hash_sha2_batch() == 0);
+	assert(test_SPX_mtl_node_set_hash_shake_batch() == 0);
+	assert(test_SPX_spx_node_funcs() == 0);
+	assert(test_SPX_hash_threads() == 0);
+	assert(test_SPX_spx_mtl_prf_sha2() == 0);
+	assert(test_SPX_spx_mtl_prf_shake() == 0);
+
+	spx_md_set_provider_only(0);
+	return 0;
+}
@@ -35,6 +35,8 @@
 #include "mtl_spx.h"
 #include "spx_funcs.h"
 #include <assert.h>
+#include <openssl/hmac.h>
+#include <pthread.h>
 #include <string.h>
 
 #include "mtltest.h"
@@ -46,6 +48,13 @@ uint8_t mtltest_spx_funcs_mgf1_512(void);
 uint8_t mtltest_spx_funcs_sha256(void);
 uint8_t mtltest_spx_funcs_sha512(void);
 uint8_t mtltest_spx_funcs_shake256(void);
+uint8_t mtltest_spx_funcs_sha2_multipart(void);
+uint8_t mtltest_spx_funcs_hmac_sha2_keyed(void);
+uint8_t mtltest_spx_funcs_sha256_compress(void);
+uint8_t mtltest_spx_funcs_shake256_blocks(void);
+uint8_t mtltest_spx_funcs_sha2_batch(void);
+uint8_t mtltest_spx_funcs_shake_batch(void);
+uint8_t mtltest_spx_funcs_provider(void);
 
 uint8_t mtltest_spx_funcs(void)
 {
@@ -57,6 +66,20 @@ uint8_t mtltest_spx_funcs(void)
 	RUN_TEST(mtltest_spx_funcs_sha256, "Verify SHA256 function");
 	RUN_TEST(mtltest_spx_funcs_sha512, "Verify SHA512 function");
 	RUN_TEST(mtltest_spx_funcs_shake256, "Verify SHAKE256 function");
+	RUN_TEST(mtltest_spx_funcs_sha2_multipart,
+		 "Verify multi-part SHA2 and HMAC functions");
+	RUN_TEST(mtltest_spx_funcs_hmac_sha2_keyed,
+		 "Verify HMAC-SHA2 from precomputed key pads");
+	RUN_TEST(mtltest_spx_funcs_sha256_compress,
+		 "Verify the native SHA-256 compression backend");
+	RUN_TEST(mtltest_spx_funcs_shake256_blocks,
+		 "Verify SHAKE256 across block boundaries");
+	RUN_TEST(mtltest_spx_funcs_sha2_batch,
+		 "Verify multi-buffer SHA2 against the scalar path");
+	RUN_TEST(mtltest_spx_funcs_shake_batch,
+		 "Verify 4-way SHAKE256 against the scalar path");
+	RUN_TEST(mtltest_spx_funcs_provider,
+		 "Verify the fetched digests and provider mode on many threads");
 
 	return 0;
 }
@@ -346,3 +369,548 @@ uint8_t mtltest_spx_funcs_shake256(void)
 
 	return 0;
 }
+
+/**
+ * Test the multi-part SHA2 and HMAC functions
+ */
+uint8_t mtltest_spx_funcs_sha2_multipart(void)
+{
+	uint8_t buffer[300];
+	uint8_t key[200];
+	uint8_t out_buffer[EVP_MAX_MD_SIZE];
+	uint8_t ref_buffer[EVP_MAX_MD_SIZE];
+	uint32_t ref_len = 0;
+	uint32_t key_lens[] = { 16, 32, 64, 65, 128, 129, 200 };
+	uint32_t hash_lens[] = { 16, 32 };
+	uint32_t index;
+	uint32_t key_index;
+	SHA2_STATE state;
+
+	for (index = 0; index < sizeof(buffer); index++) {
+		buffer[index] = (uint8_t) (index * 13 + 1);
+	}
+	for (index = 0; index < sizeof(key); index++) {
+		key[index] = (uint8_t) (index * 5 + 7);
+	}
+
+	// Multi-part digest matches the one-shot functions
+	sha2_init(&state, 16);
+	sha2_update(&state, buffer, 100);
+	sha2_update(&state, buffer + 100, 200);
+	assert(sha2_final(out_buffer, &state) == 32);
+	sha256(ref_buffer, buffer, 300);
+	assert(memcmp(out_buffer, ref_buffer, 32) == 0);
+
+	sha2_init(&state, 32);
+	sha2_update(&state, buffer, 1);
+	sha2_update(&state, buffer + 1, 299);
+	assert(sha2_final(out_buffer, &state) == 64);
+	sha512(ref_buffer, buffer, 300);
+	assert(memcmp(out_buffer, ref_buffer, 64) == 0);
+
+	// HMAC of two parts matches OpenSSL HMAC over the concatenation
+	for (index = 0; index < 2; index++) {
+		for (key_index = 0; key_index < sizeof(key_lens) / sizeof(uint32_t);
+		     key_index++) {
+			memset(out_buffer, 0, EVP_MAX_MD_SIZE);
+			memset(ref_buffer, 0, EVP_MAX_MD_SIZE);
+			hmac_sha2(out_buffer, key, key_lens[key_index], buffer, 40,
+				  buffer + 40, 260, hash_lens[index]);
+			assert(HMAC(hash_lens[index] <= 16 ? EVP_sha256() :
+				    EVP_sha512(), key, key_lens[key_index],
+				    buffer, 300, ref_buffer, &ref_len) != NULL);
+			assert(memcmp(out_buffer, ref_buffer, ref_len) == 0);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Test HMAC-SHA2 from precomputed key pads against the one-shot HMAC
+ */
+uint8_t mtltest_spx_funcs_hmac_sha2_keyed(void)
+{
+	uint8_t buffer[300];
+	uint8_t key[SHA2_512_BLOCK_SIZE + 1];
+	uint8_t out_buffer[EVP_MAX_MD_SIZE];
+	uint8_t ref_buffer[EVP_MAX_MD_SIZE];
+	uint32_t key_lens[] = { 16, 32, 64, 65, 128 };
+	uint32_t hash_lens[] = { 16, 32 };
+	uint32_t index;
+	uint32_t key_index;
+	uint32_t msg_index;
+	HMAC_SHA2_STATE state;
+
+	for (index = 0; index < sizeof(buffer); index++) {
+		buffer[index] = (uint8_t) (index * 11 + 3);
+	}
+	for (index = 0; index < sizeof(key); index++) {
+		key[index] = (uint8_t) (index * 3 + 1);
+	}
+
+	// One key state serves every message
+	for (index = 0; index < 2; index++) {
+		for (key_index = 0; key_index < sizeof(key_lens) / sizeof(uint32_t);
+		     key_index++) {
+			assert(hmac_sha2_state_init(&state, key, key_lens[key_index],
+						    hash_lens[index]) == MTL_OK);
+			assert(state.ready == SPX_STATE_READY);
+			for (msg_index = 1; msg_index < sizeof(buffer); msg_index += 37) {
+				memset(out_buffer, 0, EVP_MAX_MD_SIZE);
+				memset(ref_buffer, 0, EVP_MAX_MD_SIZE);
+				hmac_sha2_keyed(out_buffer, &state, buffer, msg_index,
+						buffer + msg_index,
+						sizeof(buffer) - msg_index);
+				hmac_sha2(ref_buffer, key, key_lens[key_index], buffer,
+					  sizeof(buffer), NULL, 0, hash_lens[index]);
+				assert(memcmp(out_buffer, ref_buffer, EVP_MAX_MD_SIZE) == 0);
+			}
+		}
+	}
+
+	// Keys that cannot be kept for comparison are refused
+	assert(hmac_sha2_state_init(&state, key, sizeof(key), 32) == MTL_BAD_PARAM);
+	assert(hmac_sha2_state_init(&state, key, 0, 32) == MTL_BAD_PARAM);
+	assert(hmac_sha2_state_init(&state, NULL, 32, 32) == MTL_BAD_PARAM);
+	assert(hmac_sha2_state_init(NULL, key, 32, 32) == MTL_BAD_PARAM);
+
+	// An unprimed state leaves the output alone
+	state.ready = 0;
+	memset(out_buffer, 0, EVP_MAX_MD_SIZE);
+	hmac_sha2_keyed(out_buffer, &state, buffer, 10, buffer, 10);
+	memset(ref_buffer, 0, EVP_MAX_MD_SIZE);
+	assert(memcmp(out_buffer, ref_buffer, EVP_MAX_MD_SIZE) == 0);
+
+	return 0;
+}
+
+/**
+ * Verify the native SHA-256 compression against OpenSSL
+ */
+uint8_t mtltest_spx_funcs_sha256_compress(void)
+{
+	uint8_t block[SHA2_256_BLOCK_SIZE] = { 'a', 'b', 'c', 0x80 };
+	uint8_t abc_digest[] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+		0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+		0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+	};
+	uint32_t chain[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	uint8_t buffer[200];
+	uint8_t out_buffer[EVP_MAX_MD_SIZE];
+	uint8_t ref_buffer[EVP_MAX_MD_SIZE];
+	uint32_t data_lens[] = { 16, 32, 100 };
+	SHA2_SEED_STATE seed_state;
+	SHA2_STATE ref_state;
+	uint32_t index;
+
+	// One padded block for "abc" (24 bits)
+	block[SHA2_256_BLOCK_SIZE - 1] = 24;
+	sha256_compress(chain, block, 1);
+	for (index = 0; index < 8; index++) {
+		assert(chain[index] ==
+		       (((uint32_t) abc_digest[4 * index] << 24) |
+			((uint32_t) abc_digest[4 * index + 1] << 16) |
+			((uint32_t) abc_digest[4 * index + 2] << 8) |
+			(uint32_t) abc_digest[4 * index + 3]));
+	}
+
+	// Every tail length around the block and padding boundaries
+	for (index = 0; index < sizeof(buffer); index++) {
+		buffer[index] = (uint8_t) (index * 7 + 3);
+	}
+	for (index = 1; index <= sizeof(buffer); index++) {
+		sha256(out_buffer, buffer, index);
+		SHA256(buffer, index, ref_buffer);
+		assert(memcmp(out_buffer, ref_buffer, SHA256_DIGEST_LENGTH) ==
+		       0);
+	}
+
+	// Seeded tree hashes, including a tail longer than two blocks
+	assert(sha2_seed_state_init(&seed_state, buffer, 16, 16) == MTL_OK);
+	for (index = 0; index < 3; index++) {
+		memset(out_buffer, 0, sizeof(out_buffer));
+		sha2_seeded(out_buffer, &seed_state, buffer + 16, 22,
+			    buffer + 38, data_lens[index]);
+		ref_state = seed_state.digest;
+		sha2_update(&ref_state, buffer + 16, 22);
+		sha2_update(&ref_state, buffer + 38, data_lens[index]);
+		sha2_final(ref_buffer, &ref_state);
+		assert(memcmp(out_buffer, ref_buffer, SHA256_DIGEST_LENGTH) ==
+		       0);
+	}
+
+	assert(sha256_ni_enabled() <= 1);
+	return 0;
+}
+
+/**
+ * Test the SHAKE256 sponge against OpenSSL across block boundaries
+ */
+uint8_t mtltest_spx_funcs_shake256_blocks(void)
+{
+	uint8_t buffer[400];
+	uint8_t out_buffer[300];
+	uint8_t ref_buffer[300];
+	size_t lens[] = { 1, 135, 136, 137, 271, 272, 400 };
+	uint32_t index;
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+
+	for (index = 0; index < sizeof(buffer); index++) {
+		buffer[index] = (uint8_t) (index * 11 + 5);
+	}
+
+	for (index = 0; index < sizeof(lens) / sizeof(size_t); index++) {
+		shake256(out_buffer, buffer, lens[index], sizeof(out_buffer));
+		assert(EVP_DigestInit_ex(mdctx, EVP_shake256(), NULL) == 1);
+		assert(EVP_DigestUpdate(mdctx, buffer, lens[index]) == 1);
+		assert(EVP_DigestFinalXOF(mdctx, ref_buffer,
+					  sizeof(ref_buffer)) == 1);
+		assert(memcmp(out_buffer, ref_buffer, sizeof(out_buffer)) == 0);
+	}
+
+	EVP_MD_CTX_free(mdctx);
+	return 0;
+}
+
+/**
+ * Test the multi-buffer SHA2 batch against the scalar seeded hash
+ */
+uint8_t mtltest_spx_funcs_sha2_batch(void)
+{
+	uint8_t seed[32];
+	uint8_t adrs[20][22];
+	uint8_t data[20][600];
+	uint8_t out[20][EVP_MAX_MD_SIZE];
+	uint8_t ref[EVP_MAX_MD_SIZE];
+	uint8_t *adrs_ptrs[20];
+	uint8_t *data_ptrs[20];
+	uint8_t *out_ptrs[20];
+	uint32_t hash_lens[] = { 16, 32 };
+	size_t data_lens[] = { 16, 32, 64, 150, 480 };
+	uint32_t counts[] = { 1, 4, 7, 8, 9, 17, 20 };
+	uint32_t hash_index;
+	uint32_t len_index;
+	uint32_t count_index;
+	uint32_t index;
+	uint32_t lanes;
+	SHA2_SEED_STATE state;
+
+	memset(seed, 0x5a, sizeof(seed));
+	for (index = 0; index < 20; index++) {
+		memset(adrs[index], (int)index, 22);
+		memset(data[index], (int)(index * 3 + 1), 600);
+		adrs_ptrs[index] = adrs[index];
+		data_ptrs[index] = data[index];
+		out_ptrs[index] = out[index];
+	}
+
+	for (hash_index = 0; hash_index < 2; hash_index++) {
+		assert(sha2_seed_state_init(&state, seed, 32,
+					    hash_lens[hash_index]) == 0);
+		for (len_index = 0; len_index < sizeof(data_lens) / sizeof(size_t);
+		     len_index++) {
+			for (count_index = 0;
+			     count_index < sizeof(counts) / sizeof(uint32_t);
+			     count_index++) {
+				memset(out, 0, sizeof(out));
+				sha2_seeded_batch(out_ptrs, &state, adrs_ptrs, 22,
+						  data_ptrs, data_lens[len_index],
+						  counts[count_index]);
+				for (index = 0; index < counts[count_index]; index++) {
+					sha2_seeded(ref, &state, adrs[index], 22,
+						    data[index], data_lens[len_index]);
+					assert(memcmp(out[index], ref,
+						      hash_lens[hash_index] <= 16 ?
+						      32 : 64) == 0);
+				}
+			}
+
+			// Known answers straight from the multi-buffer backend
+			lanes = sha2_avx2_lanes(&state.digest, 22 + data_lens[len_index]);
+			if (lanes > 0) {
+				memset(out, 0, sizeof(out));
+				sha2_avx2_seeded(out_ptrs, &state.digest, adrs_ptrs, 22,
+						 data_ptrs, data_lens[len_index]);
+				for (index = 0; index < lanes; index++) {
+					sha2_seeded(ref, &state, adrs[index], 22,
+						    data[index], data_lens[len_index]);
+					assert(memcmp(out[index], ref,
+						      hash_lens[hash_index] <= 16 ?
+						      32 : 64) == 0);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Test the 4-way SHAKE256 batch against the scalar seeded hash
+ */
+uint8_t mtltest_spx_funcs_shake_batch(void)
+{
+	uint8_t seed[SHA2_512_BLOCK_SIZE];
+	uint8_t adrs[9][32];
+	uint8_t data[9][600];
+	uint8_t out[9][SHAKE256_RATE];
+	uint8_t ref[SHAKE256_RATE];
+	uint8_t *adrs_ptrs[9];
+	uint8_t *data_ptrs[9];
+	uint8_t *out_ptrs[9];
+	uint32_t seed_lens[] = { 16, 32, 100, 128 };
+	size_t data_lens[] = { 16, 64, 104, 105, 300, 600 };
+	size_t hash_lens[] = { 16, 32, 136 };
+	uint32_t seed_index;
+	uint32_t len_index;
+	uint32_t hash_index;
+	uint32_t count;
+	uint32_t index;
+	SHAKE_SEED_STATE state;
+
+	memset(seed, 0x3c, sizeof(seed));
+	for (index = 0; index < 9; index++) {
+		memset(adrs[index], (int)(index + 1), 32);
+		memset(data[index], (int)(index * 5 + 2), 600);
+		adrs_ptrs[index] = adrs[index];
+		data_ptrs[index] = data[index];
+		out_ptrs[index] = out[index];
+	}
+
+	// Vary where the tail starts in the sponge block and how long it is
+	for (seed_index = 0; seed_index < 4; seed_index++) {
+		assert(shake_seed_state_init(&state, seed,
+					     seed_lens[seed_index]) == 0);
+		for (len_index = 0; len_index < sizeof(data_lens) / sizeof(size_t);
+		     len_index++) {
+			for (hash_index = 0; hash_index < 3; hash_index++) {
+				for (count = 1; count <= 9; count += 4) {
+					memset(out, 0, sizeof(out));
+					shake_seeded_batch(out_ptrs, &state, adrs_ptrs,
+							   32, data_ptrs,
+							   data_lens[len_index],
+							   hash_lens[hash_index], count);
+					for (index = 0; index < count; index++) {
+						shake_seeded(ref, &state, adrs[index], 32,
+							     data[index],
+							     data_lens[len_index],
+							     hash_lens[hash_index]);
+						assert(memcmp(out[index], ref,
+							      hash_lens[hash_index]) == 0);
+					}
+				}
+			}
+
+			// Known answers straight from the 4-way backend
+			if (shake256x4_lanes(&state.sponge, 32 + data_lens[len_index],
+					     32) > 0) {
+				memset(out, 0, sizeof(out));
+				shake256x4(out_ptrs, &state.sponge, adrs_ptrs, 32,
+					   data_ptrs, data_lens[len_index], 32);
+				for (index = 0; index < 4; index++) {
+					shake_seeded(ref, &state, adrs[index], 32,
+						     data[index], data_lens[len_index],
+						     32);
+					assert(memcmp(out[index], ref, 32) == 0);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Worker for mtltest_spx_funcs_provider, hashes with two alternating
+ * seeds and keys so the per-thread midstates are rebuilt and reused
+ */
+typedef struct SPX_FUNCS_PROVIDER_TEST {
+	SHA2_SEED_STATE sha2_seed[2];
+	SHAKE_SEED_STATE shake_seed[2];
+	HMAC_SHA2_STATE hmac[2];
+	uint8_t buffer[300];
+	uint8_t seeded[2][SHA512_DIGEST_LENGTH];
+	uint8_t batch[2][9][SHA512_DIGEST_LENGTH];
+	uint8_t shake[2][32];
+	uint8_t mac[2][SHA512_DIGEST_LENGTH];
+	uint8_t digest[SHA512_DIGEST_LENGTH];
+	uint8_t xof[100];
+} SPX_FUNCS_PROVIDER_TEST;
+
+static void mtltest_spx_funcs_provider_hash(SPX_FUNCS_PROVIDER_TEST * test,
+					    uint8_t seeded[2][SHA512_DIGEST_LENGTH],
+					    uint8_t batch[2][9][SHA512_DIGEST_LENGTH],
+					    uint8_t shake[2][32],
+					    uint8_t mac[2][SHA512_DIGEST_LENGTH])
+{
+	uint8_t *out_ptrs[9];
+	uint8_t *adrs_ptrs[9];
+	uint8_t *data_ptrs[9];
+	uint32_t index;
+	uint32_t lane;
+
+	for (index = 0; index < 2; index++) {
+		sha2_seeded(seeded[index], &test->sha2_seed[index],
+			    test->buffer, 22, test->buffer + 22, 64);
+		for (lane = 0; lane < 9; lane++) {
+			out_ptrs[lane] = batch[index][lane];
+			adrs_ptrs[lane] = test->buffer + lane;
+			data_ptrs[lane] = test->buffer + 100 + lane;
+		}
+		sha2_seeded_batch(out_ptrs, &test->sha2_seed[index], adrs_ptrs,
+				  22, data_ptrs, 32, 9);
+		shake_seeded(shake[index], &test->shake_seed[index],
+			     test->buffer, 32, test->buffer + 32, 64, 32);
+		hmac_sha2_keyed(mac[index], &test->hmac[index], test->buffer,
+				100, test->buffer + 100, 200);
+	}
+}
+
+static void *mtltest_spx_funcs_provider_thread(void *arg)
+{
+	SPX_FUNCS_PROVIDER_TEST *test = arg;
+	uint8_t seeded[2][SHA512_DIGEST_LENGTH];
+	uint8_t batch[2][9][SHA512_DIGEST_LENGTH];
+	uint8_t shake[2][32];
+	uint8_t mac[2][SHA512_DIGEST_LENGTH];
+	uint8_t digest[SHA512_DIGEST_LENGTH];
+	uint8_t xof[100];
+	uint32_t round;
+
+	for (round = 0; round < 16; round++) {
+		memset(seeded, 0, sizeof(seeded));
+		memset(batch, 0, sizeof(batch));
+		memset(shake, 0, sizeof(shake));
+		memset(mac, 0, sizeof(mac));
+		mtltest_spx_funcs_provider_hash(test, seeded, batch, shake, mac);
+		assert(memcmp(seeded, test->seeded, sizeof(seeded)) == 0);
+		assert(memcmp(batch, test->batch, sizeof(batch)) == 0);
+		assert(memcmp(shake, test->shake, sizeof(shake)) == 0);
+		assert(memcmp(mac, test->mac, sizeof(mac)) == 0);
+
+		sha512(digest, test->buffer, sizeof(test->buffer));
+		assert(memcmp(digest, test->digest, sizeof(digest)) == 0);
+		shake256(xof, test->buffer, sizeof(test->buffer), sizeof(xof));
+		assert(memcmp(xof, test->xof, sizeof(xof)) == 0);
+	}
+	return NULL;
+}
+
+/**
+ * Test the fetched digests and provider mode against the native code
+ * and OpenSSL one-shot digests on several threads
+ */
+uint8_t mtltest_spx_funcs_provider(void)
+{
+	SPX_FUNCS_PROVIDER_TEST *tests[2];
+	uint8_t out_buffer[EVP_MAX_MD_SIZE];
+	uint8_t ref_buffer[EVP_MAX_MD_SIZE];
+	uint8_t xof[100];
+	uint32_t hash_lens[] = { 16, 32 };
+	uint32_t key_lens[] = { 32, 64 };
+	unsigned int ref_len = 0;
+	pthread_t threads[4];
+	uint32_t index;
+	uint32_t seed;
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+
+	assert(mdctx != NULL);
+	assert(spx_md(SPX_MD_SHA256) != NULL);
+	assert(spx_md(SPX_MD_SHA512) != NULL);
+	assert(spx_md(SPX_MD_SHAKE256) != NULL);
+	assert(spx_md(SPX_MD_COUNT) == NULL);
+	assert(spx_md(SPX_MD_SHA256) == spx_md(SPX_MD_SHA256));
+	assert(spx_md_msg_ctx() != NULL);
+	assert(spx_md_msg_ctx() == spx_md_msg_ctx());
+
+	// Native reference values for both hash lengths
+	for (index = 0; index < 2; index++) {
+		tests[index] = calloc(1, sizeof(SPX_FUNCS_PROVIDER_TEST));
+		assert(tests[index] != NULL);
+		for (seed = 0; seed < sizeof(tests[index]->buffer); seed++) {
+			tests[index]->buffer[seed] = (uint8_t) (seed * 13 + index);
+		}
+		for (seed = 0; seed < 2; seed++) {
+			assert(sha2_seed_state_init(&tests[index]->sha2_seed[seed],
+						    tests[index]->buffer + 200 + seed,
+						    hash_lens[index],
+						    hash_lens[index]) == MTL_OK);
+			assert(shake_seed_state_init(&tests[index]->shake_seed[seed],
+						     tests[index]->buffer + 200 + seed,
+						     32) == MTL_OK);
+			assert(hmac_sha2_state_init(&tests[index]->hmac[seed],
+						    tests[index]->buffer + 100 + seed,
+						    key_lens[seed],
+						    hash_lens[index]) == MTL_OK);
+		}
+		spx_md_set_provider_only(0);
+		mtltest_spx_funcs_provider_hash(tests[index], tests[index]->seeded,
+						tests[index]->batch,
+						tests[index]->shake,
+						tests[index]->mac);
+		SHA512(tests[index]->buffer, sizeof(tests[index]->buffer),
+		       tests[index]->digest);
+		assert(EVP_DigestInit_ex(mdctx, EVP_shake256(), NULL) == 1);
+		assert(EVP_DigestUpdate(mdctx, tests[index]->buffer,
+					sizeof(tests[index]->buffer)) == 1);
+		assert(EVP_DigestFinalXOF(mdctx, tests[index]->xof,
+					  sizeof(tests[index]->xof)) == 1);
+
+		// The keyed MAC matches OpenSSL HMAC
+		HMAC(hash_lens[index] <= 16 ? EVP_sha256() : EVP_sha512(),
+		     tests[index]->buffer + 101, key_lens[1], tests[index]->buffer,
+		     sizeof(tests[index]->buffer), ref_buffer, &ref_len);
+		assert(memcmp(tests[index]->mac[1], ref_buffer, ref_len) == 0);
+	}
+
+	// The one-shot digests match OpenSSL, including an empty input
+	assert(spx_md_digest(SPX_MD_SHA256, out_buffer, 32, tests[0]->buffer,
+			     100, tests[0]->buffer + 100, 100,
+			     tests[0]->buffer + 200, 100) == MTL_OK);
+	assert(EVP_Digest(tests[0]->buffer, 300, ref_buffer, NULL,
+			  EVP_sha256(), NULL) == 1);
+	assert(memcmp(out_buffer, ref_buffer, SHA256_DIGEST_LENGTH) == 0);
+	assert(spx_md_digest(SPX_MD_SHA256, out_buffer, 32, NULL, 0, NULL, 0,
+			     NULL, 0) == MTL_OK);
+	assert(EVP_Digest(NULL, 0, ref_buffer, NULL, EVP_sha256(), NULL) == 1);
+	assert(memcmp(out_buffer, ref_buffer, SHA256_DIGEST_LENGTH) == 0);
+	assert(spx_md_digest(SPX_MD_SHAKE256, xof, sizeof(xof),
+			     tests[0]->buffer, 300, NULL, 0, NULL, 0) == MTL_OK);
+	assert(memcmp(xof, tests[0]->xof, sizeof(xof)) == 0);
+	assert(spx_md_digest(SPX_MD_SHA256, NULL, 32, tests[0]->buffer, 1,
+			     NULL, 0, NULL, 0) == MTL_NULL_PTR);
+	assert(spx_md_digest(SPX_MD_SHA256, out_buffer, 32, NULL, 1, NULL, 0,
+			     NULL, 0) == MTL_NULL_PTR);
+	assert(spx_md_digest(SPX_MD_COUNT, out_buffer, 32, tests[0]->buffer,
+			     1, NULL, 0, NULL, 0) != MTL_OK);
+
+	// Provider mode gives the native answers on every thread
+	spx_md_set_provider_only(1);
+	assert(spx_md_provider_only() == 1);
+	for (index = 0; index < 4; index++) {
+		assert(pthread_create(&threads[index], NULL,
+				      mtltest_spx_funcs_provider_thread,
+				      tests[index % 2]) == 0);
+	}
+	for (index = 0; index < 4; index++) {
+		assert(pthread_join(threads[index], NULL) == 0);
+	}
+	mtltest_spx_funcs_provider_thread(tests[0]);
+	mtltest_spx_funcs_provider_thread(tests[1]);
+
+	// A FIPS library context stays in provider mode
+	spx_md_set_provider_only(0);
+	assert(spx_md_provider_only() ==
+	       EVP_default_properties_is_fips_enabled(NULL));
+
+	free(tests[0]);
+	free(tests[1]);
+	EVP_MD_CTX_free(mdctx);
+	return 0;
+}